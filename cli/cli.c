@@ -71,6 +71,8 @@
 #include "cli_status.h"
 #include "cli_set_serial.h"
 #include "cli_set_ssid.h"
+#include "cli_bench.h"
+#include "trace.h"
 #include "print_dct.h"
 #include "cli.h"
 
@@ -105,6 +107,7 @@ enum cli_states {
 enum cmds {				// Must match commands variable order
 	CLI_HELP, 			// ?
 	CLI_AT_CMD,			// AT Commands
+    CLI_BENCH,          // Benchmarks, current code against the method it replaced
 	CLI_BLE_SCAN_PRINT,	// Print results of BLE Scan
 	CLI_BLE_SCAN_START,	// Start a background BLE scan
 	CLI_BLE_SCAN_STOP,	// Stop a background BLE scan
@@ -120,6 +123,7 @@ enum cmds {				// Must match commands variable order
 	CLI_LED,			// Set the LED and Mode
     CLI_LOG,            // Enable/Disable Log
     CLI_NTP,
+    CLI_OTA_VERIFY,     // Read back and check OTA images
 	CLI_DUMP_MEMORY,	// dump internal memory
 	CLI_MFG_TEST,       // Do a manufacturing test / function
     CLI_REBOOT,         // reboot
@@ -128,6 +132,7 @@ enum cmds {				// Must match commands variable order
 	CLI_PRINT_STATUS,	// s
     CLI_SET_SERIAL,     // Set the serial number of a unit
 	CLI_SSID,			// set SSID and passphrase
+    CLI_TRACE,          // Print the binary trace
 	NO_CMDS
 };
 /******************************************************
@@ -168,6 +173,7 @@ static uint16_t terminal_cmd_index, telnet_cmd_index, *cmd_index, cmd_found;
 cli_commands_t command[ NO_CMDS ] = {
 		{ "?",	&cli_help, NO_CMDS,  "Print this help" },	// Help
 		{ "AT", &cli_at, 0, "AT Commands &IC/&IS to set Controls & Sensor values" },
+        { "bench", &cli_bench, 0, "bench [ xmit [ <pending> ] | encode [ <samples> ] | msg [ <bytes> ] ] - Time the current code against the method it replaced, all benchmarks with no option" },
 		{ "boot", &cli_boot, 0, "boot <n>, boot to image n where image should be: 2 - Factory Reset, 3 OTA App, 5 - APP0 or 6 APP1" },
 		{ "ble_print", &print_ble_scan_results, 0, "Print BLE Scan Results" },
 		{ "ble_start", &ble_scan, true, "Start background BLE Scan" },
@@ -184,6 +190,7 @@ cli_commands_t command[ NO_CMDS ] = {
 		{ "log", &cli_log, 0, "log <on|off> Enable/Disable Logging to iMatrix" },
 		{ "m", &cli_dump, DUMP_MEMORY, "m [ <start address> ] [ <length> ] if no start, start at 0, if no length, print out 1k of SRAM data" },
 		{ "ntp", &cli_ntp, 0, "ntp - Retry get NTP" },
+		{ "ota_verify", &cli_ota_verify, 0, "ota_verify <on|off> - Read back each OTA image from SFLASH and check its SHA-256" },
 		{ "mfg", mfg_test, 0, "mfg <test/function number>" },
 		{ "reboot", &cli_reboot, 0, "reboot the device" },	// reboot the device
 		{ "reset", (void*) &imatrix_load_config, true, "Reset the configuration of the device to factory defaults" },
@@ -191,6 +198,7 @@ cli_commands_t command[ NO_CMDS ] = {
 		{ "setup", &cli_wifi_setup, 0, "setup <on | off> - Sets to use Soft AP to provision" },
         { "set_serial", &cli_set_serial, 0, "Set the serial number of a unit <serial number>" },    // Set SSID and PSK
 		{ "ssid", &cli_set_ssid, 0, "Set the SSID and PSK for WPA2PSK mode. ssid <ssid> <passphrase>" },	// Set SSID and PSK
+        { "trace", &cli_trace, 0, "trace [ raw | clear | flash [ on | off ] ] - Print the binary trace, raw words for host decoding or the flash mirror" },
 };
 /******************************************************
  *               Function Definitions
@@ -0,0 +1,684 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file cli_bench.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Benchmarks run from the CLI. Each one times the current code against the method it replaced on the same data, checks
+ *  both give the right result and prints the rate of each and the ratio. The main loop is held for the length of a run.
+ *
+ *      bench xmit [ <pending> ]    pending confirmables handled - timed (heap) list against the linked list
+ *      bench encode [ <samples> ]  upload blocks encoded - sample_encode against copy out then byte swap in place
+ *      bench msg [ <bytes> ]       message pool get / release pairs with 1 to 3 threads - header only clearing and
+ *                                  counted free lists against clearing the data block and walking the free list
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../device/icb_def.h"
+#include "../coap/coap.h"
+#include "../coap/que_manager.h"
+#include "../networking/utility.h"
+#include "../imatrix_upload/sample_encode.h"
+#include "../time/ck_time.h"
+#include "interface.h"
+#include "cli_bench.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define BENCH_PERIOD                    1000    // mS each timed pass runs for
+#define BENCH_TIME_CHECK_MASK           0x0F    // Operations between reads of the clock
+
+#define XMIT_BENCH_MAX_PENDING          128     // Messages held from the pool for the run
+#define XMIT_BENCH_BYTES                16
+#define XMIT_BENCH_START_TIME           0x00001000
+#define XMIT_BENCH_MIN_BACKOFF          2000    // mS, CoAP ACK_TIMEOUT
+#define XMIT_BENCH_BACKOFF_SPREAD       30000   // mS, up to the last retransmit backoff
+#define XMIT_BENCH_CHECKS               1000    // Confirmables both lists must hand back in the same order
+#define XMIT_BENCH_SEED                 0x1234567
+
+#define ENC_BENCH_DEFAULT_SAMPLES       32
+#define ENC_BENCH_MAX_SAMPLES           255     // bits_t no_samples is 8 bits
+#define ENC_BENCH_DEST_OFFSET           1       // Blocks follow the CoAP options so are not word aligned in the packet
+#define ENC_BENCH_ID                    0x12345678
+#define ENC_BENCH_SAMPLE_RATE           1000
+
+#define MSG_BENCH_MAX_THREADS           3
+#define MSG_BENCH_DEFAULT_BYTES         64
+#define MSG_BENCH_THREAD_STACK_SIZE     1024
+#define MSG_BENCH_THREAD_PRIORITY       ( WICED_APPLICATION_PRIORITY + 1 )  // Below the CLI so it can end each pass on time
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+/*
+ * One operation of a benchmark - returns false if its result was wrong
+ */
+typedef bool (*bench_step_t)( void *context );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t operations;
+    uint32_t errors;                            // Operations with a wrong result
+    uint32_t elapsed;                           // mS, at least 1
+} bench_pass_t;
+
+typedef struct {
+    message_list_t *list;
+    wiced_time_t last;                          // Time stamp of the last confirmable popped
+    uint32_t seed;
+    uint32_t check;                             // Running digest of the pop order
+} xmit_bench_t;
+
+typedef struct {
+    upload_data_t *upload_data;
+    imx_data_32_t *src;
+    uint16_t samples;
+    uint16_t first_part;                        // Samples before the wrap of the history
+    wiced_utc_time_ms_t upload_time;
+} enc_bench_t;
+
+typedef struct {
+    wiced_thread_t thread;
+    bench_step_t step;
+    uint32_t pairs;                             // msg_get / msg_release pairs completed
+    uint32_t errors;                            // msg_get returned NULL or a message not ready for use
+    uint32_t free_blocks;                       // Last free list length counted by the previous method
+} msg_bench_worker_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static bool bench_token( uint32_t *value, uint32_t default_value, uint32_t max_value, const char *usage );
+static void bench_run( bench_step_t step, void *context, bench_pass_t *pass );
+static uint32_t bench_rate( bench_pass_t *pass );
+static bool bench_compare( const char *unit, const char *before_name, bench_pass_t *before, const char *after_name, bench_pass_t *after );
+static void bench_xmit(void);
+static bool xmit_bench_compare( uint16_t pending );
+static void xmit_bench_fill( xmit_bench_t *bench, uint16_t pending );
+static bool xmit_bench_drain( xmit_bench_t *bench, uint16_t pending );
+static bool xmit_bench_step( void *context );
+static uint32_t xmit_bench_backoff( xmit_bench_t *bench );
+static void bench_encode(void);
+static bool enc_bench_check( enc_bench_t *bench );
+static bool enc_bench_copy_swap( void *context );
+static bool enc_bench_encode( void *context );
+static void bench_msg(void);
+static bool msg_bench_threads( bench_step_t step, uint16_t threads, bench_pass_t *pass, uint32_t *contention );
+static void msg_bench_thread( wiced_thread_arg_t arg );
+static bool msg_bench_ready( message_t *msg );
+static bool msg_bench_clear_walk( void *context );
+static bool msg_bench_header_only( void *context );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static message_list_t bench_timed, bench_linked;
+static bool bench_lists_ready;
+static message_t *held[ XMIT_BENCH_MAX_PENDING ];
+extern iMatrix_Control_Block_t icb;
+extern message_list_t list_free;
+extern wiced_mutex_t list_mutex;
+static msg_bench_worker_t worker[ MSG_BENCH_MAX_THREADS ];
+static volatile bool bench_running;
+static uint16_t bench_bytes;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  bench [ xmit [ <pending> ] | encode [ <samples> ] | msg [ <bytes> ] ] - run a benchmark, all of them with no option
+  * @param  None
+  * @retval : None
+  */
+void cli_bench( uint16_t arg )
+{
+    char *token;
+
+    UNUSED_PARAMETER( arg );
+    token = strtok( NULL, " " );
+    if( token == NULL ) {
+        bench_xmit();
+        bench_encode();
+        bench_msg();
+    } else if( strcmp( token, "xmit" ) == 0 )
+        bench_xmit();
+    else if( strcmp( token, "encode" ) == 0 )
+        bench_encode();
+    else if( strcmp( token, "msg" ) == 0 )
+        bench_msg();
+    else
+        imx_cli_print( "Invalid option, bench [ xmit [ <pending> ] | encode [ <samples> ] | msg [ <bytes> ] ]\r\n" );
+}
+/**
+  * @brief  Read the optional count of a benchmark
+  * @param  value, used if there is no token, largest allowed, usage text
+  * @retval : true / false - not valid, usage printed
+  */
+static bool bench_token( uint32_t *value, uint32_t default_value, uint32_t max_value, const char *usage )
+{
+    char *token;
+
+    *value = default_value;
+    token = strtok( NULL, " " );
+    if( token )
+        *value = strtoul( token, NULL, 10 );
+    if( ( *value == 0 ) || ( *value > max_value ) ) {
+        imx_cli_print( "Invalid count, bench %s 1 - %lu\r\n", usage, max_value );
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Repeat an operation for BENCH_PERIOD
+  * @param  operation, its context, results
+  * @retval : None
+  */
+static void bench_run( bench_step_t step, void *context, bench_pass_t *pass )
+{
+    wiced_time_t start_time, now;
+
+    pass->operations = 0;
+    pass->errors = 0;
+    wiced_time_get_time( &start_time );
+    now = start_time;
+    do {
+        if( step( context ) == false )
+            pass->errors += 1;
+        pass->operations += 1;
+        if( ( pass->operations & BENCH_TIME_CHECK_MASK ) == 0 )
+            wiced_time_get_time( &now );
+    } while( ( now - start_time ) < BENCH_PERIOD );
+    pass->elapsed = now - start_time;
+}
+/**
+  * @brief  Operations per second of a pass
+  * @param  pass
+  * @retval : rate
+  */
+static uint32_t bench_rate( bench_pass_t *pass )
+{
+    return (uint32_t) ( ( (uint64_t) pass->operations * 1000 ) / ( ( pass->elapsed == 0 ) ? 1 : pass->elapsed ) );
+}
+/**
+  * @brief  Print the rate of the previous method and the current one, the ratio and whether all results were right
+  * @param  what is counted, previous method and its pass, current method and its pass
+  * @retval : true - no errors in either pass
+  */
+static bool bench_compare( const char *unit, const char *before_name, bench_pass_t *before, const char *after_name, bench_pass_t *after )
+{
+    uint32_t before_rate, after_rate, ratio;
+    bool passed;
+
+    before_rate = bench_rate( before );
+    after_rate = bench_rate( after );
+    ratio = ( before_rate == 0 ) ? 0 : (uint32_t) ( ( (uint64_t) after_rate * 100 ) / before_rate );
+    passed = ( before->errors == 0 ) && ( after->errors == 0 );
+    imx_cli_print( "    Before, %-16s %10lu %s per second, %lu errors\r\n", before_name, before_rate, unit, before->errors );
+    imx_cli_print( "    After,  %-16s %10lu %s per second, %lu errors\r\n", after_name, after_rate, unit, after->errors );
+    imx_cli_print( "    After / before: %lu.%02lu times, %s\r\n", ratio / 100, ratio % 100, ( passed == true ) ? "PASS" : "FAIL" );
+    return passed;
+}
+/**
+  * @brief  Pending confirmables handled - pop the earliest retransmit and add it back with a new backoff - on the timed
+  *         (heap) list against the linked list it replaced, with 8, 32 and 128 pending or the number given
+  * @param  None - optional token is the number of confirmables pending
+  * @retval : None
+  */
+static void bench_xmit(void)
+{
+    uint16_t pending, step;
+    uint32_t requested;
+
+    if( bench_token( &requested, XMIT_BENCH_MAX_PENDING, XMIT_BENCH_MAX_PENDING, "xmit [ <pending> ]" ) == false )
+        return;
+    /*
+     * Lists are set up once, list_init() creates the mutex and the heap storage is never freed
+     */
+    if( bench_lists_ready == false ) {
+        if( list_init_timed( &bench_timed, XMIT_BENCH_MAX_PENDING ) == false ) {
+            imx_cli_print( "Unable to allocate timed list storage\r\n" );
+            return;
+        }
+        list_init( &bench_linked );
+        bench_lists_ready = true;
+    }
+    for( pending = 0; pending < requested; pending++ ) {
+        held[ pending ] = msg_get( XMIT_BENCH_BYTES );
+        if( held[ pending ] == NULL )
+            break;
+    }
+    if( pending == 0 ) {
+        imx_cli_print( "No free messages\r\n" );
+        return;
+    }
+
+    imx_cli_print( "Transmit queue benchmark, %u mS per pass, up to %u pending\r\n", BENCH_PERIOD, pending );
+    for( step = ( requested == XMIT_BENCH_MAX_PENDING ) ? 8 : pending; ; step *= 4 ) {
+        if( step > pending )
+            step = pending;
+        if( xmit_bench_compare( step ) == false )
+            break;
+        if( step == pending )
+            break;
+    }
+    while( pending > 0 )
+        msg_release( held[ --pending ] );
+    print_free_msg_sizes();
+}
+/**
+  * @brief  Check both lists hand back the same confirmables in time order, then time them
+  * @param  number pending
+  * @retval : true / false - the held messages could not all be taken back from a list
+  */
+static bool xmit_bench_compare( uint16_t pending )
+{
+    xmit_bench_t timed, linked;
+    bench_pass_t before, after;
+    uint32_t i, order_errors;
+
+    imx_cli_print( "  %u pending\r\n", pending );
+    timed.list = &bench_timed;
+    linked.list = &bench_linked;
+    xmit_bench_fill( &timed, pending );
+    xmit_bench_fill( &linked, pending );
+    order_errors = 0;
+    for( i = 0; i < XMIT_BENCH_CHECKS; i++ ) {
+        if( xmit_bench_step( &timed ) == false )
+            order_errors += 1;
+        if( xmit_bench_step( &linked ) == false )
+            order_errors += 1;
+    }
+    if( ( xmit_bench_drain( &timed, pending ) == false ) || ( xmit_bench_drain( &linked, pending ) == false ) )
+        return false;
+    if( ( order_errors != 0 ) || ( timed.check != linked.check ) )
+        imx_cli_print( "    Lists differ, %lu confirmables out of order, %s order\r\n", order_errors,
+                ( timed.check != linked.check ) ? "different" : "same" );
+
+    xmit_bench_fill( &linked, pending );
+    bench_run( xmit_bench_step, &linked, &before );
+    if( xmit_bench_drain( &linked, pending ) == false )
+        return false;
+    xmit_bench_fill( &timed, pending );
+    bench_run( xmit_bench_step, &timed, &after );
+    if( xmit_bench_drain( &timed, pending ) == false )
+        return false;
+    if( ( order_errors != 0 ) || ( timed.check != linked.check ) )
+        after.errors += 1;
+    bench_compare( "confirmables", "linked list:", &before, "timed list:", &after );
+    return true;
+}
+/**
+  * @brief  Queue the held messages with the first backoffs, the same sequence for every pass
+  * @param  bench, number pending
+  * @retval : None
+  */
+static void xmit_bench_fill( xmit_bench_t *bench, uint16_t pending )
+{
+    uint16_t i;
+
+    bench->seed = XMIT_BENCH_SEED;
+    bench->last = XMIT_BENCH_START_TIME;
+    bench->check = 0;
+    for( i = 0; i < pending; i++ )
+        list_add_at( XMIT_BENCH_START_TIME + xmit_bench_backoff( bench ), bench->list, held[ i ], 1 );
+}
+/**
+  * @brief  Take the held messages back from the list
+  * @param  bench, number pending
+  * @retval : true / false - some were missing
+  */
+static bool xmit_bench_drain( xmit_bench_t *bench, uint16_t pending )
+{
+    uint16_t i;
+
+    for( i = 0; i < pending; i++ ) {
+        held[ i ] = list_pop_before( bench->last + XMIT_BENCH_MIN_BACKOFF + XMIT_BENCH_BACKOFF_SPREAD, bench->list );
+        if( held[ i ] == NULL ) {
+            imx_cli_print( "Benchmark lost %u messages\r\n", pending - i );
+            return false;
+        }
+    }
+    return true;
+}
+/**
+  * @brief  Pop the earliest confirmable and add it back later - every pending one is due within the largest backoff
+  *         of the last, so the pop limit moves with the virtual clock and never wraps
+  * @param  bench
+  * @retval : true / false - none popped or popped out of time order
+  */
+static bool xmit_bench_step( void *context )
+{
+    xmit_bench_t *bench = (xmit_bench_t *) context;
+    message_t *msg;
+    bool in_order;
+
+    msg = list_pop_before( bench->last + XMIT_BENCH_MIN_BACKOFF + XMIT_BENCH_BACKOFF_SPREAD, bench->list );
+    if( msg == NULL )
+        return false;
+    in_order = ( imx_is_later( bench->last, msg->coap.next_timestamp ) == false );
+    bench->last = msg->coap.next_timestamp;
+    bench->check = ( bench->check * 31 ) + bench->last;
+    list_add_at( bench->last + xmit_bench_backoff( bench ), bench->list, msg, 1 );
+    return in_order;
+}
+/**
+  * @brief  Next retransmit backoff, simple LCG so the passes are repeatable
+  * @param  bench
+  * @retval : backoff in mS
+  */
+static uint32_t xmit_bench_backoff( xmit_bench_t *bench )
+{
+    bench->seed = bench->seed * 1103515245 + 12345;
+    return XMIT_BENCH_MIN_BACKOFF + ( ( bench->seed >> 16 ) % XMIT_BENCH_BACKOFF_SPREAD );
+}
+/**
+  * @brief  Upload blocks encoded - header and a run of samples that wraps half way, as at the end of the circular
+  *         history - with the sample_encode helpers against the copy out then byte swap in place method they replaced
+  * @param  None - optional token is the number of samples in each block
+  * @retval : None
+  */
+static void bench_encode(void)
+{
+    enc_bench_t bench;
+    bench_pass_t before, after;
+    message_t *src_msg, *dest_msg;
+    uint32_t samples, max_samples, i;
+
+    max_samples = ( max_packet_size() - ENC_BENCH_DEST_OFFSET - sizeof( header_t ) ) / IMX_SAMPLE_LENGTH;
+    if( max_samples > max_packet_size() / ( 2 * IMX_SAMPLE_LENGTH ) )
+        max_samples = max_packet_size() / ( 2 * IMX_SAMPLE_LENGTH );  // Source holds the check copy after the samples
+    if( max_samples > ENC_BENCH_MAX_SAMPLES )
+        max_samples = ENC_BENCH_MAX_SAMPLES;
+    if( bench_token( &samples, ENC_BENCH_DEFAULT_SAMPLES, max_samples, "encode [ <samples> ]" ) == false )
+        return;
+    src_msg = msg_get( max_packet_size() );
+    dest_msg = msg_get( max_packet_size() );
+    if( ( src_msg == NULL ) || ( dest_msg == NULL ) ) {
+        imx_cli_print( "No free messages\r\n" );
+        if( src_msg != NULL )
+            msg_release( src_msg );
+        if( dest_msg != NULL )
+            msg_release( dest_msg );
+        return;
+    }
+    bench.src = (imx_data_32_t *) src_msg->coap.data_block->data;
+    for( i = 0; i < samples; i++ )
+        bench.src[ i ].uint_32bit = 0x01020304 * ( i + 1 );
+    bench.upload_data = (upload_data_t *) ( dest_msg->coap.data_block->data + ENC_BENCH_DEST_OFFSET );
+    bench.samples = (uint16_t) samples;
+    bench.first_part = bench.samples / 2;
+    wiced_time_get_utc_time_ms( &bench.upload_time );
+
+    imx_cli_print( "Upload encode benchmark, %u mS per pass, %u samples per block\r\n", BENCH_PERIOD, bench.samples );
+    bench_run( enc_bench_copy_swap, &bench, &before );
+    bench_run( enc_bench_encode, &bench, &after );
+    if( enc_bench_check( &bench ) == false ) {
+        imx_cli_print( "    Encoded blocks do not match\r\n" );
+        after.errors += 1;
+    }
+    bench_compare( "blocks", "copy then swap:", &before, "sample_encode:", &after );
+    imx_cli_print( "    %lu samples per second before, %lu after\r\n", bench_rate( &before ) * bench.samples, bench_rate( &after ) * bench.samples );
+
+    msg_release( src_msg );
+    msg_release( dest_msg );
+}
+/**
+  * @brief  Check both methods produce the same block, the header and the samples are compared separately so the check
+  *         does not need a second packet buffer
+  * @param  bench
+  * @retval : true / false - the blocks differ
+  */
+static bool enc_bench_check( enc_bench_t *bench )
+{
+    uint8_t reference[ sizeof( header_t ) ];
+    uint16_t i;
+
+    enc_bench_copy_swap( bench );
+    memcpy( reference, &bench->upload_data->header, sizeof( header_t ) );
+    for( i = 0; i < bench->samples; i++ )
+        bench->src[ bench->samples + i ].uint_32bit = bench->upload_data->data[ i ].uint_32bit;    // Keep the copy / swap samples after the source
+    enc_bench_encode( bench );
+    return ( memcmp( reference, &bench->upload_data->header, sizeof( header_t ) ) == 0 ) &&
+           ( memcmp( &bench->src[ bench->samples ], bench->upload_data->data, bench->samples * IMX_SAMPLE_LENGTH ) == 0 );
+}
+/**
+  * @brief  Previous upload method - fill in the header bitfields one at a time, copy the two runs out and byte swap in place
+  * @param  bench
+  * @retval : true
+  */
+static bool enc_bench_copy_swap( void *context )
+{
+    enc_bench_t *bench = (enc_bench_t *) context;
+    upload_data_t *upload_data = bench->upload_data;
+    bits_t header_bits;
+    uint16_t i;
+
+    upload_data->header.id = htonl( ENC_BENCH_ID );
+    header_bits.bits.data_type = IMX_INT32;
+    upload_data->header.sample_rate = htonl( ENC_BENCH_SAMPLE_RATE );
+    header_bits.bits.block_type = IMX_BLOCK_SENSOR;
+    header_bits.bits.no_samples = bench->samples;
+    header_bits.bits.version = IMATRIX_VERSION_1;
+    header_bits.bits.warning = 0;
+    header_bits.bits.sensor_error = 0;
+    header_bits.bits.reserved = 0;
+    upload_data->header.bits.bit_data = htonl( header_bits.bit_data );
+    upload_data->header.last_utc_ms_sample_time = 0;
+    if( icb.time_set_with_NTP == true )
+        upload_data->header.last_utc_ms_sample_time = htonll( bench->upload_time );
+
+    memcpy( &upload_data->data[ 0 ], &bench->src[ bench->samples - bench->first_part ], bench->first_part * IMX_SAMPLE_LENGTH );
+    memcpy( &upload_data->data[ bench->first_part ], &bench->src[ 0 ], ( bench->samples - bench->first_part ) * IMX_SAMPLE_LENGTH );
+    for( i = 0; i < bench->samples; i++ )
+        upload_data->data[ i ].uint_32bit = htonl( upload_data->data[ i ].uint_32bit );
+    return true;
+}
+/**
+  * @brief  Current upload method using the sample_encode helpers
+  * @param  bench
+  * @retval : true
+  */
+static bool enc_bench_encode( void *context )
+{
+    enc_bench_t *bench = (enc_bench_t *) context;
+
+    encode_header( &bench->upload_data->header, ENC_BENCH_ID, ENC_BENCH_SAMPLE_RATE,
+            encode_header_bits( IMX_BLOCK_SENSOR, IMX_INT32, bench->samples, 0, 0 ), bench->upload_time );
+    encode_samples( (uint8_t *) &bench->upload_data->data[ 0 ], &bench->src[ bench->samples - bench->first_part ], bench->first_part );
+    encode_samples( (uint8_t *) &bench->upload_data->data[ bench->first_part ], &bench->src[ 0 ], bench->samples - bench->first_part );
+    return true;
+}
+/**
+  * @brief  Message pool get / release pairs with 1 to MSG_BENCH_MAX_THREADS threads, the current pool against the previous
+  *         one. The threads share a priority, they compete for the pools when the RTOS time slices them and with any
+  *         live network traffic
+  * @param  None - optional token is the number of bytes requested from msg_get()
+  * @retval : None
+  */
+static void bench_msg(void)
+{
+    bench_pass_t before, after;
+    uint32_t bytes, before_contention, after_contention;
+    uint16_t threads;
+
+    if( bench_token( &bytes, MSG_BENCH_DEFAULT_BYTES, max_packet_size(), "msg [ <bytes> ]" ) == false )
+        return;
+    bench_bytes = (uint16_t) bytes;
+    imx_cli_print( "Message pool benchmark, %u mS per pass, %u Byte data blocks\r\n", BENCH_PERIOD, bench_bytes );
+    for( threads = 1; threads <= MSG_BENCH_MAX_THREADS; threads++ ) {
+        imx_cli_print( "  %u thread(s)\r\n", threads );
+        if( ( msg_bench_threads( msg_bench_clear_walk, threads, &before, &before_contention ) == false ) ||
+            ( msg_bench_threads( msg_bench_header_only, threads, &after, &after_contention ) == false ) )
+            return;
+        bench_compare( "pairs", "clear and walk:", &before, "header only:", &after );
+        imx_cli_print( "    Free list lock contention, before: %lu, after: %lu\r\n", before_contention, after_contention );
+    }
+    print_free_msg_sizes();
+}
+/**
+  * @brief  Run a pass of get / release pairs on a number of threads, the free message count must be the same after it
+  * @param  pair to run, threads, results, free list lock contention during the pass
+  * @retval : true / false - a thread could not be started
+  */
+static bool msg_bench_threads( bench_step_t step, uint16_t threads, bench_pass_t *pass, uint32_t *contention )
+{
+    wiced_time_t start_time, end_time;
+    uint16_t i, started;
+    int free_messages;
+
+    memset( worker, 0x00, sizeof( worker ) );
+    free_messages = list_size( &list_free );
+    *contention = list_free.contention;
+    bench_running = true;
+    wiced_time_get_time( &start_time );
+    for( started = 0; started < threads; started++ ) {
+        worker[ started ].step = step;
+        if( wiced_rtos_create_thread( &worker[ started ].thread, MSG_BENCH_THREAD_PRIORITY, "Msg bench", msg_bench_thread,
+                MSG_BENCH_THREAD_STACK_SIZE, &worker[ started ] ) != WICED_SUCCESS )
+            break;
+    }
+    wiced_rtos_delay_milliseconds( BENCH_PERIOD );
+    bench_running = false;
+    for( i = 0; i < started; i++ ) {
+        wiced_rtos_thread_join( &worker[ i ].thread );
+        wiced_rtos_delete_thread( &worker[ i ].thread );
+    }
+    wiced_time_get_time( &end_time );
+    *contention = list_free.contention - *contention;
+    if( started < threads ) {
+        imx_cli_print( "Unable to start benchmark thread %u\r\n", started + 1 );
+        return false;
+    }
+    pass->operations = 0;
+    pass->errors = 0;
+    for( i = 0; i < threads; i++ ) {
+        pass->operations += worker[ i ].pairs;
+        pass->errors += worker[ i ].errors;
+    }
+    if( list_size( &list_free ) != free_messages ) {
+        imx_cli_print( "    %d messages not returned to the pool\r\n", free_messages - list_size( &list_free ) );
+        pass->errors += 1;
+    }
+    pass->elapsed = ( end_time == start_time ) ? 1 : end_time - start_time;
+    return true;
+}
+/**
+  * @brief  Run get / release pairs until the pass ends
+  * @param  worker
+  * @retval : None
+  */
+static void msg_bench_thread( wiced_thread_arg_t arg )
+{
+    msg_bench_worker_t *bench_worker = (msg_bench_worker_t *) arg;
+
+    while( bench_running == true ) {
+        if( bench_worker->step( bench_worker ) == true )
+            bench_worker->pairs += 1;
+        else
+            bench_worker->errors += 1;
+    }
+}
+/**
+  * @brief  Check a message from msg_get() is ready for use - a cleared header and a data block large enough
+  * @param  message
+  * @retval : true / false
+  */
+static bool msg_bench_ready( message_t *msg )
+{
+    return ( msg->coap.msg_length == 0 ) && ( msg->coap.data_block != NULL ) && ( msg->coap.data_block->next == NULL ) &&
+           ( coap_msg_data_size( &msg->coap ) >= bench_bytes );
+}
+/**
+  * @brief  Previous pool - the whole data block was cleared when handed out and again when released, and the free list
+  *         walked to keep its low water mark. The walk takes list_mutex again, the previous code did it within msg_get()
+  * @param  worker
+  * @retval : true / false - no message or not ready for use
+  */
+static bool msg_bench_clear_walk( void *context )
+{
+    msg_bench_worker_t *bench_worker = (msg_bench_worker_t *) context;
+    message_data_block_t *block;
+    message_t *msg;
+    uint16_t size;
+    bool ready;
+
+    msg = msg_get( bench_bytes );
+    if( msg == NULL )
+        return false;
+    size = coap_msg_data_size( &msg->coap );
+    memset( msg->coap.data_block->data, 0, size );
+    wiced_rtos_lock_mutex( &list_mutex );
+    bench_worker->free_blocks = 0;
+    for( block = msg->coap.data_block->release_list_for_data_size->msg_data; block != NULL; block = block->next )
+        bench_worker->free_blocks += 1;
+    wiced_rtos_unlock_mutex( &list_mutex );
+    ready = msg_bench_ready( msg );
+    memset( msg->coap.data_block->data, 0, size );
+    msg_release( msg );
+    return ready;
+}
+/**
+  * @brief  Current pool - only the message header is cleared, the free lists keep their length
+  * @param  worker
+  * @retval : true / false - no message or not ready for use
+  */
+static bool msg_bench_header_only( void *context )
+{
+    message_t *msg;
+    bool ready;
+
+    UNUSED_PARAMETER( context );
+    msg = msg_get( bench_bytes );
+    if( msg == NULL )
+        return false;
+    ready = msg_bench_ready( msg );
+    msg_release( msg );
+    return ready;
+}
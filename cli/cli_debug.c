@@ -43,6 +43,7 @@
 #include "interface.h"
 #include "cli_debug.h"
 #include "messages.h"
+#include "imx_debug.h"
 #include "../device/config.h"
 #include "../storage.h"
 /******************************************************
@@ -52,7 +53,7 @@
 /******************************************************
  *                    Constants
  ******************************************************/
-#define NO_DEBUG_MSGS   12
+#define NO_DEBUG_MSGS   13
 const char *debug_flags_description[ NO_DEBUG_MSGS ] =
 {
         "General Debugging ",                   // 0x00000001
@@ -67,6 +68,7 @@ const char *debug_flags_description[ NO_DEBUG_MSGS ] =
         "Debugs For Application Start",         // 0x00000200
         "Debugs For Event Driven Entries",      // 0x00000400
         "Debugs for Sample Driven Entries",     // 0x00000800
+        "Record Debugs in Binary Trace",        // 0x00001000
 };
 
 /******************************************************
@@ -121,6 +123,7 @@ void cli_debug(uint16_t mode)
 		        device_config.log_messages = strtoul( &token[ 2 ], &foo, 16 );
 		    else
 		        device_config.log_messages = strtoul( token, &foo, 10 );
+		    imx_debug_update_mask();
 		    imatrix_save_config();
 		}
 	} else
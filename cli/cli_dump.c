@@ -36,6 +36,7 @@
 
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include <ctype.h>
 
@@ -53,6 +54,7 @@
  ******************************************************/
 #define CHAR_PER_LINE			32
 #define MAX_BUFFER_SIZE			2048
+#define LINE_LENGTH				( 10 + ( CHAR_PER_LINE * 4 ) + 4 + 1 )	// Address, hex, spacers, characters
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -132,25 +134,27 @@ void cli_dump(uint16_t mode)
 void hex_dump( uint8_t *buffer, uint32_t dump_start, uint32_t dump_length )
 {
 	uint32_t i, j;
+	uint16_t length;
+	char line[ LINE_LENGTH ];
 
 	i = 0;
 	while( i < dump_length ) {
 		/*
-		 * Print 32 Bytes per line
+		 * Print 32 Bytes per line, each line is built up and printed in one go
 		 */
-		imx_cli_print( "%08lX  ", dump_start + (uint32_t) i );
+		length = sprintf( line, "%08lX  ", dump_start + (uint32_t) i );
 		for( j = 0; ( ( i + j ) < dump_length ) && ( j < CHAR_PER_LINE ); j++ ) {
-			imx_cli_print( "%02X ", buffer[ i + j ] );
+			length += sprintf( &line[ length ], "%02X ", buffer[ i + j ] );
 			if( ( j == 7 ) || ( j == 15 ) || (j == 23 ) )	// Make it easier to read
-				imx_cli_print( " " );
+				line[ length++ ] = ' ';
 		}
 		for( j = 0; ( i + j ) < ( dump_length ) && ( j < CHAR_PER_LINE ); j++ )
 			if( isprint( (uint16_t) buffer[ i + j ] ) && ( (uint16_t) buffer[ i + j ] != 0x0a ) && ((uint16_t) buffer[ i + j ] != 0x0d ) )
-				imx_cli_print( "%c", buffer[ i + j ] );
+				line[ length++ ] = (char) buffer[ i + j ];
 			else
-				imx_cli_print( "." );
+				line[ length++ ] = '.';
 		i += CHAR_PER_LINE;
-		imx_cli_print( "\r\n" );
-
+		line[ length ] = 0x00;
+		imx_cli_print( "%s\r\n", line );
 	}
 }
@@ -44,14 +44,20 @@
 #include "../storage.h"
 #include "../version.h"
 #include "interface.h"
+#include "log_buffer.h"
+#include "telnetd.h"
+#include "trace.h"
 #include "./ble/ble_manager.h"
 #include "../coap/que_manager.h"
+#include "../coap/coap_observe.h"
+#include "../cs_ctrl/hal_spill.h"
 #include "../device/config.h"
 #include "../device/hal_wifi.h"
 #include "../device/hal_leds.h"
 #include "../device/icb_def.h"
 #include "../device/imx_LEDS.h"
 #include "../device/var_data.h"
+#include "../sflash/sflash_writer.h"
 #include "../imatrix_upload/imatrix_upload.h"
 #include "../wifi/wifi.h"
 #include "cli_status.h"
@@ -192,8 +198,11 @@ void cli_status( uint16_t arg )
             imx_cli_print( "    TCP Statistics:" );
 	    imx_cli_print( " Packets - Received: %lu, Multicast: %lu, Unicast Received: %lu, Errors: %lu",
 	            icb.ip_stats[ i ].packets_received, icb.ip_stats[ i ].packets_multicast_received, icb.ip_stats[ i ].packets_unitcast_received, icb.ip_stats[ i ].packets_received_errors );
-	    imx_cli_print( " Creation Failure: %lu, Fail to Send: %lu, Packets Sent: %lu, Last Receive Error: %lu\r\n",
+	    imx_cli_print( " Creation Failure: %lu, Fail to Send: %lu, Packets Sent: %lu, Last Receive Error: %lu",
 	            icb.ip_stats[ i ].packet_creation_failure, icb.ip_stats[ i ].fail_to_send_packet, icb.ip_stats[ i ].packets_sent, icb.ip_stats[ i ].rec_error );
+	    if( i == UDP_STATS )
+	        imx_cli_print( ", Requests - New: %lu, Duplicates: %lu", icb.ip_stats[ i ].new_requests, icb.ip_stats[ i ].duplicate_requests );
+	    imx_cli_print( "\r\n" );
 	}
 
     imx_cli_print( "AT Commands processed: %lu, Errors: %lu, Verbose mode: ", icb.AT_commands_processed, icb.AT_command_errors );
@@ -218,6 +227,14 @@ void cli_status( uint16_t arg )
     if( icb.imatrix_no_packet_avail == true )
         imx_cli_print( "*** iMatrix Out of Packets: " );
     print_free_msg_sizes();
+    print_list_contention();
+    print_observers();
+    print_log_buffer_status();
+    print_telnet_state();
+    print_trace_status();
+    print_sflash_writer_status();
+    print_imatrix_throughput();
+    print_spill_status();
     /*
      * Show Variable length pools
      */
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file imx_debug.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef IMX_DEBUG_H_
+#define IMX_DEBUG_H_
+
+#include "messages.h"
+
+/*
+ *  Debug output shared by all modules. Each module maps its PRINTF on to IMX_DEBUG_PRINTF() with its category from
+ *  messages.h. A site is only compiled if its category is in IMX_DEBUG_CATEGORIES and its level is at least
+ *  IMX_DEBUG_MIN_LEVEL, otherwise PRINTF is empty and its arguments are never evaluated. The categories that are
+ *  compiled are checked at run time against imx_debug_mask, a copy of device_config.log_messages.
+ *
+ *  For a production build with no debug output add: GLOBAL_DEFINES += IMX_DEBUG_MIN_LEVEL=IMX_DEBUG_LEVEL_NONE
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+/*
+ * Usable in #if - true if sites for this category are compiled at all
+ */
+#define IMX_DEBUG_COMPILED( category )          ( ( IMX_DEBUG_MIN_LEVEL <= IMX_DEBUG_LEVEL_DEBUG ) && ( ( IMX_DEBUG_CATEGORIES & ( category ) ) != 0 ) )
+#define IMX_DEBUG_ACTIVE( level, category )     ( ( ( level ) >= IMX_DEBUG_MIN_LEVEL ) && ( ( IMX_DEBUG_CATEGORIES & ( category ) ) != 0 ) && \
+                                                  ( ( imx_debug_mask & ( category ) ) != 0 ) )
+#define IMX_DEBUG_LOG( level, category, ... )   do { if( IMX_DEBUG_ACTIVE( level, category ) ) imx_printf( __VA_ARGS__ ); } while( 0 )
+#define IMX_DEBUG_PRINTF( category, ... )       IMX_DEBUG_LOG( IMX_DEBUG_LEVEL_DEBUG, category, __VA_ARGS__ )
+/*
+ * As IMX_DEBUG_PRINTF() but recorded in the binary trace when DEBUGS_TO_TRACE is set - include trace.h
+ */
+#define IMX_DEBUG_TRACE( category, ... )        do { if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, category ) ) TRACE_OR_PRINTF( __VA_ARGS__ ); } while( 0 )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define IMX_DEBUG_LEVEL_DEBUG       0
+#define IMX_DEBUG_LEVEL_INFO        1
+#define IMX_DEBUG_LEVEL_WARNING     2
+#define IMX_DEBUG_LEVEL_ERROR       3
+#define IMX_DEBUG_LEVEL_NONE        4
+
+#ifndef IMX_DEBUG_MIN_LEVEL
+#define IMX_DEBUG_MIN_LEVEL         IMX_DEBUG_LEVEL_DEBUG
+#endif
+/*
+ * Categories compiled - by default those selected with the PRINT_DEBUGS_FOR_ defines in imatrix.mk
+ */
+#ifndef IMX_DEBUG_CATEGORIES
+#ifdef PRINT_DEBUGS_FOR_BLE
+#define IMX_DEBUG_BUILD_BLE                 DEBUGS_BLE
+#else
+#define IMX_DEBUG_BUILD_BLE                 0
+#endif
+#ifdef PRINT_DEBUGS_FOR_BASIC_MESSAGING
+#define IMX_DEBUG_BUILD_BASIC_MESSAGING     DEBUGS_FOR_BASIC_MESSAGING
+#else
+#define IMX_DEBUG_BUILD_BASIC_MESSAGING     0
+#endif
+#ifdef PRINT_DEBUGS_FOR_XMIT
+#define IMX_DEBUG_BUILD_XMIT                DEBUGS_FOR_XMIT
+#else
+#define IMX_DEBUG_BUILD_XMIT                0
+#endif
+#ifdef PRINT_DEBUGS_FOR_RECV
+#define IMX_DEBUG_BUILD_RECV                DEBUGS_FOR_RECV
+#else
+#define IMX_DEBUG_BUILD_RECV                0
+#endif
+#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#define IMX_DEBUG_BUILD_COAP_DEFINES        DEBUGS_FOR_COAP_DEFINES
+#else
+#define IMX_DEBUG_BUILD_COAP_DEFINES        0
+#endif
+#ifdef PRINT_DEBUGS_FOR_HAL
+#define IMX_DEBUG_BUILD_HAL                 DEBUGS_FOR_HAL
+#else
+#define IMX_DEBUG_BUILD_HAL                 0
+#endif
+#ifdef PRINT_DEBUGS_FOR_IMX_UPLOAD
+#define IMX_DEBUG_BUILD_IMX_UPLOAD          DEBUGS_FOR_IMX_UPLOAD
+#else
+#define IMX_DEBUG_BUILD_IMX_UPLOAD          0
+#endif
+#ifdef PRINT_DEBUGS_FOR_SFLASH
+#define IMX_DEBUG_BUILD_SFLASH              DEBUGS_FOR_SFLASH
+#else
+#define IMX_DEBUG_BUILD_SFLASH              0
+#endif
+#ifdef PRINT_DEBUGS_FOR_APPLICATION_START
+#define IMX_DEBUG_BUILD_APPLICATION_START   DEBUGS_FOR_APPLICATION_START
+#else
+#define IMX_DEBUG_BUILD_APPLICATION_START   0
+#endif
+#ifdef PRINT_DEBUGS_FOR_EVENTS_DRIVEN
+#define IMX_DEBUG_BUILD_EVENTS_DRIVEN       DEBUGS_FOR_EVENTS_DRIVEN
+#else
+#define IMX_DEBUG_BUILD_EVENTS_DRIVEN       0
+#endif
+#ifdef PRINT_DEBUGS_FOR_SAMPLING
+#define IMX_DEBUG_BUILD_SAMPLING            DEBUGS_FOR_SAMPLING
+#else
+#define IMX_DEBUG_BUILD_SAMPLING            0
+#endif
+#define IMX_DEBUG_CATEGORIES        ( IMX_DEBUG_BUILD_BLE | IMX_DEBUG_BUILD_BASIC_MESSAGING | IMX_DEBUG_BUILD_XMIT | IMX_DEBUG_BUILD_RECV | \
+                                      IMX_DEBUG_BUILD_COAP_DEFINES | IMX_DEBUG_BUILD_HAL | IMX_DEBUG_BUILD_IMX_UPLOAD | IMX_DEBUG_BUILD_SFLASH | \
+                                      IMX_DEBUG_BUILD_APPLICATION_START | IMX_DEBUG_BUILD_EVENTS_DRIVEN | IMX_DEBUG_BUILD_SAMPLING )
+#endif
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern uint32_t imx_debug_mask;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void imx_debug_update_mask(void);
+#endif /* IMX_DEBUG_H_ */
@@ -40,6 +40,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <ctype.h>
 #include <stdarg.h>     /* va_list, va_start, va_arg, va_end */
 #include "wiced.h"
@@ -50,6 +51,8 @@
 #include "../device/icb_def.h"
 #include "interface.h"
 #include "telnetd.h"
+#include "log_buffer.h"
+#include "imx_debug.h"
 
 
 /******************************************************
@@ -59,7 +62,6 @@
 /******************************************************
  *                    Constants
  ******************************************************/
-#define SPRINTF_BUFFER_LENGTH	128
 
 /******************************************************
  *                   Enumerations
@@ -76,11 +78,13 @@
 /******************************************************
  *               Function Declarations
  ******************************************************/
+static void output_vprintf( uint16_t sinks, char *buffer, int prefix_length, char *format, va_list args );
 
 /******************************************************
  *               Variable Definitions
  ******************************************************/
 uint16_t active_device = CONSOLE_OUTPUT;
+uint32_t imx_debug_mask = 0;                   // Copy of device_config.log_messages tested by the debug PRINTF sites
 extern iMatrix_Control_Block_t icb;
 extern IOT_Device_Config_t device_config;
 extern const char *debug_flags_description[];
@@ -105,6 +109,16 @@ bool imx_verify_cmd( void )
 	}
 }
 
+/**
+  * @brief  Refresh the copy of the debug flags used by the debug PRINTF sites, call after changing device_config.log_messages
+  * @param  None
+  * @retval : None
+  */
+void imx_debug_update_mask(void)
+{
+    imx_debug_mask = device_config.log_messages;
+}
+
 bool imx_get_ch( char *ch )
 {
 	uint32_t expected_data_size;
@@ -124,86 +138,69 @@ bool imx_get_ch( char *ch )
 		return false;
 }
 
+/**
+  * @brief  Print a status message on the console - formatted once and queued for the log output thread
+  * @param  format, ...
+  * @retval : None
+  */
 void imx_printf( char *format, ... )
 {
+    char buffer[ LOG_MAX_MESSAGE ];
+    va_list args;// Arguments from the expanded elipsis "..."
+
     /*
      * Check if output for status messages is enabled.
      *
      * This is only valid if this system is not using AT commands or in set up mode
      */
     if( ( device_config.AT_verbose == IMX_AT_VERBOSE_STANDARD_STATUS ) || ( device_config.AP_setup_mode == true ) || ( device_config.print_debugs == true ) ) {
-        va_list args;// Arguments from the expanded elipsis "..."
         va_start( args, format );// Initialize list of arguments.
-        vprintf( format, args );
-        fflush(stdout);
+        output_vprintf( LOG_SINK_CONSOLE, buffer, 0, format, args );
+        va_end( args );
     }
-
 }
-
-
+/**
+  * @brief  Print CLI output on the active device, console or telnet
+  * @param  format, ...
+  * @retval : None
+  */
 void imx_cli_print( char *format, ... )
 {
-	char buffer[ SPRINTF_BUFFER_LENGTH ];
+	char buffer[ LOG_MAX_MESSAGE ];
 	va_list args;// Arguments from the expanded elipsis "..."
-
+	uint16_t sinks;
+
+    if( active_device == CONSOLE_OUTPUT )
+        sinks = LOG_SINK_CONSOLE;
+    else if( active_device == TELNET_OUTPUT )
+        sinks = LOG_SINK_TELNET;
+    else
+        return;
     va_start( args, format );// Initialize list of arguments.
-
-    if( active_device == CONSOLE_OUTPUT ) {
-    	vprintf( format, args );
-    	fflush(stdout);
-    } else if( active_device == TELNET_OUTPUT ) {
-
-        uint16_t size = vsnprintf( NULL, 0, format, args ) + 1;// Get length with room for null terminator.
-
-    	if( size > SPRINTF_BUFFER_LENGTH ) {
-    		sprintf( buffer, "Message length(%u) for Telnet exceeds buffer length: %u\r\n", size, SPRINTF_BUFFER_LENGTH );
-    		imx_printf( "Telnet Buffer Could Overflow with this message:\r\n");
-    	    vprintf( format, args );
-    	} else
-    		vsprintf( buffer, format, args );
-    	if( telnetd_write( buffer, strlen( buffer ) ) == false ) {
-    		imx_printf( "Telnet stream failure, closing session\r\n" );
-    		telnetd_deinit();
-    	}
-    }
+    output_vprintf( sinks, buffer, 0, format, args );
     va_end( args );
 }
-
+/**
+  * @brief  Print a time stamped log message on the console and any telnet session
+  * @param  format, ...
+  * @retval : 0
+  */
 int imx_log_printf( char *format, ... )
 {
 	if ( ( device_config.print_debugs == true) ) {
-		char buffer[ SPRINTF_BUFFER_LENGTH ];
+		char buffer[ LOG_MAX_MESSAGE ];
 		va_list args;// Arguments from the expanded elipsis "..."
 		wiced_utc_time_t utc_time = 0;
+		int prefix_length;
 
 		wiced_time_get_utc_time( &utc_time );
-
-		printf( "Log Message\r\n" );
+		/*
+		 * Time stamp and message formatted once in to the same buffer
+		 */
+		prefix_length = snprintf( buffer, LOG_MAX_MESSAGE, "%06lu: ", (uint32_t) ( utc_time % IMX_SEC_IN_DAY  ) );
 	    va_start( args, format );// Initialize list of arguments.
-
-    	uint16_t size = vsnprintf( NULL, 0, format, args ) + 1;	// Get length with room for null terminator.
-		imx_printf( "%06lu: ", (uint32_t) ( utc_time % IMX_SEC_IN_DAY  ) );
-	    vprintf( format, args );
-	    fflush(stdout);
-
-    	if( size > SPRINTF_BUFFER_LENGTH ) {
-    		sprintf( buffer, "Message length(%u) for Telnet exceeds write buffer length: %u\r\n", size, SPRINTF_BUFFER_LENGTH );
-    		imx_printf( "log buffer Could Overflow with this message: %s\r\n", buffer );
-    	} else {
-	    	if( telnet_active() == true ) {	// Output to telnet session as well
-		    	sprintf( buffer, "%06lu: ", (uint32_t) ( utc_time % IMX_SEC_IN_DAY  ) );
-		    	if( telnetd_write( buffer, strlen( buffer ) ) == false ) {
-		    		imx_printf( "Telnet stream failure, closing session\r\n" );
-		    		telnetd_deinit();
-		    	}
-	    	}
-	    	vsprintf( buffer, format, args );
-	    	if( telnet_active() == true ) {	// Output to telnet session as well
-		    	if( telnetd_write( buffer, strlen( buffer ) ) == false ) {
-		    		imx_printf( "Telnet stream failure, closing session\r\n" );
-		    		telnetd_deinit();
-		    	}
-	    	}
+	    output_vprintf( LOG_SINK_CONSOLE | ( ( telnet_active() == true ) ? LOG_SINK_TELNET : 0 ), buffer, prefix_length, format, args );
+	    va_end( args );
 //
 //
 //	    	if( ( device_config.log_messages & DEBUG_LOG_TO_IMATRIX ) != 0 ) {
@@ -213,8 +210,44 @@ int imx_log_printf( char *format, ... )
 //	    		vsprintf( buffer, format, args );
 //	        	imatrix_log( buffer );
 //	    	}
-    	}
-	    va_end( args );
 	}
     return 0;
 }
+/**
+  * @brief  Format a message after any prefix already in the buffer and queue it for the sinks
+  *         A message too long for the buffer is formatted again in to one of its full length, up to LOG_MAX_LONG_MESSAGE,
+  *         and split across records by log_buffer_write(). Only a longer message, or no memory for it, is truncated
+  * @param  LOG_SINK_ bits, buffer of LOG_MAX_MESSAGE bytes holding the prefix, prefix length, format, arguments
+  * @retval : None
+  */
+static void output_vprintf( uint16_t sinks, char *buffer, int prefix_length, char *format, va_list args )
+{
+    va_list args_copy;
+    char *long_buffer;
+    int length;
+
+    va_copy( args_copy, args );
+    length = vsnprintf( &buffer[ prefix_length ], LOG_MAX_MESSAGE - prefix_length, format, args );
+    if( length >= 0 ) {
+        length += prefix_length;
+        if( length < LOG_MAX_MESSAGE )
+            log_buffer_write( sinks, buffer, length );
+        else {
+            if( length > LOG_MAX_LONG_MESSAGE ) {
+                length = LOG_MAX_LONG_MESSAGE;
+                log_buffer_truncated();
+            }
+            long_buffer = malloc( length + 1 );
+            if( long_buffer != NULL ) {
+                memcpy( long_buffer, buffer, prefix_length );
+                vsnprintf( &long_buffer[ prefix_length ], length + 1 - prefix_length, format, args_copy );
+                log_buffer_write( sinks, long_buffer, length );
+                free( long_buffer );
+            } else {
+                log_buffer_truncated();
+                log_buffer_write( sinks, buffer, LOG_MAX_MESSAGE - 1 );
+            }
+        }
+    }
+    va_end( args_copy );
+}
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file log_buffer.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Buffered output for imx_printf(), imx_cli_print() and imx_log_printf(). Each message is formatted once by the caller
+ *  and copied in to a ring as a record tagged with the sinks it goes to; the log output thread writes the records to the
+ *  console and the telnet session so a slow UART or a congested telnet link no longer holds up the caller.
+ *
+ *  The ring takes writers from any thread without a lock: space is reserved by moving the reserve index with a compare
+ *  and swap, the record is filled in and then marked ready. The output thread takes records in order, stopping at one
+ *  that is still being filled in, and clears each one before handing the space back. A record that does not fit before
+ *  the end of the ring is preceded by a skip record. Messages longer than a record are split across records. A writer that
+ *  finds the ring full waits a short time for the output thread to make space, as it waited on the output before the ring,
+ *  and the message is counted and dropped only if there is still no space.
+ *
+ *  Each sink has an optional rate limit in bytes per second. Messages over the limit are dropped for that sink only and a
+ *  count of them is printed when output resumes. Until the thread is running, output is written directly as before.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "interface.h"
+#include "telnetd.h"
+#include "log_buffer.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define LOG_RECORD_SIZE( length )   ( ( sizeof( log_record_header_t ) + ( length ) + 3 ) & ~3 )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE             ( 4096 )    // Must be a power of 2
+#endif
+#define LOG_BUFFER_MASK             ( LOG_BUFFER_SIZE - 1 )
+#define LOG_THREAD_STACK_SIZE       ( 2048 )
+/*
+ * imx_process() never sleeps, a thread below the application priority would never run. This thread sits just above
+ * it and sleeps whenever the ring is empty or a sink is waiting on I/O
+ */
+#ifndef LOG_THREAD_PRIORITY
+#define LOG_THREAD_PRIORITY         ( WICED_APPLICATION_PRIORITY - 1 )
+#endif
+#define LOG_DRAIN_INTERVAL          ( 10 )      // mS between checks of an empty ring
+#ifndef LOG_CONSOLE_RATE
+#define LOG_CONSOLE_RATE            ( 0 )       // Bytes per second, 0 - no limit
+#endif
+#ifndef LOG_TELNET_RATE
+#define LOG_TELNET_RATE             ( 8192 )
+#endif
+#define SUPPRESSED_MESSAGE_LENGTH   64
+#define LOG_FULL_WAIT               ( 1 )       // mS between checks of a full ring
+#define LOG_FULL_MAX_WAIT           ( 250 )     // mS a writer waits for space before dropping the message
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum log_record_states {
+    LOG_RECORD_FREE = 0,                        // Reserved, still being filled in
+    LOG_RECORD_READY,
+    LOG_RECORD_SKIP                             // Space to the end of the ring not used
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint16_t length;                            // Message bytes following the header
+    uint8_t sinks;
+    volatile uint8_t state;                     // Written last by the writer, cleared by the output thread
+} log_record_header_t;
+
+typedef struct {
+    uint32_t rate;                              // Bytes per second, 0 - no limit
+    uint32_t budget;                            // Bytes that can be written now
+    wiced_time_t last_refill;
+    uint32_t bytes;
+    uint32_t messages;
+    uint32_t rate_dropped;                      // Total dropped by the rate limit
+    uint32_t suppressed;                        // Dropped since output was last allowed
+} log_sink_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static void log_output_thread( wiced_thread_arg_t arg );
+static void log_record_write( uint16_t sinks, char *data, uint16_t length );
+static uint16_t log_drain( wiced_time_t current_time );
+static bool sink_allowed( log_sink_t *sink, uint16_t length, wiced_time_t current_time );
+static void sink_write( uint16_t sink, char *data, uint16_t length, bool buffered );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint8_t log_ring[ LOG_BUFFER_SIZE ] __attribute__ ((aligned (4)));
+static volatile uint32_t log_reserve;           // Moved by writers, free running
+static volatile uint32_t log_out;               // Moved by the output thread, free running
+static uint32_t log_messages, log_dropped, log_truncated, log_split, log_waits, log_high_water;
+static log_sink_t log_sinks[ LOG_NO_SINKS ] = {
+        { .rate = LOG_CONSOLE_RATE },
+        { .rate = LOG_TELNET_RATE },
+};
+static wiced_thread_t log_thread;
+static bool log_running = false;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Start the log output thread, output is buffered from now on
+  * @param  None
+  * @retval : true if the thread started
+  */
+bool log_buffer_init(void)
+{
+    uint16_t i;
+
+    memset( log_ring, 0x00, sizeof( log_ring ) );
+    log_reserve = 0;
+    log_out = 0;
+    for( i = 0; i < LOG_NO_SINKS; i++ ) {
+        log_sinks[ i ].budget = log_sinks[ i ].rate;
+        wiced_time_get_time( &log_sinks[ i ].last_refill );
+    }
+    if( wiced_rtos_create_thread( &log_thread, LOG_THREAD_PRIORITY, "Log output", log_output_thread, LOG_THREAD_STACK_SIZE, NULL ) != WICED_SUCCESS )
+        return false;
+    log_running = true;
+    return true;
+}
+/**
+  * @brief  Queue a formatted message for the sinks - written directly if the output thread is not running
+  *         Messages longer than LOG_MAX_MESSAGE are split across records
+  * @param  LOG_SINK_ bits, message, length
+  * @retval : None
+  */
+void log_buffer_write( uint16_t sinks, char *data, uint16_t length )
+{
+    uint16_t chunk;
+
+    if( ( sinks == 0 ) || ( length == 0 ) )
+        return;
+    if( log_running == false ) {
+        if( ( sinks & LOG_SINK_CONSOLE ) != 0 )
+            sink_write( LOG_CONSOLE, data, length, false );
+        if( ( sinks & LOG_SINK_TELNET ) != 0 )
+            sink_write( LOG_TELNET, data, length, false );
+        return;
+    }
+    if( length > LOG_MAX_MESSAGE )
+        log_split += 1;
+    while( length > 0 ) {
+        chunk = ( length > LOG_MAX_MESSAGE ) ? LOG_MAX_MESSAGE : length;
+        log_record_write( sinks, data, chunk );
+        data += chunk;
+        length -= chunk;
+    }
+}
+/**
+  * @brief  Count a message cut short by the caller, used when a long message could not be formatted in full
+  * @param  None
+  * @retval : None
+  */
+void log_buffer_truncated(void)
+{
+    log_truncated += 1;
+}
+/**
+  * @brief  Copy one record in to the ring, waiting for space if it is full
+  *         The output thread never waits on itself, it is the only one that makes space
+  * @param  LOG_SINK_ bits, message, length - at most LOG_MAX_MESSAGE
+  * @retval : None
+  */
+static void log_record_write( uint16_t sinks, char *data, uint16_t length )
+{
+    uint32_t in, out, position, needed, record_size;
+    uint16_t waited;
+    log_record_header_t *record;
+
+    /*
+     * Reserve space - a record that would run past the end of the ring starts at the beginning after a skip record
+     */
+    record_size = LOG_RECORD_SIZE( length );
+    waited = 0;
+    while( true ) {
+        in = log_reserve;
+        out = log_out;
+        position = in & LOG_BUFFER_MASK;
+        needed = record_size;
+        if( ( LOG_BUFFER_SIZE - position ) < record_size )
+            needed += LOG_BUFFER_SIZE - position;
+        if( ( ( in - out ) + needed ) <= LOG_BUFFER_SIZE ) {
+            if( __sync_bool_compare_and_swap( &log_reserve, in, in + needed ) == true )
+                break;
+        } else {
+            if( ( waited >= LOG_FULL_MAX_WAIT ) || ( wiced_rtos_is_current_thread( &log_thread ) == WICED_SUCCESS ) ) {
+                log_dropped += 1;
+                return;
+            }
+            if( waited == 0 )
+                log_waits += 1;
+            wiced_rtos_delay_milliseconds( LOG_FULL_WAIT );
+            waited += LOG_FULL_WAIT;
+        }
+    }
+    if( ( in + needed - out ) > log_high_water )
+        log_high_water = in + needed - out;
+
+    if( needed != record_size ) {
+        record = (log_record_header_t *) &log_ring[ position ];
+        record->length = LOG_BUFFER_SIZE - position - sizeof( log_record_header_t );
+        record->sinks = 0;
+        __sync_synchronize();
+        record->state = LOG_RECORD_SKIP;
+        position = 0;
+    }
+    record = (log_record_header_t *) &log_ring[ position ];
+    record->length = length;
+    record->sinks = sinks;
+    memcpy( &log_ring[ position + sizeof( log_record_header_t ) ], data, length );
+    __sync_synchronize();           // Message must be in place before the record is marked ready
+    record->state = LOG_RECORD_READY;
+    log_messages += 1;
+}
+/**
+  * @brief  Set the rate limit of a sink
+  * @param  LOG_CONSOLE / LOG_TELNET, bytes per second - 0 for no limit
+  * @retval : None
+  */
+void log_buffer_set_rate( uint16_t sink, uint32_t bytes_per_second )
+{
+    if( sink >= LOG_NO_SINKS )
+        return;
+    log_sinks[ sink ].rate = bytes_per_second;
+    log_sinks[ sink ].budget = bytes_per_second;
+}
+/**
+  * @brief  Print the log buffer statistics
+  * @param  None
+  * @retval : None
+  */
+void print_log_buffer_status(void)
+{
+    imx_cli_print( "Log buffer: %s, %u Bytes, In use: %lu, High water: %lu, Messages: %lu, Waited (full): %lu, Dropped (full): %lu, Split: %lu, Truncated: %lu\r\n",
+            log_running ? "Buffered" : "Direct", LOG_BUFFER_SIZE, log_reserve - log_out, log_high_water, log_messages, log_waits, log_dropped,
+            log_split, log_truncated );
+    imx_cli_print( "    Console: %lu Messages, %lu Bytes, Rate limit: %lu B/s, Dropped: %lu - Telnet: %lu Messages, %lu Bytes, Rate limit: %lu B/s, Dropped: %lu\r\n",
+            log_sinks[ LOG_CONSOLE ].messages, log_sinks[ LOG_CONSOLE ].bytes, log_sinks[ LOG_CONSOLE ].rate, log_sinks[ LOG_CONSOLE ].rate_dropped,
+            log_sinks[ LOG_TELNET ].messages, log_sinks[ LOG_TELNET ].bytes, log_sinks[ LOG_TELNET ].rate, log_sinks[ LOG_TELNET ].rate_dropped );
+}
+/**
+  * @brief  Log output thread - write out records as they are ready
+  * @param  Not used
+  * @retval : None
+  */
+static void log_output_thread( wiced_thread_arg_t arg )
+{
+    wiced_time_t current_time;
+
+    UNUSED_PARAMETER( arg );
+    while( true ) {
+        wiced_time_get_time( &current_time );
+        if( log_drain( current_time ) == 0 )
+            wiced_rtos_delay_milliseconds( LOG_DRAIN_INTERVAL );
+    }
+}
+/**
+  * @brief  Write out the records that are ready
+  * @param  current time
+  * @retval : Number of records written out
+  */
+static uint16_t log_drain( wiced_time_t current_time )
+{
+    uint16_t count, i;
+    uint32_t position, record_size;
+    char suppressed_message[ SUPPRESSED_MESSAGE_LENGTH ];
+    log_record_header_t *record;
+
+    count = 0;
+    while( log_out != log_reserve ) {
+        position = log_out & LOG_BUFFER_MASK;
+        record = (log_record_header_t *) &log_ring[ position ];
+        if( record->state == LOG_RECORD_FREE )
+            break;                  // Still being filled in
+        __sync_synchronize();       // Read the record after seeing it ready
+        record_size = LOG_RECORD_SIZE( record->length );
+        if( record->state == LOG_RECORD_READY ) {
+            for( i = 0; i < LOG_NO_SINKS; i++ ) {
+                if( ( record->sinks & ( 1 << i ) ) == 0 )
+                    continue;
+                if( ( i == LOG_TELNET ) && ( telnet_active() == false ) )
+                    continue;
+                if( sink_allowed( &log_sinks[ i ], record->length, current_time ) == false )
+                    continue;
+                if( log_sinks[ i ].suppressed > 0 ) {
+                    snprintf( suppressed_message, SUPPRESSED_MESSAGE_LENGTH, "*** %lu log messages suppressed ***\r\n", log_sinks[ i ].suppressed );
+                    sink_write( i, suppressed_message, strlen( suppressed_message ), true );
+                    log_sinks[ i ].suppressed = 0;
+                }
+                sink_write( i, (char *) &log_ring[ position + sizeof( log_record_header_t ) ], record->length, true );
+            }
+            count += 1;
+        }
+        /*
+         * Clear the record so a later record header can not land on stale data, then hand the space back
+         */
+        memset( record, 0x00, record_size );
+        __sync_synchronize();
+        log_out += record_size;
+    }
+    return count;
+}
+/**
+  * @brief  Check the rate limit of a sink
+  * @param  sink, message length, current time
+  * @retval : true if the message can be written
+  */
+static bool sink_allowed( log_sink_t *sink, uint16_t length, wiced_time_t current_time )
+{
+    uint32_t elapsed, refill;
+
+    if( sink->rate == 0 )
+        return true;
+    elapsed = (uint32_t) ( current_time - sink->last_refill );
+    if( elapsed > 1000 )
+        elapsed = 1000;                         // A full budget, and no overflow below
+    refill = ( elapsed * sink->rate ) / 1000;
+    if( refill > 0 ) {
+        sink->budget += refill;
+        if( sink->budget > sink->rate )
+            sink->budget = sink->rate;          // Burst of up to one second
+        sink->last_refill = current_time;
+    }
+    if( sink->budget < length ) {
+        sink->rate_dropped += 1;
+        sink->suppressed += 1;
+        return false;
+    }
+    sink->budget -= length;
+    return true;
+}
+/**
+  * @brief  Write a message to a sink
+  * @param  sink, message, length, buffered - telnet output goes to the telnet transmit ring, sent from the main loop
+  * @retval : None
+  */
+static void sink_write( uint16_t sink, char *data, uint16_t length, bool buffered )
+{
+    log_sinks[ sink ].messages += 1;
+    log_sinks[ sink ].bytes += length;
+    if( sink == LOG_CONSOLE ) {
+        fwrite( data, 1, length, stdout );
+        fflush( stdout );
+    } else if( buffered == true ) {
+        telnetd_send( data, length );
+    } else if( telnetd_write( data, length ) == false ) {
+        imx_printf( "Telnet stream failure, closing session\r\n" );
+        telnetd_deinit();
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file log_buffer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef LOG_BUFFER_H_
+#define LOG_BUFFER_H_
+
+/*
+ *  Output ring for console, CLI and log messages, written to the console and telnet by the log output thread
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define LOG_MAX_MESSAGE         256         // Largest record, messages are formatted in to a buffer of this size first
+#define LOG_MAX_LONG_MESSAGE    4096        // Longer messages are split across records up to this length, then truncated
+#define LOG_SINK_CONSOLE        0x01
+#define LOG_SINK_TELNET         0x02
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum log_sinks {
+    LOG_CONSOLE,
+    LOG_TELNET,
+    LOG_NO_SINKS
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+bool log_buffer_init(void);
+void log_buffer_write( uint16_t sinks, char *data, uint16_t length );
+void log_buffer_truncated(void);
+void log_buffer_set_rate( uint16_t sink, uint32_t bytes_per_second );
+void print_log_buffer_status(void);
+#endif /* LOG_BUFFER_H_ */
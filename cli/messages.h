@@ -61,6 +61,7 @@
 #define DEBUGS_FOR_APPLICATION_START    (0x00000200)
 #define DEBUGS_FOR_EVENTS_DRIVEN        (0x00000400)
 #define DEBUGS_FOR_SAMPLING             (0x00000800)
+#define DEBUGS_TO_TRACE                 (0x00001000)    // Record converted debugs in the binary trace instead of printing them
 /*
  * Background (callback) messages to print in main loop
  */
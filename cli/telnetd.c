@@ -59,7 +59,16 @@
 /******************************************************
  *                    Constants
  ******************************************************/
-#define TELNET_BUFFER_LENGTH		64		// Must be a power of 2
+#define TELNET_RX_BUFFER_LENGTH		512		// Must be a power of 2
+#define TELNET_RX_MASK				( TELNET_RX_BUFFER_LENGTH - 1 )
+#define TELNET_READ_LENGTH			128		// Read from the stream in blocks of this size
+#define TELNET_TX_BUFFER_LENGTH		4096	// Must be a power of 2
+#define TELNET_TX_MASK				( TELNET_TX_BUFFER_LENGTH - 1 )
+#define TELNET_TX_FLUSH_SIZE		1024	// Send as soon as this much output is waiting
+#define TELNET_TX_NEWLINE_IDLE		10		// mS with no new output after a line ending before it is sent
+#define TELNET_TX_IDLE				50		// mS with no new output after anything else, a prompt for example
+#define TELNET_TX_WAIT				10		// mS the writer waits for space in the transmit ring
+#define TELNET_TX_MAX_WAITS			50
 #define TELNET_SERVER_LISTEN_PORT	23
 #define TELNET_TIME_OUT				(30 * 60 )		// 2 mins during debugging
 /*
@@ -177,6 +186,15 @@ typedef struct {
 	wiced_thread_t		thread;
 } telnet_tcp_server_t;
 
+typedef struct {
+	uint32_t rx_bytes;
+	uint32_t rx_dropped;						// Receive ring full
+	uint32_t tx_bytes;
+	uint32_t segments;							// Stream flushes, each sends at least one TCP segment
+	uint32_t stalls;							// Writer waited for space in the transmit ring
+	uint32_t tx_dropped;						// Bytes dropped after waiting too long
+} telnet_session_stats_t;
+
 /******************************************************
  *                    Structures
  ******************************************************/
@@ -184,6 +202,9 @@ typedef struct {
 /******************************************************
  *               Function Declarations
  ******************************************************/
+static void reset_session_buffers(void);
+static void telnet_tx_process( wiced_time_t current_time );
+static bool telnet_tx_drain(void);
 
 /******************************************************
  *               Variable Definitions
@@ -212,7 +233,17 @@ struct TELNET_CONFIG {
 	uint16_t state;
 	uint16_t start;
 	uint16_t length;
-	uint8_t buffer[ TELNET_BUFFER_LENGTH ];
+	uint8_t buffer[ TELNET_RX_BUFFER_LENGTH ];
+	/*
+	 * Transmit ring - written by the log output thread, sent by telnetd() in the main loop
+	 */
+	uint8_t tx_buffer[ TELNET_TX_BUFFER_LENGTH ];
+	volatile uint32_t tx_in;					// Free running, moved by the writer
+	volatile uint32_t tx_out;					// Free running, moved by telnetd()
+	volatile wiced_time_t tx_last_write;
+	volatile bool tx_newline;					// Last output written ended a line
+	volatile bool tx_failed;					// Stream write failed, session is closed by telnetd()
+	telnet_session_stats_t stats;
 	wiced_tcp_server_t tcp_server;
     wiced_tcp_socket_t *socket;
     wiced_tcp_stream_t tcp_stream;
@@ -315,7 +346,7 @@ void telnetd(void)
 
 	wiced_interface_t interface;
 	wiced_result_t result;
-    uint8_t local_buffer[ TELNET_BUFFER_LENGTH ], *reply_string;
+    uint8_t local_buffer[ TELNET_READ_LENGTH ], *reply_string;
     uint16_t i;
     uint32_t local_buffer_length;
 	server_event_message_t current_event;
@@ -323,8 +354,17 @@ void telnetd(void)
 
 	wiced_time_get_time( &time );// Need current time to see if telnet session should time out.
 
+	if( telnet_config.tx_failed == true ) {
+		telnet_config.tx_failed = false;
+		imx_printf( "Telnet stream failure, closing session\r\n" );
+		telnetd_deinit();
+		return;
+	}
+
 	switch( telnet_config.state ) {
 		case TELNET_MONITOR :
+			if( telnet_config.active == true )
+				telnet_tx_process( time );
 			if( wiced_rtos_pop_from_queue(&server_event_queue, &current_event, 0) != WICED_SUCCESS ) {
 
 				// Check for timeout.
@@ -336,8 +376,8 @@ void telnetd(void)
 			    	result =  wiced_tcp_stream_flush( &telnet_config.tcp_stream );
 					wiced_tcp_server_disconnect_socket( &telnet_config.tcp_server, telnet_config.socket );//current_event.socket);
 					telnet_config.socket = NULL;
-					memset( telnet_config.buffer, 0, TELNET_BUFFER_LENGTH );
 					telnet_config.active = false;
+					reset_session_buffers();
 				}
 			}
 			else {// Got an event off the queue.
@@ -348,8 +388,8 @@ void telnetd(void)
 						icb.print_telnet_msg = TELNET_MSG_DISCONNECT;
 						wiced_tcp_server_disconnect_socket(&telnet_config.tcp_server, current_event.socket);
 						telnet_config.socket = NULL;
-						memset( telnet_config.buffer, 0, TELNET_BUFFER_LENGTH );
 						telnet_config.active = false;
+						reset_session_buffers();
 						break;
 					case SOCKET_CONNECT_EVENT:
 						icb.print_msg |= MSG_TELNET;
@@ -359,10 +399,14 @@ void telnetd(void)
 							icb.print_telnet_msg = TELNET_MSG_CONNECT_DISCONNECT;
 							wiced_tcp_server_disconnect_socket(&telnet_config.tcp_server, telnet_config.socket);
 							telnet_config.socket = NULL;
-							memset( telnet_config.buffer, 0, TELNET_BUFFER_LENGTH );
+							telnet_config.active = false;
 						}
 						wiced_tcp_server_accept(&telnet_config.tcp_server, current_event.socket);
 						telnet_config.socket = current_event.socket;	// Use this when we support multiple instances
+						reset_session_buffers();
+						memset( &telnet_config.stats, 0, sizeof( telnet_session_stats_t ) );
+						telnet_config.tx_failed = false;
+						__sync_synchronize();
 						telnet_config.active = true;
 						result = wiced_tcp_stream_init( &telnet_config.tcp_stream, telnet_config.socket );
 						if( result == WICED_TCPIP_SUCCESS ) {
@@ -421,8 +465,14 @@ void telnetd(void)
 						}
 						break;
 					case SOCKET_MESSAGE_EVENT:
-						result = wiced_tcp_stream_read_with_count( &telnet_config.tcp_stream, local_buffer, TELNET_BUFFER_LENGTH, 0, &local_buffer_length );
+						/*
+						 * Send any output waiting so echoes and replies follow it
+						 */
+						if( telnet_config.active == true )
+							telnet_tx_drain();
+						result = wiced_tcp_stream_read_with_count( &telnet_config.tcp_stream, local_buffer, TELNET_READ_LENGTH, 0, &local_buffer_length );
 						if( result == WICED_TCPIP_SUCCESS ) { // Got some data process it - First off this will be the negotiation
+							telnet_config.stats.rx_bytes += local_buffer_length;
 							// imx_printf( "\r\nReceived: %lu Bytes >", local_buffer_length );
 					    	for( i = 0; i < local_buffer_length; i++ ) {
 					    		/*
@@ -566,14 +616,11 @@ void telnetd(void)
 						    			/*
 						    			 * Just a regular character - add to buffer to be processed in CLI
 						    			 */
-					    				if( telnet_config.length == TELNET_BUFFER_LENGTH )
-					    					;	// Drop Character
+					    				if( telnet_config.length == TELNET_RX_BUFFER_LENGTH )
+					    					telnet_config.stats.rx_dropped += 1;	// Drop Character
 					    				else {
 					    					// imx_printf( "Adding character [0x%02x] at start: %u and length: %u\r\n", (uint16_t ) local_buffer[ i ], telnet_config.start, telnet_config.length );
-						    				if( telnet_config.start + telnet_config.length > TELNET_BUFFER_LENGTH )
-						    					telnet_config.buffer[ ( telnet_config.start + telnet_config.length ) - TELNET_BUFFER_LENGTH ] = local_buffer[ i ];
-						    				else
-						    					telnet_config.buffer[ ( telnet_config.start + telnet_config.length ) ] = local_buffer[ i ];
+					    					telnet_config.buffer[ ( telnet_config.start + telnet_config.length ) & TELNET_RX_MASK ] = local_buffer[ i ];
 					    					telnet_config.length += 1;
 					    				}
 					    			}
@@ -731,7 +778,7 @@ uint16_t telnetd_getch( char *ch )
 		*ch = (char) telnet_config.buffer[ telnet_config.start ];
 		//imx_printf( "Got character [0x%02x] at start: %u and length: %u\r\n", (uint16_t ) *ch, telnet_config.start, telnet_config.length );
 		telnet_config.start += 1;
-		if( telnet_config.start == TELNET_BUFFER_LENGTH )
+		if( telnet_config.start == TELNET_RX_BUFFER_LENGTH )
 			telnet_config.start = 0;	// Wrap
 		telnet_config.length -= 1;
 		//imx_printf( "length now %u\r\n", telnet_config.length );
@@ -740,10 +787,17 @@ uint16_t telnetd_getch( char *ch )
 		return false;
 }
 
+/**
+  * @brief  Write to the telnet stream and flush, output waiting in the transmit ring goes first - main loop only
+  * @param  buffer, length
+  * @retval : true / false
+  */
 uint16_t telnetd_write( char *buffer, uint16_t length )
 {
 	wiced_result_t result;
 
+	if( telnet_tx_drain() == false )
+		return false;
 	result = wiced_tcp_stream_write( &telnet_config.tcp_stream, (void *) buffer, (uint32_t) length );
 	if ( result != WICED_TCPIP_SUCCESS ) {
 		imx_printf( "Failed to send to TCP Stream\r\n" );
@@ -754,11 +808,123 @@ uint16_t telnetd_write( char *buffer, uint16_t length )
 		imx_printf( "Failed to flush TCP Stream with error code: %u\r\n", result );
 		return false;
 	}
+	telnet_config.stats.tx_bytes += length;
+	telnet_config.stats.segments += 1;
+	return true;
+}
+
+/**
+  * @brief  Add output to the transmit ring, telnetd() sends it from the main loop
+  *         Used by the log output thread, waits for space for a while if the ring is full - never call from the main loop
+  * @param  buffer, length
+  * @retval : true / false
+  */
+uint16_t telnetd_send( char *buffer, uint16_t length )
+{
+	uint32_t in, position, first;
+	uint16_t waits;
+	wiced_time_t now;
+
+	if( ( telnet_config.active == false ) || ( telnet_config.tx_failed == true ) || ( length > TELNET_TX_BUFFER_LENGTH ) )
+		return false;
+	for( waits = 0; ( TELNET_TX_BUFFER_LENGTH - ( telnet_config.tx_in - telnet_config.tx_out ) ) < length; waits++ ) {
+		if( waits == TELNET_TX_MAX_WAITS ) {
+			telnet_config.stats.tx_dropped += length;
+			return false;
+		}
+		telnet_config.stats.stalls += 1;
+		wiced_rtos_delay_milliseconds( TELNET_TX_WAIT );
+	}
+	in = telnet_config.tx_in;
+	position = in & TELNET_TX_MASK;
+	first = TELNET_TX_BUFFER_LENGTH - position;
+	if( first >= length )
+		memcpy( &telnet_config.tx_buffer[ position ], buffer, length );
+	else {
+		memcpy( &telnet_config.tx_buffer[ position ], buffer, first );
+		memcpy( &telnet_config.tx_buffer[ 0 ], &buffer[ first ], length - first );
+	}
+	wiced_time_get_time( &now );
+	telnet_config.tx_last_write = now;
+	telnet_config.tx_newline = ( buffer[ length - 1 ] == '\n' );
+	__sync_synchronize();			// Data must be in place before the writer index moves
+	telnet_config.tx_in = in + length;
 	return true;
 }
 
 void print_telnet_state(void)
 {
 	imx_cli_print( "Telnet State: %s State: %u \r\n", telnet_config.active ? "Active" : "Idle", telnet_config.state );
+	if( telnet_config.active == true )
+		imx_cli_print( "    Session - Received: %lu Bytes, Dropped: %lu, Sent: %lu Bytes in %lu Flushes, TX waiting: %lu Bytes, TX stalls: %lu, TX dropped: %lu Bytes\r\n",
+				telnet_config.stats.rx_bytes, telnet_config.stats.rx_dropped, telnet_config.stats.tx_bytes, telnet_config.stats.segments,
+				telnet_config.tx_in - telnet_config.tx_out, telnet_config.stats.stalls, telnet_config.stats.tx_dropped );
+}
+/**
+  * @brief  Clear the receive ring and drop any output waiting in the transmit ring
+  * @param  None
+  * @retval : None
+  */
+static void reset_session_buffers(void)
+{
+	telnet_config.start = 0;
+	telnet_config.length = 0;
+	memset( telnet_config.buffer, 0, TELNET_RX_BUFFER_LENGTH );
+	telnet_config.tx_out = telnet_config.tx_in;
+	telnet_config.tx_newline = false;
+}
+/**
+  * @brief  Send the transmit ring once enough is waiting, or output has stopped - after a line ending or a short idle time
+  * @param  current time
+  * @retval : None
+  */
+static void telnet_tx_process( wiced_time_t current_time )
+{
+	uint32_t pending, idle;
+
+	pending = telnet_config.tx_in - telnet_config.tx_out;
+	if( pending == 0 )
+		return;
+	idle = (uint32_t) ( current_time - telnet_config.tx_last_write );
+	if( ( pending >= TELNET_TX_FLUSH_SIZE ) || ( idle >= TELNET_TX_IDLE ) ||
+		( ( telnet_config.tx_newline == true ) && ( idle >= TELNET_TX_NEWLINE_IDLE ) ) )
+		telnet_tx_drain();
+}
+/**
+  * @brief  Write everything in the transmit ring to the stream and flush it
+  * @param  None
+  * @retval : false if the stream failed, the session is then closed by telnetd()
+  */
+static bool telnet_tx_drain(void)
+{
+	uint32_t in, out, position, chunk;
 
+	if( telnet_config.tx_failed == true )
+		return false;
+	in = telnet_config.tx_in;
+	out = telnet_config.tx_out;
+	if( in == out )
+		return true;
+	__sync_synchronize();			// Read the data after seeing the writer index
+	while( out != in ) {
+		position = out & TELNET_TX_MASK;
+		chunk = TELNET_TX_BUFFER_LENGTH - position;
+		if( chunk > in - out )
+			chunk = in - out;
+		if( wiced_tcp_stream_write( &telnet_config.tcp_stream, &telnet_config.tx_buffer[ position ], chunk ) != WICED_TCPIP_SUCCESS ) {
+			telnet_config.tx_out = in;
+			telnet_config.tx_failed = true;
+			return false;
+		}
+		out += chunk;
+		telnet_config.stats.tx_bytes += chunk;
+		__sync_synchronize();
+		telnet_config.tx_out = out;
+	}
+	if( wiced_tcp_stream_flush( &telnet_config.tcp_stream ) != WICED_TCPIP_SUCCESS ) {
+		telnet_config.tx_failed = true;
+		return false;
+	}
+	telnet_config.stats.segments += 1;
+	return true;
 }
@@ -73,5 +73,6 @@ uint16_t telnet_active(void);
 void telnetd(void);
 uint16_t telnetd_getch( char *ch );
 uint16_t telnetd_write( char *buffer, uint16_t length );
+uint16_t telnetd_send( char *buffer, uint16_t length );
 void print_telnet_state(void);
 #endif /* _TELNET_D_H_ */
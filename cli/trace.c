@@ -0,0 +1,376 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file trace.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Binary trace. A trace call records the address of its format string, a time stamp and up to TRACE_MAX_ARGS raw
+ *  arguments in a fixed size record in a RAM ring. Nothing is formatted when the record is made, so leaving debugs on
+ *  costs a few stores rather than a vsnprintf() and a write to the console. The ring is a flight recorder, the newest
+ *  records replace the oldest.
+ *
+ *  The "trace" command formats the records on the device, the format strings are in this image. "trace raw" prints the
+ *  records as words so they can be decoded on a host with tools/trace_decode and the ELF file of the same build.
+ *
+ *  The records can also be mirrored to a ring in unpartitioned serial flash so they survive a reboot. The mirror is
+ *  written from the main loop, a few records at a time, never from the trace call. The sector after the write position
+ *  is always erased so the position can be found again at start up. Records read back from flash are only printed
+ *  raw, after an update the format string addresses no longer match this image.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../storage.h"
+#include "../ota_loader/ota_structure.h"
+#include "../sflash/sflash.h"
+#include "../sflash/sflash_log.h"
+#include "../sflash/sflash_writer.h"
+#include "spi_flash_fast_erase.h"
+#include "interface.h"
+#include "messages.h"
+#include "trace.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS           ( 128 )         // Must be a power of 2
+#endif
+#define TRACE_MASK              ( TRACE_RECORDS - 1 )
+/*
+ * Mirror sits above the default flash spill log, below the OTA checkpoints and the configuration area
+ */
+#ifndef TRACE_LOG_START
+#define TRACE_LOG_START         ( 0x390000 )
+#endif
+#ifndef TRACE_LOG_SIZE
+#define TRACE_LOG_SIZE          ( 0x020000 )    // At least two 64K sectors, the sector ahead of the write position is erased
+#endif
+#ifndef TRACE_MIRROR_DEFAULT
+#define TRACE_MIRROR_DEFAULT    ( false )
+#endif
+#define TRACE_MIRROR_BATCH      ( 8 )           // Records written to flash per pass of the main loop
+#define TRACE_BLANK             ( 0xFFFFFFFF )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t sector_size;
+    uint32_t head;                              // Offset of the next record to write
+    uint32_t mirrored;                          // Next record number to copy from RAM
+    uint32_t written, lost, write_errors, erases;
+    unsigned int available : 1;
+    unsigned int enabled : 1;
+} trace_mirror_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static bool read_ram_record( uint32_t index, trace_record_t *record );
+static void print_record( trace_record_t *record, bool raw );
+static void mirror_write( trace_record_t *record );
+static void dump_mirror(void);
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static trace_record_t trace_ring[ TRACE_RECORDS ];
+static volatile uint32_t trace_next;            // Records made, free running
+static uint32_t trace_start;                    // First record to print, moved by trace clear
+static trace_mirror_t mirror;
+extern sflash_handle_t sflash_handle;
+extern IOT_Device_Config_t device_config;   // Defined in storage.h
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Find the write position of the flash mirror, called once the serial flash is initialized
+  * @param  serial flash initialized and of the expected size
+  * @retval : None
+  */
+void trace_init( bool sflash_ok )
+{
+    uint32_t offset;
+    bool previous_blank, blank, found;
+
+    memset( &mirror, 0, sizeof( trace_mirror_t ) );
+    if( ( sflash_ok == false ) || ( sflash_log_area_free( TRACE_LOG_START, TRACE_LOG_SIZE ) == false ) ) {
+        imx_printf( "Trace flash mirror not available\r\n" );
+        return;
+    }
+    mirror.sector_size = get_sflash_sector_size();
+    /*
+     * The write position is the first blank slot after a written one, all blank is a new log
+     */
+    found = false;
+    previous_blank = sflash_log_slot_blank( TRACE_LOG_START + TRACE_LOG_SIZE - sizeof( trace_record_t ), sizeof( trace_record_t ) );
+    for( offset = 0; ( offset < TRACE_LOG_SIZE ) && ( found == false ); offset += sizeof( trace_record_t ) ) {
+        blank = sflash_log_slot_blank( TRACE_LOG_START + offset, sizeof( trace_record_t ) );
+        if( ( blank == true ) && ( previous_blank == false ) ) {
+            mirror.head = offset;
+            found = true;
+        }
+        previous_blank = blank;
+    }
+    if( found == false ) {
+        mirror.head = 0;
+        if( previous_blank == false ) {
+            /*
+             * No blank slot, not written by this code - start again
+             */
+            if( sflash_erase_area( &sflash_handle, TRACE_LOG_START, mirror.sector_size, mirror.sector_size ) != 0 ) {
+                imx_printf( "Unable to erase trace flash mirror\r\n" );
+                return;
+            }
+            mirror.erases += 1;
+        }
+    }
+    mirror.mirrored = trace_next;
+    mirror.available = true;
+    mirror.enabled = TRACE_MIRROR_DEFAULT;
+    TRACE( "Trace started, boot count: %lu\r\n", device_config.boot_count );
+}
+/**
+  * @brief  Record a trace entry - use the TRACE() macro rather than calling this directly
+  * @param  format string, arguments
+  * @retval : None
+  */
+void imx_trace( const char *format, uint32_t arg_1, uint32_t arg_2, uint32_t arg_3, uint32_t arg_4, uint32_t arg_5 )
+{
+    trace_record_t *record;
+    wiced_time_t now;
+    uint32_t index;
+
+    wiced_time_get_time( &now );
+    index = __sync_fetch_and_add( &trace_next, 1 );
+    record = &trace_ring[ index & TRACE_MASK ];
+    record->sequence = 0;
+    __sync_synchronize();
+    record->format = (uint32_t) format;
+    record->time = (uint32_t) now;
+    record->arg[ 0 ] = arg_1;
+    record->arg[ 1 ] = arg_2;
+    record->arg[ 2 ] = arg_3;
+    record->arg[ 3 ] = arg_4;
+    record->arg[ 4 ] = arg_5;
+    __sync_synchronize();
+    record->sequence = index + 1;
+}
+/**
+  * @brief  Copy new records to the flash mirror, called from the main loop
+  * @param  None
+  * @retval : None
+  */
+void trace_process(void)
+{
+    trace_record_t record;
+    uint32_t next;
+    uint16_t count;
+
+    if( ( mirror.available == false ) || ( mirror.enabled == false ) )
+        return;
+    next = trace_next;
+    if( ( next - mirror.mirrored ) > TRACE_RECORDS ) {
+        mirror.lost += ( next - mirror.mirrored ) - TRACE_RECORDS;
+        mirror.mirrored = next - TRACE_RECORDS;
+    }
+    for( count = 0; ( mirror.mirrored != next ) && ( count < TRACE_MIRROR_BATCH ); count++ ) {
+        if( read_ram_record( mirror.mirrored, &record ) == false ) {
+            if( trace_ring[ mirror.mirrored & TRACE_MASK ].sequence == 0 )
+                return;                         // Still being filled in, try again next time
+            mirror.lost += 1;                   // Already replaced
+        } else
+            mirror_write( &record );
+        mirror.mirrored += 1;
+    }
+}
+/**
+  * @brief  trace [ raw | clear | flash [ on | off ] ] - print or manage the trace
+  * @param  None
+  * @retval : None
+  */
+void cli_trace( uint16_t arg )
+{
+    trace_record_t record;
+    uint32_t index, next;
+    bool raw;
+    char *token;
+
+    UNUSED_PARAMETER( arg );
+    raw = false;
+    token = strtok( NULL, " " );
+    if( token ) {
+        if( strcmp( token, "raw" ) == 0 )
+            raw = true;
+        else if( strcmp( token, "clear" ) == 0 ) {
+            trace_start = trace_next;
+            return;
+        } else if( strcmp( token, "flash" ) == 0 ) {
+            if( mirror.available == false ) {
+                imx_cli_print( "Trace flash mirror not available\r\n" );
+                return;
+            }
+            token = strtok( NULL, " " );
+            if( token == NULL )
+                dump_mirror();
+            else if( strcmp( token, "on" ) == 0 ) {
+                mirror.mirrored = trace_next;
+                mirror.enabled = true;
+            } else if( strcmp( token, "off" ) == 0 )
+                mirror.enabled = false;
+            else
+                imx_cli_print( "Invalid option, trace flash [ on | off ]\r\n" );
+            return;
+        } else {
+            imx_cli_print( "Invalid option, trace [ raw | clear | flash [ on | off ] ]\r\n" );
+            return;
+        }
+    }
+    next = trace_next;
+    index = ( ( next - trace_start ) > TRACE_RECORDS ) ? next - TRACE_RECORDS : trace_start;
+    if( raw == true )
+        imx_cli_print( "Sequence Time(mS) Format   Arguments\r\n" );
+    for( ; index != next; index++ )
+        if( read_ram_record( index, &record ) == true )
+            print_record( &record, raw );
+}
+/**
+  * @brief  Print the state of the trace
+  * @param  None
+  * @retval : None
+  */
+void print_trace_status(void)
+{
+    imx_cli_print( "Trace: %lu Records made, %u held in RAM, Debugs %s\r\n", trace_next, (uint16_t) TRACE_RECORDS,
+            ( ( device_config.log_messages & DEBUGS_TO_TRACE ) != 0x00 ) ? "traced" : "printed" );
+    if( mirror.available == true )
+        imx_cli_print( "    Flash mirror %s @: 0x%08lx, Size: 0x%08lx, Next record @: 0x%08lx, Written: %lu, Lost: %lu, Write errors: %lu, Sector erases: %lu\r\n",
+                ( mirror.enabled == true ) ? "enabled" : "disabled", (uint32_t) TRACE_LOG_START, (uint32_t) TRACE_LOG_SIZE,
+                (uint32_t) TRACE_LOG_START + mirror.head, mirror.written, mirror.lost, mirror.write_errors, mirror.erases );
+    else
+        imx_cli_print( "    Flash mirror not available\r\n" );
+}
+/**
+  * @brief  Copy a record from the RAM ring
+  * @param  record number, copy
+  * @retval : true - record complete and not replaced while it was copied
+  */
+static bool read_ram_record( uint32_t index, trace_record_t *record )
+{
+    trace_record_t *entry;
+
+    entry = &trace_ring[ index & TRACE_MASK ];
+    if( entry->sequence != index + 1 )
+        return false;
+    __sync_synchronize();
+    memcpy( record, entry, sizeof( trace_record_t ) );
+    __sync_synchronize();
+    return ( entry->sequence == index + 1 ) && ( record->sequence == index + 1 );
+}
+
+static void print_record( trace_record_t *record, bool raw )
+{
+    if( raw == true )
+        imx_cli_print( "%08lx %08lx %08lx %08lx %08lx %08lx %08lx %08lx\r\n", record->sequence, record->time, record->format,
+                record->arg[ 0 ], record->arg[ 1 ], record->arg[ 2 ], record->arg[ 3 ], record->arg[ 4 ] );
+    else {
+        imx_cli_print( "%06lu.%03lu: ", record->time / 1000, record->time % 1000 );
+        imx_cli_print( (char *) record->format, record->arg[ 0 ], record->arg[ 1 ], record->arg[ 2 ], record->arg[ 3 ], record->arg[ 4 ] );
+    }
+}
+/**
+  * @brief  Append a record to the flash mirror, erasing the sector ahead as the write position reaches it
+  * @param  record
+  * @retval : None
+  */
+static void mirror_write( trace_record_t *record )
+{
+    sflash_writer_lock();
+    if( protected_sflash_write( &sflash_handle, TRACE_LOG_START + mirror.head, record, sizeof( trace_record_t ), WRITE_SFLASH_UNPARTITIONED_SPACE ) != 0 )
+        mirror.write_errors += 1;
+    else
+        mirror.written += 1;
+    mirror.head = sflash_log_next_slot( mirror.head, sizeof( trace_record_t ), TRACE_LOG_SIZE );
+    if( ( mirror.head % mirror.sector_size ) == 0 ) {
+        if( sflash_erase_area( &sflash_handle, TRACE_LOG_START + mirror.head, mirror.sector_size, mirror.sector_size ) != 0 ) {
+            /*
+             * Without a blank sector ahead the write position can not be found again, stop here
+             */
+            mirror.write_errors += 1;
+            mirror.enabled = false;
+        } else
+            mirror.erases += 1;
+    }
+    sflash_writer_unlock();
+}
+/**
+  * @brief  Print the flash mirror as words, oldest first
+  * @param  None
+  * @retval : None
+  */
+static void dump_mirror(void)
+{
+    trace_record_t record;
+    uint32_t offset;
+    int result;
+
+    imx_cli_print( "Sequence Time(mS) Format   Arguments\r\n" );
+    offset = mirror.head;
+    do {
+        sflash_writer_lock();
+        result = sflash_read( &sflash_handle, TRACE_LOG_START + offset, &record, sizeof( trace_record_t ) );
+        sflash_writer_unlock();
+        if( ( result == 0 ) && ( record.sequence != TRACE_BLANK ) )
+            print_record( &record, true );
+        offset = sflash_log_next_slot( offset, sizeof( trace_record_t ), TRACE_LOG_SIZE );
+    } while( offset != mirror.head );
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file trace.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "imx_debug.h"
+
+/*
+ *  Binary trace - debug messages recorded as a format string address and raw arguments, formatted only when read back
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+/*
+ * Up to TRACE_MAX_ARGS integer or pointer arguments of at most 32 bits. More arguments, or a 64 bit or floating point
+ * argument, do not compile. %s arguments are recorded as pointers so they must still be valid when the trace is read,
+ * literals and configuration names are fine
+ */
+#define TRACE( ... )                TRACE_SELECT( __VA_ARGS__, TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, \
+                                        TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, \
+                                        TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, TRACE_TOO_MANY_ARGS, TRACE_CHECKED, TRACE_CHECKED, \
+                                        TRACE_CHECKED, TRACE_CHECKED, TRACE_CHECKED, TRACE_CHECKED, 0 )( __VA_ARGS__ )
+/*
+ * Used by the debug PRINTF macros - record the message in the trace when DEBUGS_TO_TRACE is set, otherwise print it.
+ * A message the trace can not hold - more than TRACE_MAX_ARGS arguments, or a 64 bit or floating point one - is
+ * always printed
+ */
+#define TRACE_OR_PRINTF( ... )      TRACE_SELECT( __VA_ARGS__, imx_printf, imx_printf, imx_printf, imx_printf, imx_printf, \
+                                        imx_printf, imx_printf, imx_printf, imx_printf, imx_printf, TRACE_OR_PRINTF_FIT, \
+                                        TRACE_OR_PRINTF_FIT, TRACE_OR_PRINTF_FIT, TRACE_OR_PRINTF_FIT, TRACE_OR_PRINTF_FIT, \
+                                        TRACE_OR_PRINTF_FIT, 0 )( __VA_ARGS__ )
+/*
+ * Helpers for the above - pick a macro by the number of arguments, including the format, up to 16
+ */
+#define TRACE_SELECT( _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, name, ... )  name
+#define TRACE_TOO_MANY_ARGS( ... )  imx_trace_too_many_args()
+#define TRACE_CHECKED( ... )        TRACE_PAD_CHECKED( __VA_ARGS__, 0, 0, 0, 0, 0 )
+#define TRACE_PAD_CHECKED( format, a, b, c, d, e, ... ) \
+    imx_trace( format, TRACE_ARG_CHECKED( a ), TRACE_ARG_CHECKED( b ), TRACE_ARG_CHECKED( c ), TRACE_ARG_CHECKED( d ), TRACE_ARG_CHECKED( e ) )
+#define TRACE_ARG_CHECKED( a )      ( (void) sizeof( struct { int trace_argument_not_32_bit_integer : TRACE_ARG_FITS( a ) ? 1 : -1; } ), (uint32_t) ( a ) )
+#define TRACE_OR_PRINTF_FIT( ... )  __builtin_choose_expr( TRACE_ARGS_FIT( __VA_ARGS__, 0, 0, 0, 0, 0 ), \
+                                        ( ( imx_debug_mask & DEBUGS_TO_TRACE ) != 0x00 ) ? TRACE_PAD( __VA_ARGS__, 0, 0, 0, 0, 0 ) : imx_printf( __VA_ARGS__ ), \
+                                        imx_printf( __VA_ARGS__ ) )
+#define TRACE_PAD( format, a, b, c, d, e, ... ) \
+    imx_trace( format, (uint32_t) ( a ), (uint32_t) ( b ), (uint32_t) ( c ), (uint32_t) ( d ), (uint32_t) ( e ) )
+#define TRACE_ARGS_FIT( format, a, b, c, d, e, ... ) \
+    ( TRACE_ARG_FITS( a ) && TRACE_ARG_FITS( b ) && TRACE_ARG_FITS( c ) && TRACE_ARG_FITS( d ) && TRACE_ARG_FITS( e ) )
+#define TRACE_ARG_FITS( a )         ( ( sizeof( 0 ? ( a ) : ( a ) ) <= sizeof( uint32_t ) ) && ( __builtin_classify_type( 0 ? ( a ) : ( a ) ) != TRACE_REAL_TYPE_CLASS ) )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TRACE_MAX_ARGS              5
+#define TRACE_REAL_TYPE_CLASS       8           // __builtin_classify_type() of float and double
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+/*
+ * Trace record - the same 32 Bytes in the RAM ring and in the flash mirror, little endian words
+ *
+ *  Bytes   Field
+ *  0-3     Address of the format string in the image that made the record
+ *  4-7     mS since boot
+ *  8-11    Record number + 1, written last - 0 while being filled in, 0xFFFFFFFF for a blank flash slot
+ *  12-31   TRACE_MAX_ARGS arguments as 32 bit words, unused ones are 0. A %s argument is the address of the string
+ *
+ * "trace raw" and "trace flash" print one record per line as 8 hex words in the order: record number + 1, time,
+ * format address, arguments. tools/trace_decode formats those lines, or a binary copy of the flash mirror, using the
+ * ELF file of the build that made them.
+ */
+typedef struct {                                // 32 Bytes, records never cross a flash page
+    uint32_t format;                            // Address of the format string
+    uint32_t time;                              // mS since boot
+    volatile uint32_t sequence;                 // Record number + 1, written last, 0 while being filled in
+    uint32_t arg[ TRACE_MAX_ARGS ];
+} trace_record_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void trace_init( bool sflash_ok );
+void imx_trace( const char *format, uint32_t arg_1, uint32_t arg_2, uint32_t arg_3, uint32_t arg_4, uint32_t arg_5 );
+void imx_trace_too_many_args( void ) __attribute__(( error( "TRACE() records at most 5 arguments" ) ));
+void trace_process(void);
+void cli_trace( uint16_t arg );
+void print_trace_status(void);
+#endif /* TRACE_H_ */
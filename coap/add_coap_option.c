@@ -46,14 +46,15 @@
 #include "add_coap_option.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../storage.h"
 
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_BASIC_MESSAGING
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_BASIC_MESSAGING )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_BASIC_MESSAGING ) != 0x00 ) imx_printf( __VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_BASIC_MESSAGING, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -100,7 +101,7 @@ extern IOT_Device_Config_t device_config;   // Defined in device/storage.h
  *
  * written by Eric Thelin 4 February 2016
  */
-uint16_t coap_insert_numeric_option( uint16_t option_number, uint16_t *preceeding_option_number, uint16_t option_value,
+uint16_t coap_insert_numeric_option( uint16_t option_number, uint16_t *preceeding_option_number, uint32_t option_value,
 		uint16_t start_array_index, coap_message_t *msg )
 {
 	if ( ( preceeding_option_number == NULL ) || ( msg == NULL ) || ( msg->data_block == NULL ) ) {
@@ -127,7 +128,7 @@ PRINTF("Adding option to end\r\n");
 		return option_length;
 	}
 	else {// There are other options and data after the insertion point for this option.
-		uint8_t option_bytes[ 7 ] = { 0, 0, 0, 0, 0, 0, 0 };// up to 5 bytes for header and up to 2 bytes for value
+		uint8_t option_bytes[ 9 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };// up to 5 bytes for header and up to 4 bytes for value
         uint8_t next_delta_bytes[ 3 ] = { 0, 0, 0 };
         uint16_t next_delta = 0;
         uint16_t delta_length = 0, new_delta_length = 0;
@@ -182,7 +183,7 @@ PRINTF( "Adding option in middle.\r\n" );
         }
 		else { PRINTF( "Inserting before payload marker.\r\n" );}
 
-		option_length = add_coap_uint_option( option_number, option_value, preceeding_option_number, option_bytes, 7 );
+		option_length = add_coap_uint_option( option_number, option_value, preceeding_option_number, option_bytes, 9 );
 
 		if ( option_length <= 0 ) {// Failed to create option.
 			return 0;
@@ -424,7 +425,7 @@ uint16_t create_coap_option_header( uint8_t *header, uint16_t option_number, uin
  *
  * written by Eric Thelin 29 January 2016
  */
-uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, uint16_t *current_option_number,
+uint16_t add_coap_uint_option( uint16_t option_number, uint32_t option_value, uint16_t *current_option_number,
 		uint8_t *buffer, uint16_t buf_length )
 {
 	if ( ( buffer == NULL ) || ( current_option_number == NULL ) ) {
@@ -432,7 +433,7 @@ uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, ui
 		return 0;
 	}
 	uint16_t option_length = 1;
-	uint16_t header_length = 0;
+	uint16_t header_length = 0, i;
 	uint8_t header[ 5 ] = { 0, 0, 0, 0, 0 };
 
 	// Calculate minimum size required by option_value.
@@ -440,9 +441,15 @@ uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, ui
     if ( option_value <= 0xFF ) {// 8 bit uint
 		option_length = 1;
 	}
-	else {
+	else if ( option_value <= 0xFFFF ) {
 		option_length = 2;// 16 bit uint
 	}
+	else if ( option_value <= 0xFFFFFF ) {
+		option_length = 3;// 24 bit uint - Observe sequence, Block number
+	}
+	else {
+		option_length = 4;// 32 bit uint
+	}
 
 	// Get header for option.
 
@@ -458,12 +465,8 @@ uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, ui
 
 	// Copy value into buffer.
 
-	if ( option_length == 1 ) {
-		buffer[ header_length ] = option_value;
-	}
-	else if ( option_length == 2 ) {
-		option_value = htons( option_value );
-		memmove( buffer + header_length, &option_value, 2 );
+	for ( i = 0; i < option_length; i++ ) {// Big endian, most significant byte first
+		buffer[ header_length + i ] = (uint8_t) ( option_value >> ( 8 * ( option_length - 1 - i ) ) );
 	}
 
 	*current_option_number = option_number;
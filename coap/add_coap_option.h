@@ -67,12 +67,12 @@
 /******************************************************
  *               Function Declarations
  ******************************************************/
-uint16_t coap_insert_numeric_option( uint16_t option_number, uint16_t *previous_option_number, uint16_t option_value,
+uint16_t coap_insert_numeric_option( uint16_t option_number, uint16_t *previous_option_number, uint32_t option_value,
 		uint16_t start_array_index, coap_message_t *msg );
 wiced_result_t coap_find_numeric_option( uint16_t option_number_in, coap_message_t *msg,
 		uint16_t *option_value_out, uint16_t *option_index_out, uint16_t *preceeding_option_number_out );
 uint16_t create_coap_option_header( uint8_t *header, uint16_t option_number, uint16_t option_length, uint16_t current_option_number );
-uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, uint16_t *current_option_number,
+uint16_t add_coap_uint_option( uint16_t option_number, uint32_t option_value, uint16_t *current_option_number,
 		uint8_t *buffer, uint16_t buf_length );
 uint16_t add_coap_str_option( uint16_t option_number, uint16_t *current_option_number, char *option_string, uint8_t *buffer, uint16_t buf_length );
 
@@ -47,12 +47,13 @@
 #include "../cli/interface.h"
 #include "../storage.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf( __VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -99,7 +100,9 @@ wiced_udp_socket_t udp_coap_socket;
 uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
 {
     uint8_t option_code, option_delta, processing_options;
-    uint16_t option_length, i;
+    uint16_t option_length, i, j;
+    uint32_t block_value;
+    coap_block_option_t *block;
     char *error_description = "";
     uint16_t response_type = NON_CONFIRMABLE; // Unless the request type is Confirmable - used after bad_message: label
 
@@ -115,8 +118,17 @@ uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
     option_delta = 0;
     cd->payload_length = 0;
     processing_options = true;
-    memset( cd->uri, 0x00, MAX_URI_LENGTH );
-    memset( cd->uri_query, 0x00, MAX_URI_LENGTH );
+    cd->no_uri_segments = 0;
+    cd->uri_length = 0;
+    cd->option_data = msg->coap.data_block->data;
+    cd->no_uri_query_segments = 0;
+    cd->uri_query_length = 0;
+    memset( &cd->block1, 0x00, sizeof( coap_block_option_t ) );
+    memset( &cd->block2, 0x00, sizeof( coap_block_option_t ) );
+    cd->observe = 0;
+    cd->observe_present = false;
+    cd->uri[ 0 ] = 0x00;
+    cd->uri_query[ 0 ] = 0x00;
     /*
      * Skip over Tokens
      */
@@ -215,6 +227,20 @@ uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
                     case IF_NONE_MATCH :
                         PRINTF( "Processing IF None Match\r\n" );
                         break;
+                    case OBSERVE :
+                        PRINTF( "Processing Observe\r\n" );
+                        /*
+                         * 0 - 3 byte value: 0 register, 1 deregister - RFC 7641
+                         */
+                        if( option_length > 3 ) {
+                            error_description = "Invalid observe option.";
+                            goto bad_message;
+                        }
+                        cd->observe = 0;
+                        for( j = 0; j < option_length; j++ )
+                            cd->observe = ( cd->observe << 8 ) | msg->coap.data_block->data[ i + j ];
+                        cd->observe_present = true;
+                        break;
                     case URI_PORT :
                         PRINTF( "Processing URI Port\r\n" );
                         break;
@@ -224,11 +250,14 @@ uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
                     case URI_PATH :
   //                      PRINTF( "Processing URI Path\r\n" );
                         /*
-                         * Add this to the uri Path, make sure this will not exceed the max length
+                         * Record where this segment of the uri Path is, make sure this will not exceed the max length
+                         * The uri string is only built if it is asked for - coap_uri_string()
                          */
-                        if( ( strlen( cd->uri ) + option_length + 1 ) < MAX_URI_LENGTH ) {
-                            strcat( cd->uri, "/" );
-                            strncat( cd->uri, (char * ) &msg->coap.data_block->data[ i ], option_length );
+                        if( ( ( cd->uri_length + option_length + 1 ) < MAX_URI_LENGTH ) && ( cd->no_uri_segments < MAX_URI_SEGMENTS ) ) {
+                            cd->uri_segment[ cd->no_uri_segments ].offset = i;
+                            cd->uri_segment[ cd->no_uri_segments ].length = option_length;
+                            cd->no_uri_segments += 1;
+                            cd->uri_length += option_length + 1;
                         } else {
                             //sprintf( (char * ) msg->coap.data_block->data, "URI Length exceeded\r\n" );
                             error_description = "URI length exceeded.";
@@ -244,12 +273,14 @@ uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
                     case URI_QUERY :
                         PRINTF( "Processing URI Query\r\n" );
                         /*
-                         * Add this to the uri Query, make sure this will not exceed the max length
+                         * Record where this part of the uri Query is, make sure this will not exceed the max length
+                         * The query string is only built if it is asked for - coap_uri_query_string()
                          */
-                        if( ( strlen( cd->uri ) + option_length + 1 ) < MAX_URI_LENGTH ) {
-                            if( strlen( cd->uri_query) > 0 )
-                                strcat( cd->uri_query, "&" );
-                            strncat( cd->uri_query, (char * ) &msg->coap.data_block->data[ i ], option_length );
+                        if( ( ( cd->uri_query_length + option_length + 1 ) < MAX_URI_LENGTH ) && ( cd->no_uri_query_segments < MAX_URI_QUERY_SEGMENTS ) ) {
+                            cd->uri_query_segment[ cd->no_uri_query_segments ].offset = i;
+                            cd->uri_query_segment[ cd->no_uri_query_segments ].length = option_length;
+                            cd->no_uri_query_segments += 1;
+                            cd->uri_query_length += option_length + 1;
                         } else {
                             //sprintf( (char * ) msg->coap.data, "URI Length exceeded\r\n" );
                             error_description = "URI length exceeded.";
@@ -263,13 +294,28 @@ uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd )
                     case LOCATION_QUERY :
                         PRINTF( "Processing Location Query\r\n" );
                         break;
-                    case BLOCK2 :    // Set the Block size - from Wireshark definition
-                        PRINTF( "Processing Block 2\r\n" );
-                        cd->blocksize = msg->coap.data_block->data[ i ];
-                        break;
-                    case BLOCK1 :    // Set the Block size - from Wireshark definition
-                        PRINTF( "Processing Block Size\r\n" );
-                        cd->blocksize = msg->coap.data_block->data[ i ];
+                    case BLOCK2 :
+                    case BLOCK1 :
+                        PRINTF( "Processing Block %u\r\n", ( option_code == BLOCK1 ) ? 1 : 2 );
+                        /*
+                         * 0 - 3 byte value: block number, more flag and size exponent - RFC 7959
+                         */
+                        if( option_length > 3 ) {
+                            error_description = "Invalid block option.";
+                            goto bad_message;
+                        }
+                        block_value = 0;
+                        for( j = 0; j < option_length; j++ )
+                            block_value = ( block_value << 8 ) | msg->coap.data_block->data[ i + j ];
+                        block = ( option_code == BLOCK1 ) ? &cd->block1 : &cd->block2;
+                        block->num = block_value >> 4;
+                        block->more = ( block_value >> 3 ) & 0x01;
+                        block->szx = block_value & 0x07;
+                        block->present = true;
+                        if( block->szx == COAP_BLOCK_SZX_RESERVED ) {
+                            error_description = "Invalid block size.";
+                            goto bad_message;
+                        }
                         break;
                     case PROXY_URI :
                         PRINTF( "Processing Proxy URL\r\n" );
@@ -319,3 +365,44 @@ bad_message:
     PRINTF( "Bad Message Detected\r\n" );
     return COAP_SEND_RESPONSE;
 }
+/**
+  * @brief  coap_uri_string - build the uri string "/seg1/seg2..." from the Uri-Path segments found by process_coap_msg()
+  * @param  cd
+  * @retval : uri
+  */
+char *coap_uri_string( CoAP_msg_detail_t *cd )
+{
+    uint16_t i, length;
+
+    if( ( cd->uri[ 0 ] == 0x00 ) && ( cd->no_uri_segments > 0 ) ) {
+        length = 0;
+        for( i = 0; i < cd->no_uri_segments; i++ ) {
+            cd->uri[ length++ ] = '/';
+            memcpy( &cd->uri[ length ], &cd->option_data[ cd->uri_segment[ i ].offset ], cd->uri_segment[ i ].length );
+            length += cd->uri_segment[ i ].length;
+        }
+        cd->uri[ length ] = 0x00;
+    }
+    return cd->uri;
+}
+/**
+  * @brief  coap_uri_query_string - build the query string "q1&q2..." from the Uri-Query options found by process_coap_msg()
+  * @param  cd
+  * @retval : uri query
+  */
+char *coap_uri_query_string( CoAP_msg_detail_t *cd )
+{
+    uint16_t i, length;
+
+    if( ( cd->uri_query[ 0 ] == 0x00 ) && ( cd->no_uri_query_segments > 0 ) ) {
+        length = 0;
+        for( i = 0; i < cd->no_uri_query_segments; i++ ) {
+            if( i > 0 )
+                cd->uri_query[ length++ ] = '&';
+            memcpy( &cd->uri_query[ length ], &cd->option_data[ cd->uri_query_segment[ i ].offset ], cd->uri_query_segment[ i ].length );
+            length += cd->uri_query_segment[ i ].length;
+        }
+        cd->uri_query[ length ] = 0x00;
+    }
+    return cd->uri_query;
+}
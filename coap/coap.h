@@ -111,6 +111,7 @@ uint16_t no_user_coap_entries(void);
 #define VALID                   ( MSG_2_XX | 3 )
 #define CHANGED                 ( MSG_2_XX | 4 )
 #define CONTENT                 ( MSG_2_XX | 5 )
+#define CONTINUE                ( MSG_2_XX | 31 )
 /*
  * 4.xx
  */
@@ -122,6 +123,7 @@ uint16_t no_user_coap_entries(void);
 #define NOT_FOUND               ( MSG_4_XX | 4 )
 #define METHOD_NOT_ALLOWED      ( MSG_4_XX | 5 )
 #define NOT_ACCEPTABLE          ( MSG_4_XX | 6 )
+#define REQUEST_ENTITY_INCOMPLETE   ( MSG_4_XX | 8 )
 #define PRECONDTION_FAILED      ( MSG_4_XX | 12 )
 #define REQUEST_ENTITY_TOO_BIG  ( MSG_4_XX | 13 )
 #define UNSUPPORTED_CONTENT     ( MSG_4_XX | 15 )
@@ -154,6 +156,7 @@ uint16_t no_user_coap_entries(void);
 #define URI_HOST                0x03
 #define ETAG                    0x04
 #define IF_NONE_MATCH           0x05
+#define OBSERVE                 0x06
 #define URI_PORT                0x07
 #define LOCATION_PATH           0x08
 #define URI_PATH                0x0B
@@ -180,7 +183,14 @@ uint16_t no_user_coap_entries(void);
  * CoAP Option related defines
  */
 #define MAX_URI_LENGTH          256     // 255 + 0x00
+#define MAX_URI_SEGMENTS        16      // Uri-Path options recorded per message
+#define MAX_URI_QUERY_SEGMENTS  8       // Uri-Query options recorded per message
 #define PAYLOAD_START           0xFF
+#define COAP_BLOCK_SZX_MAX      6       // Block size 16 << SZX - 1024 Bytes, MAX_PAYLOAD_LENGTH
+#define COAP_BLOCK_SZX_RESERVED 7
+#define COAP_OBSERVE_REGISTER   0       // Observe option value in a GET - RFC 7641
+#define COAP_OBSERVE_DEREGISTER 1
+#define COAP_OBSERVE_SEQUENCE_MASK  0x00FFFFFF  // Observe values in notifications are 24 bits
 #define OPTION_LENGTH_8BITS     0x0D
 #define OPTION_LENGTH_16BITS    0x0E
 #define OPTION_LENGTH_ERROR     0x0F
@@ -205,13 +215,39 @@ typedef uint8_t token_buffer_t[ MAX_TOKEN_LENGTH ];
 /******************************************************
  *                    Structures
  ******************************************************/
+/*
+ * Location of a Uri-Path option value in the message data
+ */
+typedef struct {
+    uint16_t offset;
+    uint16_t length;
+} uri_segment_t;
+/*
+ * Block1 / Block2 option - RFC 7959
+ */
+typedef struct {
+    uint32_t num;                                   // Block number
+    uint8_t szx;                                    // Block size is 16 << szx
+    unsigned int more : 1;
+    unsigned int present : 1;
+} coap_block_option_t;
 /*
  * Stucture holding processed info for msg
  */
 typedef struct {
-    uint8_t blocksize;
-    char uri[ MAX_URI_LENGTH ];
-    char uri_query[ MAX_URI_LENGTH ];
+    coap_block_option_t block1;                     // Request payload sent in blocks
+    coap_block_option_t block2;                     // Block of the response asked for
+    uint32_t observe;                               // Observe option value, only valid if observe_present
+    bool observe_present;
+    uint8_t no_uri_segments;
+    uint16_t uri_length;                            // Length of uri as "/seg1/seg2..."
+    uint8_t *option_data;                           // Message data the segments refer to
+    uri_segment_t uri_segment[ MAX_URI_SEGMENTS ];
+    uint8_t no_uri_query_segments;
+    uint16_t uri_query_length;                      // Length of query as "q1&q2..."
+    uri_segment_t uri_query_segment[ MAX_URI_QUERY_SEGMENTS ];
+    char uri[ MAX_URI_LENGTH ];                     // Only built on request - use coap_uri_string()
+    char uri_query[ MAX_URI_LENGTH ];               // Only built on request - use coap_uri_query_string()
     char *payload;
     uint16_t payload_length;
 } CoAP_msg_detail_t;
@@ -232,6 +268,7 @@ typedef struct describe_data_block{
 typedef struct describe_message_size{
 	uint16_t data_size;
 	message_data_block_t *msg_data;
+	uint16_t free_count;//        Blocks on msg_data, kept on every push and pop.
 	uint8_t min_free_list_size;// For statistical purposes only.
 	uint8_t list_empty_errors;//  For statistical purposes only.
 } message_size_t;
@@ -256,6 +293,8 @@ typedef struct {
     unsigned int response_processing_method : 3;
     unsigned int received_as_multicast : 1;
     wiced_time_t initial_timestamp, next_timestamp;
+    wiced_packet_t *packet;                         // Received packet still held by this message - see msg_get_packet()
+    message_data_block_t packet_block;              // Data block referring to the CoAP data in the held packet
 } coap_message_t;
 
 typedef struct message {
@@ -263,9 +302,27 @@ typedef struct message {
     coap_message_t coap;
 } message_t;
 
+typedef struct {
+    message_t *msg;
+    wiced_time_t timestamp;                         // Copy of msg->coap.next_timestamp, keeps compares in the heap array
+    uint32_t sequence;                              // Insertion order - entries with equal timestamps leave first in first out
+} timed_entry_t;
+
 typedef struct {
     message_t *head;
     message_t *tail;
+    timed_entry_t *heap;                            // When not NULL, entries are kept in a binary min heap ordered by timestamp
+    uint16_t heap_count;
+    uint16_t heap_size;
+    uint32_t sequence;
+    message_t **ring;                               // When not NULL, lock free single producer / single consumer ring
+    volatile uint16_t ring_in;                      // Only written by the producer
+    volatile uint16_t ring_out;                     // Only written by the consumer
+    uint16_t ring_size;
+    wiced_mutex_t mutex;                            // Each list has its own lock
+    uint32_t users;                                 // Threads holding or waiting for the lock, updated atomically
+    uint32_t contention;                            // Times the lock was already held when requested
+    uint32_t ring_full;
 } message_list_t;
 
 typedef struct {
@@ -296,7 +353,7 @@ typedef struct {
  ******************************************************/
 uint16_t in_my_groups( uint16_t group );
 uint16_t add_options_from_string( uint16_t option_number, char separator, char *str_in, uint16_t *current_option_number, uint8_t *buffer, uint16_t buf_length );
-uint16_t add_coap_uint_option( uint16_t option_number, uint16_t option_value, uint16_t *current_option_number, uint8_t *buffer, uint16_t buf_length );
+uint16_t add_coap_uint_option( uint16_t option_number, uint32_t option_value, uint16_t *current_option_number, uint8_t *buffer, uint16_t buf_length );
 wiced_result_t coap_append_response_payload_using_printf( uint16_t media_type, coap_message_t* msg_out, char* format,  ... );
 wiced_result_t coap_store_response_header( coap_message_t* msg_out, uint16_t code_in, uint16_t type_in, uint16_t *header_size );
 wiced_result_t get_uint_from_query_str( char* name, uint16_t *value, char* query_str );
@@ -304,6 +361,8 @@ uint16_t add_coap_str_option( uint16_t option_number, uint16_t *current_option_n
 wiced_result_t coap_append_response_payload( uint16_t media_type, coap_message_t* msg_out, uint8_t* data, uint16_t size );
 wiced_result_t coap_store_response_data(coap_message_t* msg_out, uint16_t code_in, uint16_t type_in, char* data_str, uint16_t media_type );
 uint16_t process_coap_msg( message_t *msg, CoAP_msg_detail_t *cd );
+char *coap_uri_string( CoAP_msg_detail_t *cd );
+char *coap_uri_query_string( CoAP_msg_detail_t *cd );
 void * coap_msg_payload( coap_message_t* coap );
 message_t *msg_get( uint16_t min_bytes );
 uint16_t get_messaging_list_empty_errors(void);
@@ -0,0 +1,364 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file coap_block.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Block-wise transfers - RFC 7959. A request payload sent in Block1 blocks is collected in a reassembly buffer and
+ *  handed to the handler as one payload once the last block arrives, each earlier block is answered with 2.31 Continue.
+ *  A response larger than the block size is sent in Block2 blocks. Responses are built again for each block asked for
+ *  and only the part that belongs to that block is kept, so nothing has to be remembered between block requests.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../cli/interface.h"
+#include "../cli/imx_debug.h"
+#include "coap.h"
+#include "add_coap_option.h"
+#include "que_manager.h"
+#include "../CoAP_interface/coap_msg_get_store.h"
+#include "coap_block.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_RECV )
+    #undef PRINTF
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_RECV, __VA_ARGS__ )
+#elif !defined PRINTF
+    #define PRINTF(...)
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef COAP_BLOCK1_BUFFER_SIZE
+#define COAP_BLOCK1_BUFFER_SIZE     ( 2048 )        // Largest request payload that can be received in blocks
+#endif
+#define MAX_BLOCK_OPTION_LENGTH     ( 5 )           // Option header with extended delta and a 2 byte value
+#define MAX_BLOCK_NUMBER            ( 0x0FFF )      // Block option values are added as 16 bit numbers
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+    uint32_t uri_hash;
+    uint32_t next_num;                              // Block expected next
+    uint16_t length;
+    unsigned int active : 1;
+    uint8_t data[ COAP_BLOCK1_BUFFER_SIZE + 1 ];    // + 1 for a terminating 0x00
+} coap_block1_buffer_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static uint32_t uri_hash( CoAP_msg_detail_t *cd );
+static bool find_payload( coap_message_t *msg, uint16_t *payload_index );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern IOT_Device_Config_t device_config;   // Used for diags
+
+static coap_block1_buffer_t block1;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Add a Block1 or Block2 option to a message, in order with any options already there
+  * @param  msg, BLOCK1 / BLOCK2, block number, more blocks follow, size exponent
+  * @retval : WICED_SUCCESS / WICED_ERROR
+  */
+wiced_result_t coap_add_block_option( coap_message_t *msg, uint16_t option_number, uint32_t num, bool more, uint8_t szx )
+{
+    uint16_t option_index, preceeding_option_number;
+
+    if( num > MAX_BLOCK_NUMBER )
+        return WICED_ERROR;
+    /*
+     * Make sure the data block has room for the option
+     */
+    if( coap_msg_resize( msg, msg->msg_length + MAX_BLOCK_OPTION_LENGTH ) != WICED_SUCCESS )
+        return WICED_ERROR;
+    if( coap_find_numeric_option( option_number, msg, NULL, &option_index, &preceeding_option_number ) != WICED_NOT_FOUND )
+        return WICED_ERROR;
+    if( coap_insert_numeric_option( option_number, &preceeding_option_number, (uint16_t) ( ( num << 4 ) | ( more ? 0x08 : 0x00 ) | ( szx & 0x07 ) ),
+            option_index, msg ) == 0 )
+        return WICED_ERROR;
+    return WICED_SUCCESS;
+}
+/**
+  * @brief  Collect a request payload sent in Block1 blocks
+  * @param  msg, cd
+  * @retval : COAP_MESSAGE_MAY_BE_PROCESSED - no Block1 option or the last block arrived, cd->payload is the whole payload
+  *           COAP_SEND_RESPONSE - 2.31 Continue or an error response is in msg
+  */
+uint16_t coap_block1_receive( coap_message_t *msg, CoAP_msg_detail_t *cd )
+{
+    uint16_t response_type, size, code;
+    uint32_t offset, hash;
+    char *error_description;
+
+    if( cd->block1.present == false )
+        return COAP_MESSAGE_MAY_BE_PROCESSED;
+
+    response_type = ( msg->header.t == CONFIRMABLE ) ? ACKNOWLEDGEMENT : NON_CONFIRMABLE;
+    size = COAP_BLOCK_SIZE( cd->block1.szx );
+    offset = cd->block1.num * size;
+    hash = uri_hash( cd );
+    PRINTF( "Block1 %lu, %u Bytes, more: %u\r\n", cd->block1.num, cd->payload_length, cd->block1.more );
+
+    if( cd->block1.num == 0 ) {
+        /*
+         * Start of a new transfer, replaces any that was not finished
+         */
+        block1.ip = msg->ip_addr.ip.v4;
+        block1.port = msg->port;
+        block1.uri_hash = hash;
+        block1.next_num = 0;
+        block1.length = 0;
+        block1.active = true;
+    }
+    if( ( block1.active == false ) || ( block1.ip != msg->ip_addr.ip.v4 ) || ( block1.port != msg->port ) ||
+        ( block1.uri_hash != hash ) || ( block1.next_num != cd->block1.num ) ) {
+        code = REQUEST_ENTITY_INCOMPLETE;
+        error_description = "Block out of sequence.";
+        goto block_error;
+    }
+    if( ( cd->block1.more == true ) && ( cd->payload_length != size ) ) {
+        code = BAD_REQUEST;
+        error_description = "Block size does not match.";
+        goto block_error;
+    }
+    if( ( offset + cd->payload_length ) > COAP_BLOCK1_BUFFER_SIZE ) {
+        code = REQUEST_ENTITY_TOO_BIG;
+        error_description = "Payload too large.";
+        goto block_error;
+    }
+    if( cd->payload_length > 0 )
+        memcpy( &block1.data[ offset ], cd->payload, cd->payload_length );
+    block1.length = offset + cd->payload_length;
+    block1.next_num = cd->block1.num + 1;
+
+    if( cd->block1.more == true ) {
+        if( ( coap_store_response_header( msg, CONTINUE, response_type, NULL ) != WICED_SUCCESS ) ||
+            ( coap_add_block_option( msg, BLOCK1, cd->block1.num, true, cd->block1.szx ) != WICED_SUCCESS ) ) {
+            PRINTF( "Unable to create Continue response.\r\n" );
+            return COAP_NO_RESPONSE;
+        }
+        return COAP_SEND_RESPONSE;
+    }
+    /*
+     * Last block - the handler sees the whole payload
+     */
+    block1.active = false;
+    block1.data[ block1.length ] = 0x00;
+    cd->payload = (char *) block1.data;
+    cd->payload_length = block1.length;
+    PRINTF( "Block1 transfer complete, %u Bytes\r\n", block1.length );
+    return COAP_MESSAGE_MAY_BE_PROCESSED;
+
+block_error:
+    block1.active = false;
+    if( coap_store_response_data( msg, code, response_type, error_description, TEXT_MEDIA_TYPE ) != WICED_SUCCESS )
+        return COAP_NO_RESPONSE;
+    return COAP_SEND_RESPONSE;
+}
+/**
+  * @brief  Acknowledge the last block of a Block1 transfer in the handler's response
+  * @param  msg, cd, response from the handler
+  * @retval : response
+  */
+uint16_t coap_block1_response( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t response )
+{
+    if( ( cd->block1.present == true ) && ( response == COAP_SEND_RESPONSE ) && ( MSG_CLASS( msg->header.code ) == SUCCESS_RESPONSE ) ) {
+        if( coap_add_block_option( msg, BLOCK1, cd->block1.num, false, cd->block1.szx ) != WICED_SUCCESS )
+            PRINTF( "Unable to add Block1 option to response.\r\n" );
+    }
+    return response;
+}
+/**
+  * @brief  Send a response larger than the block size, or asked for in smaller blocks, as the Block2 block asked for
+  * @param  msg, cd, response from the handler
+  * @retval : response
+  */
+uint16_t coap_block2_response( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t response )
+{
+    uint16_t payload_index, payload_length, size, slice, response_type;
+    uint32_t start, num;
+    uint8_t szx;
+
+    if( ( response != COAP_SEND_RESPONSE ) || ( MSG_CLASS( msg->header.code ) != SUCCESS_RESPONSE ) )
+        return response;
+    if( coap_find_numeric_option( BLOCK2, msg, NULL, NULL, NULL ) == WICED_SUCCESS )
+        return response;    // Handler built the block itself - coap_block2_write()
+    if( find_payload( msg, &payload_index ) == false )
+        return response;
+    payload_length = msg->msg_length - payload_index;
+
+    if( cd->block2.present == true ) {
+        szx = ( cd->block2.szx > COAP_BLOCK_SZX_MAX ) ? COAP_BLOCK_SZX_MAX : cd->block2.szx;
+        num = cd->block2.num;
+    } else {
+        szx = COAP_BLOCK_SZX_MAX;
+        num = 0;
+    }
+    size = COAP_BLOCK_SIZE( szx );
+    if( ( cd->block2.present == false ) && ( payload_length <= size ) )
+        return response;
+
+    start = num * size;
+    if( start >= payload_length ) {
+        response_type = msg->header.t;
+        if( coap_store_response_data( msg, BAD_OPTION, response_type, "Block out of range.", TEXT_MEDIA_TYPE ) != WICED_SUCCESS )
+            return COAP_NO_RESPONSE;
+        return COAP_SEND_RESPONSE;
+    }
+    /*
+     * Keep just this block of the payload
+     */
+    slice = ( ( start + size ) < payload_length ) ? size : payload_length - start;
+    memmove( &msg->data_block->data[ payload_index ], &msg->data_block->data[ payload_index + start ], slice );
+    msg->msg_length = payload_index + slice;
+    if( coap_add_block_option( msg, BLOCK2, num, ( start + slice ) < payload_length, szx ) != WICED_SUCCESS ) {
+        PRINTF( "Unable to add Block2 option to response.\r\n" );
+        return COAP_NO_RESPONSE;
+    }
+    PRINTF( "Block2 %lu of %u Byte response, %u Bytes\r\n", num, payload_length, slice );
+    return COAP_SEND_RESPONSE;
+}
+/**
+  * @brief  Start building the Block2 block asked for, the whole response is written with coap_block2_write()
+  * @param  bw, cd
+  * @retval : None
+  */
+void coap_block2_writer_init( coap_block_writer_t *bw, CoAP_msg_detail_t *cd )
+{
+    if( cd->block2.present == true ) {
+        bw->szx = ( cd->block2.szx > COAP_BLOCK_SZX_MAX ) ? COAP_BLOCK_SZX_MAX : cd->block2.szx;
+        bw->num = cd->block2.num;
+        bw->requested = true;
+    } else {
+        bw->szx = COAP_BLOCK_SZX_MAX;
+        bw->num = 0;
+        bw->requested = false;
+    }
+    bw->start = bw->num * COAP_BLOCK_SIZE( bw->szx );
+    bw->end = bw->start + COAP_BLOCK_SIZE( bw->szx );
+    bw->offset = 0;
+}
+/**
+  * @brief  Add the next part of a response, only the bytes that fall in this block are added to msg
+  * @param  msg, bw, media type, data, length
+  * @retval : WICED_SUCCESS / error from coap_append_response_payload()
+  */
+wiced_result_t coap_block2_write( coap_message_t *msg, coap_block_writer_t *bw, uint16_t media_type, uint8_t *data, uint16_t length )
+{
+    uint32_t first, last;
+    wiced_result_t result;
+
+    result = WICED_SUCCESS;
+    first = ( bw->offset > bw->start ) ? bw->offset : bw->start;
+    last = ( ( bw->offset + length ) < bw->end ) ? bw->offset + length : bw->end;
+    if( first < last )
+        result = coap_append_response_payload( media_type, msg, &data[ first - bw->offset ], (uint16_t) ( last - first ) );
+    bw->offset += length;
+    return result;
+}
+/**
+  * @brief  Finish a response built with coap_block2_write() - add the Block2 option when it did not fit in one block
+  * @param  msg, bw
+  * @retval : WICED_SUCCESS, WICED_ERROR - block asked for is past the end
+  */
+wiced_result_t coap_block2_writer_finish( coap_message_t *msg, coap_block_writer_t *bw )
+{
+    if( ( bw->num > 0 ) && ( bw->start >= bw->offset ) )
+        return WICED_ERROR;
+    if( ( bw->requested == false ) && ( bw->offset <= bw->end ) )
+        return WICED_SUCCESS;   // All of it fit - no block option needed
+    return coap_add_block_option( msg, BLOCK2, bw->num, bw->offset > bw->end, bw->szx );
+}
+/**
+  * @brief  Hash of the Uri-Path, a Block1 transfer must keep going to the same resource
+  * @param  cd
+  * @retval : hash
+  */
+static uint32_t uri_hash( CoAP_msg_detail_t *cd )
+{
+    uint16_t i, j;
+    uint32_t hash;
+
+    hash = 2166136261UL;    // FNV-1a
+    for( i = 0; i < cd->no_uri_segments; i++ ) {
+        for( j = 0; j < cd->uri_segment[ i ].length; j++ ) {
+            hash ^= cd->option_data[ cd->uri_segment[ i ].offset + j ];
+            hash *= 16777619UL;
+        }
+        hash ^= '/';
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+/**
+  * @brief  Find the start of the payload in a message
+  * @param  msg, payload_index - returns index of first payload byte
+  * @retval : true if there is a payload
+  */
+static bool find_payload( coap_message_t *msg, uint16_t *payload_index )
+{
+    uint16_t index;
+
+    if( coap_find_numeric_option( 0xFFFF, msg, NULL, &index, NULL ) != WICED_NOT_FOUND )
+        return false;
+    if( ( index >= msg->msg_length ) || ( msg->data_block->data[ index ] != PAYLOAD_START ) )
+        return false;
+    *payload_index = index + 1;
+    return true;
+}
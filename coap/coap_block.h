@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file coap_block.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef COAP_BLOCK_H_
+#define COAP_BLOCK_H_
+
+/*
+ *  Block-wise transfers - RFC 7959
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define COAP_BLOCK_SIZE( szx )      ( (uint16_t) 16 << ( szx ) )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+/*
+ * Builds one block of a response that may be larger than a message, see coap_block2_write()
+ */
+typedef struct {
+    uint32_t num;
+    uint32_t start, end;                            // Part of the representation that goes in this block
+    uint32_t offset;                                // Bytes of the representation produced so far
+    uint8_t szx;
+    unsigned int requested : 1;                     // Request had a Block2 option
+} coap_block_writer_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+wiced_result_t coap_add_block_option( coap_message_t *msg, uint16_t option_number, uint32_t num, bool more, uint8_t szx );
+uint16_t coap_block1_receive( coap_message_t *msg, CoAP_msg_detail_t *cd );
+uint16_t coap_block1_response( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t response );
+uint16_t coap_block2_response( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t response );
+void coap_block2_writer_init( coap_block_writer_t *bw, CoAP_msg_detail_t *cd );
+wiced_result_t coap_block2_write( coap_message_t *msg, coap_block_writer_t *bw, uint16_t media_type, uint8_t *data, uint16_t length );
+wiced_result_t coap_block2_writer_finish( coap_message_t *msg, coap_block_writer_t *bw );
+#endif /* COAP_BLOCK_H_ */
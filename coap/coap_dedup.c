@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file coap_dedup.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Message ID deduplication for received requests - RFC 7252 4.5. The source address, port and Message ID of recent
+ *  requests are kept in a small cache along with the response that was sent. A retransmitted request is answered from
+ *  the cache so the handler, and anything it saves, is not run twice. When the cache is full the least recently used
+ *  entry is replaced. Responses too large to keep are answered with an empty Acknowledgement instead.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../cli/interface.h"
+#include "../cli/imx_debug.h"
+#include "../device/icb_def.h"
+#include "../time/ck_time.h"
+#include "coap.h"
+#include "que_manager.h"
+#include "coap_dedup.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_RECV )
+    #undef PRINTF
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_RECV, __VA_ARGS__ )
+#elif !defined PRINTF
+    #define PRINTF(...)
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef COAP_DEDUP_ENTRIES
+#define COAP_DEDUP_ENTRIES          ( 8 )
+#endif
+#ifndef COAP_DEDUP_RESPONSE_SIZE
+#define COAP_DEDUP_RESPONSE_SIZE    ( 128 )         // Token, options and payload of a response that can be replayed
+#endif
+#define COAP_EXCHANGE_LIFETIME      ( 247 * SECONDS )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+    uint16_t id;                                    // Message ID of the request
+    wiced_time_t received;                          // When the request was first seen
+    uint32_t last_used;                             // Least recently used entry is replaced
+    unsigned int in_use : 1;
+    unsigned int response_sent : 1;
+    unsigned int response_saved : 1;                // response data below can be replayed
+    unsigned int t : 2;
+    unsigned int tkl : 4;
+    uint8_t code;
+    uint16_t response_id;
+    uint16_t length;
+    uint8_t data[ COAP_DEDUP_RESPONSE_SIZE ];
+} coap_dedup_entry_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern iMatrix_Control_Block_t icb;
+extern IOT_Device_Config_t device_config;   // Used for diags
+
+static coap_dedup_entry_t dedup[ COAP_DEDUP_ENTRIES ];
+static uint32_t dedup_use_count;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Clear the cache
+  * @param  None
+  * @retval : None
+  */
+void coap_dedup_init(void)
+{
+    memset( dedup, 0x00, sizeof( dedup ) );
+    dedup_use_count = 0;
+}
+/**
+  * @brief  Check if a received request has been seen before. A new request is given an entry for coap_dedup_save(),
+  *         a duplicate has the saved response loaded into msg
+  * @param  msg, entry - returns entry for the new request or COAP_DEDUP_NO_ENTRY
+  * @retval : COAP_MESSAGE_MAY_BE_PROCESSED for a new request, otherwise COAP_SEND_RESPONSE / COAP_NO_RESPONSE
+  */
+uint16_t coap_dedup_check( message_t *msg, uint16_t *entry )
+{
+    uint16_t i, oldest;
+    wiced_time_t now;
+    coap_dedup_entry_t *de;
+
+    *entry = COAP_DEDUP_NO_ENTRY;
+    wiced_time_get_time( &now );
+    dedup_use_count += 1;
+    oldest = 0;
+    for( i = 0; i < COAP_DEDUP_ENTRIES; i++ ) {
+        de = &dedup[ i ];
+        if( ( de->in_use == true ) && ( imx_is_later( now, de->received + COAP_EXCHANGE_LIFETIME ) == true ) )
+            de->in_use = false;     // Sender will no longer retransmit this one
+        if( de->in_use == false ) {
+            if( dedup[ oldest ].in_use == true )
+                oldest = i;
+            continue;
+        }
+        if( ( de->id == msg->coap.header.id ) && ( de->port == msg->coap.port ) && ( de->ip == msg->coap.ip_addr.ip.v4 ) ) {
+            /*
+             * Duplicate - answer it the same way as the first time
+             */
+            icb.ip_stats[ UDP_STATS ].duplicate_requests += 1;
+            de->last_used = dedup_use_count;
+            PRINTF( "Duplicate request, Message ID: 0x%04x\r\n", de->id );
+            if( de->response_saved == true ) {
+                msg->coap.msg_length = 0;
+                if( coap_msg_resize( &msg->coap, de->length ) != WICED_SUCCESS )
+                    return COAP_NO_RESPONSE;
+                memcpy( msg->coap.data_block->data, de->data, de->length );
+                msg->coap.msg_length = de->length;
+                msg->coap.header.t = de->t;
+                msg->coap.header.tkl = de->tkl;
+                msg->coap.header.code = de->code;
+                msg->coap.header.id = de->response_id;
+                msg->coap.has_payload_bit_flag = 0;
+                msg->coap.initial_timestamp = 0;
+                msg->coap.next_timestamp = 0;
+                msg->coap.send_attempts = 0;
+                return COAP_SEND_RESPONSE;
+            }
+            if( ( de->response_sent == true ) && ( msg->coap.header.t == CONFIRMABLE ) ) {
+                /*
+                 * Response was too big to keep - acknowledge so the sender stops retransmitting
+                 */
+                msg->coap.header.tkl = 0;
+                if( coap_store_response_header( &msg->coap, EMPTY_MSG, ACKNOWLEDGEMENT, NULL ) != WICED_SUCCESS )
+                    return COAP_NO_RESPONSE;
+                return COAP_SEND_RESPONSE;
+            }
+            return COAP_NO_RESPONSE;
+        }
+        if( ( dedup[ oldest ].in_use == true ) && ( de->last_used < dedup[ oldest ].last_used ) )
+            oldest = i;
+    }
+    /*
+     * New request - take a free entry or the least recently used one
+     */
+    icb.ip_stats[ UDP_STATS ].new_requests += 1;
+    de = &dedup[ oldest ];
+    memset( de, 0x00, sizeof( coap_dedup_entry_t ) - COAP_DEDUP_RESPONSE_SIZE );
+    de->ip = msg->coap.ip_addr.ip.v4;
+    de->port = msg->coap.port;
+    de->id = msg->coap.header.id;
+    de->received = now;
+    de->last_used = dedup_use_count;
+    de->in_use = true;
+    *entry = oldest;
+    return COAP_MESSAGE_MAY_BE_PROCESSED;
+}
+/**
+  * @brief  Save the response to a new request so a retransmission of it can be answered from the cache
+  * @param  entry from coap_dedup_check(), msg holding the response, response from the handler
+  * @retval : None
+  */
+void coap_dedup_save( uint16_t entry, message_t *msg, uint16_t response )
+{
+    coap_dedup_entry_t *de;
+
+    if( entry >= COAP_DEDUP_ENTRIES )
+        return;
+    de = &dedup[ entry ];
+    if( response == COAP_NO_RESPONSE )
+        return;
+    de->response_sent = true;
+    if( ( response == COAP_SEND_RESPONSE ) && ( msg->coap.data_block != NULL ) && ( msg->coap.msg_length <= COAP_DEDUP_RESPONSE_SIZE ) ) {
+        memcpy( de->data, msg->coap.data_block->data, msg->coap.msg_length );
+        de->length = msg->coap.msg_length;
+        de->t = msg->coap.header.t;
+        de->tkl = msg->coap.header.tkl;
+        de->code = msg->coap.header.code;
+        de->response_id = msg->coap.header.id;
+        de->response_saved = true;
+    }
+}
@@ -0,0 +1,388 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file coap_observe.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Observe for control / sensor values - RFC 7641. A GET with Observe 0 registers the sender in a small table, keyed on
+ *  address, port and token, against the control / sensor entry it asked for. Sampling and events mark the entry changed;
+ *  changes made while a notification is waiting are coalesced in to that notification, and an observer is not sent more
+ *  than one notification every OBSERVE_MIN_INTERVAL. The value is read when the notification is built so it is always
+ *  the latest. Every OBSERVE_CON_INTERVAL notification is Confirmable, an observer that does not acknowledge them or
+ *  sends a Reset is dropped. When the table is full the observer heard from least recently is replaced.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../cli/interface.h"
+#include "../cli/imx_debug.h"
+#include "../device/icb_def.h"
+#include "../time/ck_time.h"
+#include "coap.h"
+#include "add_coap_option.h"
+#include "que_manager.h"
+#include "coap_observe.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_RECV )
+    #undef PRINTF
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_RECV, __VA_ARGS__ )
+#elif !defined PRINTF
+    #define PRINTF(...)
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef COAP_MAX_OBSERVERS
+#define COAP_MAX_OBSERVERS          ( 8 )
+#endif
+#ifndef OBSERVE_MIN_INTERVAL
+#define OBSERVE_MIN_INTERVAL        ( 1 * SECONDS ) // Max rate of notifications to one observer
+#endif
+#define OBSERVE_CON_INTERVAL        ( 16 )          // Every n th notification is Confirmable to check the observer is still there
+#define OBSERVE_MAX_UNACKED         ( 2 )           // Confirmable notifications not acknowledged before the observer is dropped
+#define OBSERVE_OPTION_LENGTH       ( 4 )           // Option header and a 24 bit sequence number
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    wiced_ip_address_t ip_addr;
+    uint16_t port;
+    token_buffer_t token;
+    uint8_t token_length;
+    uint16_t type;                                  // Control / Sensor entry observed
+    uint16_t entry;
+    coap_observe_notify_t notify;
+    uint32_t sequence;                              // Observe option value of the last notification
+    uint16_t last_msg_id;                           // Message ID of the last notification, matched with a Reset
+    uint16_t con_msg_id;                            // Message ID of the last Confirmable notification, matched with an ACK
+    wiced_time_t last_notify_time;
+    wiced_time_t last_heard;                        // Registration or acknowledgement of a notification
+    uint32_t notifications;
+    uint32_t coalesced;                             // Changes folded in to a notification already waiting
+    uint8_t unacked;                                // Confirmable notifications not yet acknowledged
+    unsigned int active : 1;
+    unsigned int pending : 1;                       // Entry changed, notification to be sent
+} coap_observer_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static uint16_t find_observer( coap_message_t *msg );
+static void remove_observer( uint16_t observer );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern IOT_Device_Config_t device_config;   // Used for diags
+extern message_list_t list_udp_coap_xmit;
+
+static coap_observer_t observers[ COAP_MAX_OBSERVERS ];
+static uint16_t no_observers;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Clear the observer table
+  * @param  None
+  * @retval : None
+  */
+void coap_observe_init(void)
+{
+    memset( observers, 0x00, sizeof( observers ) );
+    no_observers = 0;
+}
+/**
+  * @brief  Register or deregister the sender of a GET as an observer of an entry - before the response is built
+  * @param  msg, cd, type & entry the request is for, function to build notifications
+  * @retval : observer registered, to pass to coap_observe_response(), or COAP_OBSERVE_NO_ENTRY
+  */
+uint16_t coap_observe_request( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t type, uint16_t entry, coap_observe_notify_t notify )
+{
+    uint16_t i, observer;
+    wiced_time_t current_time;
+
+    if( ( cd->observe_present == false ) || ( msg->header.tkl > MAX_TOKEN_LENGTH ) )
+        return COAP_OBSERVE_NO_ENTRY;
+
+    observer = find_observer( msg );
+    if( cd->observe == COAP_OBSERVE_DEREGISTER ) {
+        if( observer != COAP_OBSERVE_NO_ENTRY ) {
+            PRINTF( "Observer %u deregistered\r\n", observer );
+            remove_observer( observer );
+        }
+        return COAP_OBSERVE_NO_ENTRY;
+    } else if( cd->observe != COAP_OBSERVE_REGISTER )
+        return COAP_OBSERVE_NO_ENTRY;
+
+    wiced_time_get_time( &current_time );
+    if( observer == COAP_OBSERVE_NO_ENTRY ) {
+        /*
+         * New observer - use a free entry or replace the one heard from least recently
+         */
+        for( i = 0; i < COAP_MAX_OBSERVERS; i++ ) {
+            if( observers[ i ].active == false ) {
+                observer = i;
+                break;
+            }
+            if( ( observer == COAP_OBSERVE_NO_ENTRY ) || imx_is_later( observers[ observer ].last_heard, observers[ i ].last_heard ) )
+                observer = i;
+        }
+        if( observers[ observer ].active == true ) {
+            PRINTF( "Observer table full, replacing observer %u\r\n", observer );
+            remove_observer( observer );
+        }
+        memset( &observers[ observer ], 0x00, sizeof( coap_observer_t ) );
+        observers[ observer ].ip_addr = msg->ip_addr;
+        observers[ observer ].port = msg->port;
+        observers[ observer ].token_length = msg->header.tkl;
+        memcpy( observers[ observer ].token, msg->data_block->data, msg->header.tkl );
+        observers[ observer ].active = true;
+        no_observers += 1;
+    }
+    /*
+     * Registering again with the same token replaces the entry observed and restarts the sequence
+     */
+    observers[ observer ].type = type;
+    observers[ observer ].entry = entry;
+    observers[ observer ].notify = notify;
+    observers[ observer ].sequence = 0;
+    observers[ observer ].pending = false;
+    observers[ observer ].unacked = 0;
+    observers[ observer ].last_notify_time = current_time;
+    observers[ observer ].last_heard = current_time;
+    PRINTF( "Observer %u registered for %s: %u\r\n", observer, type == IMX_CONTROLS ? "Control" : "Sensor", entry );
+    return observer;
+}
+/**
+  * @brief  Add the Observe option to the response of a registration, an error response ends the registration
+  * @param  msg holding the response, observer from coap_observe_request(), response from the handler
+  * @retval : None
+  */
+void coap_observe_response( coap_message_t *msg, uint16_t observer, uint16_t response )
+{
+    uint16_t option_index, preceeding_option_number;
+
+    if( ( observer >= COAP_MAX_OBSERVERS ) || ( observers[ observer ].active == false ) )
+        return;
+    if( ( response != COAP_SEND_RESPONSE ) || ( MSG_CLASS( msg->header.code ) != SUCCESS_RESPONSE ) ||
+        ( coap_msg_resize( msg, msg->msg_length + OBSERVE_OPTION_LENGTH ) != WICED_SUCCESS ) ||
+        ( coap_find_numeric_option( OBSERVE, msg, NULL, &option_index, &preceeding_option_number ) != WICED_NOT_FOUND ) ||
+        ( coap_insert_numeric_option( OBSERVE, &preceeding_option_number, observers[ observer ].sequence, option_index, msg ) == 0 ) ) {
+        PRINTF( "Observer %u not registered, response: %u.%02u\r\n", observer, MSG_CLASS( msg->header.code ), MSG_DETAIL( msg->header.code ) );
+        remove_observer( observer );
+    }
+}
+/**
+  * @brief  A control / sensor value, warning level or percent change was detected - mark its observers for a notification
+  * @param  type, entry
+  * @retval : None
+  */
+void coap_observe_changed( uint16_t type, uint16_t entry )
+{
+    uint16_t i;
+
+    if( no_observers == 0 )
+        return;
+    for( i = 0; i < COAP_MAX_OBSERVERS; i++ )
+        if( ( observers[ i ].active == true ) && ( observers[ i ].type == type ) && ( observers[ i ].entry == entry ) ) {
+            if( observers[ i ].pending == true )
+                observers[ i ].coalesced += 1;
+            else
+                observers[ i ].pending = true;
+        }
+}
+/**
+  * @brief  Send notifications for changed entries to observers that have not had one for OBSERVE_MIN_INTERVAL
+  * @param  current time
+  * @retval : None
+  */
+void coap_observe_process( wiced_time_t current_time )
+{
+    uint16_t i, response_type;
+    message_t *msg;
+    coap_observer_t *o;
+
+    if( no_observers == 0 )
+        return;
+    for( i = 0; i < COAP_MAX_OBSERVERS; i++ ) {
+        o = &observers[ i ];
+        if( ( o->active == false ) || ( o->pending == false ) ||
+            ( imx_is_later( current_time, o->last_notify_time + OBSERVE_MIN_INTERVAL ) == false ) )
+            continue;
+        if( o->unacked >= OBSERVE_MAX_UNACKED ) {
+            PRINTF( "Observer %u not acknowledging notifications, removed\r\n", i );
+            remove_observer( i );
+            continue;
+        }
+        msg = msg_get( o->token_length + OBSERVE_OPTION_LENGTH );
+        if( msg == NULL )
+            return;     // Try again next time round
+        if( msg->coap.data_block == NULL ) {
+            msg_release( msg );
+            return;
+        }
+        /*
+         * Same as a response to the registration - the token of the request then the current value
+         */
+        msg->coap.header.ver = 1;
+        msg->coap.header.tkl = o->token_length;
+        memcpy( msg->coap.data_block->data, o->token, o->token_length );
+        msg->coap.msg_length = o->token_length;
+        msg->coap.ip_addr = o->ip_addr;
+        msg->coap.port = o->port;
+        response_type = ( ( ( o->notifications + 1 ) % OBSERVE_CON_INTERVAL ) == 0 ) ? CONFIRMABLE : NON_CONFIRMABLE;
+        if( ( o->notify( &msg->coap, o->type, o->entry, response_type ) != COAP_SEND_RESPONSE ) ) {
+            msg_release( msg );
+            continue;
+        }
+        if( MSG_CLASS( msg->coap.header.code ) != SUCCESS_RESPONSE ) {
+            /*
+             * Error notification - the observation ends with it
+             */
+            PRINTF( "Observer %u ended, response: %u.%02u\r\n", i, MSG_CLASS( msg->coap.header.code ), MSG_DETAIL( msg->coap.header.code ) );
+            remove_observer( i );
+            list_add( &list_udp_coap_xmit, msg );
+            continue;
+        }
+        o->sequence = ( o->sequence + 1 ) & COAP_OBSERVE_SEQUENCE_MASK;
+        coap_observe_response( &msg->coap, i, COAP_SEND_RESPONSE );
+        if( o->active == false ) {
+            msg_release( msg );
+            continue;
+        }
+        o->last_msg_id = msg->coap.header.id;
+        o->last_notify_time = current_time;
+        o->pending = false;
+        o->notifications += 1;
+        if( response_type == CONFIRMABLE ) {
+            o->con_msg_id = o->last_msg_id;
+            o->unacked += 1;
+        }
+        list_add( &list_udp_coap_xmit, msg );
+    }
+}
+/**
+  * @brief  An ACK or Reset was received, see if it is for a notification - a Reset ends the observation
+  * @param  Message ID, ACKNOWLEDGEMENT / RESET
+  * @retval : None
+  */
+void coap_observe_peer_reply( uint16_t id, uint16_t type )
+{
+    uint16_t i;
+
+    if( no_observers == 0 )
+        return;
+    for( i = 0; i < COAP_MAX_OBSERVERS; i++ )
+        if( ( observers[ i ].active == true ) && ( observers[ i ].notifications > 0 ) ) {
+            if( ( type == RESET ) && ( observers[ i ].last_msg_id == id ) ) {
+                PRINTF( "Observer %u sent Reset, removed\r\n", i );
+                remove_observer( i );
+                return;
+            } else if( ( type == ACKNOWLEDGEMENT ) && ( observers[ i ].unacked > 0 ) && ( observers[ i ].con_msg_id == id ) ) {
+                observers[ i ].unacked = 0;
+                wiced_time_get_time( &observers[ i ].last_heard );
+                return;
+            }
+        }
+}
+/**
+  * @brief  Print the observers
+  * @param  None
+  * @retval : None
+  */
+void print_observers(void)
+{
+    uint16_t i;
+
+    imx_cli_print( "CoAP Observers: %u\r\n", no_observers );
+    for( i = 0; i < COAP_MAX_OBSERVERS; i++ )
+        if( observers[ i ].active == true )
+            imx_cli_print( "  %u.%u.%u.%u:%u %s: %u, Notifications: %lu, Coalesced: %lu, Sequence: %lu%s\r\n",
+                    (unsigned int) ( ( observers[ i ].ip_addr.ip.v4 >> 24 ) & 0xff ),
+                    (unsigned int) ( ( observers[ i ].ip_addr.ip.v4 >> 16 ) & 0xff ),
+                    (unsigned int) ( ( observers[ i ].ip_addr.ip.v4 >>  8 ) & 0xff ),
+                    (unsigned int) ( ( observers[ i ].ip_addr.ip.v4 >>  0 ) & 0xff ),
+                    observers[ i ].port, observers[ i ].type == IMX_CONTROLS ? "Control" : "Sensor", observers[ i ].entry,
+                    observers[ i ].notifications, observers[ i ].coalesced, observers[ i ].sequence,
+                    observers[ i ].pending ? ", Pending" : "" );
+}
+/**
+  * @brief  Find the observer with the address, port and token of a message
+  * @param  msg
+  * @retval : observer or COAP_OBSERVE_NO_ENTRY
+  */
+static uint16_t find_observer( coap_message_t *msg )
+{
+    uint16_t i;
+
+    for( i = 0; i < COAP_MAX_OBSERVERS; i++ )
+        if( ( observers[ i ].active == true ) &&
+            ( observers[ i ].ip_addr.ip.v4 == msg->ip_addr.ip.v4 ) &&
+            ( observers[ i ].port == msg->port ) &&
+            ( observers[ i ].token_length == msg->header.tkl ) &&
+            ( memcmp( observers[ i ].token, msg->data_block->data, msg->header.tkl ) == 0 ) )
+            return i;
+    return COAP_OBSERVE_NO_ENTRY;
+}
+/**
+  * @brief  Remove an observer
+  * @param  observer
+  * @retval : None
+  */
+static void remove_observer( uint16_t observer )
+{
+    if( observers[ observer ].active == true ) {
+        observers[ observer ].active = false;
+        observers[ observer ].pending = false;
+        no_observers -= 1;
+    }
+}
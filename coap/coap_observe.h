@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file coap_observe.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef COAP_OBSERVE_H_
+#define COAP_OBSERVE_H_
+
+/*
+ *  Observers of control / sensor values - RFC 7641
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define COAP_OBSERVE_NO_ENTRY   ( 0xFFFF )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+/*
+ * Build the notification for an observed entry in msg - same as the response to a GET, returns COAP_SEND_RESPONSE or COAP_NO_RESPONSE
+ */
+typedef uint16_t (*coap_observe_notify_t)( coap_message_t *msg, uint16_t type, uint16_t entry, uint16_t response_type );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void coap_observe_init(void);
+uint16_t coap_observe_request( coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t type, uint16_t entry, coap_observe_notify_t notify );
+void coap_observe_response( coap_message_t *msg, uint16_t observer, uint16_t response );
+void coap_observe_changed( uint16_t type, uint16_t entry );
+void coap_observe_process( wiced_time_t current_time );
+void coap_observe_peer_reply( uint16_t id, uint16_t type );
+void print_observers(void);
+#endif /* COAP_OBSERVE_H_ */
@@ -41,7 +41,9 @@
 
 #include "wiced.h"
 
+#include "coap.h"
 #include "coap_transmit.h"
+#include "coap_observe.h"
 #include "coap_receive.h"
 #include "coap_process.h"
 
@@ -84,6 +86,8 @@
   */
 void coap_process(void)
 {
+    wiced_time_t current_time;
+
     /*
      * Check if there is any CoAP messages to process
      */
@@ -95,4 +99,6 @@ void coap_process(void)
     /*
      * Check for any observe requests we need to process
      */
+    wiced_time_get_time( &current_time );
+    coap_observe_process( current_time );
 }
@@ -48,6 +48,7 @@
 #include "../storage.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/config.h"
 #include "../device/icb_def.h"
 #include "coap.h"
@@ -57,15 +58,19 @@
 #include "../CoAP_interface/imx_wrong_group.h"
 #include "que_manager.h"
 #include "coap_receive.h"
+#include "coap_dedup.h"
+#include "coap_observe.h"
+#include "coap_block.h"
+#include "../imatrix_upload/imatrix_upload.h"
 #include "../cli/messages.h"
 #include "../storage.h"
 
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -118,7 +123,7 @@ uint16_t handle_request(message_t* msg) {
     }
 
     response = process_coap_msg( msg, &cd );
-    PRINTF( "CoAP message processed. Response: %u, %s\r\n", response, cd.uri );
+    PRINTF( "CoAP message processed. Response: %u, %s\r\n", response, coap_uri_string( &cd ) );
     /*
      * Processing a GET so unless the msg was bad see if we get that they asked for
      */
@@ -130,26 +135,19 @@ uint16_t handle_request(message_t* msg) {
     // Reject all packets being sent to the wrong_group except for packets sent to provisioning.
     // Because devices don't initially have groups assigned,
     // all devices need to get provisioning messages regardless of group.
-    if ( ( 0 != strcmp( cd.uri, "/control/provisioning" ) ) &&
+    if ( ( 0 != compare_uri( &cd, "/control/provisioning" ) ) &&
          imx_wrong_group( &cd ) ) {
         return COAP_NO_RESPONSE;
     }
 
 
-    PRINTF( "Looking for uri in iMatrix CoAP entries\r\n" );
-    matched_entry = match_uri( cd.uri, CoAP_entries, NO_IMATRIX_COAP_ENTRIES );
+    PRINTF( "Looking for uri in iMatrix and Host Application CoAP entries\r\n" );
+    matched_entry = match_uri_segments( &cd );
     if ( matched_entry == NULL ) {// uri was not found in list of known actions
-        /*
-         * Check is any host entries to process
-         */
-        PRINTF( "Looking for uri in Host Application CoAP entries\r\n" );
-        matched_entry = match_uri( cd.uri, icb.coap_entries, icb.no_host_coap_entries );
-        if ( matched_entry == NULL ) {
-            if ( coap_store_response_header( &(msg->coap), NOT_FOUND, response_type, NULL ) != WICED_SUCCESS )
-            {
-                imx_printf( "Unable to create response header in handle_request function.\r\n");
-                return COAP_NO_RESPONSE;
-            }
+        if ( coap_store_response_header( &(msg->coap), NOT_FOUND, response_type, NULL ) != WICED_SUCCESS )
+        {
+            imx_printf( "Unable to create response header in handle_request function.\r\n");
+            return COAP_NO_RESPONSE;
         }
     }
     if( matched_entry != NULL ) {
@@ -158,12 +156,20 @@ uint16_t handle_request(message_t* msg) {
         switch( MSG_DETAIL(msg->coap.header.code) ) {
             case GET :
                 if ( matched_entry->node.get_function != NULL ) {
-                    return (matched_entry->node.get_function)( &msg->coap, &cd, matched_entry->node.arg );
+                    response = (matched_entry->node.get_function)( &msg->coap, &cd, matched_entry->node.arg );
+                    return coap_block2_response( &msg->coap, &cd, response );
                 }
                 break;
             case POST :
                 if ( matched_entry->node.post_function != NULL ) {
-                    return (matched_entry->node.post_function)( &msg->coap, &cd, matched_entry->node.arg );
+                    /*
+                     * A payload sent in blocks is collected before the handler sees it
+                     */
+                    response = coap_block1_receive( &msg->coap, &cd );
+                    if( response != COAP_MESSAGE_MAY_BE_PROCESSED )
+                        return response;
+                    response = (matched_entry->node.post_function)( &msg->coap, &cd, matched_entry->node.arg );
+                    return coap_block1_response( &msg->coap, &cd, response );
                 }
                 break;
 
@@ -187,7 +193,7 @@ void handle_response(message_t* msg) {
     uint16_t result;
 
     result = process_coap_msg( msg, &cd );
-    PRINTF( "CoAP message processed. Response: %u, %s\r\n", result, cd.uri );
+    PRINTF( "CoAP message processed. Response: %u, %s\r\n", result, coap_uri_string( &cd ) );
     /*
      * Processing a GET so unless the msg was bad see if we get that they asked for
      */
@@ -218,7 +224,7 @@ void handle_response(message_t* msg) {
 void coap_recv(uint16_t process_to_end )
 {
     message_t *msg;
-    uint16_t confirmable, response, reset_condition, protocol;
+    uint16_t confirmable, response, reset_condition, protocol, dedup_entry;
     bool done;
 /*
  * Look for any data on the receive list and process it. if no data sleep for COAP_RECV_SLEEP
@@ -268,7 +274,18 @@ void coap_recv(uint16_t process_to_end )
                             confirmable = false;
                         PRINTF( "Processing Class: %u\r\n", MSG_CLASS(msg->coap.header.code) );
                         if ( REQUEST == MSG_CLASS( msg->coap.header.code ) ) {
-                            response = handle_request( msg );
+                            /*
+                             * A retransmitted request is answered from the duplicate cache without running the handler again
+                             */
+                            dedup_entry = COAP_DEDUP_NO_ENTRY;
+                            if( protocol == COMM_UDP )
+                                response = coap_dedup_check( msg, &dedup_entry );
+                            else
+                                response = COAP_MESSAGE_MAY_BE_PROCESSED;
+                            if( response == COAP_MESSAGE_MAY_BE_PROCESSED ) {
+                                response = handle_request( msg );
+                                coap_dedup_save( dedup_entry, msg, response );
+                            }
                         }
                         else {
                             handle_response( msg );
@@ -276,6 +293,13 @@ void coap_recv(uint16_t process_to_end )
                         break;
                     case ACKNOWLEDGEMENT :
                     case RESET :
+                        coap_observe_peer_reply( msg->coap.header.id, msg->coap.header.t );
+                        imatrix_upload_block_response( msg->coap.header.id, msg->coap.header.t, msg->coap.header.code );
+                        imatrix_upload_ack( msg->coap.header.id ); // Frees the slot in the iMatrix upload window
+                        PRINTF( "Message Type %u with Response Code %u.%u Ignored.\r\n", msg->coap.header.t,
+                                MSG_CLASS(msg->coap.header.code), MSG_DETAIL(msg->coap.header.code) );
+                        response = COAP_NO_RESPONSE;
+                        break;
                     default :
                         PRINTF( "Message Type %u with Response Code %u.%u Ignored.\r\n", msg->coap.header.t,
                                 MSG_CLASS(msg->coap.header.code), MSG_DETAIL(msg->coap.header.code) );
@@ -283,6 +307,10 @@ void coap_recv(uint16_t process_to_end )
                         break;
                 }
                 PRINTF( "Return Value: %u, Response: %x Confirmable: %s, Reset condition: %s\r\n", response, msg->coap.header.code, confirmable ? "true" : "false", reset_condition ? "true" : "false" );
+                /*
+                 * Request has been dispatched - if a response was built in a data block of its own the received packet can go back now
+                 */
+                msg_release_packet( &msg->coap );
                 /*
                  * Generate a response if needed
                  */
@@ -49,6 +49,8 @@
 #include "sent_message_list.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
+#include "../cli/trace.h"
 #include "../device/config.h"
 #include "../wifi/wifi.h"
 #include "../storage.h"
@@ -57,9 +59,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_XMIT
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_XMIT )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_XMIT ) != 0x00 ) imx_printf( __VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_TRACE( DEBUGS_FOR_XMIT, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -176,8 +178,8 @@ void coap_transmit( uint16_t process_to_end )
                 wiced_packet_delete( packet ); /* Delete packet, since the send failed */
                 goto free_msg;
             }
-#ifdef PRINT_DEBUGS_FOR_XMIT
-            if( ( device_config.log_messages & DEBUGS_FOR_XMIT ) != 0x00 ) {
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_XMIT )
+            if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_XMIT ) ) {
                 imx_printf( "Message DATA as string:" );
                 if ( msg->coap.data_block != NULL ) {
                     for( i = 0; i < msg->coap.msg_length; i++ ) {
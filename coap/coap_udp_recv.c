@@ -50,6 +50,7 @@
 #include "coap_transmit.h"
 #include "que_manager.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../cli/cli.h"
 #include "../device/icb_def.h"
 
@@ -57,9 +58,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_RECV
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_RECV )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_RECV ) != 0x00 ) st_log_print_status( __VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_RECV, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -109,13 +110,13 @@ wiced_result_t coap_udp_recv( wiced_udp_socket_t* udp_socket, void* arg )
     uint16_t                  udp_src_port;
     wiced_ip_address_t        dest_ip;
 	wiced_ip_address_t        my_ip;
-    uint16_t i;
     wiced_result_t result;
     message_t *msg;
     uint16_t two_bytes; //
     wiced_utc_time_t now;
     uint16_t coap_data_length = 0;
     uint16_t id = 0;
+    bool held;
     wiced_time_get_time( &now );
 
     result = wiced_udp_receive( udp_socket, &packet, 0 );
@@ -175,10 +176,13 @@ wiced_result_t coap_udp_recv( wiced_udp_socket_t* udp_socket, void* arg )
      */
 
 
-    msg = msg_get( coap_data_length );
+    /*
+     * The message refers to the data in the packet, the packet is returned to the stack when the message is done with it
+     */
+    msg = msg_get_packet( packet, &rx_data[ COAP_HEADER_LENGTH ], coap_data_length );
     if ( ( msg == NULL ) || ( msg->coap.data_block == NULL) ||
          ( msg->coap.data_block->data == NULL ) ||
-	     ( msg->coap.data_block->release_list_for_data_size == NULL ) )
+	     ( ( msg->coap.packet == NULL ) && ( msg->coap.data_block->release_list_for_data_size == NULL ) ) )
     {
     	if ( msg == NULL ) {
     		icb.print_msg |= MSG_UDP_OUT_OF_MEMORY;
@@ -196,7 +200,7 @@ wiced_result_t coap_udp_recv( wiced_udp_socket_t* udp_socket, void* arg )
         goto recv_cleanup;
     }
     /*
-     * Copy packet to msg
+     * Fill in msg from the packet header
      */
     msg->coap.ip_addr = udp_src_ip_addr;
     msg->coap.port = udp_src_port;
@@ -207,10 +211,6 @@ wiced_result_t coap_udp_recv( wiced_udp_socket_t* udp_socket, void* arg )
     msg->coap.header.code = rx_data[ 1 ];
     msg->coap.header.id = id;
     msg->coap.msg_length = coap_data_length;
-
-    for( i = 0; i < coap_data_length; i++ ) {
-    	msg->coap.data_block->data[ i ] = rx_data[ i + COAP_HEADER_LENGTH ];
-    }
     /*
      * Do Not PRINT HERE - if this is needed save to variables and print using print msg logic in do everything - no time to implement at the moment
 
@@ -219,7 +219,10 @@ wiced_result_t coap_udp_recv( wiced_udp_socket_t* udp_socket, void* arg )
     /*
      * Add the msg to the CoAP receive list for processing
      */
+    held = ( msg->coap.packet != NULL );
     list_add( &list_udp_coap_recv, msg );
+    if( held == true )
+        return WICED_SUCCESS;   // Packet is released with the message after coap_recv() has processed it
 
 recv_cleanup:
        /* Delete the received packet, it is no longer needed */
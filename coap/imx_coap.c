@@ -37,6 +37,7 @@
 
 #include "../storage.h"
 #include "../device/icb_def.h"
+#include "../coap_interface/match_uri.h"
 
 /******************************************************
  *                      Macros
@@ -101,6 +102,10 @@ void imx_set_host_coap_interface( uint16_t no_coap_entries, CoAP_entry_t *host_c
      */
     icb.no_host_coap_entries = no_coap_entries;
     icb.coap_entries = host_coap_entries;
+    /*
+     * Rebuild the uri dispatch index to include these entries
+     */
+    build_uri_index();
 }
 
 /**
@@ -48,6 +48,7 @@
 #include "../storage.h"
 #include "coap.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../cli/interface.h"
 #include "../time/ck_time.h"
 #include "add_coap_option.h"
@@ -56,9 +57,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -102,6 +103,17 @@
 
 // Total: 9960 bytes less than 10K
 
+// Received UDP packets that may be held by messages waiting in the receive list, after this they are copied
+// so the network stack does not run out of receive packets
+#define MAX_HELD_RECV_PACKETS 4
+
+/*
+ * Data blocks are not cleared when handed out or released, only the message_t header is. Define QUE_POISON_BLOCKS in a
+ * debug build to fill released blocks with a pattern that is checked when the block is handed out again, this shows up
+ * writes through a stale pointer after release and reads of data that was never written
+ */
+#define QUE_POISON_FREE 0xDB
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -117,15 +129,25 @@
  *               Function Declarations
  ******************************************************/
 void dump_list( message_list_t *list );
-static uint16_t blocks_remaining_in_free_messages_by_size( uint16_t index );
+static message_data_block_t *data_block_pop( message_size_t *release_list );
+static void data_block_push( message_data_block_t *block );
+static bool timed_entry_before( timed_entry_t *entry1, timed_entry_t *entry2 );
+static void heap_sift_up( message_list_t *list, uint16_t index );
+static void heap_sift_down( message_list_t *list, uint16_t index );
+static message_t *heap_remove( message_list_t *list, uint16_t index );
+static void list_lock( message_list_t *list );
+static void list_unlock( message_list_t *list );
 
 /******************************************************
  *               Variable Definitions
  ******************************************************/
-wiced_mutex_t list_mutex;
+wiced_mutex_t list_mutex;                 // Protects the free data block pools, each message list has its own lock
 wiced_mutex_t udp_xmit_reset_mutex;
 wiced_mutex_t last_packet_mutex;
 static wiced_time_t last_udp_packet_recv_time = 0;
+#ifdef QUE_POISON_BLOCKS
+static uint32_t poison_errors = 0;         // Released data blocks found written to when handed out again
+#endif
 
 extern message_list_t list_free;
 extern message_list_t list_udp_coap_recv;
@@ -142,6 +164,10 @@ static uint16_t block_not_found_errors;
 static message_size_t free_messages_by_size[ NUMBER_OF_DATA_SIZES ];// one list for each size of msg data.
 static message_data_block_t all_data_blocks[ TOTAL_NUM_MESSAGE_BUFFERS ];
 static uint8_t *all_data_bytes;         //static uint8_t tiny_bytes_data[ NUM_MSG_W_TINY_DATA_SIZE ][ TINY_DATA_BYTES ];
+static uint16_t held_packets;           // Received packets currently referred to by messages
+static uint16_t max_held_packets;
+static uint32_t zero_copy_packets;
+static uint32_t copied_packets;
 
 /******************************************************
  *               Function Definitions
@@ -236,9 +262,56 @@ void list_init( message_list_t *list )
 {
     list->head = NULL;
     list->tail = NULL;
+    list->heap = NULL;
+    list->heap_count = 0;
+    list->heap_size = 0;
+    list->sequence = 0;
+    list->ring = NULL;
+    list->ring_in = 0;
+    list->ring_out = 0;
+    list->ring_size = 0;
+    list->users = 0;
+    list->contention = 0;
+    list->ring_full = 0;
+    if( wiced_rtos_init_mutex( &list->mutex ) != WICED_SUCCESS )
+        imx_printf( "Unable to setup list mutex...\r\n" );
 
 }
 
+/**
+  * @brief  list_init_timed - Set up a clean list kept as a min heap on the entry timestamps
+  *         Insert is O(log n) and checking the earliest entry is O(1), used for the retransmit queue
+  * @param  list to initialize, maximum number of entries
+  * @retval : true if heap storage allocated
+  *
+  */
+bool list_init_timed( message_list_t *list, uint16_t size )
+{
+    list_init( list );
+    list->heap = (timed_entry_t *) imx_allocate_storage( size * sizeof( timed_entry_t ) );
+    if( list->heap == NULL )
+        return false;
+    list->heap_size = size;
+    return true;
+}
+
+/**
+  * @brief  list_init_spsc - Set up a clean list as a lock free ring
+  *         Only one thread may add to the list and only one other thread may pop from it
+  * @param  list to initialize, maximum number of entries
+  * @retval : true if ring storage allocated
+  *
+  */
+bool list_init_spsc( message_list_t *list, uint16_t size )
+{
+    list_init( list );
+    list->ring = (message_t **) imx_allocate_storage( ( size + 1 ) * sizeof( message_t * ) );   // One slot always empty
+    if( list->ring == NULL )
+        return false;
+    list->ring_size = size + 1;
+    return true;
+}
+
 /**
   * @brief  add a message to the bottom of the list
   * @param  list, new item
@@ -254,19 +327,46 @@ void list_add( message_list_t *list, message_t *entry )
 
 void list_add_at( wiced_time_t timestamp, message_list_t *list, message_t *new_entry, uint8_t send_attempts )
 {
-    wiced_result_t result;
     message_t* entry;
+    uint16_t next_in;
 
-    result = wiced_rtos_lock_mutex( &list_mutex );   // All use same mutex for simplicity
-    if( result != WICED_SUCCESS ) {
-        imx_printf( "Unable to lock list mutex...\r\n" );
-    }
-   
     new_entry->coap.send_attempts = send_attempts;
     new_entry->coap.initial_timestamp = 0;
     new_entry->coap.next_timestamp = timestamp;
 
-    if( list->head == NULL ) { // Assume first entry
+    if( list->ring != NULL ) {
+        /*
+         * Producer side of the ring, no lock. Only called from the thread feeding this list
+         */
+        next_in = ( list->ring_in + 1 ) % list->ring_size;
+        if( next_in == list->ring_out ) {
+            list->ring_full += 1;       // Can not happen when sized to the message pool - don't print here, may be in a callback
+            msg_release( new_entry );
+            return;
+        }
+        new_entry->header.next = NULL;
+        new_entry->header.prev = NULL;
+        list->ring[ list->ring_in ] = new_entry;
+        __sync_synchronize();           // Entry must be visible before the index moves
+        list->ring_in = next_in;
+        return;
+    }
+
+    list_lock( list );
+
+    if( list->heap != NULL ) {
+        if( list->heap_count < list->heap_size ) {
+            new_entry->header.next = NULL;
+            new_entry->header.prev = NULL;
+            list->heap[ list->heap_count ].msg = new_entry;
+            list->heap[ list->heap_count ].timestamp = timestamp;
+            list->heap[ list->heap_count ].sequence = list->sequence++;
+            list->heap_count += 1;
+            heap_sift_up( list, list->heap_count - 1 );
+        } else
+            imx_printf( "Timed list full, message: 0x%08lX lost...\r\n", (uint32_t) new_entry );
+    }
+    else if( list->head == NULL ) { // Assume first entry
         list->head = new_entry;
         list->tail = new_entry;
         new_entry->header.next = NULL;
@@ -296,10 +396,7 @@ void list_add_at( wiced_time_t timestamp, message_list_t *list, message_t *new_e
         }
    }
 
-    result = wiced_rtos_unlock_mutex( &list_mutex );   // All use same mutex for simplicity
-        if( result != WICED_SUCCESS ) {
-            imx_printf( "Unable to unlock list mutex...\r\n" );
-        }
+    list_unlock( list );
 
 }
 /**
@@ -318,15 +415,32 @@ message_t  *list_pop( message_list_t  *list )
 
 message_t *list_pop_before( wiced_time_t timestamp, message_list_t *list )
 {
-    wiced_result_t result;
     message_t *entry;
 
-    result = wiced_rtos_lock_mutex( &list_mutex );   // All use same mutex for simplicity
-    if( result != WICED_SUCCESS ) {
-        imx_printf( "Unable to lock list mutex...\r\n" );
+    if( list->ring != NULL ) {
+        /*
+         * Consumer side of the ring, no lock. Only called from the thread processing this list
+         */
+        if( list->ring_out == list->ring_in )
+            return NULL;
+        __sync_synchronize();           // Read the entry after seeing the index move
+        entry = list->ring[ list->ring_out ];
+        if( imx_is_later( entry->coap.next_timestamp, timestamp ) )
+            return NULL;
+        __sync_synchronize();           // Finished with the slot before handing it back
+        list->ring_out = ( list->ring_out + 1 ) % list->ring_size;
+        return entry;
     }
 
-    if ( ( list->head == NULL ) || ( imx_is_later( list->head->coap.next_timestamp, timestamp ) ) ) {// Assume no entries
+    list_lock( list );
+
+    if( list->heap != NULL ) {
+        if( ( list->heap_count == 0 ) || ( imx_is_later( list->heap[ 0 ].timestamp, timestamp ) ) )
+            entry = NULL;
+        else
+            entry = heap_remove( list, 0 );
+    }
+    else if ( ( list->head == NULL ) || ( imx_is_later( list->head->coap.next_timestamp, timestamp ) ) ) {// Assume no entries
         entry = NULL;
     }
     else {
@@ -343,10 +457,7 @@ message_t *list_pop_before( wiced_time_t timestamp, message_list_t *list )
         entry->header.prev = NULL;
     }
 
-    result = wiced_rtos_unlock_mutex( &list_mutex );   // All use same mutex for simplicity
-    if( result != WICED_SUCCESS ) {
-        imx_printf( "Unable to un lock list mutex...\r\n" );
-    }
+    list_unlock( list );
     return entry;
 
 }
@@ -386,6 +497,9 @@ bool create_msg_lists()
 
     message_list_empty_errors = 0;
     block_not_found_errors = 0;
+#ifdef QUE_POISON_BLOCKS
+    memset( all_data_bytes, QUE_POISON_FREE, TOTAL_BYTES_FOR_MESSAGE_DATA );
+#endif
 
 	for( s = 0; s < NUMBER_OF_DATA_SIZES; s++ ) {
 		free_messages_by_size[ s ].min_free_list_size = num_msg;// For statistical purposes only.
@@ -403,6 +517,7 @@ bool create_msg_lists()
 			b++;// Next data block struct.
 		}
 		free_messages_by_size[ s ].msg_data = last_data_block;
+		free_messages_by_size[ s ].free_count = num_msg;
 
 		// Assign number of data bytes and number of messages for the next bigger size.
 
@@ -435,8 +550,10 @@ bool create_msg_lists()
 	// Create list of free message_t structs.
 
 	list_init( &list_free );
-	list_init( &list_udp_coap_recv );
-	list_init( &list_udp_coap_xmit );
+	if( list_init_spsc( &list_udp_coap_recv, TOTAL_NUM_MESSAGE_BUFFERS ) == false )   // Fed by the UDP receive callback, read by coap_recv()
+	    return false;
+	if( list_init_timed( &list_udp_coap_xmit, TOTAL_NUM_MESSAGE_BUFFERS ) == false )
+	    return false;
     list_init( &list_tcp_coap_recv );
     list_init( &list_tcp_coap_xmit );
 
@@ -456,9 +573,8 @@ message_t *msg_get( uint16_t min_bytes )
 {
     wiced_result_t result;
     message_t *msg = NULL;// Return NULL if not successful.
-    uint16_t remaining;
 
-    result = wiced_rtos_lock_mutex( &list_mutex );   // All use same mutex for simplicity
+    result = wiced_rtos_lock_mutex( &list_mutex );   // Data block pools
     if( result != WICED_SUCCESS ) {
     	icb.print_msg |= MSG_MSG_GET_NO_MUTEX;
         return NULL;
@@ -495,23 +611,13 @@ message_t *msg_get( uint16_t min_bytes )
         			goto unlock_mutex_and_return_msg;
         		}
 
-        		// Initialize msg and data array to 0
+        		// Initialize msg to 0, the data array is left as is - users write the msg_length bytes they send
 
         		memset( msg, 0, sizeof( message_t ) );
-        		memset( free_messages_by_size[ s ].msg_data->data, 0, free_messages_by_size[ s ].data_size );
 
         		// Assign data block
 
-        		msg->coap.data_block = free_messages_by_size[ s ].msg_data;
-        		free_messages_by_size[ s ].msg_data = msg->coap.data_block->next;
-        		msg->coap.data_block->next = NULL;
-
-        		// Store minimum size of this free list.
-
-        	    remaining = blocks_remaining_in_free_messages_by_size( s );
-        		if ( remaining < free_messages_by_size[ s ].min_free_list_size ) {
-        			 free_messages_by_size[ s ].min_free_list_size = remaining;
-        		}
+        		msg->coap.data_block = data_block_pop( &( free_messages_by_size[ s ] ) );
 
         		goto unlock_mutex_and_return_msg;
     		}
@@ -522,13 +628,92 @@ message_t *msg_get( uint16_t min_bytes )
     block_not_found_errors++;
 
 unlock_mutex_and_return_msg:
-    result = wiced_rtos_unlock_mutex( &list_mutex );   // All use same mutex for simplicity
+    result = wiced_rtos_unlock_mutex( &list_mutex );   // Data block pools
     if( result != WICED_SUCCESS ) {
     	icb.print_msg |= MSG_MSG_GET_NO_UNLOCK_MUTEX;
     }
     return msg;
 }
 
+/**
+  * @brief  Return a free message_t whose data block refers to the CoAP data in a received packet - the data is not copied
+  *         The packet is held until msg_release_packet() or msg_release(). When too many packets are already held
+  *         the data is copied into a data block from the pools and the message does not hold the packet
+  * @param  packet, data - CoAP data following the header, length of data
+  * @retval : message or NULL if none available
+  */
+message_t *msg_get_packet( wiced_packet_t *packet, uint8_t *data, uint16_t length )
+{
+    wiced_result_t result;
+    message_t *msg = NULL;
+    bool copy = false;
+
+    result = wiced_rtos_lock_mutex( &list_mutex );   // Held packet count
+    if( result != WICED_SUCCESS ) {
+        icb.print_msg |= MSG_MSG_GET_NO_MUTEX;
+        return NULL;
+    }
+    if( held_packets >= MAX_HELD_RECV_PACKETS ) {
+        copied_packets += 1;
+        copy = true;
+    } else {
+        msg = list_pop_before( 0, &list_free );
+        if ( msg == NULL ) {
+            icb.print_msg |= MSG_MSG_GET_OUT_MEMORY;
+            message_list_empty_errors++;
+        } else if ( msg->coap.data_block != NULL ) {// msg should be empty with no data_block
+            icb.print_msg |= MSG_MSG_GET_MEM_LEAK;
+            msg = NULL;
+        } else {
+            /*
+             * Only the message is initialized, the data stays where it is in the packet
+             */
+            memset( msg, 0, sizeof( message_t ) );
+            msg->coap.packet = packet;
+            msg->coap.packet_block.data = data;
+            msg->coap.data_block = &msg->coap.packet_block;
+            held_packets += 1;
+            if( held_packets > max_held_packets )
+                max_held_packets = held_packets;
+            zero_copy_packets += 1;
+        }
+    }
+    result = wiced_rtos_unlock_mutex( &list_mutex );
+    if( result != WICED_SUCCESS ) {
+        icb.print_msg |= MSG_MSG_GET_NO_UNLOCK_MUTEX;
+    }
+
+    if( copy == true ) {
+        msg = msg_get( length );
+        if( ( msg != NULL ) && ( msg->coap.data_block != NULL ) && ( msg->coap.data_block->data != NULL ) )
+            memcpy( msg->coap.data_block->data, data, length );
+    }
+    return msg;
+}
+
+/**
+  * @brief  Return the packet held by a message to the network stack once the message data no longer refers to it
+  * @param  coap
+  * @retval : None
+  */
+void msg_release_packet( coap_message_t *coap )
+{
+    if( ( coap == NULL ) || ( coap->packet == NULL ) || ( coap->data_block == &coap->packet_block ) )
+        return;
+
+    wiced_packet_delete( coap->packet );
+    coap->packet = NULL;
+
+    if( wiced_rtos_lock_mutex( &list_mutex ) != WICED_SUCCESS ) {
+        imx_printf( "Unable to lock list mutex...\r\n" );
+    }
+    if( held_packets > 0 )
+        held_packets -= 1;
+    if( wiced_rtos_unlock_mutex( &list_mutex ) != WICED_SUCCESS ) {
+        imx_printf( "Unable to unlock list mutex...\r\n" );
+    }
+}
+
 /**
  * Insert "msg" and the data block it contains into the appropriate free list.
  *
@@ -541,11 +726,15 @@ wiced_result_t msg_release( message_t *msg )
 		return WICED_ERROR;
 	}
     wiced_result_t result, return_result = WICED_SUCCESS;
-    message_size_t *release_list = NULL;
+
+    if ( msg->coap.data_block == &msg->coap.packet_block ) {// Data is in a held packet, not a data block from the pools
+        msg->coap.data_block = NULL;
+    }
+    msg_release_packet( &msg->coap );
 
     if ( msg->coap.data_block != NULL ) {// Release data part of message if it exists.
 
-		result = wiced_rtos_lock_mutex( &list_mutex );   // All use same mutex for simplicity
+		result = wiced_rtos_lock_mutex( &list_mutex );   // Data block pools
 		if( result != WICED_SUCCESS ) {
 			imx_printf( "Unable to lock list mutex...\r\n" );
 		}
@@ -558,15 +747,10 @@ wiced_result_t msg_release( message_t *msg )
 			return_result = WICED_ERROR;
 		}
 		else {
-			release_list = msg->coap.data_block->release_list_for_data_size;
-			msg->coap.data_block->next = release_list->msg_data;
-			release_list->msg_data = msg->coap.data_block;
+			data_block_push( msg->coap.data_block );
 			msg->coap.data_block = NULL;
-
-			// Initialize data block array to 0
-			memset( release_list->msg_data->data, 0, release_list->data_size );
 		}
-		result = wiced_rtos_unlock_mutex( &list_mutex );   // All use same mutex for simplicity
+		result = wiced_rtos_unlock_mutex( &list_mutex );   // Data block pools
 		if( result != WICED_SUCCESS ) {
 			imx_printf( "Unable to unlock list mutex...\r\n" );
 		}
@@ -608,7 +792,7 @@ void list_release_all( message_list_t *list )
 
     // This should never happen but just check to make sure the list is empty.
 
-    if ( ( list->head != NULL ) || ( list->tail != NULL ) ) {
+    if ( list_size( list ) != 0 ) {
     	imx_printf( "Failed to release all list members in list_release_all function.\r\n" );
     }
 }
@@ -627,9 +811,12 @@ wiced_result_t coap_msg_resize( coap_message_t* coap, uint16_t min_bytes )
 		return WICED_ERROR;
 	}
     wiced_result_t result, return_result = WICED_ERROR;
-    uint16_t remaining;
+    message_data_block_t *new_block;
+    bool in_packet;
 
-	if ( ( coap->data_block != NULL ) &&
+    in_packet = ( coap->data_block == &coap->packet_block );   // Data still in the received packet - always gets a data block of its own
+
+	if ( ( coap->data_block != NULL ) && ( in_packet == false ) &&
 			( ( coap->data_block->release_list_for_data_size == NULL ) ||
 			  ( coap->data_block->data == NULL ) ) )
 	{
@@ -637,7 +824,7 @@ wiced_result_t coap_msg_resize( coap_message_t* coap, uint16_t min_bytes )
 		return WICED_ERROR;
 	}
 
-    result = wiced_rtos_lock_mutex( &list_mutex );   // All use same mutex for simplicity
+    result = wiced_rtos_lock_mutex( &list_mutex );   // Data block pools
     if( result != WICED_SUCCESS ) {
         imx_printf( "Unable to lock list mutex...\r\n" );
 		return WICED_ERROR;
@@ -651,44 +838,35 @@ wiced_result_t coap_msg_resize( coap_message_t* coap, uint16_t min_bytes )
     	if ( ( min_bytes <= free_messages_by_size[ s ].data_size ) &&
     	     ( NULL != free_messages_by_size[ s ].msg_data ) ) {
 
-    		if ( coap->data_block != NULL ) {// copy data into new message data block
+			// The currently attached data block is the best we can do, don't copy & resize.
+			if ( ( coap->data_block != NULL ) && ( in_packet == false ) &&
+			     ( free_messages_by_size[ s ].data_size >= coap->data_block->release_list_for_data_size->data_size ) &&
+				 ( min_bytes <= coap->data_block->release_list_for_data_size->data_size ) ) {
+				return_result = WICED_SUCCESS;
 
-				// The currently attached data block is the best we can do, don't copy & resize.
-				if ( ( free_messages_by_size[ s ].data_size >= coap->data_block->release_list_for_data_size->data_size ) &&
-					 ( min_bytes <= coap->data_block->release_list_for_data_size->data_size ) ) {
-					return_result = WICED_SUCCESS;
+				goto unlock_mutex;
+			}
 
-					goto unlock_mutex;
-				}
+			// Take the new data block before the old one is released so the old one can not be handed straight back.
+			new_block = data_block_pop( &( free_messages_by_size[ s ] ) );
 
-				// Initialize new data block to 0
-				memset( free_messages_by_size[ s ].msg_data->data, 0, free_messages_by_size[ s ].data_size );
+    		if ( coap->data_block != NULL ) {// copy data into new message data block
 
 				// if the old message does not fit copy as much as possible
     			if ( coap->msg_length > free_messages_by_size[ s ].data_size ) {
     				coap->msg_length = free_messages_by_size[ s ].data_size;
     			}
 
-    			memmove( free_messages_by_size[ s ].msg_data->data, coap->data_block->data, coap->msg_length );
+    			memmove( new_block->data, coap->data_block->data, coap->msg_length );
     		}
 
-    		// Release old data block from message.
-    		message_size_t *release_list = coap->data_block->release_list_for_data_size;
-    		coap->data_block->next = release_list->msg_data;
-    		release_list->msg_data = coap->data_block;
-    		coap->data_block = NULL;
+    		// Release old data block from message. A packet stays held so views of the request made from it remain valid.
+    		if ( ( coap->data_block != NULL ) && ( in_packet == false ) ) {
+    			data_block_push( coap->data_block );
+    		}
 
     		// Assign new data block.
-    		coap->data_block = free_messages_by_size[ s ].msg_data;
-    		free_messages_by_size[ s ].msg_data = coap->data_block->next;
-    		coap->data_block->next = NULL;
-
-    		// Store minimum size of list of free blocks.
-
-    	    remaining = blocks_remaining_in_free_messages_by_size( s );
-    		if ( remaining < free_messages_by_size[ s ].min_free_list_size ) {
-    			 free_messages_by_size[ s ].min_free_list_size = remaining;
-    		}
+    		coap->data_block = new_block;
 
     		return_result = WICED_SUCCESS;
     		goto unlock_mutex;
@@ -698,7 +876,7 @@ wiced_result_t coap_msg_resize( coap_message_t* coap, uint16_t min_bytes )
     return_result = WICED_ERROR;
 
 unlock_mutex:
-    result = wiced_rtos_unlock_mutex( &list_mutex );   // All use same mutex for simplicity
+    result = wiced_rtos_unlock_mutex( &list_mutex );   // Data block pools
     if( result != WICED_SUCCESS ) {
         imx_printf( "Unable to unlock list mutex...\r\n" );
     }
@@ -719,6 +897,9 @@ uint16_t coap_msg_data_size( coap_message_t* coap )
 	if ( coap->data_block == NULL ) {// OK: No data block means no data.
 		return 0;
 	}
+	if ( coap->data_block == &coap->packet_block ) {// Data in a held packet can not grow
+		return coap->msg_length;
+	}
 	if ( coap->data_block->release_list_for_data_size == NULL ) {
 		imx_printf( "Data block missing required release list in coap_msg_data_size function.r\n" );
 		return 0;
@@ -830,6 +1011,24 @@ uint8_t confirmable_match( message_t *entry, wiced_ip_address_t *remote_ip, uint
 message_t *list_pop_confirmable_match( message_list_t *xmit_list, wiced_ip_address_t *remote_ip,
         uint16_t remote_port, uint16_t id )
 {
+    uint16_t i;
+    message_t *match;
+
+    if( xmit_list->ring != NULL )
+        return NULL;    // Entries can only leave a ring in order
+
+    if( xmit_list->heap != NULL ) {
+        match = NULL;
+        list_lock( xmit_list );
+        for( i = 0; i < xmit_list->heap_count; i++ ) {
+            if( confirmable_match( xmit_list->heap[ i ].msg, remote_ip, remote_port, id ) ) {
+                match = heap_remove( xmit_list, i );
+                break;
+            }
+        }
+        list_unlock( xmit_list );
+        return match;
+    }
     //hunt through list backwards to find oldest matching message.
     message_t *entry = xmit_list->tail;
 
@@ -895,6 +1094,13 @@ int list_size( message_list_t *list )
 {
     message_t* entry = list->head;
 
+    if( list->ring != NULL ) {
+        return ( list->ring_in + list->ring_size - list->ring_out ) % list->ring_size;
+    }
+    if( list->heap != NULL ) {
+        return list->heap_count;
+    }
+
     if ( entry == NULL ) {
         return 0;
     }
@@ -928,6 +1134,22 @@ void dump_lists(void)
 void dump_list( message_list_t *list )
 {
 	message_t* entry = list->head;
+	uint16_t i;
+
+	    if( list->heap != NULL ) {
+	        if( list->heap_count == 0 )
+	            imx_cli_print( "No Entries\r\n" );
+	        for( i = 0; i < list->heap_count; i++ )
+	            imx_cli_print( "Entry: 0x%08lX, Time: %lu\r\n", (uint32_t) list->heap[ i ].msg, (uint32_t) list->heap[ i ].timestamp );
+	        return;
+	    }
+	    if( list->ring != NULL ) {
+	        if( list->ring_out == list->ring_in )
+	            imx_cli_print( "No Entries\r\n" );
+	        for( i = list->ring_out; i != list->ring_in; i = ( i + 1 ) % list->ring_size )
+	            imx_cli_print( "Entry: 0x%08lX\r\n", (uint32_t) list->ring[ i ] );
+	        return;
+	    }
 
 	    if ( entry == NULL ) {
 	        imx_cli_print( "No Entries\r\n" );
@@ -982,19 +1204,50 @@ uint16_t get_block_list_details( uint16_t index, uint16_t *smallest_freelist_siz
 }
 
 /**
- * Return the length of the list of free blocks in free_messages_by_size[ index ]
- *
- * written by Eric Thelin 5 April 2016
- */
-static uint16_t blocks_remaining_in_free_messages_by_size( uint16_t index )
+  * @brief  Take the first data block from a free list, keeping the free count and its low water mark up to date
+  *         Called with list_mutex held and the free list not empty
+  * @param  release_list
+  * @retval : data block, disconnected from the list
+  */
+static message_data_block_t *data_block_pop( message_size_t *release_list )
 {
-	uint16_t count = 0;
-	message_data_block_t *block = free_messages_by_size[ index ].msg_data;
-	while ( block != NULL ) {
-		count++;
-		block = block->next;
-	}
-	return count;
+    message_data_block_t *block;
+
+    block = release_list->msg_data;
+    release_list->msg_data = block->next;
+    block->next = NULL;
+    release_list->free_count -= 1;
+    if( release_list->free_count < release_list->min_free_list_size )
+        release_list->min_free_list_size = release_list->free_count;
+#ifdef QUE_POISON_BLOCKS
+    uint16_t i;
+
+    for( i = 0; i < release_list->data_size; i++ ) {
+        if( block->data[ i ] != QUE_POISON_FREE ) {
+            poison_errors += 1;
+            PRINTF( "Data block %p (%u bytes) written at offset %u after release\r\n", block->data, release_list->data_size, i );
+            break;
+        }
+    }
+#endif
+    return block;
+}
+/**
+  * @brief  Return a data block to the front of the free list it came from
+  *         Called with list_mutex held
+  * @param  block
+  * @retval : None
+  */
+static void data_block_push( message_data_block_t *block )
+{
+    message_size_t *release_list = block->release_list_for_data_size;
+
+#ifdef QUE_POISON_BLOCKS
+    memset( block->data, QUE_POISON_FREE, release_list->data_size );
+#endif
+    block->next = release_list->msg_data;
+    release_list->msg_data = block;
+    release_list->free_count += 1;
 }
 /**
  * Print failed attempts with blocks
@@ -1010,6 +1263,11 @@ static uint16_t blocks_remaining_in_free_messages_by_size( uint16_t index )
         imx_cli_print( "  Block Size: %4u, Unused Blocks: %2u, Required Larger Block When Out of This Size: %u\r\n", block_size, smallest_freelist_size, errors );
         s++;
     }
+    imx_cli_print( "Received packets - Zero copy: %lu, Copied (%u already held): %lu, Held now: %u, Most held: %u\r\n",
+            zero_copy_packets, MAX_HELD_RECV_PACKETS, copied_packets, held_packets, max_held_packets );
+#ifdef QUE_POISON_BLOCKS
+    imx_cli_print( "Data blocks written after release: %lu\r\n", poison_errors );
+#endif
 
 }
 /**
@@ -1023,15 +1281,7 @@ void print_free_msg_sizes()
 
 	imx_cli_print( "Free message packet sizes: ");
 	for ( s = 0; s < NUMBER_OF_DATA_SIZES; s++ ) {
-/*
-		uint16_t count = 0;
-		message_data_block_t *block = free_messages_by_size[ s ].msg_data;
-		while ( block != NULL ) {
-			count++;
-			block = block->next;
-		}
-*/
-		imx_cli_print("%u Bytes[ %u ] ", free_messages_by_size[ s ].data_size, blocks_remaining_in_free_messages_by_size( s ) );
+		imx_cli_print("%u Bytes[ %u ] ", free_messages_by_size[ s ].data_size, free_messages_by_size[ s ].free_count );
 	}
 	imx_cli_print( "\r\n" );
 }
@@ -1040,3 +1290,113 @@ uint16_t max_packet_size(void)
 {
 	return HUGE_DATA_BYTES;
 }
+/**
+  * @brief  Print the number of times each list lock was found held by another thread
+  * @param  None
+  * @retval : None
+  */
+void print_list_contention(void)
+{
+    imx_cli_print( "List lock contention - Free: %lu, UDP Xmit: %lu, TCP Recv: %lu, TCP Xmit: %lu, UDP Recv (lock free) ring full: %lu\r\n",
+            list_free.contention, list_udp_coap_xmit.contention, list_tcp_coap_recv.contention, list_tcp_coap_xmit.contention,
+            list_udp_coap_recv.ring_full );
+}
+/**
+  * @brief  Take the lock for a list, counting when another thread already holds it or is waiting for it
+  *         The WICED mutex has no timeout to try it with, the holders and waiters are counted atomically instead
+  * @param  list
+  * @retval : None
+  */
+static void list_lock( message_list_t *list )
+{
+    if( __sync_fetch_and_add( &list->users, 1 ) != 0 )
+        __sync_fetch_and_add( &list->contention, 1 );
+    if( wiced_rtos_lock_mutex( &list->mutex ) != WICED_SUCCESS )
+        imx_printf( "Unable to lock list mutex...\r\n" );
+}
+/**
+  * @brief  Release the lock for a list
+  * @param  list
+  * @retval : None
+  */
+static void list_unlock( message_list_t *list )
+{
+    if( wiced_rtos_unlock_mutex( &list->mutex ) != WICED_SUCCESS )
+        imx_printf( "Unable to unlock list mutex...\r\n" );
+    __sync_fetch_and_sub( &list->users, 1 );
+}
+/**
+  * @brief  Determine if a heap entry must leave the list before another
+  *         Earlier timestamp first, equal timestamps in the order they were added
+  * @param  heap entries to compare
+  * @retval : true if entry1 is before entry2
+  */
+static bool timed_entry_before( timed_entry_t *entry1, timed_entry_t *entry2 )
+{
+    if( imx_is_later( entry2->timestamp, entry1->timestamp ) )
+        return true;
+    if( imx_is_later( entry1->timestamp, entry2->timestamp ) )
+        return false;
+    return ( (int32_t) ( entry2->sequence - entry1->sequence ) > 0 );
+}
+/**
+  * @brief  Move a heap entry up towards the root until the heap is in order
+  * @param  list, index of entry
+  * @retval : None
+  */
+static void heap_sift_up( message_list_t *list, uint16_t index )
+{
+    timed_entry_t entry;
+    uint16_t parent;
+
+    entry = list->heap[ index ];
+    while( index > 0 ) {
+        parent = ( index - 1 ) / 2;
+        if( timed_entry_before( &entry, &list->heap[ parent ] ) == false )
+            break;
+        list->heap[ index ] = list->heap[ parent ];
+        index = parent;
+    }
+    list->heap[ index ] = entry;
+}
+/**
+  * @brief  Move a heap entry down away from the root until the heap is in order
+  * @param  list, index of entry
+  * @retval : None
+  */
+static void heap_sift_down( message_list_t *list, uint16_t index )
+{
+    timed_entry_t entry;
+    uint16_t child;
+
+    entry = list->heap[ index ];
+    while( ( child = ( 2 * index ) + 1 ) < list->heap_count ) {
+        if( ( child + 1 < list->heap_count ) && timed_entry_before( &list->heap[ child + 1 ], &list->heap[ child ] ) )
+            child += 1;
+        if( timed_entry_before( &list->heap[ child ], &entry ) == false )
+            break;
+        list->heap[ index ] = list->heap[ child ];
+        index = child;
+    }
+    list->heap[ index ] = entry;
+}
+/**
+  * @brief  Remove an entry from the heap, caller holds the list mutex
+  * @param  list, index of entry
+  * @retval : message removed
+  */
+static message_t *heap_remove( message_list_t *list, uint16_t index )
+{
+    message_t *entry;
+
+    entry = list->heap[ index ].msg;
+    list->heap_count -= 1;
+    if( index < list->heap_count ) {
+        list->heap[ index ] = list->heap[ list->heap_count ];
+        heap_sift_up( list, index );
+        heap_sift_down( list, index );
+    }
+    entry->header.next = NULL;
+    entry->header.prev = NULL;
+    return entry;
+}
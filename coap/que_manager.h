@@ -72,6 +72,8 @@ void mutex_init(void);
 void set_last_packet_time( wiced_time_t time );
 wiced_time_t get_last_packet_time();
 void list_init( message_list_t *list );
+bool list_init_timed( message_list_t *list, uint16_t size );
+bool list_init_spsc( message_list_t *list, uint16_t size );
 void list_add( message_list_t *list, message_t *entry  );
 void list_add_at( wiced_time_t timestamp, message_list_t *list, message_t *new_entry, uint8_t retry );
 message_t *list_pop( message_list_t  *list );
@@ -79,6 +81,8 @@ message_t *list_pop_before( wiced_time_t timestamp, message_list_t *list);
 bool create_msg_lists(void);
 void list_release_all( message_list_t *list );
 message_t *msg_get( uint16_t min_bytes );
+message_t *msg_get_packet( wiced_packet_t *packet, uint8_t *data, uint16_t length );
+void msg_release_packet( coap_message_t *coap );
 wiced_result_t msg_release( message_t *msg );
 wiced_result_t coap_msg_resize( coap_message_t* coap, uint16_t min_bytes );
 uint16_t coap_msg_data_size( coap_message_t* coap );
@@ -96,6 +100,7 @@ int list_size( message_list_t *list );
 void dump_lists(void);
 void print_msg_errors(void);
 void print_free_msg_sizes();
+void print_list_contention(void);
 uint16_t max_packet_size(void);
 
 #endif /* QUE_MANAGER_H_ */
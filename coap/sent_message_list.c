@@ -42,6 +42,7 @@
 
 #include "coap.h"
 #include "imx_coap.h"
+#include "../storage.h"
 #include "../cli/interface.h"
 #include "../time/ck_time.h"
 #include "sent_message_list.h"
@@ -49,9 +50,9 @@
 /*******************
  * Private Variables
  *******************/
-static sent_message_list_t messages_awaiting_response = { .list = {{0,0,0,0,{0},0}}, .top = NOT_FOUND_IN_LIST, .free = 0 };
-// The above initialization does not initialize the next index attribute of the list correctly,
-// so the list must be created before use.
+static sent_message_list_t messages_awaiting_response = { .list = NULL, .hash = NULL, .size = SENT_MESSAGE_LIST_SIZE, .hash_size = 0, .count = 0,
+        .oldest = NOT_FOUND_IN_LIST, .newest = NOT_FOUND_IN_LIST, .free = NOT_FOUND_IN_LIST };
+// The list and hash index are allocated on first use, so the size may be changed until then.
 static uint16_t sent_message_list_requires_creation = true;
 
 /********************************
@@ -59,11 +60,29 @@ static uint16_t sent_message_list_requires_creation = true;
  ********************************/
 static void create_free_list_by_connecting_next_indexes_in_sent_msg_list();
 static void free_oldest_msg();
+static void free_sent_msg( uint16_t entry_id );
+static uint16_t token_hash( uint16_t tkl, uint8_t *token );
+static uint16_t find_hash_slot( uint16_t tkl, uint8_t *token );
+static void remove_from_hash( uint16_t entry_id );
 
 /*****************************
  * Public Function Definitions
  *****************************/
 
+/**
+ * Set the number of sent messages that can be waiting for a response.
+ * Must be called before the first message is sent, the storage can not be released once allocated.
+ * Return false if the list is already in use or the size is out of range.
+ */
+bool imx_set_sent_message_list_size( uint16_t size )
+{
+	if ( ( sent_message_list_requires_creation == false ) || ( size == 0 ) || ( size > MAX_SENT_MESSAGE_LIST_SIZE ) ) {
+		return false;
+	}
+	messages_awaiting_response.size = size;
+	return true;
+}
+
 /**
  * Retrieve the token and token length from one of the stored sent message lists.
  * Return WICED_ERROR if the sent message cannot be found in a list or NULL is passed in.
@@ -77,8 +96,8 @@ wiced_result_t get_sent_msg_token( sent_message_t sent, token_buffer_t token, ui
 		imx_printf("Null value passed to get_sent_msg_token function or No list from which to get messages.\r\n");
 		return WICED_ERROR;
 	}
-	if ( sent.id >= SENT_MESSAGE_LIST_SIZE ) {
-		imx_printf("Index(%u) out of array bounds(%u) in get_sent_msg_token.\r\n", sent.id, SENT_MESSAGE_LIST_SIZE );
+	if ( sent.id >= messages_awaiting_response.size ) {
+		imx_printf("Index(%u) out of array bounds(%u) in get_sent_msg_token.\r\n", sent.id, messages_awaiting_response.size );
 		return WICED_ERROR;
 	}
 	if ( ( sent.may_resend == 0 ) && ( sent.id != NOT_FOUND_IN_LIST ) ) {
@@ -98,8 +117,8 @@ wiced_result_t get_sent_msg_token( sent_message_t sent, token_buffer_t token, ui
  */
 uint16_t sent_msg_is_multicast( sent_message_t sent )
 {
-	if ( sent.id >= SENT_MESSAGE_LIST_SIZE ) {
-		imx_printf("Index(%u) out of array bounds(%u) in sent_msg_is_multicast.\r\n", sent.id, SENT_MESSAGE_LIST_SIZE );
+	if ( sent.id >= messages_awaiting_response.size ) {
+		imx_printf("Index(%u) out of array bounds(%u) in sent_msg_is_multicast.\r\n", sent.id, messages_awaiting_response.size );
 		return 0;//false
 	}
 	if ( ( sent.may_resend == 0 ) && ( sent.id != NOT_FOUND_IN_LIST ) && ( sent_message_list_requires_creation == false ) ) {
@@ -117,8 +136,8 @@ uint16_t sent_msg_is_multicast( sent_message_t sent )
  */
 uint8_t sent_msg_processing_method( sent_message_t sent )
 {
-	if ( sent.id >= SENT_MESSAGE_LIST_SIZE ) {
-		imx_printf("Index(%u) out of array bounds(%u) in sent_msg_processing_method.\r\n", sent.id, SENT_MESSAGE_LIST_SIZE );
+	if ( sent.id >= messages_awaiting_response.size ) {
+		imx_printf("Index(%u) out of array bounds(%u) in sent_msg_processing_method.\r\n", sent.id, messages_awaiting_response.size );
 		return IGNORE_RESPONSE;
 	}
 	if ( ( sent.may_resend == 0 ) && ( sent.id != NOT_FOUND_IN_LIST ) && ( sent_message_list_requires_creation == false ) ) {
@@ -141,7 +160,7 @@ uint8_t sent_msg_processing_method( sent_message_t sent )
 void expect_response_from( coap_message_t* msg )
 {
 	sent_message_t sent;
-    uint16_t i;
+    uint16_t i, slot;
 
 	if ( msg == NULL ) {
 		imx_printf( "Null passed to expect_response_from function.\r\n");
@@ -149,6 +168,10 @@ void expect_response_from( coap_message_t* msg )
 	}
 	if ( sent_message_list_requires_creation ) {
 		create_free_list_by_connecting_next_indexes_in_sent_msg_list();
+		if ( sent_message_list_requires_creation ) {
+			imx_printf("Unable to allocate sent message list in expect_response_from.\r\n");
+			return;
+		}
 	}
 	if ( msg->header.tkl > MAX_TOKEN_LENGTH ) {
 		imx_printf("Token length out of bounds in find_sent_msg.\r\n");
@@ -169,6 +192,21 @@ void expect_response_from( coap_message_t* msg )
 			return;
 		}
 		else imx_printf("Keeping new message.\r\n");
+
+		// Unlink so it is added back as the newest entry below, keeping the list in expiry order.
+
+		if ( messages_awaiting_response.list[ sent.id ].prev == NOT_FOUND_IN_LIST ) {
+			messages_awaiting_response.oldest = messages_awaiting_response.list[ sent.id ].next;
+		}
+		else {
+			messages_awaiting_response.list[ messages_awaiting_response.list[ sent.id ].prev ].next = messages_awaiting_response.list[ sent.id ].next;
+		}
+		if ( messages_awaiting_response.list[ sent.id ].next == NOT_FOUND_IN_LIST ) {
+			messages_awaiting_response.newest = messages_awaiting_response.list[ sent.id ].prev;
+		}
+		else {
+			messages_awaiting_response.list[ messages_awaiting_response.list[ sent.id ].next ].prev = messages_awaiting_response.list[ sent.id ].prev;
+		}
 	}
 	else {// Find a free message into which to save the passed in message.
 
@@ -190,14 +228,27 @@ void expect_response_from( coap_message_t* msg )
 			sent.id = messages_awaiting_response.free;
 		    sent.may_resend = 0;
 			messages_awaiting_response.free = messages_awaiting_response.list[ sent.id ].next;
+			messages_awaiting_response.count++;
 
-			// Move this to the top of the list.
+			// Index it by token.
 
-			messages_awaiting_response.list[ sent.id ].next = messages_awaiting_response.top;
-			messages_awaiting_response.top = sent.id;
+			slot = find_hash_slot( msg->header.tkl, msg->data_block->data );
+			messages_awaiting_response.hash[ slot ] = sent.id;
 		}
 	}
 
+	// Add as the newest entry.
+
+	messages_awaiting_response.list[ sent.id ].prev = messages_awaiting_response.newest;
+	messages_awaiting_response.list[ sent.id ].next = NOT_FOUND_IN_LIST;
+	if ( messages_awaiting_response.newest == NOT_FOUND_IN_LIST ) {
+		messages_awaiting_response.oldest = sent.id;
+	}
+	else {
+		messages_awaiting_response.list[ messages_awaiting_response.newest ].next = sent.id;
+	}
+	messages_awaiting_response.newest = sent.id;
+
 	// Copy data from the passed in message.
 
 	messages_awaiting_response.list[ sent.id ].initial_timestamp = msg->initial_timestamp;
@@ -219,8 +270,6 @@ void expect_response_from( coap_message_t* msg )
  */
 sent_message_t find_sent_msg( coap_message_t* response_msg  )
 {
-	//uint16_t byte = 0;
-	//uint16_t token_matches = true;
     sent_message_t entry = { .may_resend = 0, .id = NOT_FOUND_IN_LIST };
 
 	if ( ( response_msg == NULL ) || ( response_msg->data_block == NULL ) ) {
@@ -237,27 +286,18 @@ sent_message_t find_sent_msg( coap_message_t* response_msg  )
 		return entry;// NOT FOUND.
 	}
 
-	entry.id =  messages_awaiting_response.top;
-
-	while ( entry.id != NOT_FOUND_IN_LIST ) {
-
-		if ( ( response_msg->header.tkl == messages_awaiting_response.list[ entry.id ].tkl ) &&
-        		( 0 == memcmp( response_msg->data_block->data, messages_awaiting_response.list[ entry.id ].token, response_msg->header.tkl ) ) ) {
-        	return entry;
-        }
-		entry.id = messages_awaiting_response.list[ entry.id ].next;
-	}
+	entry.id = messages_awaiting_response.hash[ find_hash_slot( response_msg->header.tkl, response_msg->data_block->data ) ];
 	return entry;
 }
 
 /**
  * Free all sent message entries where the initial_timestamp is more than SENT_MESSAGE_EXPIRATION ms ago.
+ * Entries are linked in the order they were sent so stop at the first one that has not expired.
  *
  * written by Eric Thelin 12 July 2016
  */
 void free_all_expired_sent_msg()
 {
-	uint8_t entry_id, last_entry_id, next_entry_id;
 	wiced_time_t now;
 
 	if ( sent_message_list_requires_creation ) {
@@ -265,69 +305,28 @@ void free_all_expired_sent_msg()
 		return;
 	}
 
-	entry_id = messages_awaiting_response.top;
-	last_entry_id = entry_id;
 	wiced_time_get_time( &now );
 
-	while ( entry_id != NOT_FOUND_IN_LIST ) {
-		if ( imx_is_later( now, messages_awaiting_response.list[ entry_id ].initial_timestamp + SENT_MESSAGE_EXPIRATION ) ) {
-
-			// Free expired entry;
-
-			next_entry_id = messages_awaiting_response.list[ entry_id ].next;
-			if ( messages_awaiting_response.top == entry_id ) {
-				last_entry_id = next_entry_id;
-				messages_awaiting_response.top = next_entry_id;
-			}
-			else {
-				messages_awaiting_response.list[ last_entry_id ].next = next_entry_id;
-			}
-
-			// Add entry to free list.
-
-			memset( &( messages_awaiting_response.list[ entry_id ] ), 0, sizeof( coap_message_summary_t ) );
-			messages_awaiting_response.list[ entry_id ].next = messages_awaiting_response.free;
-			messages_awaiting_response.free = entry_id;
-
-			entry_id = next_entry_id;
-		}
-		else {
-			last_entry_id = entry_id;
-			entry_id = messages_awaiting_response.list[ entry_id ].next;
-		}
+	while ( ( messages_awaiting_response.oldest != NOT_FOUND_IN_LIST ) &&
+			imx_is_later( now, messages_awaiting_response.list[ messages_awaiting_response.oldest ].initial_timestamp + SENT_MESSAGE_EXPIRATION ) ) {
+		free_sent_msg( messages_awaiting_response.oldest );
 	}
 }
 
 uint16_t sent_msg_list_length()
 {
-	uint16_t this, length = 0;
-
 	if ( sent_message_list_requires_creation ) {
 		return 0;
 	}
-
-	this = messages_awaiting_response.top;
-    while ( this != NOT_FOUND_IN_LIST) {
-    	length++;
-    	this = messages_awaiting_response.list[ this ].next;
-    }
-    return length;
+    return messages_awaiting_response.count;
 }
 
 uint16_t free_sent_msg_list_length()
 {
-	uint16_t this, length = 0;
-
 	if ( sent_message_list_requires_creation ) {
 		return 0;
 	}
-
-	this = messages_awaiting_response.free;
-    while ( this != NOT_FOUND_IN_LIST) {
-    	length++;
-    	this = messages_awaiting_response.list[ this ].next;
-    }
-    return length;
+    return messages_awaiting_response.size - messages_awaiting_response.count;
 }
 
 /******************************
@@ -335,11 +334,10 @@ uint16_t free_sent_msg_list_length()
  ******************************/
 
 /**
- * Connect each struct in the sent message array to the following struct by assigning the correct index value to next.
+ * Allocate the sent message array and its hash index, then connect each struct in the array
+ * to the following struct by assigning the correct index value to next.
  * The last struct is assigned next = NOT_FOUND_IN_LIST.
  *
- * ASSUME: All values in the messages_awaiting_response list should be initialized
- * except for the next indexes for the free list.
  * This is intended to be called once before anything is added to the list,
  * and never called again until the next boot.
  *
@@ -348,10 +346,30 @@ uint16_t free_sent_msg_list_length()
 static void create_free_list_by_connecting_next_indexes_in_sent_msg_list()
 {
 	uint16_t i;
-	for ( i = 0; i < SENT_MESSAGE_LIST_SIZE; i++ ) {
+
+	// Hash index is a power of 2 at least twice the list size to keep probe sequences short.
+
+	messages_awaiting_response.hash_size = 1;
+	while ( messages_awaiting_response.hash_size < 2 * messages_awaiting_response.size ) {
+		messages_awaiting_response.hash_size <<= 1;
+	}
+	messages_awaiting_response.list = imx_allocate_storage( messages_awaiting_response.size * sizeof( coap_message_summary_t ) );
+	messages_awaiting_response.hash = imx_allocate_storage( messages_awaiting_response.hash_size * sizeof( uint16_t ) );
+	if ( ( messages_awaiting_response.list == NULL ) || ( messages_awaiting_response.hash == NULL ) ) {
+		return;
+	}
+
+	for ( i = 0; i < messages_awaiting_response.hash_size; i++ ) {
+		messages_awaiting_response.hash[ i ] = NOT_FOUND_IN_LIST;
+	}
+	for ( i = 0; i < messages_awaiting_response.size; i++ ) {
 		messages_awaiting_response.list[ i ].next = i + 1;
 	}
-	messages_awaiting_response.list[ SENT_MESSAGE_LIST_SIZE - 1 ].next = NOT_FOUND_IN_LIST;
+	messages_awaiting_response.list[ messages_awaiting_response.size - 1 ].next = NOT_FOUND_IN_LIST;
+	messages_awaiting_response.free = 0;
+	messages_awaiting_response.count = 0;
+	messages_awaiting_response.oldest = NOT_FOUND_IN_LIST;
+	messages_awaiting_response.newest = NOT_FOUND_IN_LIST;
 	sent_message_list_requires_creation = false;
 }
 
@@ -363,61 +381,115 @@ static void create_free_list_by_connecting_next_indexes_in_sent_msg_list()
  */
 static void free_oldest_msg()
 {
-	uint8_t entry, next_entry, oldest, before_oldest;// = { .may_resend = 0, .id =  };
-	//sent_message_t oldest = entry;
-
 	if ( sent_message_list_requires_creation ) {
 //		imx_printf("No list from which to free messages in free_oldest_msg.\r\n");//This can legitimately happen, so don't send an error message.
 		return;
 	}
 
-	// Initialize using first entry.
-
-	entry = messages_awaiting_response.top;
-	if ( entry == NOT_FOUND_IN_LIST ) {
-		return;
+	if ( messages_awaiting_response.oldest != NOT_FOUND_IN_LIST ) {
+		free_sent_msg( messages_awaiting_response.oldest );
 	}
-	oldest = entry;
-	before_oldest = entry;
-	next_entry = messages_awaiting_response.list[ entry ].next;
+}
 
-	// Loop over remaining entries.
+/**
+ * Remove an entry from the time ordered list and the hash index and add it to the free list.
+ */
+static void free_sent_msg( uint16_t entry_id )
+{
+	remove_from_hash( entry_id );
 
-	while ( next_entry != NOT_FOUND_IN_LIST ) {
-		if ( imx_is_later( messages_awaiting_response.list[ oldest ].initial_timestamp,
-				messages_awaiting_response.list[ next_entry ].initial_timestamp ) ) {
-            before_oldest = entry;
-			oldest = next_entry;
-		}
-		entry = next_entry;
-		next_entry = messages_awaiting_response.list[ next_entry ].next;
+	if ( messages_awaiting_response.list[ entry_id ].prev == NOT_FOUND_IN_LIST ) {
+		messages_awaiting_response.oldest = messages_awaiting_response.list[ entry_id ].next;
 	}
-
-	// Remove oldest entry from sent messages list.
-
-	if ( oldest == messages_awaiting_response.top ) {
-		messages_awaiting_response.top = messages_awaiting_response.list[ oldest ].next;
+	else {
+		messages_awaiting_response.list[ messages_awaiting_response.list[ entry_id ].prev ].next = messages_awaiting_response.list[ entry_id ].next;
+	}
+	if ( messages_awaiting_response.list[ entry_id ].next == NOT_FOUND_IN_LIST ) {
+		messages_awaiting_response.newest = messages_awaiting_response.list[ entry_id ].prev;
 	}
 	else {
-		messages_awaiting_response.list[ before_oldest ].next =
-				messages_awaiting_response.list[ oldest ].next;
+		messages_awaiting_response.list[ messages_awaiting_response.list[ entry_id ].next ].prev = messages_awaiting_response.list[ entry_id ].prev;
+	}
+
+	memset( &( messages_awaiting_response.list[ entry_id ] ), 0, sizeof( coap_message_summary_t ) );
+	messages_awaiting_response.list[ entry_id ].next = messages_awaiting_response.free;
+	messages_awaiting_response.free = entry_id;
+	messages_awaiting_response.count--;
+}
+
+/**
+ * FNV-1a hash of the token length and token, masked to the hash index size.
+ */
+static uint16_t token_hash( uint16_t tkl, uint8_t *token )
+{
+	uint32_t hash = 2166136261u;
+	uint16_t i;
+
+	hash = ( hash ^ tkl ) * 16777619u;
+	for ( i = 0; i < tkl; i++ ) {
+		hash = ( hash ^ token[ i ] ) * 16777619u;
 	}
+	return (uint16_t) ( hash & ( messages_awaiting_response.hash_size - 1 ) );
+}
 
-	// Free oldest entry.
+/**
+ * Return the hash index slot holding the entry with this token,
+ * or the empty slot where it would be added if there is no such entry.
+ * The index is never more than half full so an empty slot always ends the probe.
+ */
+static uint16_t find_hash_slot( uint16_t tkl, uint8_t *token )
+{
+	uint16_t slot, entry_id;
 
-	memset( &( messages_awaiting_response.list[ oldest ] ), 0, sizeof( coap_message_summary_t ) );
-	messages_awaiting_response.list[ oldest ].next = messages_awaiting_response.free;
-	messages_awaiting_response.free = oldest;
+	slot = token_hash( tkl, token );
+	while ( ( entry_id = messages_awaiting_response.hash[ slot ] ) != NOT_FOUND_IN_LIST ) {
+		if ( ( messages_awaiting_response.list[ entry_id ].tkl == tkl ) &&
+				( 0 == memcmp( messages_awaiting_response.list[ entry_id ].token, token, tkl ) ) ) {
+			break;
+		}
+		slot = ( slot + 1 ) & ( messages_awaiting_response.hash_size - 1 );
+	}
+	return slot;
+}
 
-	return;
+/**
+ * Remove an entry from the hash index, moving back any following entries
+ * in the probe sequence so lookups never need tombstones.
+ */
+static void remove_from_hash( uint16_t entry_id )
+{
+	uint16_t slot, next, home, mask;
+
+	mask = messages_awaiting_response.hash_size - 1;
+	slot = find_hash_slot( messages_awaiting_response.list[ entry_id ].tkl, messages_awaiting_response.list[ entry_id ].token );
+	if ( messages_awaiting_response.hash[ slot ] != entry_id ) {
+		return;
+	}
+	messages_awaiting_response.hash[ slot ] = NOT_FOUND_IN_LIST;
+
+	next = ( slot + 1 ) & mask;
+	while ( messages_awaiting_response.hash[ next ] != NOT_FOUND_IN_LIST ) {
+		home = token_hash( messages_awaiting_response.list[ messages_awaiting_response.hash[ next ] ].tkl,
+				messages_awaiting_response.list[ messages_awaiting_response.hash[ next ] ].token );
+		// Move the entry back if the emptied slot is between its home slot and where it is now.
+		if ( ( ( next - home ) & mask ) >= ( ( next - slot ) & mask ) ) {
+			messages_awaiting_response.hash[ slot ] = messages_awaiting_response.hash[ next ];
+			messages_awaiting_response.hash[ next ] = NOT_FOUND_IN_LIST;
+			slot = next;
+		}
+		next = ( next + 1 ) & mask;
+	}
 }
 
 void test_is_later()
 {
+	if ( sent_message_list_requires_creation ) {
+		return;
+	}
 	imx_printf("Initial time[0] %lu ",  messages_awaiting_response.list[ 0 ].initial_timestamp);
 	if ( imx_is_later( messages_awaiting_response.list[ 0 ].initial_timestamp,
-					messages_awaiting_response.list[ 49].initial_timestamp ) ) {
+					messages_awaiting_response.list[ messages_awaiting_response.size - 1 ].initial_timestamp ) ) {
 		imx_printf(">");
 	} else imx_printf("<=");
-	imx_printf(" %lu time[49]",  messages_awaiting_response.list[ 49 ].initial_timestamp);
+	imx_printf(" %lu time[%u]",  messages_awaiting_response.list[ messages_awaiting_response.size - 1 ].initial_timestamp, messages_awaiting_response.size - 1 );
 }
@@ -41,9 +41,10 @@
 /******************************************************
  *                    Constants
  ******************************************************/
-#define SENT_MESSAGE_LIST_SIZE  ( 0x32 )
-#define NOT_FOUND_IN_LIST       ( 0xFF )
-// NOT_FOUND_IN_LIST must be bigger than any index in the array so NOT_FOUND_IN_LIST >= SENT_MESSAGE_LIST_SIZE
+#define SENT_MESSAGE_LIST_SIZE  ( 0x32 )     // Default capacity, see imx_set_sent_message_list_size()
+#define MAX_SENT_MESSAGE_LIST_SIZE  ( 0x0800 )
+#define NOT_FOUND_IN_LIST       ( 0x7FFF )
+// NOT_FOUND_IN_LIST must be bigger than any index in the array so NOT_FOUND_IN_LIST >= MAX_SENT_MESSAGE_LIST_SIZE and fit in sent_message_t.id
 #define SENT_MESSAGE_EXPIRATION ( 1 * MINUTES )
 
 /******************************************************
@@ -62,7 +63,8 @@ enum response_processing_directive {
  ******************************************************/
 typedef struct describe_coap_message_summary {// A summary of information in the message_t struct defined in coap.h.
 	// This summary should be sufficient to process a response, but should not include everything needed to resend a message.
-    uint8_t        next;
+    uint16_t       next;              // Next newer entry, or next free entry
+    uint16_t       prev;              // Next older entry
     unsigned int   tkl        : 4;    // Token Length
     unsigned int   response_processing_method : 3;
     unsigned int   sent_as_multicast : 1;
@@ -76,8 +78,10 @@ typedef struct describe_sent_message {
 } sent_message_t;
 
 typedef struct describe_sent_message_list{
-	coap_message_summary_t list[ SENT_MESSAGE_LIST_SIZE ];
-	uint8_t top, free;
+	coap_message_summary_t *list;     // Entries in use are linked oldest to newest, which is also the expiry order
+	uint16_t *hash;                   // Open addressed index of entries keyed on ( tkl, token ), NOT_FOUND_IN_LIST if empty
+	uint16_t size, hash_size, count;
+	uint16_t oldest, newest, free;
 } sent_message_list_t;
 
 /******************************************************
@@ -92,6 +96,7 @@ sent_message_t find_sent_msg( coap_message_t* response_msg  );//PASSED input val
 void free_all_expired_sent_msg();// PASSED all
 uint16_t sent_msg_list_length();// PASSED all
 uint16_t free_sent_msg_list_length();// PASSED all
+bool imx_set_sent_message_list_size( uint16_t size );
 
 //static void create_free_list_by_connecting_next_indexes_in_sent_msg_list() PASSED all
 //static void free_oldest_msg()// PASSED all
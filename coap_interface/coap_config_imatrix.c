@@ -53,15 +53,16 @@
 #include "coap_msg_get_store.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/icb_def.h"
 
 #include "coap_control_otaupdate.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -121,11 +122,11 @@ uint16_t coap_post_config_imatrix(coap_message_t *msg, CoAP_msg_detail_t *cd, ui
     /*
      * Process the passed URI Query
      */
-    if( strlen( cd->uri_query ) > 0 ) {
+    if( cd->no_uri_query_segments > 0 ) {
         response = BAD_REQUEST;     // No URI Query supported
         goto bad_data;
     }
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
     PRINTF( "URI Payload: %s\r\n", cd->payload );
 
     result = json_read_object( cd->payload, json_attrs, NULL );
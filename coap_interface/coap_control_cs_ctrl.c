@@ -57,21 +57,24 @@
 #include "../cs_ctrl/hal_event.h"
 #include "../json/mjson.h"
 #include "../coap/add_coap_option.h"
+#include "../coap/coap_observe.h"
 #include "../CoAP_interface/imx_get_uint_from_query_str.h"
 #include "../cs_ctrl/imx_cs_interface.h"
+#include "../cs_ctrl/cs_index.h"
 #include "../device/var_data.h"
 #include "../wifi/wifi.h"
 #include "coap_def.h"
 #include "coap_msg_get_store.h"
 #include "coap_control_cs_ctrl.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/icb_def.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -122,6 +125,8 @@ extern iMatrix_Control_Block_t icb;
  * Scan control or sensor control blocks for ID and return "msg" updated to be a response
  * containing the JSON with name and current value in it.
  *
+ * With an Observe option of 0 the sender is registered for notifications of the value - RFC 7641.
+ *
  * @param msg is the request, and returned as the response.
  * @param coap_cd  contains the query string extracted from msg.
  * @param arg is not used.
@@ -133,10 +138,8 @@ uint16_t coap_get_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_c
 {
     UNUSED_PARAMETER( arg );
     // Respond with value for ID.
-    char json_out[ JSON_MAX_SIZE ];     // Allocate this from heap later
-    char base64_output[ BASE64_MAX_LENGTH ];
-    int32_t result;
-    uint16_t type, i;
+    char json_out[ JSON_MAX_SIZE ];
+    uint16_t type, entry, observer, response;
     uint32_t id = 0;
     uint16_t response_type = NON_CONFIRMABLE; // Unless the request type is Confirmable.
 
@@ -150,9 +153,9 @@ uint16_t coap_get_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_c
     }
 
     PRINTF( "Get Configuration - '/control/cs_ctrl'\r\n");
-    PRINTF( "URI Query: %s\r\n", coap_cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( coap_cd ) );
 
-    if ( WICED_SUCCESS != imx_get_uint_from_query_str( "type", &type, coap_cd->uri_query ) ) {// Require type
+    if ( WICED_SUCCESS != imx_get_uint_from_query_str( "type", &type, coap_uri_query_string( coap_cd ) ) ) {// Require type
         if( coap_store_response_header( msg, BAD_REQUEST, response_type, NULL )  != WICED_SUCCESS ) {
             PRINTF( "Failed to create response.\r\n" );
             return COAP_NO_RESPONSE;
@@ -163,7 +166,7 @@ uint16_t coap_get_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_c
         }
     }  else {// type is OK.
 
-        if ( WICED_SUCCESS == imx_get_uint32_from_query_str( "id", &id, coap_cd->uri_query ) ) {
+        if ( WICED_SUCCESS == imx_get_uint32_from_query_str( "id", &id, coap_uri_query_string( coap_cd ) ) ) {
 
             if ( imx_is_multicast_ip( &( msg->my_ip_from_request ) ) ) {
                 return COAP_NO_RESPONSE;
@@ -172,78 +175,19 @@ uint16_t coap_get_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_c
              * Scan array for entry
              */
             PRINTF( "Scanning for %u, id: %lu, 0x%08lx\r\n", type, id, id );
-            if( type == IMX_CONTROLS ) {
-                for( i = 0; i < device_config.no_controls; i++ )
-                    if( device_config.ccb[ i ].id == id ) {
-                        switch( device_config.ccb[ i ].data_type ) {
-                            case IMX_UINT32 :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"uint_value\" : %lu }", device_config.ccb[ i ].name, cd[ i ].last_value.uint_32bit );
-                                break;
-                            case IMX_INT32 :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"int_value\" : %ld }", device_config.ccb[ i ].name, cd[ i ].last_value.uint_32bit );
-                                break;
-                            case IMX_FLOAT :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"float_value\" : %f }", device_config.ccb[ i ].name, cd[ i ].last_value.float_32bit );
-                                break;
-                            case IMX_VARIABLE_LENGTH :
-                                if( cd[ i ].last_value.var_data->length > 0 ) {
-                                    result = base64_encode( (unsigned char* ) cd[ i ].last_value.var_data->data, cd[ i ].last_value.var_data->length,
-                                            (unsigned char*) base64_output, BASE64_MAX_LENGTH, BASE64_STANDARD );
-                                    if( result < 0 ) {
-                                        /*
-                                         * Error
-                                         */
-                                        if( coap_store_response_header( msg, REQUEST_ENTITY_TOO_BIG, response_type, NULL )  != WICED_SUCCESS ) {
-                                            PRINTF( "Failed to create response.\r\n" );
-                                            return COAP_NO_RESPONSE;
-                                        }
-                                    }
-                                }
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"var_value\" : \"%s\" }",
-                                        device_config.ccb[ i ].name, ( cd[ i ].last_value.var_data == NULL ? "" : (char* ) base64_output ) );
-                                break;
-                        }
-                        goto done;
-                    }
-            } else {
-                for( i = 0; i < device_config.no_sensors; i++ )
-                    if( device_config.scb[ i ].id == id ) {
-                        switch( device_config.scb[ i ].data_type ) {
-                            case IMX_UINT32 :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"uint_value\" : %lu }", device_config.scb[ i ].name, sd[ i ].last_value.uint_32bit );
-                                break;
-                            case IMX_INT32 :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"int_value\" : %ld }", device_config.scb[ i ].name, sd[ i ].last_value.uint_32bit );
-                                break;
-                            case IMX_FLOAT :
-                                sprintf( json_out, "{ \"name\" : \"%s\", \"float_value\" : %f }", device_config.scb[ i ].name, sd[ i ].last_value.float_32bit );
-                                break;
-                            case IMX_VARIABLE_LENGTH :
-                                result = base64_encode( (unsigned char* ) sd[ i ].last_value.var_data->data, sd[ i ].last_value.var_data->length,
-                                        (unsigned char*) base64_output, BASE64_MAX_LENGTH, BASE64_STANDARD );
-                                if( result < 0 ) {
-                                    /*
-                                     * Error
-                                     */
-                                    if( coap_store_response_header( msg, REQUEST_ENTITY_TOO_BIG, response_type, NULL )  != WICED_SUCCESS ) {
-                                        PRINTF( "Failed to create response.\r\n" );
-                                        return COAP_NO_RESPONSE;
-                                    }
-                                } else {
-                                    sprintf( json_out, "{ \"name\" : \"%s\", \"var_value\" : \"%s\" }",
-                                            device_config.scb[ i ].name, ( sd[ i ].last_value.var_data == NULL ? "" : (char* ) base64_output ) );
-
-                                }
-                                break;
-                        }
-                        goto done;
-                    }
+            if( cs_find_entry( type, id, &entry ) == true ) {
+                /*
+                 * Register / deregister an observer before the response is built from the request
+                 */
+                observer = coap_observe_request( msg, coap_cd, type, entry, coap_notify_control_cs_ctrl );
+                response = coap_notify_control_cs_ctrl( msg, type, entry, response_type );
+                coap_observe_response( msg, observer, response );
+                return response;
             }
             /*
              * Failed to find ID
              */
             sprintf( json_out, "{ \"id\" : %lu, \"value\" : \"Not_Found\" }", id );
-done:
 
             // else Respond to unicast with VALID(successfully did nothing).
             if( coap_store_response_header( msg, VALID, response_type, NULL )  != WICED_SUCCESS ) {
@@ -258,6 +202,62 @@ done:
     }
     return COAP_SEND_RESPONSE;
 }
+/**
+  * @brief  Build the response holding the name and current value of a control / sensor - used for the GET and Observe notifications
+  * @param  msg holding the token of the request, type, entry, response type
+  * @retval : COAP_SEND_RESPONSE / COAP_NO_RESPONSE
+  */
+uint16_t coap_notify_control_cs_ctrl( coap_message_t *msg, uint16_t type, uint16_t entry, uint16_t response_type )
+{
+    char json_out[ JSON_MAX_SIZE ];     // Allocate this from heap later
+    char base64_output[ BASE64_MAX_LENGTH ];
+    int32_t result;
+    imx_control_sensor_block_t *csb;
+    control_sensor_data_t *csd;
+
+    if( type == IMX_CONTROLS ) {
+        csb = &device_config.ccb[ entry ];
+        csd = &cd[ entry ];
+    } else {
+        csb = &device_config.scb[ entry ];
+        csd = &sd[ entry ];
+    }
+    switch( csb->data_type ) {
+        case IMX_UINT32 :
+            sprintf( json_out, "{ \"name\" : \"%s\", \"uint_value\" : %lu }", csb->name, csd->last_value.uint_32bit );
+            break;
+        case IMX_INT32 :
+            sprintf( json_out, "{ \"name\" : \"%s\", \"int_value\" : %ld }", csb->name, csd->last_value.uint_32bit );
+            break;
+        case IMX_FLOAT :
+            sprintf( json_out, "{ \"name\" : \"%s\", \"float_value\" : %f }", csb->name, csd->last_value.float_32bit );
+            break;
+        case IMX_VARIABLE_LENGTH :
+        default :
+            base64_output[ 0 ] = 0x00;
+            if( ( csd->last_value.var_data != NULL ) && ( csd->last_value.var_data->length > 0 ) ) {
+                result = base64_encode( (unsigned char* ) csd->last_value.var_data->data, csd->last_value.var_data->length,
+                        (unsigned char*) base64_output, BASE64_MAX_LENGTH, BASE64_STANDARD );
+                if( result < 0 ) {
+                    /*
+                     * Error
+                     */
+                    if( coap_store_response_header( msg, REQUEST_ENTITY_TOO_BIG, response_type, NULL )  != WICED_SUCCESS ) {
+                        PRINTF( "Failed to create response.\r\n" );
+                        return COAP_NO_RESPONSE;
+                    }
+                    return COAP_SEND_RESPONSE;
+                }
+            }
+            sprintf( json_out, "{ \"name\" : \"%s\", \"var_value\" : \"%s\" }", csb->name, base64_output );
+            break;
+    }
+    if ( coap_store_response_data( msg, CONTENT, response_type, json_out, JSON_MEDIA_TYPE ) != WICED_SUCCESS ) {
+        PRINTF( "Failed to create response.\r\n" );
+        return COAP_NO_RESPONSE;
+    }
+    return COAP_SEND_RESPONSE;
+}
 
 /**
  * Set the control with "id":??? to "value":???
@@ -312,12 +312,12 @@ uint16_t coap_post_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_
     /*
      * Process the passed URI Query
      */
-    if( strlen( coap_cd->uri_query ) > 0 ) {
+    if( coap_cd->no_uri_query_segments > 0 ) {
         PRINTF( "Query string sent to coap_post_control_cs_ctrl instead of JSON object.\r\n");
         response_code = BAD_REQUEST;
         goto create_response_and_exit;
     }
-    PRINTF( "URI Query: %s\r\n", coap_cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( coap_cd ) );
     PRINTF( "URI Payload: %s\r\n", coap_cd->payload );
 
     json_read_object( coap_cd->payload, json_attrs, NULL );
@@ -327,77 +327,76 @@ uint16_t coap_post_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *coap_
      * Scan array for entry
      */
     PRINTF( "Updating: %lu, 0x%08lx - to: %lu, %ld, %f\r\n", id, id, uint_value, int_value, float_value );
-    for( i = 0; i < device_config.no_controls; i++ )
-        if( device_config.ccb[ i ].id == id ) {
-            switch( device_config.ccb[ i ].data_type ) {
-                case IMX_UINT32 :
-                    if( uint_value != NO_VALUE_VALUE ) {
-                        if( imx_set_control_sensor( IMX_CONTROLS,  i, &uint_value ) != IMX_SUCCESS ) {
-                            response_code = BAD_REQUEST;
-                            goto create_response_and_exit;
-                        }
-                    } else {
+    if( cs_find_entry( IMX_CONTROLS, id, &i ) == true ) {
+        switch( device_config.ccb[ i ].data_type ) {
+            case IMX_UINT32 :
+                if( uint_value != NO_VALUE_VALUE ) {
+                    if( imx_set_control_sensor( IMX_CONTROLS,  i, &uint_value ) != IMX_SUCCESS ) {
                         response_code = BAD_REQUEST;
                         goto create_response_and_exit;
                     }
-                    break;
-                case IMX_INT32 :
-                    if( int_value != NO_VALUE_VALUE ) {
-                        if( imx_set_control_sensor( IMX_CONTROLS,  i, &int_value ) != IMX_SUCCESS ) {
-                            response_code = BAD_REQUEST;
-                            goto create_response_and_exit;
-                        }
-                    } else {
+                } else {
+                    response_code = BAD_REQUEST;
+                    goto create_response_and_exit;
+                }
+                break;
+            case IMX_INT32 :
+                if( int_value != NO_VALUE_VALUE ) {
+                    if( imx_set_control_sensor( IMX_CONTROLS,  i, &int_value ) != IMX_SUCCESS ) {
                         response_code = BAD_REQUEST;
                         goto create_response_and_exit;
                     }
-                    break;
-                case IMX_FLOAT :
-                    if( float_value != NO_FLOAT_VALUE ) {
-                        if( imx_set_control_sensor( IMX_CONTROLS,  i, &float_value ) != IMX_SUCCESS ) {
-                            response_code = BAD_REQUEST;
-                            goto create_response_and_exit;
-                        }
-                    } else {
+                } else {
+                    response_code = BAD_REQUEST;
+                    goto create_response_and_exit;
+                }
+                break;
+            case IMX_FLOAT :
+                if( float_value != NO_FLOAT_VALUE ) {
+                    if( imx_set_control_sensor( IMX_CONTROLS,  i, &float_value ) != IMX_SUCCESS ) {
                         response_code = BAD_REQUEST;
                         goto create_response_and_exit;
-
                     }
-                    break;
-                case IMX_VARIABLE_LENGTH :
+                } else {
+                    response_code = BAD_REQUEST;
+                    goto create_response_and_exit;
+
+                }
+                break;
+            case IMX_VARIABLE_LENGTH :
+                /*
+                 * Convert base 64 to binary
+                 */
+                result = base64_decode( (unsigned char* ) string_value, strlen( string_value ), (unsigned char* ) base64_result, BASE64_MAX_LENGTH, BASE64_STANDARD );
+                if( result < 0 ) {
                     /*
-                     * Convert base 64 to binary
+                     * Error
                      */
-                    result = base64_decode( (unsigned char* ) string_value, strlen( string_value ), (unsigned char* ) base64_result, BASE64_MAX_LENGTH, BASE64_STANDARD );
-                    if( result < 0 ) {
-                        /*
-                         * Error
-                         */
-                        if( coap_store_response_header( msg, REQUEST_ENTITY_TOO_BIG, response_type, NULL )  != WICED_SUCCESS ) {
-                            PRINTF( "Failed to create response.\r\n" );
-                            return COAP_NO_RESPONSE;
-                        }
+                    if( coap_store_response_header( msg, REQUEST_ENTITY_TOO_BIG, response_type, NULL )  != WICED_SUCCESS ) {
+                        PRINTF( "Failed to create response.\r\n" );
+                        return COAP_NO_RESPONSE;
                     }
-                    value.var_data = imx_get_var_data( result );
-                    if( value.var_data != NULL ) {
-                        memcpy( value.var_data->data, base64_result, result );
-                        value.var_data->length = result; // Add space for the NULL - all data is returned 0 from allocation routine
-                        imx_status = imx_set_control_sensor( IMX_CONTROLS,  i, &value );
-                        imx_add_var_free_pool( value.var_data );
-                        if( imx_status != IMX_SUCCESS ) {
-                            response_code = BAD_REQUEST;
-                            goto create_response_and_exit;
-                        }
-                    } else {
-                        response_code = SERVICE_UNAVAILABLE;
+                }
+                value.var_data = imx_get_var_data( result );
+                if( value.var_data != NULL ) {
+                    memcpy( value.var_data->data, base64_result, result );
+                    value.var_data->length = result; // Add space for the NULL - all data is returned 0 from allocation routine
+                    imx_status = imx_set_control_sensor( IMX_CONTROLS,  i, &value );
+                    imx_add_var_free_pool( value.var_data );
+                    if( imx_status != IMX_SUCCESS ) {
+                        response_code = BAD_REQUEST;
                         goto create_response_and_exit;
-
                     }
+                } else {
+                    response_code = SERVICE_UNAVAILABLE;
+                    goto create_response_and_exit;
 
-                    break;
-            }
-            goto done;
+                }
+
+                break;
         }
+        goto done;
+    }
     /*
      * Failed to find id
      */
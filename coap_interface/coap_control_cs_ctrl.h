@@ -64,5 +64,6 @@
  ******************************************************/
 uint16_t coap_post_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t arg);
 uint16_t coap_get_control_cs_ctrl(coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t arg);
+uint16_t coap_notify_control_cs_ctrl( coap_message_t *msg, uint16_t type, uint16_t entry, uint16_t response_type );
 
 #endif /* COAP_CONTROL_CS_CTRL_H_ */
@@ -57,13 +57,14 @@
 #include "coap_msg_get_store.h"
 #include "coap_control_securessid.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/icb_def.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -130,7 +131,7 @@ uint16_t coap_get_control_imatrix(coap_message_t *msg, CoAP_msg_detail_t *cd, ui
     }
 
     PRINTF( "Get Configuration - '/control/imatrix'\r\n");
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
 
     memset( buffer, 0x00, PRODUCT_ID_SN_BUFFER_LENGTH );
 
@@ -163,13 +164,13 @@ uint16_t coap_post_control_imatrix(coap_message_t *msg, CoAP_msg_detail_t *cd, u
     /*
      * Process the passed URI Query
      */
-    if( strlen( cd->uri_query ) > 0 ) {
+    if( cd->no_uri_query_segments > 0 ) {
         PRINTF( "Query string sent to coap_post_control_demand instead of JSON object.\r\n");
         response = BAD_REQUEST;     // No URI Query supported
         goto bad_data;
     }
 
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
     PRINTF( "URI Payload: %s\r\n", cd->payload );
 
     /*
@@ -52,14 +52,15 @@
 #include "coap_msg_get_store.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../storage.h"
 #include "coap_control_otaupdate.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -103,12 +104,14 @@ uint16_t coap_post_control_otaupdate(coap_message_t *msg, CoAP_msg_detail_t *cd,
     int port;
     int result;
     int checksum32;
+    bool delta;
     struct json_attr_t json_attrs[] = {
             {"site",  t_string, .addr.string = site, .len = IMX_IMATRIX_SITE_LENGTH },// Strings default to empty string ""
             {"uri",  t_string, .addr.string = uri, .len = IMX_IMATRIX_URI_LENGTH },
             {"port", t_integer, .addr.integer = &port, .dflt.integer = 80 },
             {"image_no", t_integer, .addr.integer = &image_no, .dflt.integer = NO_IMAGE_NO },
 			{"cksum", t_integer, .addr.integer = &checksum32, .dflt.integer = (long int)IGNORE_CHECKSUM32 },// initially tried using t_uinteger, but that is only a 31 bit integer.
+            {"delta", t_boolean, .addr.boolean = &delta, .dflt.boolean = false },// uri is a patch against image_no, the installed application
             {NULL}
     };
     uint16_t response;
@@ -117,12 +120,12 @@ uint16_t coap_post_control_otaupdate(coap_message_t *msg, CoAP_msg_detail_t *cd,
     /*
      * Process the passed URI Query
      */
-    if( strlen( cd->uri_query ) > 0 ) {
+    if( cd->no_uri_query_segments > 0 ) {
         printf("URI query is invalid.\r\n");
         response = BAD_REQUEST;     // No URI Query supported
         goto bad_data;
     }
-    printf( "URI Query: %s\r\n", cd->uri_query );
+    printf( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
     printf( "URI Payload: %s\r\n", cd->payload );
 
     result = json_read_object( cd->payload, json_attrs, NULL );
@@ -172,7 +175,10 @@ uint16_t coap_post_control_otaupdate(coap_message_t *msg, CoAP_msg_detail_t *cd,
      *
      */
 
-    setup_ota_loader( site, uri, (uint16_t)port, image_no, true );
+    if( delta == true )
+        setup_ota_delta( site, uri, (uint16_t)port, image_no );
+    else
+        setup_ota_loader( site, uri, (uint16_t)port, image_no, true );
 
     if( msg->header.t == CONFIRMABLE ) {
         if( coap_store_response_header( msg, CHANGED, ACKNOWLEDGEMENT, NULL )  != WICED_SUCCESS ) {
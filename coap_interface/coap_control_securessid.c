@@ -57,14 +57,15 @@
 #include "coap_msg_get_store.h"
 #include "coap_control_securessid.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/icb_def.h"
 
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -130,7 +131,7 @@ uint16_t coap_get_control_securessid(coap_message_t *msg, CoAP_msg_detail_t *cd,
     }
 
     imx_printf( "Get Configuration - '/control/securessid'\r\n");
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
 
     memset( buffer, 0x00, SSID_OUTPUT_BUFFER_LENGTH );
 
@@ -190,12 +191,12 @@ uint16_t coap_post_control_securessid(coap_message_t *msg, CoAP_msg_detail_t *cd
     /*
      * Process the passed URI Query
      */
-    if( strlen( cd->uri_query ) > 0 ) {
+    if( cd->no_uri_query_segments > 0 ) {
         PRINTF( "Query string sent to coap_post_control_securessid instead of JSON object.\r\n");
         response_code = BAD_REQUEST;
         goto create_response_and_exit;
     }
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
     PRINTF( "URI Payload: %s\r\n", cd->payload );
 
     result = json_read_object( cd->payload, json_attrs, NULL );
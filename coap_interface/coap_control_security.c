@@ -61,14 +61,15 @@
 #include "coap_msg_get_store.h"
 #include "coap_control_security.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/icb_def.h"
 #include "../storage.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -142,9 +143,9 @@ uint16_t coap_get_control_security(coap_message_t *msg, CoAP_msg_detail_t *cd, u
     }
 
     PRINTF( "Get Configuration - '/control/security'\r\n");
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
 
-    if ( WICED_SUCCESS != imx_get_uint_from_query_str( "cert_type", &cert_type, cd->uri_query ) ) {// Require ID
+    if ( WICED_SUCCESS != imx_get_uint_from_query_str( "cert_type", &cert_type, coap_uri_query_string( cd ) ) ) {// Require ID
         if( coap_store_response_header( msg, BAD_REQUEST, response_type, NULL )  != WICED_SUCCESS ) {
     		PRINTF( "Failed to create response.\r\n" );
         }
@@ -274,12 +275,12 @@ uint16_t coap_post_control_security(coap_message_t *msg, CoAP_msg_detail_t *cd,
     /*
      * Process the passed URI Query
      */
-    if( ( strlen( cd->uri_query ) > 0 ) || cd->payload_length < MIN_CERT_LENGTH ) {
+    if( ( cd->no_uri_query_segments > 0 ) || cd->payload_length < MIN_CERT_LENGTH ) {
         PRINTF( "Query string sent to coap_post_control_securessid instead of Binary object.\r\n");
         response_code = BAD_REQUEST;
         goto create_response_and_exit;
     }
-    PRINTF( "URI Query: %s\r\n", cd->uri_query );
+    PRINTF( "URI Query: %s\r\n", coap_uri_query_string( cd ) );
     PRINTF( "URI Payload: %s\r\n", cd->payload );
 
     /*
@@ -49,6 +49,7 @@
 #include "../CoAP/coap.h"
 #include "../CoAP/add_coap_option.h"
 #include "../CoAP/que_manager.h"
+#include "../CoAP/coap_block.h"
 #include "../CoAP_interface/imx_get_uint_from_query_str.h"
 #include "../device/icb_def.h"
 #include "../ota_loader/ota_loader.h"
@@ -68,13 +69,14 @@
 #include "coap_sensor_rssi.h"
 #include "token_string.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../storage.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_COAP_DEFINES
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_COAP_DEFINES )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_COAP_DEFINES ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_COAP_DEFINES, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -113,7 +115,7 @@ extern IOT_Device_Config_t device_config;   // Defined in storage.h
  *               Variable Definitions
  ******************************************************/
 // NO_COAP_ENTRIES defined in coap.c
-CoAP_entry_t CoAP_entries[ NO_IMATRIX_COAP_ENTRIES ] = // The structure must be fully initialized and ALL URI's are sorted in alphabetical sequence
+CoAP_entry_t CoAP_entries[ NO_IMATRIX_COAP_ENTRIES ] = // The structure must be fully initialized - lookups use the sorted index built in match_uri.c
 {
    {
        .header.next = NULL,
@@ -264,7 +266,6 @@ CoAP_entry_t CoAP_entries[ NO_IMATRIX_COAP_ENTRIES ] = // The structure must be
 
 uint16_t get_well_known(coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t arg)
 {
-    UNUSED_PARAMETER( cd );
     UNUSED_PARAMETER( arg );
 
     if ( msg == NULL ) {
@@ -273,8 +274,10 @@ uint16_t get_well_known(coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t arg
     }
 
     uint16_t payload_index = 1080;// Suggest a minimum number of bytes for the message_t struct's data block.
-    uint16_t i;
+    uint16_t i, length;
     uint16_t response_type = NON_CONFIRMABLE; // Unless the request type is Confirmable.
+    char link[ MAX_URI_LENGTH ];
+    coap_block_writer_t bw;
 
     if ( msg->header.t == CONFIRMABLE ) {// Piggy back the response on an Acknowledgment.
         response_type = ACKNOWLEDGEMENT;
@@ -288,25 +291,29 @@ uint16_t get_well_known(coap_message_t *msg, CoAP_msg_detail_t *cd, uint16_t arg
 		PRINTF( "Failed to create response.\r\n" );
 		return COAP_NO_RESPONSE;
 	}
-
+	/*
+	 * The whole list is produced each time, only the Block2 block asked for is kept
+	 */
+	coap_block2_writer_init( &bw, cd );
     for( i = 0; i < NO_IMATRIX_COAP_ENTRIES; i++ ) {
 
     	char* comma = "";
     	if ( i > 0 )
     	    comma = ",";
 
-        if ( coap_append_response_payload_using_printf( LINK_MEDIA_TYPE, msg,
-        		"%s<%s>;title=\"%s\";rt=\"%s\";if=\"%s\"", comma,
+        length = snprintf( link, MAX_URI_LENGTH, "%s<%s>;title=\"%s\";rt=\"%s\";if=\"%s\"", comma,
         		CoAP_entries[ i ].node.uri, CoAP_entries[ i ].node.att.title,
-        		CoAP_entries[ i ].node.att.rt, CoAP_entries[ i ].node.att.if_desc  ) != WICED_SUCCESS )
-        {
-        	break;// Skip any that don't fit in the message.
+        		CoAP_entries[ i ].node.att.rt, CoAP_entries[ i ].node.att.if_desc );
+        if ( length >= MAX_URI_LENGTH )
+            length = MAX_URI_LENGTH - 1;
+        if ( coap_block2_write( msg, &bw, LINK_MEDIA_TYPE, (uint8_t *) link, length ) != WICED_SUCCESS ) {
+        	PRINTF( "Failed to add link to response.\r\n" );
+        	return COAP_NO_RESPONSE;
         }
     }
-
-    char* payload = coap_msg_payload( msg );
-    if ( payload != NULL ) {
-        PRINTF( "Sending Well Known response '%s'\r\n", payload );
+    if ( coap_block2_writer_finish( msg, &bw ) != WICED_SUCCESS ) {
+        if ( coap_store_response_data( msg, BAD_OPTION, response_type, "Block out of range.", TEXT_MEDIA_TYPE ) != WICED_SUCCESS )
+            return COAP_NO_RESPONSE;
     }
 
     return COAP_SEND_RESPONSE;
@@ -47,14 +47,15 @@
 #include "coap_msg_get_store.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../storage.h"
 
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_BASIC_MESSAGING
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_BASIC_MESSAGING )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_BASIC_MESSAGING ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_BASIC_MESSAGING, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
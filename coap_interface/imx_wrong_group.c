@@ -49,7 +49,8 @@ int imx_wrong_group( CoAP_msg_detail_t *cd )
 {
     uint16_t group = 0;
 
-    if ( WICED_SUCCESS != imx_get_uint_from_query_str( "group", &group, cd->uri_query ) ) {
+    if ( ( cd->no_uri_query_segments == 0 ) ||
+         ( WICED_SUCCESS != imx_get_uint_from_query_str( "group", &group, coap_uri_query_string( cd ) ) ) ) {
         if ( WICED_SUCCESS != imx_get_group_from_json( cd->payload, cd->payload_length, &group ) ) {
             return false; // no group found means no groups are being excluded -- Group OK
         }
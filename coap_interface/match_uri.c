@@ -34,14 +34,17 @@
  *
  */
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "wiced.h"
 
 #include "../CoAP/coap.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../cli/messages.h"
 #include "../device/icb_def.h"
 #include "coap_def.h" // coap_def.c creates the global array CoAP_entries[]
+#include "match_uri.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
 #include "../storage.h"
@@ -59,9 +62,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_RECV
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_RECV )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_RECV ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_RECV, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -90,6 +93,13 @@
  *               Variable Definitions
  ******************************************************/
 extern IOT_Device_Config_t device_config;   // Defined in storage.h
+extern iMatrix_Control_Block_t icb;
+extern CoAP_entry_t CoAP_entries[];         // Defined in coap_def.c.
+/*
+ * Dispatch index - iMatrix and Host entries sorted by uri, iMatrix entries ahead of Host entries with the same uri
+ */
+static CoAP_entry_t **uri_index = NULL;
+static uint16_t no_uri_index_entries = 0;
 
 /******************************************************
  *               Function Definitions
@@ -132,3 +142,106 @@ CoAP_entry_t* match_uri(char* uri, CoAP_entry_t* all_entries, int arSize)
         }
     }
 }
+
+/**
+  * @brief  Build the sorted dispatch index over the iMatrix and Host CoAP entries.
+  *         Called when the Host sets its entries, or on first use if it never does.
+  *         The index only holds pointers, the tables themselves are not reordered.
+  * @param  None
+  * @retval : None
+  */
+void build_uri_index(void)
+{
+    uint16_t i, j, no_entries;
+    CoAP_entry_t *entry;
+
+    if( uri_index != NULL ) {
+        free( uri_index );
+        uri_index = NULL;
+    }
+    no_uri_index_entries = 0;
+    no_entries = NO_IMATRIX_COAP_ENTRIES;
+    if( icb.coap_entries != NULL )
+        no_entries += icb.no_host_coap_entries;
+    uri_index = (CoAP_entry_t **) malloc( no_entries * sizeof( CoAP_entry_t * ) );
+    if( uri_index == NULL ) {
+        imx_printf( "Unable to allocate CoAP uri index - using linear search\r\n" );
+        return;
+    }
+    /*
+     * Insertion sort - stable, so iMatrix entries stay ahead of any Host entry with the same uri
+     */
+    for( i = 0; i < no_entries; i++ ) {
+        entry = ( i < NO_IMATRIX_COAP_ENTRIES ) ? &CoAP_entries[ i ] : &icb.coap_entries[ i - NO_IMATRIX_COAP_ENTRIES ];
+        for( j = no_uri_index_entries; ( j > 0 ) && ( strcmp( uri_index[ j - 1 ]->node.uri, entry->node.uri ) > 0 ); j-- )
+            uri_index[ j ] = uri_index[ j - 1 ];
+        uri_index[ j ] = entry;
+        no_uri_index_entries += 1;
+    }
+    PRINTF( "CoAP uri index built with %u entries\r\n", no_uri_index_entries );
+}
+
+/**
+  * @brief  Compare the uri held as Uri-Path segments in a message with a uri string, same ordering as strcmp
+  * @param  message detail, uri
+  * @retval : < 0, 0, > 0 as message uri is less than, equal to or greater than uri
+  */
+int16_t compare_uri( CoAP_msg_detail_t *cd, char *uri )
+{
+    uint16_t i, j;
+    uint8_t *segment;
+
+    for( i = 0; i < cd->no_uri_segments; i++ ) {
+        if( *uri != '/' )
+            return (int16_t) '/' - (int16_t) (uint8_t) *uri;
+        uri++;
+        segment = &cd->option_data[ cd->uri_segment[ i ].offset ];
+        for( j = 0; j < cd->uri_segment[ i ].length; j++ ) {
+            if( segment[ j ] != (uint8_t) *uri )
+                return (int16_t) segment[ j ] - (int16_t) (uint8_t) *uri;
+            uri++;
+        }
+    }
+    return ( *uri == 0x00 ) ? 0 : -1;
+}
+
+/**
+  * @brief  Find the entry for the uri in a processed message - binary search of the dispatch index
+  * @param  message detail
+  * @retval : pointer to entry or NULL if not found
+  */
+CoAP_entry_t *match_uri_segments( CoAP_msg_detail_t *cd )
+{
+    uint16_t low, high, mid;
+    CoAP_entry_t *entry;
+
+    if( uri_index == NULL )
+        build_uri_index();
+    if( uri_index == NULL ) {
+        /*
+         * No index - fall back to searching the tables
+         */
+        entry = match_uri( coap_uri_string( cd ), CoAP_entries, NO_IMATRIX_COAP_ENTRIES );
+        if( entry == NULL )
+            entry = match_uri( coap_uri_string( cd ), icb.coap_entries, icb.no_host_coap_entries );
+        return entry;
+    }
+    /*
+     * Find the first entry not less than the uri
+     */
+    low = 0;
+    high = no_uri_index_entries;
+    while( low < high ) {
+        mid = low + ( ( high - low ) / 2 );
+        if( compare_uri( cd, uri_index[ mid ]->node.uri ) > 0 )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if( ( low < no_uri_index_entries ) && ( compare_uri( cd, uri_index[ low ]->node.uri ) == 0 ) ) {
+        PRINTF( "Found %s.\r\n", uri_index[ low ]->node.uri );
+        return uri_index[ low ];
+    }
+    PRINTF( "Did not find %s.\r\n", coap_uri_string( cd ) );
+    return NULL;
+}
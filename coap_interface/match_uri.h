@@ -63,5 +63,8 @@
  ******************************************************/
 
 CoAP_entry_t* match_uri(char* uri, CoAP_entry_t* all_entries, int arSize);
+void build_uri_index(void);
+int16_t compare_uri( CoAP_msg_detail_t *cd, char *uri );
+CoAP_entry_t *match_uri_segments( CoAP_msg_detail_t *cd );
 
 #endif /* MATCH_URI_H_ */
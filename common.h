@@ -316,8 +316,13 @@ typedef struct var_data_entry {
 } var_data_entry_t;
 
 typedef struct var_data_block {
-    var_data_entry_t *head;
-    var_data_entry_t *tail;
+    var_data_entry_t *head;                 // Free list, last freed is first reused
+    uint16_t no_entries;
+    uint16_t no_free;
+    uint16_t high_water;                    // Most entries in use at one time
+    uint16_t reserved;
+    uint32_t allocations;
+    uint32_t failures;                      // Requests for this size class that could not be met from any pool
 } imx_var_data_block_t;
 /*
  * Define generic 32 bit data or pointer to variable length record
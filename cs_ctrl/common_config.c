@@ -37,6 +37,7 @@
 
 #include "../storage.h"
 #include "../cli/interface.h"
+#include "cs_index.h"
 
 /******************************************************
  *                      Macros
@@ -104,6 +105,7 @@ void cs_reset_defaults(void)
 //            print_csb_entry( type, csb, i );
         }
     }
+    cs_build_index();
 }
 /**
  *  @brief  initialize the controls & sensors system
@@ -150,6 +152,7 @@ void cs_init(void)
             }
         }
     }
+    cs_build_index();
 }
 
 /**
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file cs_index.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Index of Control and Sensor IDs. CoAP requests and spill records name a control or sensor by its iMatrix ID, this
+ *  open addressed hash table finds its entry in ccb[] / scb[] without scanning them. Each slot holds only the type
+ *  and entry, the ID is compared in the control sensor block itself. The table is kept at least half empty so
+ *  linear probing stays short. It is rebuilt by cs_reset_defaults(), cs_init() and imatrix_load_config(), the only
+ *  places the tables change.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../cli/interface.h"
+#include "cs_index.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define CS_INDEX_HASH( id )     ( (uint16_t) ( ( (uint32_t) ( id ) * 2654435761UL ) >> ( 32 - CS_INDEX_BITS ) ) )
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#if ( IMX_MAX_NO_CONTROLS + IMX_MAX_NO_SENSORS ) <= 32
+#define CS_INDEX_BITS           ( 6 )
+#elif ( IMX_MAX_NO_CONTROLS + IMX_MAX_NO_SENSORS ) <= 64
+#define CS_INDEX_BITS           ( 7 )
+#elif ( IMX_MAX_NO_CONTROLS + IMX_MAX_NO_SENSORS ) <= 128
+#define CS_INDEX_BITS           ( 8 )
+#elif ( IMX_MAX_NO_CONTROLS + IMX_MAX_NO_SENSORS ) <= 256
+#define CS_INDEX_BITS           ( 9 )
+#else
+#define CS_INDEX_BITS           ( 10 )
+#endif
+#define CS_INDEX_SIZE           ( 1 << CS_INDEX_BITS )  // At least twice the number of controls and sensors
+#define CS_INDEX_EMPTY          ( 0xFFFF )
+#define CS_INDEX_SENSOR         ( 0x8000 )              // Slot is a sensor entry, otherwise a control
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static void add_entry( imx_peripheral_type_t type, uint16_t entry );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern IOT_Device_Config_t device_config;
+
+static uint16_t cs_index[ CS_INDEX_SIZE ];
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Rebuild the index from the control and sensor blocks
+  * @param  None
+  * @retval : None
+  */
+void cs_build_index(void)
+{
+    uint16_t i;
+
+    memset( cs_index, 0xFF, sizeof( cs_index ) );   // All CS_INDEX_EMPTY
+    for( i = 0; ( i < device_config.no_controls ) && ( i < IMX_MAX_NO_CONTROLS ); i++ )
+        add_entry( IMX_CONTROLS, i );
+    for( i = 0; ( i < device_config.no_sensors ) && ( i < IMX_MAX_NO_SENSORS ); i++ )
+        add_entry( IMX_SENSORS, i );
+}
+/**
+  * @brief  Find the entry of a control / sensor ID
+  * @param  type, id, entry found
+  * @retval : true if found
+  */
+bool cs_find_entry( imx_peripheral_type_t type, uint32_t id, uint16_t *entry )
+{
+    uint16_t slot, i;
+    imx_control_sensor_block_t *csb;
+
+    slot = CS_INDEX_HASH( id );
+    for( i = 0; i < CS_INDEX_SIZE; i++ ) {
+        if( cs_index[ slot ] == CS_INDEX_EMPTY )
+            return false;
+        if( ( ( cs_index[ slot ] & CS_INDEX_SENSOR ) != 0 ) == ( type == IMX_SENSORS ) ) {
+            csb = ( type == IMX_CONTROLS ) ? &device_config.ccb[ 0 ] : &device_config.scb[ 0 ];
+            if( csb[ cs_index[ slot ] & ~CS_INDEX_SENSOR ].id == id ) {
+                *entry = cs_index[ slot ] & ~CS_INDEX_SENSOR;
+                return true;
+            }
+        }
+        slot = ( slot + 1 ) & ( CS_INDEX_SIZE - 1 );
+    }
+    return false;
+}
+/**
+  * @brief  Add an entry in the first free slot from its hash
+  * @param  type, entry
+  * @retval : None
+  */
+static void add_entry( imx_peripheral_type_t type, uint16_t entry )
+{
+    uint16_t slot;
+    uint32_t id;
+
+    id = ( type == IMX_CONTROLS ) ? device_config.ccb[ entry ].id : device_config.scb[ entry ].id;
+    slot = CS_INDEX_HASH( id );
+    while( cs_index[ slot ] != CS_INDEX_EMPTY )     // Never more than half full, always finds a free slot
+        slot = ( slot + 1 ) & ( CS_INDEX_SIZE - 1 );
+    cs_index[ slot ] = entry | ( ( type == IMX_SENSORS ) ? CS_INDEX_SENSOR : 0 );
+}
@@ -47,18 +47,23 @@
 #include "../storage.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/config.h"
 #include "../device/icb_def.h"
 #include "../device/var_data.h"
 #include "../time/ck_time.h"
+#include "../coap/coap.h"
+#include "../coap/coap_observe.h"
 #include "hal_sample.h"
 #include "hal_event.h"
+#include "hal_history.h"
+#include "hal_spill.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_EVENTS_DRIVEN
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_EVENTS_DRIVEN )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_EVENTS_DRIVEN ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_EVENTS_DRIVEN, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -110,6 +115,7 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
 	wiced_time_t current_time;
 	wiced_utc_time_t upload_utc_time;
 	var_data_entry_t *var_data;
+	imx_data_32_t event_value;
 
 	wiced_time_get_time( &current_time );
 
@@ -130,17 +136,17 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
 	}
 	PRINTF( "Event - Setting %s %u Data @: 0x%08lx\r\n", type == IMX_CONTROLS ? "Control" : "Sensor", entry, (uint32_t) &csd[ entry ] );
     /*
-     * Check for overflow - Save only the last sample values
+     * Check for overflow - Move the oldest events to the flash spill log, if that is not possible save only the last sample values
      */
-    if( csd[ entry ].no_samples >= ( device_config.history_size - 2 ) ) {
+    if( ( csd[ entry ].no_samples >= ( device_config.history_size - 2 ) ) &&
+        ( spill_history( type, &csb[ entry ], &csd[ entry ] ) == false ) ) {
         PRINTF( "History Full - dropping last sample\r\n" );
         /*
          * If item is variable length - free before overwrite
          */
         if( csb[ entry ].data_type == IMX_VARIABLE_LENGTH )
-            imx_add_var_free_pool( csd[ entry ].data[ 0 ].var_data );
-        memmove( &csd[ entry ].data[ 0 ], &csd[ entry ].data[ 2 ], ( device_config.history_size - 2 ) * IMX_SAMPLE_LENGTH );
-        csd[ entry ].no_samples -= 2;
+            imx_add_var_free_pool( history_entry( &csd[ entry ], 1 )->var_data );
+        history_drop_oldest( &csd[ entry ], 2 );
     }
 	/*
 	 * Event Driven saves Time Stamp & Value pair
@@ -150,7 +156,6 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
     } else
         upload_utc_time = 0;        // Tell iMatrix to assign
 
-    memcpy( &csd[ entry ].data[ csd[ entry ].no_samples ],  &upload_utc_time, IMX_SAMPLE_LENGTH );
     /*
      * Add Data
      */
@@ -167,32 +172,23 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
              */
             return;
         }
-        csd[ entry ].no_samples += 1;
-        csd[ entry ].data[ csd[ entry ].no_samples ].var_data = var_data;
-        PRINTF( "Got entry, Var data @ 0x%08lx, data ptr @ 0x%08lx\r\n",
-                (uint32_t) csd[ entry ].data[ csd[ entry ].no_samples ].var_data, (uint32_t) csd[ entry ].data[ csd[ entry ].no_samples ].var_data->data );
+        PRINTF( "Got entry, Var data @ 0x%08lx, data ptr @ 0x%08lx\r\n", (uint32_t) var_data, (uint32_t) var_data->data );
         /*
          * Copy the data from the passed variable data
          */
-        PRINTF( "Copying new variable length data to record: %u, %u Bytes\r\n",  csd[ entry ].no_samples, ((imx_data_32_t *) value)->var_data->length );
-        memcpy( (char *) csd[ entry ].data[ csd[ entry ].no_samples ].var_data->data, (char *) ((imx_data_32_t *) value)->var_data->data, ((imx_data_32_t *) value)->var_data->length );
-        csd[ entry ].data[ csd[ entry ].no_samples ].var_data->length = ((imx_data_32_t *) value)->var_data->length;
-        PRINTF( "Sample: %u, data: 0x%08x\r\n", csd[ entry ].no_samples, (uint32_t) csd[ entry ].data[ csd[ entry ].no_samples ].var_data );
-#ifdef PRINT_DEBUGS_FOR_EVENTS_DRIVEN
-    if( ( device_config.log_messages & DEBUGS_FOR_EVENTS_DRIVEN ) != 0x00 ) {
-        imx_printf( "Event Added Data History now contains: %u Event Samples\r\n", (csd[ entry ].no_samples + 1 ) / 2 );   // 2 samples per event..
-        for( i = 0; i < (csd[ entry ].no_samples ); i += 2 )
-            imx_printf( "Sample: %u, time: %lu, data: 0x%08x\r\n", i, csd[ entry ].data[ i ].uint_32bit, csd[ entry ].data[ i + 1 ].uint_32bit );
-    }
-#endif
-
+        PRINTF( "Copying new variable length data to record: %u, %u Bytes\r\n",  csd[ entry ].no_samples + 1, ((imx_data_32_t *) value)->var_data->length );
+        memcpy( (char *) var_data->data, (char *) ((imx_data_32_t *) value)->var_data->data, ((imx_data_32_t *) value)->var_data->length );
+        var_data->length = ((imx_data_32_t *) value)->var_data->length;
+        event_value.var_data = var_data;
     } else {
         /*
          * All Other Data is really just 32 bit
          */
-        csd[ entry ].no_samples += 1;
-        memcpy( &csd[ entry ].data[ csd[ entry ].no_samples ].uint_32bit, value, IMX_SAMPLE_LENGTH );
+        memcpy( &event_value.uint_32bit, value, IMX_SAMPLE_LENGTH );
     }
+    history_add( &csd[ entry ], (uint32_t) upload_utc_time );
+    history_add( &csd[ entry ], event_value.uint_32bit );
+    PRINTF( "Sample: %u, data: 0x%08lx\r\n", csd[ entry ].no_samples - 1, event_value.uint_32bit );
 
     /*
      * Check if the data is in warning levels for the sensor
@@ -208,18 +204,18 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
         if( ( csb[ entry ].use_warning_level_low & ( 0x1 << ( i - IMX_WATCH ) ) ) != 0 )
             switch( csb[ entry ].data_type ) {
                 case IMX_INT32 :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].int_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].int_32bit )
+                    if( event_value.int_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].int_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
                 case IMX_FLOAT :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].float_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].float_32bit )
+                    if( event_value.float_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].float_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
                 case IMX_VARIABLE_LENGTH :
                     break;
                 case IMX_UINT32 :
                 default :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].uint_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].uint_32bit )
+                    if( event_value.uint_32bit < csb[ entry ].warning_level_low[ i - IMX_WATCH ].uint_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
             }
@@ -229,18 +225,18 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
         if( ( csb[ entry ].use_warning_level_high & ( 0x1 << ( i - IMX_WATCH ) ) ) != 0 )
             switch( csb[ entry ].data_type ) {
                 case IMX_INT32 :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].int_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].int_32bit )
+                    if( event_value.int_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].int_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
                 case IMX_FLOAT :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].float_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].float_32bit )
+                    if( event_value.float_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].float_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
                 case IMX_VARIABLE_LENGTH :
                     break;
                 case IMX_UINT32 :
                 default :
-                    if( csd[ entry ].data[ csd[ entry ].no_samples ].uint_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].uint_32bit )
+                    if( event_value.uint_32bit > csb[ entry ].warning_level_low[ i - IMX_WATCH ].uint_32bit )
                         csd[ entry ].warning = i;  // Now set to this level
                     break;
             }
@@ -252,18 +248,18 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
     if( csb[ entry ].send_on_percent_change == true ) {
         switch( csb[ entry ].data_type ) {
             case IMX_INT32 :
-                if( check_int_percent( csd[ entry ].data[ csd[ entry ].no_samples ].int_32bit, csd[ entry ].last_value.int_32bit, csb[ entry ].percent_change_to_send ) )
+                if( check_int_percent( event_value.int_32bit, csd[ entry ].last_value.int_32bit, csb[ entry ].percent_change_to_send ) )
                     percent_change_detected = true;
                 break;
             case IMX_FLOAT :
-                if( check_float_percent( csd[ entry ].data[ csd[ entry ].no_samples ].float_32bit, csd[ entry ].last_value.float_32bit, csb[ entry ].percent_change_to_send ) )
+                if( check_float_percent( event_value.float_32bit, csd[ entry ].last_value.float_32bit, csb[ entry ].percent_change_to_send ) )
                     percent_change_detected = true;
                 break;
             case IMX_VARIABLE_LENGTH :
                 break;
             case IMX_UINT32 :
             default :
-                if( check_uint_percent( csd[ entry ].data[ csd[ entry ].no_samples ].uint_32bit, csd[ entry ].last_value.uint_32bit, csb[ entry ].percent_change_to_send ) )
+                if( check_uint_percent( event_value.uint_32bit, csd[ entry ].last_value.uint_32bit, csb[ entry ].percent_change_to_send ) )
                     percent_change_detected = true;
                 break;
         }
@@ -272,9 +268,11 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
     /*
      * Done processing this item - its in the history and saved as current value
      */
-    csd[ entry ].no_samples += 1;
-
     csd[ entry ].last_sample_time = current_time;
+    /*
+     * Every event is a new value for any CoAP observers of this entry
+     */
+    coap_observe_changed( type, entry );
 
     PRINTF( "Event added\r\n" );
     /*
@@ -303,11 +301,11 @@ void hal_event( imx_peripheral_type_t type, uint16_t entry, void *value )
         csd[ entry ].last_error = csd[ entry ].error;
         csd[ entry ].send_on_error = true;
     }
-#ifdef PRINT_DEBUGS_FOR_EVENTS_DRIVEN
-    if( ( device_config.log_messages & DEBUGS_FOR_EVENTS_DRIVEN ) != 0x00 ) {
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_EVENTS_DRIVEN )
+    if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_EVENTS_DRIVEN ) ) {
         imx_printf( "Event Added Data History now contains: %u Event Samples\r\n", ( csd[ entry ].no_samples + 1 ) / 2 );   // 2 samples per event..
         for( i = 0; i < (csd[ entry ].no_samples ); i += 2 )
-            imx_printf( "Sample: %u, time: %lu, data: 0x%08x\r\n", i, csd[ entry ].data[ i ], csd[ entry ].data[ i + 1] );
+            imx_printf( "Sample: %u, time: %lu, data: 0x%08lx\r\n", i, history_entry( &csd[ entry ], i )->uint_32bit, history_entry( &csd[ entry ], i + 1 )->uint_32bit );
     }
 #endif
 
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file hal_history.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Circular sample history for Controls and Sensors. Replaces shifting the history up with memmove each time
+ *  an entry is dropped or uploaded. Entries are accessed by logical index, 0 being the oldest sample.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "hal_history.h"
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern IOT_Device_Config_t device_config;   // Defined in storage.h
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Empty the history for an entry
+  * @param  control / sensor data
+  * @retval : None
+  */
+void history_reset( control_sensor_data_t *csd )
+{
+    csd->start_index = 0;
+    csd->no_samples = 0;
+}
+/**
+  * @brief  Add a sample to the end of the history, if the history is full the oldest sample is overwritten
+  * @param  control / sensor data, value - its all just 32 bit data
+  * @retval : None
+  */
+void history_add( control_sensor_data_t *csd, uint32_t value )
+{
+    uint16_t index;
+
+    if( device_config.history_size == 0 )
+        return;
+    if( csd->no_samples >= device_config.history_size )
+        history_drop_oldest( csd, 1 );
+    index = csd->start_index + csd->no_samples;
+    if( index >= device_config.history_size )
+        index -= device_config.history_size;
+    csd->data[ index ].uint_32bit = value;
+    csd->no_samples += 1;
+}
+/**
+  * @brief  Return the entry at a logical position in the history, 0 is the oldest
+  * @param  control / sensor data, index
+  * @retval : pointer to entry
+  */
+imx_data_32_t *history_entry( control_sensor_data_t *csd, uint16_t index )
+{
+    uint32_t position;
+
+    position = (uint32_t) csd->start_index + index;
+    if( position >= device_config.history_size )
+        position -= device_config.history_size;
+    return &csd->data[ position ];
+}
+/**
+  * @brief  Drop the oldest entries from the history
+  * @param  control / sensor data, number of entries to drop
+  * @retval : None
+  */
+void history_drop_oldest( control_sensor_data_t *csd, uint16_t count )
+{
+    if( count >= csd->no_samples ) {
+        history_reset( csd );   // Start again at the base of the buffer
+        return;
+    }
+    csd->start_index += count;
+    if( csd->start_index >= device_config.history_size )
+        csd->start_index -= device_config.history_size;
+    csd->no_samples -= count;
+}
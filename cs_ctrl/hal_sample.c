@@ -48,9 +48,14 @@
 #include "../common.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/config.h"
 #include "../time/ck_time.h"
+#include "../coap/coap.h"
+#include "../coap/coap_observe.h"
 #include "hal_sample.h"
+#include "hal_history.h"
+#include "hal_spill.h"
 /******************************************************
  *                      Macros
  ******************************************************/
@@ -64,9 +69,9 @@
                     csd = &sd[ 0 ];                  \
                     f = &imx_sensor_functions[ 0 ]; \
                 }
-#ifdef PRINT_DEBUGS_FOR_SAMPLING
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SAMPLING )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_SAMPLING ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_SAMPLING, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -115,7 +120,8 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
 {
 	uint16_t i, *active;
 	uint8_t status;
-	bool percent_change_detected;
+	uint16_t previous_warning;
+	bool percent_change_detected, value_changed;
     imx_data_32_t sampled_value;
 	control_sensor_data_t *csd;
 	imx_control_sensor_block_t *csb;
@@ -140,8 +146,8 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
 	}
 
 	SET_CSB_VARS_F( type );
-#ifdef PRINT_DEBUGS_FOR_SAMPLING
-	if( device_config.log_messages & DEBUGS_FOR_SAMPLING )
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SAMPLING )
+	if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_SAMPLING ) )
 	    wiced_rtos_delay_milliseconds( 100 ); // Used for debug to slow things down
 #endif
 	/*
@@ -150,11 +156,12 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
 	 * Sample rate of 0 represents event driven
 	 */
 	if( ( csb[ *active ].enabled == true ) && ( csb[ *active ].sample_rate > 0 ) && ( imx_is_later( current_time, csd[ *active ].last_poll_time + csb[ *active ].poll_rate ))) {
-		status = 0;	// Controls may not have an update function as the may just be set remotely
+		status = 0;
+		value_changed = false;	// Controls may not have an update function as the may just be set remotely
 		if( f[ *active ].update != NULL ) {
 			status = ( f[ *active ].update)( f[ *active ].arg, &sampled_value );
-#ifdef PRINT_DEBUGS_FOR_SAMPLING
-			if( device_config.log_messages & DEBUGS_FOR_SAMPLING ) {
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SAMPLING )
+			if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_SAMPLING ) ) {
 	            imx_cli_print( "Sampled %s: %u, result: %u", ( type == IMX_CONTROLS ) ? "Control" : "Sensor", *active, status );
 	            imx_cli_print( ", Value: " );
 	            switch( csb[ *active ].data_type ) {
@@ -173,6 +180,8 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
 			}
 #endif
 	        if( status == IMX_SUCCESS ) {
+	            if( ( csd[ *active ].valid == false ) || ( csd[ *active ].last_value.uint_32bit != sampled_value.uint_32bit ) )
+	                value_changed = true;
 	            csd[ *active ].last_poll_time = current_time;                       // Got valid data this time
 	            csd[ *active ].last_value.uint_32bit = sampled_value.uint_32bit;    // Its all just 32 bit data
 	            csd[ *active ].valid = true;      // We have a sample
@@ -205,6 +214,7 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
         /*
          * Check if the data is in warning levels for the sensor
          */
+        previous_warning = csd[ *active ].warning;
         csd[ *active ].warning = IMX_INFORMATIONAL;  // Assume for now
         /*
          * Each time thru the loop will check for the next most severe level and set the highest by the end
@@ -269,6 +279,11 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
                         percent_change_detected = true;
                     break;
             }
+        /*
+         * Let any CoAP observers of this entry know about a new value, warning level or percent change
+         */
+        if( ( value_changed == true ) || ( csd[ *active ].warning != previous_warning ) || ( percent_change_detected == true ) )
+            coap_observe_changed( type, *active );
 
         /*
          * See if we save this entry
@@ -285,17 +300,17 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
             ( csd[ *active ].warning != csd[ *active ].last_warning ) ||
             ( percent_change_detected == true ) ) ) {
 
-            csd[ *active ].data[ csd[ *active ].no_samples ].uint_32bit = csd[ *active ].last_value.uint_32bit; // Save this entry its all just 32 bit data
 /*
             imx_printf( "Saving %s value for sensor(%u): %s, Saved entries: %u\r\n", type == IMX_CONTROLS ? "Control" : "Sensor", *active, csb[ *active ].name, ( csd[ *active ].no_samples + 1 ) );
 */
             /*
-             * Check for overflow - Save only the last sample values
+             * Check for overflow - Move the oldest samples to the flash spill log, if that is not possible save only the last sample values
              */
             if( csd[ *active ].no_samples >= ( device_config.history_size - 1 ) ) {
-                memmove( &csd[ *active ].data[ 0 ], &csd[ *active ].data[ 1 ], ( device_config.history_size - 1 ) * IMX_SAMPLE_LENGTH );
-            } else
-                csd[ *active ].no_samples += 1;
+                if( spill_history( type, &csb[ *active ], &csd[ *active ] ) == false )
+                    history_drop_oldest( &csd[ *active ], 1 );
+            }
+            history_add( &csd[ *active ], csd[ *active ].last_value.uint_32bit );  // Save this entry its all just 32 bit data
             csd[ *active ].last_sample_time = current_time;
             /*
              * See if the batch is ready to go
@@ -305,8 +320,8 @@ void hal_sample( imx_peripheral_type_t type, wiced_time_t current_time )
                 ( csd[ *active ].no_samples >= ( device_config.history_size - 2  ) ) || // We can't get any more in to this record
                 ( csd[ *active ].update_now == true ) ||
                 ( percent_change_detected == true ) ) {
-#ifdef PRINT_DEBUGS_FOR_SAMPLING
-                if( device_config.log_messages & DEBUGS_FOR_SAMPLING ) {
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SAMPLING )
+                if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_SAMPLING ) ) {
                     imx_cli_print( "Setting %s: %u, ID: 0x%08lx to send batch of: %u, batch size %u, sample_now: %s sensor_warning: %u, last: %u, %%change detected: %s\r\n", type == IMX_CONTROLS ? "Control" : "Sensor",
                             *active, csb[ *active ].id, csd[ *active ].no_samples, csb[ *active ].sample_batch_size, csd[ *active ].update_now ? "true" : "false",
                             csd[ *active ].warning, csd[ *active ].last_warning, percent_change_detected ? "true" : "false" );
@@ -0,0 +1,552 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file hal_spill.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Flash spill log for Control and Sensor history. When a history fills up while iMatrix is unreachable the
+ *  oldest samples are written to an append only log in serial flash instead of being dropped. The log is a ring
+ *  of fixed size records that runs through every sector in turn so each sector sees the same number of erases.
+ *  Each record carries a sequence number and a CRC so the log can be rebuilt after a power loss, a record that
+ *  was only partly written fails its CRC and is skipped. Records are uploaded oldest first by imatrix_upload()
+ *  and marked drained by programming a single byte once iMatrix ACKs the packet, so no erase is needed to retire
+ *  them. Records in a packet that is never ACKed are sent again.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../storage.h"
+#include "../cli/interface.h"
+#include "../cli/messages.h"
+#include "../cli/imx_debug.h"
+#include "../device/icb_def.h"
+#include "../imatrix_upload/sample_encode.h"
+#include "../ota_loader/ota_structure.h"
+#include "../sflash/sflash.h"
+#include "../sflash/sflash_log.h"
+#include "../sflash/sflash_writer.h"
+#include "spi_flash_fast_erase.h"
+#include "cs_index.h"
+#include "hal_history.h"
+#include "hal_spill.h"
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SFLASH )
+    #undef PRINTF
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_SFLASH, __VA_ARGS__ )
+#elif !defined PRINTF
+    #define PRINTF(...)
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef SPILL_LOG_START
+#define SPILL_LOG_START         ( 0x340000 )    // Unpartitioned space below the configuration area at the top of flash
+#endif
+#ifndef SPILL_LOG_SIZE
+#define SPILL_LOG_SIZE          ( 0x050000 )    // Multiple of the 64K sector size, the trace mirror and OTA checkpoints follow
+#endif
+#define SPILL_RECORD_SIZE       ( 128 )         // Power of 2, records never cross a page or a sector
+#define SPILL_HEADER_SIZE       ( 28 )
+#define SPILL_RECORD_SAMPLES    ( ( SPILL_RECORD_SIZE - SPILL_HEADER_SIZE ) / IMX_SAMPLE_LENGTH )
+#define SPILL_CRC_LENGTH        ( 24 )          // Header bytes covered by the CRC, the CRC and drained flag follow
+#define SPILL_BLANK_SEQUENCE    ( 0xFFFFFFFF )
+#define SPILL_NOT_DRAINED       ( 0xFF )        // Erased state
+#define SPILL_DRAINED           ( 0x00 )
+#define SPILL_TYPE_MASK         ( 0x01 )
+#define SPILL_NOT_ERASED        ( 0xFFFFFFFF )
+#define SPILL_ERASE_AHEAD_FILL  ( 2 )           // Erase the next sector once the current one is 1 / n full
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct __attribute__((__packed__)) {        // Bytes
+    uint32_t sequence;                              // 0-3      Erased flash reads as SPILL_BLANK_SEQUENCE
+    uint32_t id;                                    // 4-7
+    wiced_utc_time_ms_t last_utc_ms_sample_time;    // 8-15
+    uint32_t sample_rate;                           // 16-19    0 - Event time stamp / value pairs
+    uint8_t type;                                   // 20       IMX_CONTROLS / IMX_SENSORS
+    uint8_t no_samples;                             // 21
+    uint8_t warning;                                // 22
+    uint8_t reserved;                               // 23
+    uint16_t crc;                                   // 24-25    CRC-16 CCITT of bytes 0-23 and the samples
+    uint8_t drained;                                // 26       Programmed to SPILL_DRAINED once uploaded
+    uint8_t reserved_2;                             // 27
+    uint32_t data[ SPILL_RECORD_SAMPLES ];          // 28-127   Raw sample words, the layout does not depend on the size of a pointer
+} spill_record_t;
+typedef char spill_record_size_check_t[ ( sizeof( spill_record_t ) == SPILL_RECORD_SIZE ) ? 1 : -1 ];
+
+typedef struct {
+    uint32_t sector_size;
+    uint32_t head;                                  // Offset of the next record to write
+    uint32_t tail;                                  // Offset of the oldest record not yet ACKed
+    uint32_t send;                                  // Offset of the next record to add to a packet
+    uint32_t sequence;                              // Sequence number of the next record
+    uint32_t pending;                               // Records waiting to be uploaded or ACKed
+    uint32_t erased;                                // Offset of the sector erased ahead of the head, SPILL_NOT_ERASED if none
+    uint32_t written, uploaded, resent, lost, crc_errors, write_errors, erases, erase_waits;
+    unsigned int available : 1;
+} spill_log_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static uint16_t record_crc( spill_record_t *record );
+static bool read_record( uint32_t offset, spill_record_t *record );
+static uint32_t next_sector(void);
+static uint32_t log_distance( uint32_t from, uint32_t to );
+static void mark_drained( uint32_t offset );
+static bool spill_write( spill_record_t *record );
+static imx_control_sensor_block_t *find_csb( uint8_t type, uint32_t id );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static spill_log_t spill;
+extern sflash_handle_t sflash_handle;
+extern IOT_Device_Config_t device_config;   // Defined in storage.h
+extern iMatrix_Control_Block_t icb;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Rebuild the spill log state from flash, called once the serial flash is initialized
+  *         The newest valid record sets the write position, the oldest one not drained the upload position
+  * @param  serial flash initialized and of the expected size
+  * @retval : None
+  */
+void spill_init( bool sflash_ok )
+{
+    spill_record_t record;
+    uint32_t offset, newest, oldest_sequence;
+    bool found;
+
+    memset( &spill, 0, sizeof( spill_log_t ) );
+    spill.erased = SPILL_NOT_ERASED;
+    if( ( sflash_ok == false ) || ( sflash_log_area_free( SPILL_LOG_START, SPILL_LOG_SIZE ) == false ) ) {
+        imx_printf( "Flash spill log not available\r\n" );
+        return;
+    }
+    spill.sector_size = get_sflash_sector_size();
+
+    found = false;
+    newest = 0;
+    oldest_sequence = SPILL_BLANK_SEQUENCE;
+    for( offset = 0; offset < SPILL_LOG_SIZE; offset += SPILL_RECORD_SIZE ) {
+        if( read_record( offset, &record ) == true ) {
+            if( ( found == false ) || ( record.sequence > spill.sequence ) ) {
+                spill.sequence = record.sequence;
+                newest = offset;
+                found = true;
+            }
+            if( record.drained != SPILL_DRAINED ) {
+                spill.pending += 1;
+                if( record.sequence < oldest_sequence ) {
+                    oldest_sequence = record.sequence;
+                    spill.tail = offset;
+                }
+            }
+        }
+    }
+    if( found == true ) {
+        spill.sequence += 1;
+        spill.head = sflash_log_next_slot( newest, SPILL_RECORD_SIZE, SPILL_LOG_SIZE );
+        /*
+         * A write interrupted by a power loss leaves a programmed slot after the newest record, start again in the next sector
+         */
+        for( offset = spill.head; ( offset % spill.sector_size ) != 0; offset = sflash_log_next_slot( offset, SPILL_RECORD_SIZE, SPILL_LOG_SIZE ) )
+            if( sflash_log_slot_blank( SPILL_LOG_START + offset, SPILL_RECORD_SIZE ) == false ) {
+                spill.head = ( ( spill.head / spill.sector_size ) + 1 ) * spill.sector_size;
+                if( spill.head >= SPILL_LOG_SIZE )
+                    spill.head = 0;
+                break;
+            }
+    }
+    if( spill.pending == 0 )
+        spill.tail = spill.head;
+    spill.send = spill.tail;
+    spill.available = true;
+    imx_printf( "Flash spill log @: 0x%08lx, %lu Records pending upload\r\n", (uint32_t) SPILL_LOG_START + spill.head, spill.pending );
+}
+/**
+  * @brief  Erase the sector the log moves on to next, called from the main loop so the sampling path never waits
+  *         for an erase. Done once the current sector is part full so older records are kept as long as possible.
+  *         Records in that sector that were never uploaded are lost, they are the oldest in the log
+  * @param  None
+  * @retval : None
+  */
+void spill_process(void)
+{
+    spill_record_t old;
+    uint32_t sector, offset, sector_end;
+    int result;
+
+    if( spill.available == false )
+        return;
+    sector = next_sector();
+    if( ( sector == spill.erased ) ||
+        ( ( sector != spill.head ) && ( ( spill.head % spill.sector_size ) < ( spill.sector_size / SPILL_ERASE_AHEAD_FILL ) ) ) )
+        return;
+    if( ( spill.pending > 0 ) && ( ( spill.tail / spill.sector_size ) == ( sector / spill.sector_size ) ) ) {
+        sector_end = sector + spill.sector_size;
+        for( offset = spill.tail; offset < sector_end; offset += SPILL_RECORD_SIZE )
+            if( ( read_record( offset, &old ) == true ) && ( old.drained != SPILL_DRAINED ) && ( spill.pending > 0 ) ) {
+                spill.pending -= 1;
+                spill.lost += 1;
+            }
+        if( sector_end >= SPILL_LOG_SIZE )
+            sector_end = 0;
+        if( log_distance( spill.tail, spill.send ) < log_distance( spill.tail, sector_end ) )
+            spill.send = sector_end;    // Not sent yet, or waiting for an ACK that can no longer retire them
+        spill.tail = sector_end;
+        if( spill.pending == 0 )
+            spill.tail = spill.send = spill.head;
+    }
+    sflash_writer_lock();
+    result = sflash_erase_area( &sflash_handle, SPILL_LOG_START + sector, spill.sector_size, spill.sector_size );
+    sflash_writer_unlock();
+    if( result != 0 ) {
+        spill.write_errors += 1;
+        return;
+    }
+    spill.erased = sector;
+    spill.erases += 1;
+}
+/**
+  * @brief  Move the oldest samples in a full history to the flash log
+  *         Variable length data is not spilled, the data blocks only live in RAM
+  * @param  type, control / sensor block, control / sensor data
+  * @retval : true - samples moved out of the history / false - caller must drop the oldest sample
+  */
+bool spill_history( imx_peripheral_type_t type, imx_control_sensor_block_t *csb, control_sensor_data_t *csd )
+{
+    spill_record_t record;
+    wiced_utc_time_ms_t utc_ms_time;
+    uint16_t i, count;
+
+    if( ( spill.available == false ) || ( csb->data_type == IMX_VARIABLE_LENGTH ) )
+        return false;
+    count = ( csd->no_samples < SPILL_RECORD_SAMPLES ) ? csd->no_samples : SPILL_RECORD_SAMPLES;
+    if( csb->sample_rate == 0 )
+        count &= ~0x01;     // Events are time stamp / value pairs
+    if( count == 0 )
+        return false;
+
+    if( icb.time_set_with_NTP == true )
+        wiced_time_get_utc_time_ms( &utc_ms_time );
+    else
+        utc_ms_time = 0;
+    memset( &record, 0xFF, sizeof( spill_record_t ) );
+    record.id = csb->id;
+    record.sample_rate = csb->sample_rate;
+    if( ( csb->sample_rate != 0 ) && ( utc_ms_time != 0 ) ) {
+        /*
+         * Time of the newest sample in this record, the rest of the history and the sample about to be added follow it
+         */
+        utc_ms_time -= (wiced_utc_time_ms_t) csb->sample_rate * ( csd->no_samples - count + 1 );
+    }
+    record.last_utc_ms_sample_time = utc_ms_time;
+    record.type = (uint8_t) type;
+    record.no_samples = (uint8_t) count;
+    record.warning = (uint8_t) csd->warning;
+    record.drained = SPILL_NOT_DRAINED;
+    for( i = 0; i < count; i++ )
+        record.data[ i ] = history_entry( csd, i )->uint_32bit;
+    if( spill_write( &record ) == false )
+        return false;
+    history_drop_oldest( csd, count );
+    PRINTF( "Spilled %u samples for ID: 0x%08lx to flash, %lu records pending\r\n", count, csb->id, spill.pending );
+    return true;
+}
+/**
+  * @brief  Number of records in the flash log waiting to be uploaded
+  * @param  None
+  * @retval : records
+  */
+uint32_t spill_pending(void)
+{
+    return spill.available ? spill.pending : 0;
+}
+/**
+  * @brief  Check for records in the flash log that have not been added to a packet yet
+  * @param  None
+  * @retval : true if there are records to send
+  */
+bool spill_unsent(void)
+{
+    return ( spill.available == true ) && ( spill.pending > 0 ) && ( spill.send != spill.head );
+}
+/**
+  * @brief  Add spilled records to an iMatrix upload packet, oldest first, as long as they fit
+  *         The records stay in the log until spill_acked() is called for the packet
+  *         Records for controls / sensors no longer configured are discarded
+  * @param  pointer to the upload position, remaining space, set when a record does not fit, records added
+  * @retval : number of samples added
+  */
+uint16_t spill_upload( upload_data_t **upload_data, uint16_t *remaining_data_length, bool *packet_full, spill_range_t *range )
+{
+    spill_record_t record;
+    imx_data_32_t data[ SPILL_RECORD_SAMPLES ];
+    imx_control_sensor_block_t *csb;
+    uint32_t record_length;
+    uint16_t block_type, samples, i;
+
+    samples = 0;
+    memset( range, 0, sizeof( spill_range_t ) );
+    range->start = spill.send;
+    while( ( spill_unsent() == true ) && ( *packet_full == false ) ) {
+        if( ( read_record( spill.send, &record ) == true ) && ( record.drained != SPILL_DRAINED ) ) {
+            record_length = sizeof( header_t ) + ( IMX_SAMPLE_LENGTH * record.no_samples );
+            if( *remaining_data_length < record_length ) {
+                *packet_full = true;
+                break;
+            }
+            csb = find_csb( record.type, record.id );
+            if( csb != NULL ) {
+                if( record.sample_rate == 0 )
+                    block_type = ( record.type == IMX_CONTROLS ) ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
+                else
+                    block_type = ( record.type == IMX_CONTROLS ) ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
+                encode_header( &(*upload_data)->header, record.id, record.sample_rate,
+                        encode_header_bits( block_type, csb->data_type, record.no_samples, record.warning, 0 ), record.last_utc_ms_sample_time );
+                for( i = 0; i < record.no_samples; i++ )
+                    data[ i ].uint_32bit = record.data[ i ];
+                encode_samples( (uint8_t *) (*upload_data)->data, data, record.no_samples );
+                *upload_data = ( upload_data_t *) ( (uint8_t *) ( *upload_data ) + record_length );
+                *remaining_data_length -= record_length;
+                samples += record.no_samples;
+                if( range->records == 0 )
+                    range->first_sequence = record.sequence;
+                range->last_sequence = record.sequence;
+                range->records += 1;
+            } else {
+                PRINTF( "Discarding spilled record for unknown ID: 0x%08lx\r\n", record.id );
+                mark_drained( spill.send );
+            }
+        }
+        spill.send = sflash_log_next_slot( spill.send, SPILL_RECORD_SIZE, SPILL_LOG_SIZE );
+    }
+    range->end = spill.send;
+    if( spill.pending == 0 )
+        spill.tail = spill.send = spill.head;
+    return samples;
+}
+/**
+  * @brief  iMatrix ACKed a packet - retire its records and move the tail past everything retired
+  *         Records the log has since dropped or written over no longer match the sequence numbers and are left alone
+  * @param  records that were added to the packet
+  * @retval : None
+  */
+void spill_acked( spill_range_t *range )
+{
+    spill_record_t record;
+    uint32_t offset;
+
+    if( ( spill.available == false ) || ( range->records == 0 ) )
+        return;
+    for( offset = range->start; offset != range->end; offset = sflash_log_next_slot( offset, SPILL_RECORD_SIZE, SPILL_LOG_SIZE ) )
+        if( ( read_record( offset, &record ) == true ) && ( record.drained != SPILL_DRAINED ) &&
+            ( record.sequence >= range->first_sequence ) && ( record.sequence <= range->last_sequence ) ) {
+            mark_drained( offset );
+            spill.uploaded += 1;
+        }
+    while( ( spill.tail != spill.send ) && ( ( read_record( spill.tail, &record ) == false ) || ( record.drained == SPILL_DRAINED ) ) )
+        spill.tail = sflash_log_next_slot( spill.tail, SPILL_RECORD_SIZE, SPILL_LOG_SIZE );
+    if( spill.pending == 0 )
+        spill.tail = spill.send = spill.head;
+}
+/**
+  * @brief  A packet was never ACKed - send its records again, skipping any the log has dropped or a later packet retired
+  * @param  records that were added to the packet
+  * @retval : None
+  */
+void spill_resend( spill_range_t *range )
+{
+    if( ( spill.available == false ) || ( range->records == 0 ) )
+        return;
+    if( log_distance( spill.tail, range->start ) < log_distance( spill.tail, spill.send ) ) {
+        spill.send = range->start;
+        spill.resent += range->records;
+    }
+}
+/**
+  * @brief  Print the state of the flash spill log
+  * @param  None
+  * @retval : None
+  */
+void print_spill_status(void)
+{
+    if( spill.available == false ) {
+        imx_cli_print( "Flash spill log: Not available\r\n" );
+        return;
+    }
+    imx_cli_print( "Flash spill log @: 0x%08lx, %lu Bytes, Write @: 0x%08lx, Send @: 0x%08lx, ACK @: 0x%08lx, Pending: %lu records (%u samples each)\r\n",
+            (uint32_t) SPILL_LOG_START, (uint32_t) SPILL_LOG_SIZE, (uint32_t) SPILL_LOG_START + spill.head, (uint32_t) SPILL_LOG_START + spill.send,
+            (uint32_t) SPILL_LOG_START + spill.tail, spill.pending, (uint16_t) SPILL_RECORD_SAMPLES );
+    imx_cli_print( "    Written: %lu, Uploaded: %lu, Resent: %lu, Lost: %lu, CRC errors: %lu, Write errors: %lu, Sector erases: %lu, Waits for erase: %lu\r\n",
+            spill.written, spill.uploaded, spill.resent, spill.lost, spill.crc_errors, spill.write_errors, spill.erases, spill.erase_waits );
+}
+/**
+  * @brief  Append a record, a new sector must already have been erased by spill_process()
+  * @param  record
+  * @retval : true / false - sector not erased yet or write failed
+  */
+static bool spill_write( spill_record_t *record )
+{
+    int result;
+
+    if( ( ( spill.head % spill.sector_size ) == 0 ) && ( spill.erased != spill.head ) ) {
+        spill.erase_waits += 1;
+        return false;
+    }
+    record->sequence = spill.sequence;
+    record->crc = record_crc( record );
+    sflash_writer_lock();
+    result = protected_sflash_write( &sflash_handle, SPILL_LOG_START + spill.head, record, SPILL_RECORD_SIZE, WRITE_SFLASH_UNPARTITIONED_SPACE );
+    sflash_writer_unlock();
+    if( result != 0 ) {
+        /*
+         * Leave the slot, it may be partly programmed
+         */
+        spill.write_errors += 1;
+        spill.head = sflash_log_next_slot( spill.head, SPILL_RECORD_SIZE, SPILL_LOG_SIZE );
+        if( spill.pending == 0 )
+            spill.tail = spill.send = spill.head;
+        return false;
+    }
+    if( spill.pending == 0 )
+        spill.tail = spill.send = spill.head;
+    spill.sequence += 1;
+    spill.head = sflash_log_next_slot( spill.head, SPILL_RECORD_SIZE, SPILL_LOG_SIZE );
+    spill.pending += 1;
+    spill.written += 1;
+    return true;
+}
+/**
+  * @brief  Read a record and check it
+  * @param  offset in the log, record
+  * @retval : true - record written and the CRC is good
+  */
+static bool read_record( uint32_t offset, spill_record_t *record )
+{
+    int result;
+
+    sflash_writer_lock();
+    result = sflash_read( &sflash_handle, SPILL_LOG_START + offset, record, SPILL_HEADER_SIZE );
+    if( ( result == 0 ) && ( record->sequence != SPILL_BLANK_SEQUENCE ) && ( record->no_samples <= SPILL_RECORD_SAMPLES ) )
+        result = sflash_read( &sflash_handle, SPILL_LOG_START + offset + SPILL_HEADER_SIZE, record->data, SPILL_RECORD_SIZE - SPILL_HEADER_SIZE );
+    sflash_writer_unlock();
+    if( ( result != 0 ) || ( record->sequence == SPILL_BLANK_SEQUENCE ) )
+        return false;
+    if( ( record->no_samples > SPILL_RECORD_SAMPLES ) || ( record_crc( record ) != record->crc ) ) {
+        spill.crc_errors += 1;
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Sector the head writes to once the current one is used, the current one if the head is at its start
+  * @param  None
+  * @retval : offset of the sector in the log
+  */
+static uint32_t next_sector(void)
+{
+    uint32_t sector;
+
+    if( ( spill.head % spill.sector_size ) == 0 )
+        return spill.head;
+    sector = ( ( spill.head / spill.sector_size ) + 1 ) * spill.sector_size;
+    return ( sector >= SPILL_LOG_SIZE ) ? 0 : sector;
+}
+/**
+  * @brief  Distance forward around the log from one offset to another
+  * @param  from, to
+  * @retval : Bytes
+  */
+static uint32_t log_distance( uint32_t from, uint32_t to )
+{
+    return ( to >= from ) ? to - from : SPILL_LOG_SIZE - from + to;
+}
+/**
+  * @brief  Retire a record, programming the flag only clears bits so no erase is needed
+  * @param  offset of the record in the log
+  * @retval : None
+  */
+static void mark_drained( uint32_t offset )
+{
+    uint8_t drained;
+
+    drained = SPILL_DRAINED;
+    sflash_writer_lock();
+    protected_sflash_write( &sflash_handle, SPILL_LOG_START + offset + offsetof( spill_record_t, drained ), &drained, 1, WRITE_SFLASH_UNPARTITIONED_SPACE );
+    sflash_writer_unlock();
+    if( spill.pending > 0 )
+        spill.pending -= 1;
+}
+static imx_control_sensor_block_t *find_csb( uint8_t type, uint32_t id )
+{
+    uint16_t entry;
+
+    if( ( type & SPILL_TYPE_MASK ) == IMX_CONTROLS ) {
+        if( cs_find_entry( IMX_CONTROLS, id, &entry ) == true )
+            return &device_config.ccb[ entry ];
+    } else {
+        if( cs_find_entry( IMX_SENSORS, id, &entry ) == true )
+            return &device_config.scb[ entry ];
+    }
+    return NULL;
+}
+
+static uint16_t record_crc( spill_record_t *record )
+{
+    uint16_t crc;
+
+    crc = sflash_log_crc( 0xFFFF, (uint8_t *) record, SPILL_CRC_LENGTH );
+    return sflash_log_crc( crc, (uint8_t *) record->data, SPILL_RECORD_SIZE - SPILL_HEADER_SIZE );
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file hal_spill.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef HAL_SPILL_H_
+#define HAL_SPILL_H_
+
+/*
+ *  Samples that would be dropped from a full history are appended to a log in serial flash and sent
+ *  to iMatrix, oldest first, once uploads resume. They stay in the log until the packet is ACKed.
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t start, end;                            // Log offsets of the first record added to a packet and just past the last
+    uint32_t first_sequence, last_sequence;         // Sequence numbers of the records, to recognise them when the ACK comes
+    uint16_t records;                               // Records added, 0 - none
+} spill_range_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void spill_init( bool sflash_ok );
+void spill_process(void);
+bool spill_history( imx_peripheral_type_t type, imx_control_sensor_block_t *csb, control_sensor_data_t *csd );
+uint32_t spill_pending(void);
+bool spill_unsent(void);
+uint16_t spill_upload( upload_data_t **upload_data, uint16_t *remaining_data_length, bool *packet_full, spill_range_t *range );
+void spill_acked( spill_range_t *range );
+void spill_resend( spill_range_t *range );
+void print_spill_status(void);
+#endif /* HAL_SPILL_H_ */
@@ -38,6 +38,7 @@
 #include "../storage.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../device/var_data.h"
 #include "hal_sample.h"
 #include "hal_event.h"
@@ -45,9 +46,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_EVENTS_DRIVEN
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_EVENTS_DRIVEN )
     #undef PRINTF
-    #define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_EVENTS_DRIVEN ) != 0x00 ) imx_printf(__VA_ARGS__)
+    #define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_EVENTS_DRIVEN, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -45,7 +45,9 @@
 #include "../storage.h"
 #include "../device_app_dct.h"
 #include "../cli/interface.h"
+#include "../cli/imx_debug.h"
 #include "../cs_ctrl/common_config.h"
+#include "../cs_ctrl/cs_index.h"
 #include "../imatrix_upload/imatrix_upload.h"
 #include "cert_util.h"
 #include "icb_def.h"
@@ -157,6 +159,8 @@ wiced_result_t imatrix_load_config(bool override_config)
             imx_printf( "\r\n" );
             icb.send_host_sw_revision = true;   // Need to set this flag as data structures have not yet been initialized
         }
+        cs_build_index();   // Control and sensor blocks restored from the DCT
+        imx_debug_update_mask();
         if( save_config_flag == true ) {
             return imatrix_save_config();
         }
@@ -308,6 +312,7 @@ wiced_result_t imatrix_load_config(bool override_config)
     imx_printf( "User Configuration entries loaded\r\n" );
 
     cs_reset_defaults();
+    imx_debug_update_mask();
     /*
      * Let iMatrix know what version we are running
      */
@@ -415,6 +420,7 @@ wiced_result_t imatrix_print_saved_config( uint16_t arg )
 void imx_set_imatrix_debug_flags( uint32_t debug_flags )
 {
     device_config.log_messages = debug_flags;
+    imx_debug_update_mask();
     /*
      * No need to save this as this is an API setting
      */
@@ -79,6 +79,8 @@ typedef struct {
     uint32_t packet_creation_failure;
     uint32_t fail_to_send_packet;
     uint32_t packets_sent;
+    uint32_t new_requests;                      // Requests checked against the CoAP duplicate cache
+    uint32_t duplicate_requests;                // Retransmitted requests answered from the cache
     wiced_result_t rec_error;
 } ip_stats_t;
 
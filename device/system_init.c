@@ -53,10 +53,18 @@
 #include "../cli/cli.h"
 #include "../cli/interface.h"
 #include "../cli/telnetd.h"
+#include "../cli/log_buffer.h"
+#include "../cli/trace.h"
 #include "../cs_ctrl/common_config.h"
 #include "../location/location.h"
 #include "../ota_loader/ota_loader.h"
+#include "../ota_loader/ota_structure.h"
+#include "../ota_loader/ota_checkpoint.h"
 #include "../sflash/sflash.h"
+#include "../sflash/sflash_writer.h"
+#include "../cs_ctrl/hal_spill.h"
+#include "../coap/coap_dedup.h"
+#include "../coap/coap_observe.h"
 
 /******************************************************
  *                      Macros
@@ -137,6 +145,11 @@ bool system_init(bool override_config)
 		imx_printf( "wiced_core_init() failed with error code: %u.\r\n", wiced_result );
 		return IMX_GENERAL_FAILURE;
 	}
+	/*
+	 * Start the buffered log output thread - output before this point is written directly
+	 */
+	if( log_buffer_init() == false )
+	    imx_printf( "Unable to start log output thread, output will remain unbuffered\r\n" );
     /*
      * Load current config from DCT or factory default if none stored, includes loading serial number from CPU data.
      */
@@ -145,8 +158,18 @@ bool system_init(bool override_config)
     set_serial_number();
 //  print_serial_number();
 
-	if( init_serial_flash() == false )
+	if( init_serial_flash() == false ) {
 	    imx_printf( "ERROR: Serial Flash size does not match product definition\r\n" );
+	    spill_init( false );
+	    trace_init( false );
+	    ota_checkpoint_init( false );
+	} else {
+	    spill_init( true );
+	    trace_init( true );
+	    ota_checkpoint_init( true );
+	}
+	if( sflash_writer_init() == false )
+	    imx_printf( "Unable to start SFLASH writer thread, OTA images will be written inline\r\n" );
     device_config.boot_count += 1;
     imatrix_save_config();
 
@@ -184,6 +207,8 @@ bool system_init(bool override_config)
         imx_printf( "Failed to initialize CoAP Message pools\r\n" );
         return IMX_FAIL_COAP_SETUP;
     }
+    coap_dedup_init();
+    coap_observe_init();
     /*
      * Set up a random starting message ID
      */
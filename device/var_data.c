@@ -54,6 +54,9 @@
 /******************************************************
  *                    Constants
  ******************************************************/
+#define VAR_CLASS_GRANULE       ( 16 )      // Bytes per size class
+#define VAR_SIZE_CLASSES        ( 128 )     // Lengths above the last class start their search there
+#define VAR_NO_POOL             ( 0xFF )
 
 /******************************************************
  *                   Enumerations
@@ -75,6 +78,8 @@
  *               Variable Definitions
  ******************************************************/
 static imx_var_data_block_t var_data_block[ IMX_MAX_VAR_LENGTH_POOLS ];
+static uint8_t var_size_class[ VAR_SIZE_CLASSES ];  // First pool that can hold the smallest length in each class
+static bool var_data_zero = false;
 extern IOT_Device_Config_t device_config;
 extern uint8_t *var_pool_data;
 extern iMatrix_Control_Block_t icb;
@@ -93,7 +98,7 @@ extern iMatrix_Control_Block_t icb;
 
 void init_var_pool(void)
 {
-    uint16_t i, j, pool_index;
+    uint16_t i, j, pool_index, min_length;
     var_data_entry_t *var_data_ptr;
 
     /*
@@ -102,6 +107,19 @@ void init_var_pool(void)
      */
     imx_printf( "Initializing Variable length data pool, pool size: %u Bytes\r\n", icb.var_pool_size );
     memset( var_pool_data, 0x00, icb.var_pool_size );
+    memset( var_data_block, 0x00, sizeof( var_data_block ) );
+    /*
+     * Build the size class table, each class starts its search at the first pool, in configuration order, that could hold any length in it
+     */
+    for( i = 0; i < VAR_SIZE_CLASSES; i++ ) {
+        min_length = ( i == 0 ) ? 0 : ( ( i - 1 ) * VAR_CLASS_GRANULE ) + 1;
+        var_size_class[ i ] = VAR_NO_POOL;
+        for( j = 0; j < device_config.no_variable_length_pools; j++ )
+            if( device_config.var_data_config[ j ].size >= min_length ) {
+                var_size_class[ i ] = j;
+                break;
+            }
+    }
 
     pool_index = 0;
     for( i = 0; i < device_config.no_variable_length_pools; i++ ) {
@@ -119,12 +137,23 @@ void init_var_pool(void)
             var_data_ptr->header.next = NULL;
             var_data_ptr->length = 0;           // Length field indicates length of actual data in item
             var_data_ptr->data = &var_pool_data[ pool_index ] + sizeof( var_data_entry_t );
+            var_data_block[ i ].no_entries += 1;
             imx_add_var_free_pool( var_data_ptr );
             pool_index += sizeof( var_data_entry_t ) + device_config.var_data_config[ i ].size;
         }
     }
     print_var_pools();
 }
+/**
+  * @brief  Set if variable length data is cleared when it is allocated
+  *         Off by default, only the byte after the requested length is cleared so strings stay terminated
+  * @param  true / false
+  * @retval : None
+  */
+void imx_set_var_data_zero( bool zero )
+{
+    var_data_zero = zero;
+}
 /**
   * @brief  return / add this var data to the free lists
   * @param  None
@@ -133,30 +162,14 @@ void init_var_pool(void)
 
 void imx_add_var_free_pool( var_data_entry_t *var_data_ptr )
 {
-    var_data_entry_t *temp_ptr;
+    imx_var_data_block_t *pool;
 
 //    imx_printf( "Adding entry to Pool: %u (%u Byte pool)\r\n", var_data_ptr->header.pool_id, device_config.var_data_config[ var_data_ptr->header.pool_id ].size );
-    /*
-     * Clear all data from entry
-     */
-    memset( var_data_ptr->data, 0x00, device_config.var_data_config[ var_data_ptr->header.pool_id ].size );
-
-    if( var_data_block[ var_data_ptr->header.pool_id ].head == NULL ) {
-        /*
-         * This is first entry - set this as the head and tail.
-         */
-        var_data_block[ var_data_ptr->header.pool_id ].head = var_data_ptr;
-        var_data_block[ var_data_ptr->header.pool_id ].tail = var_data_ptr;
-        var_data_ptr->header.next = NULL;
-    } else {
-        /*
-         * Extend the list
-         */
-        temp_ptr = var_data_block[ var_data_ptr->header.pool_id ].tail;
-        temp_ptr->header.next = var_data_ptr;
-        var_data_ptr->header.next = NULL;
-        var_data_block[ var_data_ptr->header.pool_id ].tail = var_data_ptr;
-    }
+    pool = &var_data_block[ var_data_ptr->header.pool_id ];
+    var_data_ptr->length = 0;
+    var_data_ptr->header.next = pool->head;
+    pool->head = var_data_ptr;
+    pool->no_free += 1;
 }
 /**
   * @brief  get var data entry
@@ -165,28 +178,38 @@ void imx_add_var_free_pool( var_data_entry_t *var_data_ptr )
   */
 var_data_entry_t *imx_get_var_data( uint16_t length )
 {
-    uint16_t i;
+    uint16_t i, size_class, in_use, first_fit;
     var_data_entry_t *var_data_ptr;
+    imx_var_data_block_t *pool;
 
 //    imx_printf( "Request for: %u Bytes ", length );
     /*
-     * Check to find a free buffer capable of handling the requirement.
+     * Pools before the class entry are too small, start there for a free buffer capable of handling the requirement
      */
-    for( i = 0; i < device_config.no_variable_length_pools; i++ ) {
+    size_class = ( length + VAR_CLASS_GRANULE - 1 ) / VAR_CLASS_GRANULE;
+    if( size_class >= VAR_SIZE_CLASSES )
+        size_class = VAR_SIZE_CLASSES - 1;
+    first_fit = VAR_NO_POOL;
+    for( i = var_size_class[ size_class ]; i < device_config.no_variable_length_pools; i++ ) {
         if( device_config.var_data_config[ i ].size >= length ) {   // This one will do
-            if( var_data_block[ i ].head != NULL ) {
+            if( first_fit == VAR_NO_POOL )
+                first_fit = i;
+            pool = &var_data_block[ i ];
+            if( pool->head != NULL ) {
                 /*
                  * Take top element
                  */
-                var_data_ptr = var_data_block[ i ].head;
-                /*
-                 * Set Head to next element down
-                 */
-                var_data_block[ i ].head = var_data_ptr->header.next;
-                /*
-                 * Make sure data is clear before returning
-                 */
-                memset( var_data_ptr->data, 0x00, device_config.var_data_config[ i ].size );
+                var_data_ptr = pool->head;
+                pool->head = var_data_ptr->header.next;
+                pool->no_free -= 1;
+                pool->allocations += 1;
+                in_use = pool->no_entries - pool->no_free;
+                if( in_use > pool->high_water )
+                    pool->high_water = in_use;
+                if( var_data_zero == true )
+                    memset( var_data_ptr->data, 0x00, device_config.var_data_config[ i ].size );
+                else if( length < device_config.var_data_config[ i ].size )
+                    var_data_ptr->data[ length ] = 0x00;
 //                imx_printf( "Success\r\n" );
                 return( var_data_ptr );
             }
@@ -195,6 +218,8 @@ var_data_entry_t *imx_get_var_data( uint16_t length )
     /*
      * None found.
      */
+    if( first_fit != VAR_NO_POOL )
+        var_data_block[ first_fit ].failures += 1;
     imx_printf( "No free variable length data available, (requesting: %u Bytes)\r\n", length );
     return NULL;
 }
@@ -205,22 +230,13 @@ var_data_entry_t *imx_get_var_data( uint16_t length )
   */
 void print_var_pools(void)
 {
-    uint16_t i, j;
-    var_data_entry_t *var_data_ptr;
+    uint16_t i;
 
     imx_cli_print( "Variable Length Pools: " );
-    for( i = 0; i < device_config.no_variable_length_pools; i++ ) {
-        imx_cli_print( " %u Bytes", device_config.var_data_config[ i ].size );
-        j = 0;
-        if( var_data_block[ i ].head != NULL ) {
-            j = 1;  // At least one
-            var_data_ptr = var_data_block[ i ].head;
-            while( var_data_ptr->header.next != NULL ) {
-                j ++;
-                var_data_ptr = var_data_ptr->header.next;
-            }
-        }
-        imx_cli_print( "[ %u ]", j );
-    }
+    for( i = 0; i < device_config.no_variable_length_pools; i++ )
+        imx_cli_print( " %u Bytes[ %u ]", device_config.var_data_config[ i ].size, var_data_block[ i ].no_free );
     imx_cli_print( "\r\n" );
+    for( i = 0; i < device_config.no_variable_length_pools; i++ )
+        imx_cli_print( "    %u Byte pool: %u Entries, High water: %u, Allocations: %lu, Failures: %lu\r\n", device_config.var_data_config[ i ].size,
+                var_data_block[ i ].no_entries, var_data_block[ i ].high_water, var_data_block[ i ].allocations, var_data_block[ i ].failures );
 }
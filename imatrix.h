@@ -217,12 +217,14 @@ void imx_sunrise_sunset( wiced_utc_time_t any_utc_time_on_day, wiced_utc_time_t*
 void *imx_allocate_storage( uint16_t size );
 void imx_add_var_free_pool( var_data_entry_t *var_data_ptr );
 var_data_entry_t *imx_get_var_data( uint16_t length );
+void imx_set_var_data_zero( bool zero );
 /*
  * IP & CoAP Processing defines and related string handling
  */
 #include "coap/coap.h"
 bool imx_is_multicast_ip( wiced_ip_address_t *addr );
 void imx_set_host_coap_interface( uint16_t no_coap_entries, CoAP_entry_t *host_coap_entries );
+bool imx_set_sent_message_list_size( uint16_t size );
 bool imx_supress_multicast_response( wiced_ip_address_t *addr, uint16_t response );
 int imx_wrong_group( CoAP_msg_detail_t *cd );
 wiced_result_t imx_get_group_from_query_str( char* query_str, uint16_t *group );
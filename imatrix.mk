@@ -35,6 +35,8 @@
 
 # The following global defines enable debug printing in specific modules or collections of modules or All code.
 # A clean make is required to enforce any change in this list.
+# Debug PRINTF sites in categories not listed here compile to nothing, see cli/imx_debug.h. For a production build
+# with no debug output at all add: GLOBAL_DEFINES += IMX_DEBUG_MIN_LEVEL=IMX_DEBUG_LEVEL_NONE
 GLOBAL_DEFINES += PRINT_DEBUGS_FOR_ALL 
 GLOBAL_DEFINES += PRINT_DEBUGS_FOR_BLE
 GLOBAL_DEFINES += PRINT_DEBUGS_FOR_HAL					# Hardware abstraction layer
@@ -58,8 +60,9 @@ $(NAME)_SOURCES := imatrix_interface.c imatrix_interface.h storage.c storage.h h
 at_cmds/at_cmds.c at_cmds/at_cmds.h \
 ble/ble_config.c ble/ble_manager.c ble/ble_manager.h \
 cli/cli.c cli/cli.h cli/cli_help.c cli/cli_help.h cli/cli_boot.c cli/cli_boot.h cli/cli_status.c cli/status.h \
-cli/cli_set_ssid.c cli/cli_set_ssid.h cli/cli_dump.c cli/cli_dump.h cli/cli_log.c cli/cli_log.h cli/cli_ntp.c cli/cli_ntp.h \
+cli/cli_set_ssid.c cli/cli_set_ssid.h cli/cli_dump.c cli/cli_dump.h cli/cli_log.c cli/cli_log.h cli/cli_ntp.c cli/cli_ntp.h cli/cli_bench.c cli/cli_bench.h \
 cli/cli_set_serial.c cli/cli_set_serial.h \
+cli/log_buffer.c cli/log_buffer.h cli/trace.c cli/trace.h cli/imx_debug.h \
 cli/interface.c cli/interface.h cli/print_dct.c cli/print_dct.h cli/telnetd.c cli/telnetd.h cli/cli_debug.c cli/cli_debug.h \
 coap/coap.c coap/coap.h coap/coap_setup.c coap/coap_setup.h coap/coap_udp_recv.c coap_udp_recv.h \
 coap/imx_coap.c coap/imx_coap.h \
@@ -69,6 +72,9 @@ coap/que_manager.c coap/queue_manager.h \
 coap/sent_message_list.c coap/sent_message_list.h \
 coap/coap_token.c coap/coap_token.h \
 coap/coap_receive.c coap/coap_receive.h \
+coap/coap_dedup.c coap/coap_dedup.h \
+coap/coap_observe.c coap/coap_observe.h \
+coap/coap_block.c coap/coap_block.h \
 coap/coap_transmit.c coap/coap_transmit.h \
 coap/tcp_transport.c coap/tcp_transport.h \
 coap/coap_tcp_recv.c coap/coap_tcp_recv.h \
@@ -90,23 +96,24 @@ coap_interface/match_uri.c coap_interface/match_uri.h \
 coap_interface/token_string.c coap_interface/token_string.h \
 cs_ctrl/controls.c cs_ctrl/controls.h cs_ctrl/common_config.c cs_ctrl/common_config.h cs_ctrl/imx_cs_interface.c cs_ctrl/imx_cs_interface.h \
 cs_ctrl/sensors.c cs_ctrl/sensors.h \
-cs_ctrl/hal_event.c cs_ctrl/hal_event.h cs_ctrl/hal_sample.c cs_ctrl/hal_sample.h  \
+cs_ctrl/hal_event.c cs_ctrl/hal_event.h cs_ctrl/hal_sample.c cs_ctrl/hal_sample.h cs_ctrl/hal_history.c cs_ctrl/hal_history.h cs_ctrl/hal_spill.c cs_ctrl/hal_spill.h \
+cs_ctrl/cs_index.c cs_ctrl/cs_index.h \
 device/cert_util.c device/cert_util.h device/config.c device/config.h device/hal_leds.c device/hal_leds.h \
 device/hal_wifi.c device/hal_wifi.h device/imx_config.c device/imx_config.h \
 device/imx_LEDS.c device/imx_LEDS.h device/lcb_def.h \
 device/set_serial.c device/set_serial.h device/system_init.c \
 device/system_init.h device/var_data.c device/var_data.h \
 imatrix_upload/add_internal.c imatrix_upload/add_internal.h imatrix_upload/imatrix_get_ip.c imatrix_upload/imatrix_get_ip.h imatrix_upload/imatrix_upload.c imatrix_upload/imatrix_upload.h \
-imatrix_upload/logging.c imatrix_upload/logging.h imatrix_upload/registration.c imatrix_upload/registration.h \
+imatrix_upload/logging.c imatrix_upload/logging.h imatrix_upload/registration.c imatrix_upload/registration.h imatrix_upload/sample_encode.c imatrix_upload/sample_encode.h \
 json/mjson.c json/mjson.h \
 location/location.c location/location.h \
 manufacturing/manufacturing.c manufacturing/manufacturing.h \
 networking/get_inbound_destination_ip.c networking/get_inbound_destination_ip.h networking/http_get_sn_mac_address.c networking/http_get_sn_mac_address.h \
 networking/keep_alive.c networking/keep_alive.h networking/utility.c networking/utility.h \
-ota_loader/load_sflash.c ota_loader/load_sflash.h ota_loader/ota_loader.c ota_loader/ota_loader.h \
+ota_loader/load_sflash.c ota_loader/load_sflash.h ota_loader/ota_loader.c ota_loader/ota_loader.h ota_loader/ota_image.c ota_loader/ota_image.h ota_loader/ota_delta.c ota_loader/ota_delta.h ota_loader/ota_checkpoint.c ota_loader/ota_checkpoint.h \
 platform_functions/ISMART.c platform_functions/ISMART.h platform_functions/rtc_time.c platform_functions/rtc_time.h \
 platform_functions/onewire.c platform_functions/onewire.h \
-sflash/sflash.c sflash/sflash.h \
+sflash/sflash.c sflash/sflash.h sflash/sflash_log.c sflash/sflash_log.h sflash/sflash_writer.c sflash/sflash_writer.h \
 spi_flash_fast_erase/spi_flash_fast_erase.c spi_flash_fast_erase/spi_flash_fast_erase.h \
 time/ck_time.c time/ck_time.h time/ntp_success.c time/ntp_success.h time/sntp.c time/sntp.h time/watchdog.c time/watchdog.h \
 wifi/enterprise_80211.c wifi/enterprise_80211.h wifi/imx_wifi.c wifi/wifi_logging.c wifi/wifi_logging.h wifi/process_wifi.c wifi/process_wifi.h \
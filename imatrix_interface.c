@@ -39,7 +39,11 @@
 #include "cli/cli.h"
 #include "cli/cli_status.h"
 #include "cli/telnetd.h"
+#include "cli/trace.h"
 #include "cs_ctrl/hal_sample.h"
+#include "cs_ctrl/hal_spill.h"
+#include "coap/coap.h"
+#include "coap/coap_observe.h"
 #include "coap/coap_receive.h"
 #include "coap/coap_transmit.h"
 #include "device/config.h"
@@ -49,6 +53,7 @@
 #include "imatrix_upload/imatrix_upload.h"
 #include "ota_loader/ota_loader.h"
 #include "ota_loader/ota_structure.h"
+#include "ota_loader/ota_checkpoint.h"
 #include "time/watchdog.h"
 #include "wifi/process_wifi.h"
 /******************************************************
@@ -194,6 +199,11 @@ imx_status_t imx_process(void)
      * Keep the watchdog happy
      */
     imx_kick_watchdog();
+     * Pick up a download interrupted by a reset or a network failure once the network is up
+     * Pick up a download interrupted by a reset once the network is up
+     */
+    if( ( icb.wifi_up == true ) && ( device_config.AP_setup_mode == false ) && ( ota_checkpoint_available() == true ) )
+        ota_resume();
 
     if ( ota_is_active() ) {
         /*
@@ -214,6 +224,10 @@ imx_status_t imx_process(void)
      */
     cli_process();
     telnetd();
+    /*
+     * Copy new trace records to the flash mirror if enabled
+     */
+    trace_process();
     /*
      * Process controls Controls are set by direct action from logic or from CoAP POST
      */
@@ -237,7 +251,12 @@ imx_status_t imx_process(void)
      * Process any items on the CoAP queues
      */
     coap_recv( true );
+    coap_observe_process( current_time );
     coap_transmit( true );
+    /*
+     * Erase ahead in the flash spill log, kept out of the sampling path
+     */
+    spill_process();
 
     return IMX_SUCCESS;
 }
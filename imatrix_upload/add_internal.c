@@ -51,6 +51,7 @@
 #include "../device/icb_def.h"
 #include "../imatrix_upload/registration.h"
 #include "../networking/utility.h"
+#include "sample_encode.h"
 
 /******************************************************
  *                      Macros
@@ -93,7 +94,7 @@ void add_registration( upload_data_t **upload_data, uint16_t *remaining_data_len
 {
 
     uint32_t foo32bit;
-    bits_t header_bits;
+    imx_data_32_t event[ 2 ];
 
     imx_printf( "Registering product: %s - %s ", device_config.device_name, device_config.device_serial_number );
     /*
@@ -104,29 +105,16 @@ void add_registration( upload_data_t **upload_data, uint16_t *remaining_data_len
     /*
      * Registration
      */
-    (*upload_data)->header.id = htonl( IMX_INTERNAL_SENSOR_THING_EVENT );
-    header_bits.bits.data_type = IMX_UINT32;  // Floating point data for GPS
-    (*upload_data)->header.sample_rate = htonl( 0 );
-    header_bits.bits.block_type = IMX_BLOCK_EVENT_SENSOR;
-
-    header_bits.bits.no_samples = 2;
-    header_bits.bits.warning = 0;
-    header_bits.bits.sensor_error = 0;
-    header_bits.bits.version = IMATRIX_VERSION_1;
-    header_bits.bits.reserved = 0;
-    (*upload_data)->header.bits.bit_data = htonl( header_bits.bit_data );
-
+    encode_header( &(*upload_data)->header, IMX_INTERNAL_SENSOR_THING_EVENT, 0,
+            encode_header_bits( IMX_BLOCK_EVENT_SENSOR, IMX_UINT32, 2, 0, 0 ), upload_utc_ms_time );
     /*
      * Load Defaults
      */
-    (*upload_data)->header.last_utc_ms_sample_time = 0;
-    (*upload_data)->data[ 0 ].uint_32bit = 0;
-
-    if( icb.time_set_with_NTP == true ) {
-        (*upload_data)->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
-        (*upload_data)->data[ 0 ].uint_32bit = htonl( (uint32_t) ( upload_utc_ms_time / 1000L ) );  // Time in UTC Sec
-    }
-    (*upload_data)->data[ 1 ].uint_32bit = htonl( IMX_EVENT_REGISTRATION );
+    event[ 0 ].uint_32bit = 0;
+    if( icb.time_set_with_NTP == true )
+        event[ 0 ].uint_32bit = (uint32_t) ( upload_utc_ms_time / 1000L );  // Time in UTC Sec
+    event[ 1 ].uint_32bit = IMX_EVENT_REGISTRATION;
+    encode_samples( (uint8_t *) (*upload_data)->data, event, 2 );
     /*
     * Update the pointer and amount number of bytes left in buffer
     */
@@ -163,7 +151,7 @@ void add_indoor_location( upload_data_t **upload_data, uint16_t *remaining_data_
 void add_gps( upload_data_t **upload_data, uint16_t *remaining_data_length, wiced_utc_time_ms_t upload_utc_ms_time )
 {
     uint32_t foo32bit;
-    bits_t header_bits;
+    imx_data_32_t value;
 
     imx_printf( "Adding GPS Location - Latitude: %f, Longitude: %f, Altitude: %f ", icb.latitude, icb.longitude, icb.elevation );
     /*
@@ -172,23 +160,10 @@ void add_gps( upload_data_t **upload_data, uint16_t *remaining_data_length, wice
     /*
      * Latitude
      */
-    (*upload_data)->header.id = htonl( IMX_INTERNAL_SENSOR_GPS_LATITUDE );
-    header_bits.bits.data_type = IMX_FLOAT;  // Floating point data for GPS
-    (*upload_data)->header.sample_rate = htons( 0 );
-    header_bits.bits.block_type = IMX_BLOCK_GPS_COORDINATES;
-
-    header_bits.bits.no_samples = 1;
-    header_bits.bits.warning = 0;
-    header_bits.bits.sensor_error = 0;
-    header_bits.bits.version = IMATRIX_VERSION_1;
-    header_bits.bits.reserved = 0;
-    (*upload_data)->header.bits.bit_data = htonl( header_bits.bit_data );
-
-    (*upload_data)->header.last_utc_ms_sample_time = 0;
-    if( icb.time_set_with_NTP == true )
-        (*upload_data)->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
-    memcpy( &foo32bit, &icb.latitude, IMX_SAMPLE_LENGTH );
-    (*upload_data)->data[ 0 ].uint_32bit = htonl( foo32bit );
+    encode_header( &(*upload_data)->header, IMX_INTERNAL_SENSOR_GPS_LATITUDE, 0,
+            encode_header_bits( IMX_BLOCK_GPS_COORDINATES, IMX_FLOAT, 1, 0, 0 ), upload_utc_ms_time );   // Floating point data for GPS
+    memcpy( &value, &icb.latitude, IMX_SAMPLE_LENGTH );
+    encode_samples( (uint8_t *) (*upload_data)->data, &value, 1 );
     /*
     * Update the pointer and amount number of bytes left in buffer
     */
@@ -198,23 +173,10 @@ void add_gps( upload_data_t **upload_data, uint16_t *remaining_data_length, wice
     /*
      * Longitude
      */
-    (*upload_data)->header.id = htonl( IMX_INTERNAL_SENSOR_GPS_LONGITUDE );
-    header_bits.bits.data_type = IMX_FLOAT;  // Floating point data for GPS
-    (*upload_data)->header.sample_rate = htons( 0 );
-    header_bits.bits.block_type = IMX_BLOCK_GPS_COORDINATES;
-
-    header_bits.bits.no_samples = 1;
-    header_bits.bits.warning = 0;
-    header_bits.bits.sensor_error = 0;
-    header_bits.bits.version = IMATRIX_VERSION_1;
-    header_bits.bits.reserved = 0;
-    (*upload_data)->header.bits.bit_data = htonl( header_bits.bit_data );
-
-    (*upload_data)->header.last_utc_ms_sample_time = 0;
-    if( icb.time_set_with_NTP == true )
-        (*upload_data)->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
-    memcpy( &foo32bit, &icb.longitude, IMX_SAMPLE_LENGTH );
-    (*upload_data)->data[ 0 ].uint_32bit = htonl( foo32bit );
+    encode_header( &(*upload_data)->header, IMX_INTERNAL_SENSOR_GPS_LONGITUDE, 0,
+            encode_header_bits( IMX_BLOCK_GPS_COORDINATES, IMX_FLOAT, 1, 0, 0 ), upload_utc_ms_time );   // Floating point data for GPS
+    memcpy( &value, &icb.longitude, IMX_SAMPLE_LENGTH );
+    encode_samples( (uint8_t *) (*upload_data)->data, &value, 1 );
     /*
     * Update the pointer and amount number of bytes left in buffer
     */
@@ -224,23 +186,10 @@ void add_gps( upload_data_t **upload_data, uint16_t *remaining_data_length, wice
     /*
      * Elevation
      */
-    (*upload_data)->header.id = htonl( IMX_INTERNAL_SENSOR_GPS_ELEVATION );
-    header_bits.bits.data_type = IMX_FLOAT;  // Floating point data for GPS
-    (*upload_data)->header.sample_rate = htons( 0 );
-    header_bits.bits.block_type = IMX_BLOCK_GPS_COORDINATES;
-
-    header_bits.bits.no_samples = 1;
-    header_bits.bits.warning = 0;
-    header_bits.bits.sensor_error = 0;
-    header_bits.bits.version = IMATRIX_VERSION_1;
-    header_bits.bits.reserved = 0;
-    (*upload_data)->header.bits.bit_data = htonl( header_bits.bit_data );
-
-    (*upload_data)->header.last_utc_ms_sample_time = 0;
-    if( icb.time_set_with_NTP == true )
-        (*upload_data)->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
-    memcpy( &foo32bit, &icb.elevation, IMX_SAMPLE_LENGTH );
-    (*upload_data)->data[ 0 ].uint_32bit = htonl( foo32bit );
+    encode_header( &(*upload_data)->header, IMX_INTERNAL_SENSOR_GPS_ELEVATION, 0,
+            encode_header_bits( IMX_BLOCK_GPS_COORDINATES, IMX_FLOAT, 1, 0, 0 ), upload_utc_ms_time );   // Floating point data for GPS
+    memcpy( &value, &icb.elevation, IMX_SAMPLE_LENGTH );
+    encode_samples( (uint8_t *) (*upload_data)->data, &value, 1 );
     /*
     * Update the pointer and amount number of bytes left in buffer
     */
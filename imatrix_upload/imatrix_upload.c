@@ -39,6 +39,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 
 #include "wiced.h"
@@ -55,17 +56,23 @@
 #include "../cli/interface.h"
 #include "../cli/cli_status.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
+#include "../cli/trace.h"
+#include "../cs_ctrl/hal_history.h"
+#include "../cs_ctrl/hal_spill.h"
 #include "../networking/utility.h"
 #include "../time/ck_time.h"
 #include "add_internal.h"
+#include "sample_encode.h"
 #include "imatrix.h"
 #include "imatrix_get_ip.h"
+#include "imatrix_upload.h"
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_IMX_UPLOAD
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_IMX_UPLOAD )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_IMX_UPLOAD ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_TRACE( DEBUGS_FOR_IMX_UPLOAD, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
@@ -85,8 +92,15 @@
  *                    Constants
  ******************************************************/
 #define MIN_IMATRIX_PACKET	256	    // Arbitrary length
-#define MAX_VARIABLE_LENGTH 1024    // Limit to a single UDP Packet for now
+#define MAX_VARIABLE_LENGTH 1024    // Larger variable length samples are sent on their own in Block1 blocks
 #define URI_PATH_LENGTH		20	    // SN is 10 + 4 characters
+#define IMATRIX_UPLOAD_WINDOW   4       // Default packets in flight while draining a backlog, 1 - one packet per check time
+#define IMATRIX_MAX_IN_FLIGHT   8
+#define IMATRIX_ACK_TIMEOUT     ( 5 * SECONDS ) // Give up waiting for an ACK and free the slot in the window
+#define IMATRIX_BLOCK_SZX       COAP_BLOCK_SZX_MAX
+#define IMATRIX_BLOCK_SIZE      ( 16 << IMATRIX_BLOCK_SZX )
+#define IMATRIX_BLOCK_TIMEOUT   ( 45 * SECONDS ) // CoAP has given up retransmitting a block by now
+#define BLOCK_OPTIONS_LENGTH    40
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -95,7 +109,9 @@ enum imatrix_states {
 	IMATRIX_GET_PACKET,
 	IMATRIX_LOAD_PACKET,
 	IMATRIX_UPLOAD_DATA,
-	IMATRIX_UPLOAD_COMPLETE
+	IMATRIX_UPLOAD_COMPLETE,
+	IMATRIX_BLOCK_SEND,
+	IMATRIX_BLOCK_WAIT
 };
 
 enum {
@@ -107,12 +123,44 @@ enum {
 /******************************************************
  *                 Type Definitions
  ******************************************************/
+typedef struct {
+    uint16_t id;
+    wiced_time_t sent_time;
+    spill_range_t spill;                            // Spilled records in the packet, retired when it is ACKed
+    bool active;
+} in_flight_t;
+
+/*
+ * A variable length sample too big for a packet, sent in Block1 blocks - RFC 7959
+ */
+typedef struct {
+    var_data_entry_t *var_data;
+    uint8_t prefix[ sizeof( header_t ) + ( 2 * IMX_SAMPLE_LENGTH ) ];  // Header, event time stamp and data length
+    uint16_t prefix_length, total_length;
+    uint16_t num;                                   // Block being sent
+    uint16_t msg_id;
+    wiced_time_t sent_time;
+    unsigned int active : 1;
+    unsigned int acked : 1;
+    unsigned int failed : 1;
+} block_upload_t;
+
 typedef struct {
 	uint8_t	*data_ptr;
 	uint16_t state, sensor_no;
 	wiced_time_t last_upload_time;
 	message_t *msg;
+	in_flight_t in_flight[ IMATRIX_MAX_IN_FLIGHT ];   // Confirmable packets waiting for an ACK
+	uint16_t window, no_in_flight;
+	wiced_time_t drain_start;
+	uint32_t drain_samples, drain_packets;          // Current backlog drain
+	uint32_t last_drain_ms, last_drain_samples, last_drain_packets;
+	uint32_t ack_timeouts;
+	block_upload_t block;
+	uint32_t block_uploads, block_failures;
 	unsigned int tusnami_warning : 1;
+	unsigned int backlog : 1;                       // Last packet was full, there is more to send
+	unsigned int draining : 1;
 } imatrix_data_t;
 /******************************************************
  *                    Structures
@@ -121,6 +169,13 @@ typedef struct {
 /******************************************************
  *               Function Declarations
  ******************************************************/
+static void add_in_flight( uint16_t id, wiced_time_t current_time, spill_range_t *spill_range );
+static void expire_in_flight( wiced_time_t current_time );
+static void update_drain_stats( uint16_t packet_samples, wiced_time_t current_time );
+static bool start_block_upload( imx_peripheral_type_t type, imx_control_sensor_block_t *csb, control_sensor_data_t *csd,
+        uint16_t var_data_index, wiced_utc_time_ms_t upload_utc_ms_time );
+static bool send_block( wiced_time_t current_time );
+static void end_block_upload( bool sent );
 
 /******************************************************
  *               Variable Definitions
@@ -133,7 +188,7 @@ extern iMatrix_Control_Block_t icb;
 extern control_sensor_data_t *cd;
 extern control_sensor_data_t *sd;
 
-static imatrix_data_t imatrix;
+static imatrix_data_t imatrix = { .window = IMATRIX_UPLOAD_WINDOW };
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -144,8 +199,17 @@ static imatrix_data_t imatrix;
   */
 void init_imatrix(void)
 {
+	uint16_t i;
+
 	imatrix.state = IMATRIX_INIT;
 	wiced_time_get_time( &imatrix.last_upload_time );
+	for( i = 0; i < IMATRIX_MAX_IN_FLIGHT; i++ )
+	    if( imatrix.in_flight[ i ].active == true )
+	        spill_resend( &imatrix.in_flight[ i ].spill );
+	memset( imatrix.in_flight, 0x00, sizeof( imatrix.in_flight ) );
+	imatrix.no_in_flight = 0;
+	imatrix.backlog = false;
+	imatrix.draining = false;
 }
 
 /**
@@ -180,14 +244,14 @@ void imatrix_upload(wiced_time_t current_time)
     const uint16_t max_options_length = 30;
 
     uint8_t options[ max_options_length ], uri_path[ URI_PATH_LENGTH ], *data_ptr;
-    uint16_t packet_length, current_option_number, options_length, remaining_data_length, no_samples, i, j, k, variable_data_length, data_index, var_data_index;
-    bool packet_full, entry_loaded;
+    uint16_t packet_length, current_option_number, options_length, remaining_data_length, no_samples, i, k, variable_data_length, data_index, var_data_index;
+    bool packet_full, entry_loaded, skip_entry;
     uint32_t foo32bit;
     wiced_utc_time_ms_t upload_utc_ms_time;
-    wiced_iso8601_time_t iso8601_time;
     imx_peripheral_type_t type;
-    bits_t header_bits;
+    uint16_t block_type, sensor_error, packet_samples, msg_id;
     upload_data_t *upload_data;
+    spill_range_t spill_range;
     control_sensor_data_t *csd;
     imx_control_sensor_block_t *csb;
     uint16_t no_items;
@@ -258,6 +322,14 @@ void imatrix_upload(wiced_time_t current_time)
             		}
         		}
 
+    	    }
+    	    /*
+    	     * Samples spilled to flash during an outage
+    	     */
+    	    if( ( imatrix.state == IMATRIX_INIT ) && ( spill_unsent() == true ) &&
+    	        ( imx_is_later( current_time, imatrix.last_upload_time + device_config.imatrix_batch_check_time ) ) ) {
+    	        PRINTF( "Found %lu spilled records to send\r\n", spill_pending() );
+    	        imatrix.state = IMATRIX_GET_PACKET;
     	    }
     		break;
     	case IMATRIX_GET_PACKET :	// There is data to process get a packet to put it in
@@ -307,8 +379,7 @@ void imatrix_upload(wiced_time_t current_time)
     	            (unsigned int ) ( ( icb.imatrix_public_ip_address.ip.v4 & 0x000000ff ) ) );
     	    if( icb.time_set_with_NTP == true ) {
     	        wiced_time_get_utc_time_ms( &upload_utc_ms_time );
-    	    	wiced_time_get_iso8601_time( &iso8601_time );
-    	    	PRINTF( "System UTC time is: %.26s\r\n", (char*)&iso8601_time );
+    	    	PRINTF( "System UTC time is: %lu Seconds (past 1970)\r\n", (uint32_t) ( upload_utc_ms_time / 1000 ) );
     	    	icb.imatrix_upload_count += 1;
     	    } else {
     	    	PRINTF( "System does not have NTP - Sending with 0 for time stamp\r\n" );
@@ -361,6 +432,7 @@ void imatrix_upload(wiced_time_t current_time)
 	        remaining_data_length = imatrix.msg->coap.data_block->release_list_for_data_size->data_size - ( token_length + options_length + 1 );
         	upload_data = ( upload_data_t *) &imatrix.msg->coap.data_block->data[ token_length + options_length + 1 ];
         	packet_full = false;
+        	packet_samples = 0;
         	/*
         	 * Check if we are sending a registration request
         	 */
@@ -382,6 +454,13 @@ void imatrix_upload(wiced_time_t current_time)
         		icb.send_indoor_coords = false;
         		add_indoor_location( &upload_data, &remaining_data_length, upload_utc_ms_time );
         	}
+        	/*
+        	 * Samples spilled to flash are older than anything in the history, send them first
+        	 */
+        	if( imatrix.tusnami_warning == false )
+        	    packet_samples += spill_upload( &upload_data, &remaining_data_length, &packet_full, &spill_range );
+        	else
+        	    memset( &spill_range, 0, sizeof( spill_range_t ) );
         	/*
         	 * Step thru type records - Controls first then Sensors.
         	 *
@@ -407,6 +486,7 @@ void imatrix_upload(wiced_time_t current_time)
                              * ADD logic for WHILE LOOP to continue processing variable length data if available.
                              */
                             entry_loaded = false;
+                            skip_entry = false;
                             if( ( ( csd[ i ].no_samples > 0 ) && ( csd[ i ].warning != csd[ i ].last_warning ) && ( k == CHECK_WARNING )  ) ||
                                 ( ( csd[ i ].no_samples > 0 ) && ( k == CHECK_REGULAR ) ) ||
                                 ( csd[ i ].send_on_error == true ) ) {
@@ -427,8 +507,8 @@ void imatrix_upload(wiced_time_t current_time)
                                              var_data_index = 0;
                                          }
 
-                                        variable_data_length = csd[ i ].data[ var_data_index ].var_data->length; // Events have timestamp / Value pairs
-                                        PRINTF( "Trying to add variable length data record, ptr @ 0x%08lx of: %u bytes\r\n", csd[ i ].data[ var_data_index ].uint_32bit, variable_data_length );
+                                        variable_data_length = history_entry( &csd[ i ], var_data_index )->var_data->length; // Events have timestamp / Value pairs
+                                        PRINTF( "Trying to add variable length data record, ptr @ 0x%08lx of: %u bytes\r\n", history_entry( &csd[ i ], var_data_index )->uint_32bit, variable_data_length );
                                         if( remaining_data_length >= ( sizeof( header_t ) + variable_data_length ) ) {
                                             /*
                                              * Load data into packet
@@ -440,37 +520,29 @@ void imatrix_upload(wiced_time_t current_time)
                                             /*
                                              * Set up the header and copy in the data
                                              */
-                                            upload_data->header.id = htonl( csb[ i ].id );
-                                            header_bits.bits.data_type = csb[ i ].data_type;
-                                            upload_data->header.sample_rate = htonl( csb[ i ].sample_rate );
                                             if( csb[ i ].sample_rate != 0 ) {
                                                 /*
                                                  * These are individual sensor readings over time sample time
                                                  */
-                                                header_bits.bits.block_type = type == IMX_CONTROLS ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
+                                                block_type = type == IMX_CONTROLS ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
                                             } else {
                                                 /*
                                                  * These are a set of Events
                                                  */
-                                                header_bits.bits.block_type = type == IMX_CONTROLS ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
+                                                block_type = type == IMX_CONTROLS ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
                                                 PRINTF( "- Sending Event Block" );
                                             }
-                                            header_bits.bits.no_samples = 1;            // Limit to 1 sample - enhance later
-                                            header_bits.bits.version = IMATRIX_VERSION_1;
-                                            header_bits.bits.warning = csd[ i ].warning;
                                             if( csd[ i ].errors > 0 ) {
-                                                header_bits.bits.sensor_error = csd[ i ].error;
+                                                sensor_error = csd[ i ].error;
                                                 csd[ i ].errors = 0;
                                                 PRINTF( " --- Errors detected with this entry: %u", (uint16_t) csd[ i ].error );
                                             } else
-                                                header_bits.bits.sensor_error = 0;
+                                                sensor_error = 0;
                                             PRINTF( "\r\n" );
-                                            header_bits.bits.reserved = 0;
-                                            upload_data->header.bits.bit_data = htonl( header_bits.bit_data );
+                                            encode_header( &upload_data->header, csb[ i ].id, csb[ i ].sample_rate,
+                                                    encode_header_bits( block_type, csb[ i ].data_type, 1, csd[ i ].warning, sensor_error ),    // Limit to 1 sample - enhance later
+                                                    upload_utc_ms_time );
                                             PRINTF( "Header bits: 0x%08lx\r\n", upload_data->header.bits.bit_data );
-                                            upload_data->header.last_utc_ms_sample_time = 0;
-                                            if( icb.time_set_with_NTP == true )
-                                                upload_data->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
 
                                             data_index = 0;
                                             /*
@@ -480,12 +552,12 @@ void imatrix_upload(wiced_time_t current_time)
                                                 /*
                                                  * This is an event entry - put timestamp in first
                                                  */
-                                                upload_data->data[ data_index++ ].uint_32bit = htonl( csd[ i ].data[ 0 ].uint_32bit );
+                                                upload_data->data[ data_index++ ].uint_32bit = htonl( history_entry( &csd[ i ], 0 )->uint_32bit );
                                                 no_samples = 2; // Two samples for event data
                                              } else {
                                                 no_samples = 1; // One sample for Time Series data
                                              }
-                                            data_ptr =  csd[ i ].data[ var_data_index ].var_data->data;
+                                            data_ptr =  history_entry( &csd[ i ], var_data_index )->var_data->data;
                                             /*
                                              * Data for variable length data is stored in a structure with the length in the header.
                                              */
@@ -500,24 +572,24 @@ void imatrix_upload(wiced_time_t current_time)
                                             PRINTF( "\r\n" );
     */
                                             memcpy( &upload_data->data[ data_index ], data_ptr, variable_data_length );
+                                            packet_samples += no_samples;
                                             /*
                                              * Now this data is loaded in structure, free up resources
                                              */
                                             PRINTF( "About to free data\r\n" );
-                                            imx_add_var_free_pool( csd[ i ].data[ var_data_index ].var_data );
+                                            imx_add_var_free_pool( history_entry( &csd[ i ], var_data_index )->var_data );
                                             /*
                                              * Move up the data and re calculate the last sample time
                                              */
                                             if( csd[ i ].no_samples == no_samples ) {
-                                                csd[ i ].no_samples = 0;   // No need to move any data
+                                                history_reset( &csd[ i ] );   // No need to move any data
                                                 csd[ i ].send_batch = false;
                                             } else {
                                                 /*
-                                                 * Move data up and free up variable data records
+                                                 * Drop the used entries and re calculate the last sample time
                                                  */
-                                                memmove( &csd[ i ].data[ 0 ].uint_32bit, &csd[ i ].data[ no_samples ].uint_32bit, IMX_SAMPLE_LENGTH * no_samples );
                                                 upload_data->header.last_utc_ms_sample_time = htonll( (uint64_t) upload_utc_ms_time - ( csb[ i ].sample_rate * ( csd[ i ].no_samples - no_samples ) ) );
-                                                csd[ i ].no_samples = csd[ i ].no_samples - no_samples;
+                                                history_drop_oldest( &csd[ i ], no_samples );
                                             }
                                             /*
                                             * Update the pointer and amount number of bytes left in buffer
@@ -533,33 +605,22 @@ void imatrix_upload(wiced_time_t current_time)
                                             remaining_data_length -= foo32bit;
                                             entry_loaded = true;
                                             PRINTF( "Added %lu Bytes, index @: 0x%08lx  , %u Bytes remaining in packet\r\n", foo32bit, (uint32_t) upload_data, remaining_data_length );
+                                        } else if( variable_data_length >= MAX_VARIABLE_LENGTH ) {
+                                            /*
+                                             * Variable length data too big for ANY UDP packet is sent on its own in blocks once this packet is sent.
+                                             * Only one is sent at a time, until then this sensor is skipped so the others are not held up behind it
+                                             */
+                                            if( ( imatrix.block.active == false ) &&
+                                                ( start_block_upload( type, &csb[ i ], &csd[ i ], var_data_index, upload_utc_ms_time ) == true ) ) {
+                                                PRINTF( "Sending Variable length data in blocks, %u Bytes\r\n", variable_data_length );
+                                                packet_full = true;
+                                            } else
+                                                skip_entry = true;
                                         } else {
                                             /*
                                              *  Can not fit in this packet
                                              */
                                             packet_full = true;
-                                            /*
-                                             * Check for long variable length packet that is too big for ANY UDP packet, and discard
-                                             */
-                                            if( (variable_data_length >= MAX_VARIABLE_LENGTH ) ) {
-                                                imx_printf( "Discarding Variable length data, too long to process, %u Bytes\r\n", variable_data_length );
-                                                /*
-                                                 * If it is not the current value free up resources
-                                                 */
-                                                if( csd[ i ].last_value.var_data != csd[ i ].data[ var_data_index ].var_data ) {
-                                                    PRINTF( "About to free data\r\n" );
-                                                    imx_add_var_free_pool( csd[ i ].data[ var_data_index ].var_data );
-                                                    /*
-                                                     * Move data up in history
-                                                     */
-                                                    memmove( &csd[ i ].data[ 0 ].uint_32bit, &csd[ i ].data[ 1 ].uint_32bit, IMX_SAMPLE_LENGTH * 1 );
-                                                }
-                                                /*
-                                                 * Sanity check
-                                                 */
-                                                if( csd[ i ].no_samples > 0 )
-                                                    csd[ i ].no_samples -= 1;
-                                            }
                                         }
                                         if( csd[ i ].no_samples == 0 )
                                             csd[ i ].send_batch = false;
@@ -592,59 +653,46 @@ void imatrix_upload(wiced_time_t current_time)
                                             /*
                                              * Set up the header and copy in the samples that will fit
                                              */
-                                            upload_data->header.id = htonl( csb[ i ].id );
-                                            header_bits.bits.data_type = csb[ i ].data_type;
-                                            upload_data->header.sample_rate = htonl( csb[ i ].sample_rate );
                                             if( csb[ i ].sample_rate == 0 ) {
                                                 /*
                                                  * These are a set of Events
                                                  */
-                                                header_bits.bits.block_type = type == IMX_CONTROLS ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
+                                                block_type = type == IMX_CONTROLS ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
                                                 PRINTF( "- Sending Event Block" );
                                             } else {
                                                 /*
                                                  * These are individual sensor readings over time sample time
                                                  */
-                                                header_bits.bits.block_type = type == IMX_CONTROLS ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
+                                                block_type = type == IMX_CONTROLS ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
                                             }
-
-                                            header_bits.bits.no_samples = no_samples;
-                                            header_bits.bits.version = IMATRIX_VERSION_1;
-                                            header_bits.bits.warning = csd[ i ].warning;
                                             if( csd[ i ].errors > 0 ) {
-                                                header_bits.bits.sensor_error = csd[ i ].error;
+                                                sensor_error = csd[ i ].error;
                                                 csd[ i ].errors = 0;
                                                 PRINTF( " --- Errors detected with this entry: %u", (uint16_t) csd[ i ].error );
                                             } else
-                                                header_bits.bits.sensor_error = 0;
+                                                sensor_error = 0;
                                             PRINTF( "\r\n" );
-                                            header_bits.bits.reserved = 0;
-                                            upload_data->header.bits.bit_data = htonl( header_bits.bit_data );
-                                            upload_data->header.last_utc_ms_sample_time = 0;
-                                            if( icb.time_set_with_NTP == true )
-                                                upload_data->header.last_utc_ms_sample_time = htonll( upload_utc_ms_time );
+                                            encode_header( &upload_data->header, csb[ i ].id, csb[ i ].sample_rate,
+                                                    encode_header_bits( block_type, csb[ i ].data_type, no_samples, csd[ i ].warning, sensor_error ), upload_utc_ms_time );
                                             PRINTF( "Header bits: 0x%08lx, id: 0x%08lx, Sample Rate: %ld\r\n", upload_data->header.bits.bit_data, upload_data->header.id, upload_data->header.sample_rate );
 
-                                            for( j = 0; j < no_samples; j++ ) {
-                                                /*
-                                                 * Raw copy the data so sign & float are not cast
-                                                 */
-                                                memcpy( &foo32bit, &csd[ i ].data[ j ].uint_32bit, IMX_SAMPLE_LENGTH );
-                                                upload_data->data[ j ].uint_32bit = htonl( foo32bit );
-                                            }
+                                            /*
+                                             * Encode the whole run in network order, the history may wrap so it is done in order
+                                             */
+                                            encode_history( &csd[ i ], (uint8_t *) upload_data->data, no_samples );
+                                            packet_samples += no_samples;
                                             /*
                                              * Update the structure based on how many items were used
                                              */
                                             if( no_samples == csd[ i ].no_samples ) {
-                                                csd[ i ].no_samples = 0;
+                                                history_reset( &csd[ i ] );
                                                 csd[ i ].send_batch = false;
                                             } else {
                                                 /*
-                                                 * Move up the data and re calculate the last sample time
+                                                 * Drop the used entries and re calculate the last sample time
                                                  */
-                                                memmove( &csd[ i ].data[ 0 ].uint_32bit, &csd[ i ].data[ no_samples ].uint_32bit, IMX_SAMPLE_LENGTH * no_samples );
                                                 upload_data->header.last_utc_ms_sample_time = htonll( (uint64_t) upload_utc_ms_time - ( csb[ i ].sample_rate * ( csd[ i ].no_samples - no_samples ) ) );
-                                                csd[ i ].no_samples = csd[ i ].no_samples - no_samples;
+                                                history_drop_oldest( &csd[ i ], no_samples );
                                                 entry_loaded = true;
                                             }
                                             /*
@@ -654,8 +702,8 @@ void imatrix_upload(wiced_time_t current_time)
                                             upload_data = ( upload_data_t *) ( ( uint32_t) ( upload_data ) + foo32bit );
                                             remaining_data_length -= foo32bit;
                                             PRINTF( "Added %lu Bytes, index @: 0x%08lx, %u Bytes remaining in packet\r\n", foo32bit, (uint32_t) upload_data, remaining_data_length );
-#ifdef PRINT_DEBUGS_FOR_IMX_UPLOAD
-                                            if( ( device_config.log_messages & DEBUGS_FOR_IMX_UPLOAD ) != 0x00 ) {
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_IMX_UPLOAD )
+                                            if( IMX_DEBUG_ACTIVE( IMX_DEBUG_LEVEL_DEBUG, DEBUGS_FOR_IMX_UPLOAD ) ) {
                                                 PRINTF( "Data @: 0x%08lx\r\n", (uint32_t) imatrix.msg->coap.data_block->data );
                                                 PRINTF( "Message DATA as string:" );
                                                 if (imatrix.msg->coap.data_block != NULL ) {
@@ -684,7 +732,7 @@ void imatrix_upload(wiced_time_t current_time)
 
                                     if( packet_full == true )
                                         PRINTF( "\r\niMatrix Packet FULL\r\n" );
-                                } while( ( packet_full == false ) && (entry_loaded == false ) );   /* Add logic for multiple variable length data processing */
+                                } while( ( packet_full == false ) && (entry_loaded == false ) && ( skip_entry == false ) );   /* Add logic for multiple variable length data processing */
                             } else {
                                 /*
                                  * Nothing matched in this entry
@@ -716,13 +764,53 @@ void imatrix_upload(wiced_time_t current_time)
 	         * Add this message to the xmit que and start a transmit
 	         */
 	        print_msg( imatrix.msg );
+	        msg_id = imatrix.msg->coap.header.id;
 	        list_add( &list_udp_coap_xmit, imatrix.msg );
     	    PRINTF( "Time Series Data message added to queue\r\n" );
+    	    add_in_flight( msg_id, current_time, &spill_range );
+    	    imatrix.backlog = packet_full;
+    	    update_drain_stats( packet_samples, current_time );
 	        imatrix.state = IMATRIX_UPLOAD_COMPLETE;
     		break;
     	case IMATRIX_UPLOAD_COMPLETE :
     	    imx_set_led( IMX_LED_GREEN, IMX_LED_OFF, 0 );         // Set GREEN LED off - Packet sent
-    	    imatrix.state = IMATRIX_INIT;
+    	    expire_in_flight( current_time );
+    	    if( imatrix.block.active == true )
+    	        imatrix.state = IMATRIX_BLOCK_SEND;
+    	    else if( ( imatrix.backlog == true ) && ( imatrix.window > 1 ) ) {
+    	        /*
+    	         * Draining a backlog - build the next packet as soon as there is room in the window, don't wait for the next check time
+    	         */
+    	        if( imatrix.no_in_flight < imatrix.window ) {
+    	            imatrix.tusnami_warning = false;
+    	            imatrix.state = IMATRIX_GET_PACKET;
+    	        }
+    	    } else
+    	        imatrix.state = IMATRIX_INIT;
+    	    break;
+    	case IMATRIX_BLOCK_SEND :
+    	    if( send_block( current_time ) == true )
+    	        imatrix.state = IMATRIX_BLOCK_WAIT;
+    	    else if( imx_is_later( current_time, imatrix.block.sent_time + IMATRIX_BLOCK_TIMEOUT ) ) {
+    	        end_block_upload( false );     // Could not get a packet for too long
+    	        imatrix.state = IMATRIX_INIT;
+    	    }
+    	    break;
+    	case IMATRIX_BLOCK_WAIT :
+    	    if( imatrix.block.failed == true ) {
+    	        end_block_upload( false );
+    	        imatrix.state = IMATRIX_INIT;
+    	    } else if( imatrix.block.acked == true ) {
+    	        imatrix.block.num += 1;
+    	        if( ( (uint32_t) imatrix.block.num * IMATRIX_BLOCK_SIZE ) >= imatrix.block.total_length ) {
+    	            end_block_upload( true );
+    	            imatrix.state = IMATRIX_INIT;
+    	        } else
+    	            imatrix.state = IMATRIX_BLOCK_SEND;
+    	    } else if( imx_is_later( current_time, imatrix.block.sent_time + IMATRIX_BLOCK_TIMEOUT ) ) {
+    	        end_block_upload( false );
+    	        imatrix.state = IMATRIX_INIT;
+    	    }
     	    break;
     	default:
     	    imatrix.state = IMATRIX_INIT;
@@ -892,7 +980,27 @@ void imatrix_status( uint16_t arg)
     control_sensor_data_t *csd;
     imx_control_sensor_block_t *csb;
     uint16_t no_items;
-
+    char *token;
+
+    /*
+     * imx [ window <no packets in flight> ]
+     */
+    token = strtok( NULL, " " );
+    if( token ) {
+        if( strcmp( token, "window" ) == 0 ) {
+            token = strtok( NULL, " " );
+            if( token ) {
+                i = (uint16_t) atoi( token );
+                if( ( i >= 1 ) && ( i <= IMATRIX_MAX_IN_FLIGHT ) )
+                    imatrix.window = i;
+                else
+                    imx_cli_print( "Window must be 1 - %u packets\r\n", IMATRIX_MAX_IN_FLIGHT );
+            }
+            imx_cli_print( "iMatrix upload window: %u packets\r\n", imatrix.window );
+        } else
+            imx_cli_print( "Invalid option, imx [ window <1 - %u> ]\r\n", IMATRIX_MAX_IN_FLIGHT );
+        return;
+    }
     wiced_time_get_time( &current_time );
 
 	imx_cli_print( "iMatrix Max Batch Buffer length: %u entries, iMatrix state: ", device_config.history_size );
@@ -917,20 +1025,20 @@ void imatrix_status( uint16_t arg)
                             if( csb[ i ].sample_rate == 0 ) {
                                 imx_cli_print( "Event Driven: " );
                                 for( j = 0; j < csd[ i ].no_samples; j += 2 ) {
-                                    imx_cli_print( "@ %lu, ", csd[ i ].data[ j ].uint_32bit );
+                                    imx_cli_print( "@ %lu, ", history_entry( &csd[ i ], j )->uint_32bit );
                                     switch( csb[ i ].data_type ) {
                                         case IMX_UINT32 :
-                                            imx_cli_print( "%lu ", csd[ i ].data[ j + 1 ].uint_32bit );
+                                            imx_cli_print( "%lu ", history_entry( &csd[ i ], j + 1 )->uint_32bit );
                                             break;
                                         case IMX_INT32 :
-                                            imx_cli_print( "%ld ", csd[ i ].data[ j + 1 ].int_32bit );
+                                            imx_cli_print( "%ld ", history_entry( &csd[ i ], j + 1 )->int_32bit );
                                             break;
                                         case IMX_FLOAT :
-                                            imx_cli_print( "%f ", csd[ i ].data[ j + 1 ].float_32bit );
+                                            imx_cli_print( "%f ", history_entry( &csd[ i ], j + 1 )->float_32bit );
                                             break;
                                         case IMX_VARIABLE_LENGTH :
                                             imx_cli_print( "[%u] ", csd[ i ].last_value.var_data->length );
-                                            print_var_data( VR_DATA_STRING, csd[ i ].data[ j + 1 ].var_data );
+                                            print_var_data( VR_DATA_STRING, history_entry( &csd[ i ], j + 1 )->var_data );
                                             imx_cli_print( " " );
                                             break;
                                     }
@@ -939,13 +1047,13 @@ void imatrix_status( uint16_t arg)
                                 for( j = 0; j < csd[ i ].no_samples; j++ ) {
                                     switch( csb[ i ].data_type ) {
                                         case IMX_UINT32 :
-                                            imx_cli_print( "%lu ", csd[ i ].data[ j ].uint_32bit );
+                                            imx_cli_print( "%lu ", history_entry( &csd[ i ], j )->uint_32bit );
                                             break;
                                         case IMX_INT32 :
-                                            imx_cli_print( "%ld ", csd[ i ].data[ j ].int_32bit );
+                                            imx_cli_print( "%ld ", history_entry( &csd[ i ], j )->int_32bit );
                                             break;
                                         case IMX_FLOAT :
-                                            imx_cli_print( "%f ", csd[ i ].data[ j ].float_32bit );
+                                            imx_cli_print( "%f ", history_entry( &csd[ i ], j )->float_32bit );
                                             break;
                                         case IMX_VARIABLE_LENGTH :
                                             print_var_data( VR_DATA_STRING, csd[ i ].last_value.var_data );
@@ -977,10 +1085,16 @@ void imatrix_status( uint16_t arg)
     	case IMATRIX_UPLOAD_COMPLETE :
     		imx_cli_print( "History sending complete\r\n" );
     		break;
+    	case IMATRIX_BLOCK_SEND :
+    	case IMATRIX_BLOCK_WAIT :
+    		imx_cli_print( "Sending variable length data in blocks, block %u of %u\r\n", imatrix.block.num + 1,
+    		        ( imatrix.block.total_length + IMATRIX_BLOCK_SIZE - 1 ) / IMATRIX_BLOCK_SIZE );
+    		break;
     	default:
     		imx_cli_print( "Unknown\r\n" );
     		break;
     }
+    print_imatrix_throughput();
 }
 /**
   * @brief Display current status and time before next upload
@@ -997,3 +1111,291 @@ void print_imatrix_config(void)
 	imx_cli_print( " iMatrix Uploads: %lu, upload check interval: %lu\r\n", icb.imatrix_upload_count, device_config.imatrix_batch_check_time );
 
 }
+/**
+  * @brief  Print the upload window and the backlog drain throughput
+  * @param  None
+  * @retval : None
+  */
+void print_imatrix_throughput(void)
+{
+    wiced_time_t current_time;
+    uint32_t elapsed;
+
+    imx_cli_print( "iMatrix upload window: %u, In flight: %u, ACK timeouts: %lu", imatrix.window, imatrix.no_in_flight, imatrix.ack_timeouts );
+    if( ( imatrix.block_uploads > 0 ) || ( imatrix.block_failures > 0 ) )
+        imx_cli_print( ", Block uploads: %lu, Failed: %lu", imatrix.block_uploads, imatrix.block_failures );
+    if( imatrix.draining == true ) {
+        wiced_time_get_time( &current_time );
+        elapsed = (uint32_t) ( current_time - imatrix.drain_start );
+        imx_cli_print( ", Draining: %lu Samples, %lu Packets in %lu mS", imatrix.drain_samples, imatrix.drain_packets, elapsed );
+    }
+    if( imatrix.last_drain_ms > 0 )
+        imx_cli_print( ", Last drain: %lu Samples/Sec, %lu.%02lu Packets/Sec",
+                ( imatrix.last_drain_samples * 1000L ) / imatrix.last_drain_ms,
+                ( imatrix.last_drain_packets * 1000L ) / imatrix.last_drain_ms,
+                ( ( imatrix.last_drain_packets * 100000L ) / imatrix.last_drain_ms ) % 100 );
+    imx_cli_print( "\r\n" );
+}
+/**
+  * @brief  An ACK or RST was received - free the slot in the upload window if it was for one of our packets
+  * @param  CoAP message id
+  * @retval : None
+  */
+void imatrix_upload_ack( uint16_t id )
+{
+    uint16_t i;
+
+    if( ( imatrix.block.active == true ) && ( imatrix.block.msg_id == id ) ) {
+        imatrix.block.acked = true;
+        return;
+    }
+
+    for( i = 0; i < IMATRIX_MAX_IN_FLIGHT; i++ ) {
+        if( ( imatrix.in_flight[ i ].active == true ) && ( imatrix.in_flight[ i ].id == id ) ) {
+            spill_acked( &imatrix.in_flight[ i ].spill );
+            imatrix.in_flight[ i ].active = false;
+            imatrix.no_in_flight -= 1;
+            PRINTF( "iMatrix upload ACK for: 0x%04x, %u in flight\r\n", id, imatrix.no_in_flight );
+            return;
+        }
+    }
+}
+/**
+  * @brief  Record a packet sent to iMatrix that is waiting for an ACK
+  * @param  CoAP message id, current time, spilled records in the packet
+  * @retval : None
+  */
+static void add_in_flight( uint16_t id, wiced_time_t current_time, spill_range_t *spill_range )
+{
+    uint16_t i, oldest;
+
+    oldest = 0;
+    for( i = 0; i < IMATRIX_MAX_IN_FLIGHT; i++ ) {
+        if( imatrix.in_flight[ i ].active == false )
+            break;
+        if( imx_is_later( imatrix.in_flight[ oldest ].sent_time, imatrix.in_flight[ i ].sent_time ) )
+            oldest = i;
+    }
+    if( i == IMATRIX_MAX_IN_FLIGHT ) {
+        /*
+         * No room, window was reduced while packets were in flight - reuse the oldest
+         */
+        i = oldest;
+        imatrix.ack_timeouts += 1;
+        spill_resend( &imatrix.in_flight[ i ].spill );
+    } else
+        imatrix.no_in_flight += 1;
+    imatrix.in_flight[ i ].id = id;
+    imatrix.in_flight[ i ].sent_time = current_time;
+    imatrix.in_flight[ i ].spill = *spill_range;
+    imatrix.in_flight[ i ].active = true;
+}
+/**
+  * @brief  Free slots in the upload window that have waited too long for an ACK, spilled records in them are sent again
+  * @param  current time
+  * @retval : None
+  */
+static void expire_in_flight( wiced_time_t current_time )
+{
+    uint16_t i;
+
+    for( i = 0; i < IMATRIX_MAX_IN_FLIGHT; i++ ) {
+        if( ( imatrix.in_flight[ i ].active == true ) &&
+            ( imx_is_later( current_time, imatrix.in_flight[ i ].sent_time + IMATRIX_ACK_TIMEOUT ) ) ) {
+            spill_resend( &imatrix.in_flight[ i ].spill );
+            imatrix.in_flight[ i ].active = false;
+            imatrix.no_in_flight -= 1;
+            imatrix.ack_timeouts += 1;
+        }
+    }
+}
+/**
+  * @brief  Track throughput while a backlog is drained, a drain starts with a full packet and ends with one that is not
+  * @param  samples in packet just sent, current time
+  * @retval : None
+  */
+static void update_drain_stats( uint16_t packet_samples, wiced_time_t current_time )
+{
+    if( imatrix.draining == false ) {
+        if( imatrix.backlog == false )
+            return;
+        imatrix.draining = true;
+        imatrix.drain_start = current_time;
+        imatrix.drain_samples = 0;
+        imatrix.drain_packets = 0;
+    }
+    imatrix.drain_samples += packet_samples;
+    imatrix.drain_packets += 1;
+    if( imatrix.backlog == false ) {
+        imatrix.draining = false;
+        imatrix.last_drain_ms = (uint32_t) ( current_time - imatrix.drain_start );
+        if( imatrix.last_drain_ms == 0 )
+            imatrix.last_drain_ms = 1;
+        imatrix.last_drain_samples = imatrix.drain_samples;
+        imatrix.last_drain_packets = imatrix.drain_packets;
+    }
+}
+/**
+  * @brief  A response to a block of a Block1 upload - anything other than 2.31 Continue or success ends the upload
+  * @param  CoAP message id, type and code
+  * @retval : None
+  */
+void imatrix_upload_block_response( uint16_t id, uint16_t type, uint16_t code )
+{
+    if( ( imatrix.block.active == false ) || ( imatrix.block.msg_id != id ) )
+        return;
+    if( ( type == RESET ) || ( MSG_CLASS( code ) == CLIENT_ERROR ) || ( MSG_CLASS( code ) == SERVER_ERROR ) ) {
+        PRINTF( "iMatrix block upload refused, Code: %u.%02u\r\n", MSG_CLASS( code ), MSG_DETAIL( code ) );
+        imatrix.block.failed = true;
+    }
+}
+/**
+  * @brief  Take a variable length sample too big for a packet out of the history to send in blocks
+  *         The upload owns the data it sends and returns it to the pool when done
+  * @param  type, csb, csd entry, index of the variable length data in the history, upload time
+  * @retval : true if the upload was started, false if no buffer was available for a copy of the data
+  */
+static bool start_block_upload( imx_peripheral_type_t type, imx_control_sensor_block_t *csb, control_sensor_data_t *csd,
+        uint16_t var_data_index, wiced_utc_time_ms_t upload_utc_ms_time )
+{
+    uint16_t block_type, data_index, sensor_error;
+    upload_data_t *upload_data;
+    var_data_entry_t *var_data;
+
+    var_data = history_entry( csd, var_data_index )->var_data;
+    if( var_data == csd->last_value.var_data ) {
+        /*
+         * A sampled value shares its buffer with the current value, which is freed when the next value is set - send a copy
+         */
+        imatrix.block.var_data = imx_get_var_data( var_data->length );
+        if( imatrix.block.var_data == NULL )
+            return false;
+        memcpy( imatrix.block.var_data->data, var_data->data, var_data->length );
+        imatrix.block.var_data->length = var_data->length;
+    } else
+        imatrix.block.var_data = var_data;     // The history entry's own buffer, handed over with the entry
+
+    if( csb->sample_rate == 0 )
+        block_type = type == IMX_CONTROLS ? IMX_BLOCK_EVENT_CONTROL : IMX_BLOCK_EVENT_SENSOR;
+    else
+        block_type = type == IMX_CONTROLS ? IMX_BLOCK_CONTROL : IMX_BLOCK_SENSOR;
+    if( csd->errors > 0 ) {
+        sensor_error = csd->error;
+        csd->errors = 0;
+    } else
+        sensor_error = 0;
+
+    var_data = imatrix.block.var_data;
+    memset( &imatrix.block, 0x00, sizeof( block_upload_t ) );
+    imatrix.block.var_data = var_data;
+    /*
+     * Same record as a variable length sample that fits in a packet - header, time stamp for events, length and the data
+     */
+    upload_data = (upload_data_t *) imatrix.block.prefix;
+    encode_header( &upload_data->header, csb->id, csb->sample_rate,
+            encode_header_bits( block_type, csb->data_type, 1, csd->warning, sensor_error ), upload_utc_ms_time );
+    data_index = 0;
+    if( csb->sample_rate == 0 )
+        upload_data->data[ data_index++ ].uint_32bit = htonl( history_entry( csd, 0 )->uint_32bit );
+    upload_data->data[ data_index++ ].uint_32bit = htonl( (uint32_t) imatrix.block.var_data->length );
+    imatrix.block.prefix_length = sizeof( header_t ) + ( data_index * IMX_SAMPLE_LENGTH );
+    imatrix.block.total_length = imatrix.block.prefix_length + imatrix.block.var_data->length;
+    wiced_time_get_time( &imatrix.block.sent_time );
+    imatrix.block.active = true;
+    /*
+     * Drop the entry from history - Events have timestamp / Value pairs
+     */
+    history_drop_oldest( csd, var_data_index + 1 );
+    return true;
+}
+/**
+  * @brief  Send the current block of a Block1 upload
+  * @param  current time
+  * @retval : true if the block was queued
+  */
+static bool send_block( wiced_time_t current_time )
+{
+    const uint16_t token_length = 4;
+    uint8_t options[ BLOCK_OPTIONS_LENGTH ], uri_path[ URI_PATH_LENGTH ], *data;
+    uint16_t current_option_number, options_length, offset, length, prefix_part;
+    bool more;
+    message_t *msg;
+
+    msg = msg_get( max_packet_size() );
+    if( ( msg == NULL ) || ( msg->coap.data_block == NULL ) || ( msg->coap.data_block->data == NULL ) ) {
+        if( msg != NULL )
+            msg_release( msg );
+        return false;
+    }
+    offset = imatrix.block.num * IMATRIX_BLOCK_SIZE;
+    length = imatrix.block.total_length - offset;
+    if( length > IMATRIX_BLOCK_SIZE )
+        length = IMATRIX_BLOCK_SIZE;
+    more = ( offset + length ) < imatrix.block.total_length;
+    /*
+     * Options in numerical order - Uri-Path, Content-Format, Block1 and the total size with the first block
+     */
+    memset( options, 0, BLOCK_OPTIONS_LENGTH );
+    current_option_number = 0;
+    sprintf( (char *) &uri_path,"isc/%lu/%s", device_config.manufactuer_id, (char *) &device_config.device_serial_number );
+    options_length = add_coap_str_option( URI_PATH, &current_option_number, (char *) &uri_path, options, BLOCK_OPTIONS_LENGTH );
+    options_length += add_coap_uint_option( CONTENT_FORMAT, BINARY_MEDIA_TYPE, &current_option_number,
+            options + options_length, BLOCK_OPTIONS_LENGTH - options_length );
+    options_length += add_coap_uint_option( BLOCK1, ( imatrix.block.num << 4 ) | ( more ? 0x08 : 0x00 ) | IMATRIX_BLOCK_SZX, &current_option_number,
+            options + options_length, BLOCK_OPTIONS_LENGTH - options_length );
+    if( imatrix.block.num == 0 )
+        options_length += add_coap_uint_option( SIZE1, imatrix.block.total_length, &current_option_number,
+                options + options_length, BLOCK_OPTIONS_LENGTH - options_length );
+
+    msg->coap.header.ver = 1;
+    msg->coap.header.t = CONFIRMABLE;
+    msg->coap.header.code = ( REQUEST << 5 ) | PUT;
+    msg->coap.header.id = message_id++;
+    msg->coap.header.tkl = token_length;
+    request_id += 1;
+    memmove( msg->coap.data_block->data, &request_id, token_length );
+    memmove( &msg->coap.data_block->data[ token_length ], options, options_length );
+    msg->coap.data_block->data[ token_length + options_length ] = PAYLOAD_START;
+    data = &msg->coap.data_block->data[ token_length + options_length + 1 ];
+    /*
+     * The record is the prefix followed by the variable length data, copy the part that is in this block
+     */
+    prefix_part = 0;
+    if( offset < imatrix.block.prefix_length ) {
+        prefix_part = imatrix.block.prefix_length - offset;
+        if( prefix_part > length )
+            prefix_part = length;
+        memcpy( data, &imatrix.block.prefix[ offset ], prefix_part );
+    }
+    memcpy( &data[ prefix_part ], &imatrix.block.var_data->data[ offset + prefix_part - imatrix.block.prefix_length ], length - prefix_part );
+    msg->coap.msg_length = token_length + options_length + 1 + length;
+
+    msg->coap.ip_addr.version = WICED_IPV4;
+    msg->coap.ip_addr.ip.v4 = icb.imatrix_public_ip_address.ip.v4;
+    msg->coap.port = DEFAULT_COAP_PORT;
+
+    imatrix.block.msg_id = msg->coap.header.id;
+    imatrix.block.acked = false;
+    imatrix.block.sent_time = current_time;
+    PRINTF( "Sending block %u, %u Bytes, more: %u\r\n", imatrix.block.num, length, more );
+    list_add( &list_udp_coap_xmit, msg );
+    return true;
+}
+/**
+  * @brief  Finish a Block1 upload and return the variable length data to the pool
+  * @param  true if all blocks were sent
+  * @retval : None
+  */
+static void end_block_upload( bool sent )
+{
+    if( imatrix.block.active == false )
+        return;
+    if( sent == true )
+        imatrix.block_uploads += 1;
+    else {
+        imatrix.block_failures += 1;
+        imx_printf( "Discarding Variable length data, block upload failed at block %u, %u Bytes\r\n", imatrix.block.num, imatrix.block.total_length );
+    }
+    imx_add_var_free_pool( imatrix.block.var_data );
+    imatrix.block.active = false;
+}
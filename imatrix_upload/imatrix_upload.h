@@ -72,4 +72,7 @@ void imatrix_production_upload( uint16_t mode );
 void imatrix_log( char *buffer );
 void imatrix_status( uint16_t arg);
 void print_imatrix_config(void);
+void print_imatrix_throughput(void);
+void imatrix_upload_ack( uint16_t id );
+void imatrix_upload_block_response( uint16_t id, uint16_t type, uint16_t code );
 #endif /* IMATRIX_UPLOAD_H_ */
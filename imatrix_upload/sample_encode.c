@@ -0,0 +1,171 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file sample_encode.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Encode block headers and runs of samples into an iMatrix upload packet in network byte order.
+ *  Used for controls, sensors, events and the internal entries added by add_internal.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../storage.h"
+#include "../device/icb_def.h"
+#include "../networking/utility.h"
+#include "sample_encode.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+/*
+ * Byte swap a whole word, compilers for the ARM targets turn the builtin into a single REV instruction
+ */
+#if defined( __GNUC__ ) && defined( __BYTE_ORDER__ ) && ( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+    #define SWAP_SAMPLE(x)  __builtin_bswap32( x )
+#else
+    #define SWAP_SAMPLE(x)  htonl( x )
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern iMatrix_Control_Block_t icb;
+extern IOT_Device_Config_t device_config;   // Defined in storage.h
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Build the header bits for a block in one step, the version is always the current one
+  *         Layout matches bits_t
+  * @param  block type, data type, number of samples, warning level, sensor error
+  * @retval : header bits in host byte order
+  */
+uint32_t encode_header_bits( uint16_t block_type, uint16_t data_type, uint16_t no_samples, uint16_t warning, uint16_t sensor_error )
+{
+    return ( (uint32_t) ( block_type & 0x0F ) )
+         | ( (uint32_t) ( data_type & 0x03 ) << 4 )
+         | ( (uint32_t) ( warning & 0x03 ) << 6 )
+         | ( (uint32_t) ( no_samples & 0xFF ) << 8 )
+         | ( (uint32_t) ( sensor_error & 0xFF ) << 16 )
+         | ( (uint32_t) ( IMATRIX_VERSION_1 & 0x07 ) << 24 );
+}
+/**
+  * @brief  Fill in a block header, the last sample time is only set once time is set with NTP
+  * @param  header, id, sample rate, header bits from encode_header_bits(), upload time
+  * @retval : None
+  */
+void encode_header( header_t *header, uint32_t id, uint32_t sample_rate, uint32_t header_bits, wiced_utc_time_ms_t upload_utc_ms_time )
+{
+    header->bits.bit_data = htonl( header_bits );
+    header->id = htonl( id );
+    header->sample_rate = htonl( sample_rate );
+    if( icb.time_set_with_NTP == true )
+        header->last_utc_ms_sample_time = htonll( upload_utc_ms_time );
+    else
+        header->last_utc_ms_sample_time = 0;
+}
+/**
+  * @brief  Copy a run of samples into the packet in network byte order in one pass
+  *         Raw 32 bit copy so sign & float are not cast. The packet is packed so the destination may not be word aligned
+  * @param  destination in packet, samples, number of samples
+  * @retval : None
+  */
+void encode_samples( uint8_t *dest, imx_data_32_t *src, uint16_t count )
+{
+    uint32_t word[ 4 ];
+
+    while( count >= 4 ) {
+        word[ 0 ] = SWAP_SAMPLE( src[ 0 ].uint_32bit );
+        word[ 1 ] = SWAP_SAMPLE( src[ 1 ].uint_32bit );
+        word[ 2 ] = SWAP_SAMPLE( src[ 2 ].uint_32bit );
+        word[ 3 ] = SWAP_SAMPLE( src[ 3 ].uint_32bit );
+        memcpy( dest, word, 4 * IMX_SAMPLE_LENGTH );
+        dest += 4 * IMX_SAMPLE_LENGTH;
+        src += 4;
+        count -= 4;
+    }
+    while( count > 0 ) {
+        word[ 0 ] = SWAP_SAMPLE( src[ 0 ].uint_32bit );
+        memcpy( dest, word, IMX_SAMPLE_LENGTH );
+        dest += IMX_SAMPLE_LENGTH;
+        src += 1;
+        count -= 1;
+    }
+}
+/**
+  * @brief  Encode the oldest entries of the history into the packet, at most two runs as the history may wrap
+  *         Entries are not removed, use history_drop_oldest() once they have been used
+  * @param  control / sensor data, destination in packet, number of entries wanted
+  * @retval : number of entries encoded
+  */
+uint16_t encode_history( control_sensor_data_t *csd, uint8_t *dest, uint16_t count )
+{
+    uint16_t first_part;
+
+    if( count > csd->no_samples )
+        count = csd->no_samples;
+    if( count == 0 )
+        return 0;
+    first_part = device_config.history_size - csd->start_index;
+    if( first_part >= count )
+        encode_samples( dest, &csd->data[ csd->start_index ], count );
+    else {
+        encode_samples( dest, &csd->data[ csd->start_index ], first_part );
+        encode_samples( dest + ( first_part * IMX_SAMPLE_LENGTH ), &csd->data[ 0 ], count - first_part );
+    }
+    return count;
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file ota_checkpoint.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Resume checkpoints for OTA downloads. Records are appended to a small log in unpartitioned serial flash, directly
+ *  above the trace mirror and clear of the configuration area. The log is at least two sectors of the part fitted so
+ *  the newest record survives the erase of the sector ahead of it. The sector is erased as the write position enters
+ *  it, a slot that is not blank, left by a write cut short, is skipped.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../storage.h"
+#include "../sflash/sflash.h"
+#include "../sflash/sflash_log.h"
+#include "../sflash/sflash_writer.h"
+#include "spi_flash_fast_erase.h"
+#include "../cli/interface.h"
+#include "ota_structure.h"
+#include "ota_checkpoint.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#ifndef OTA_CHECKPOINT_START
+#define OTA_CHECKPOINT_START        ( 0x3B0000 )    // Directly above the trace mirror, 64K aligned
+#endif
+#ifndef OTA_CHECKPOINT_SIZE
+#define OTA_CHECKPOINT_SIZE         ( 0x020000 )    // Two of the largest (64K) sectors, one is always left whole
+#endif
+#define OTA_CHECKPOINT_SLOT         ( 512 )         // Power of 2, records never cross a sector
+#define OTA_CHECKPOINT_MAGIC        ( 0x4F544143 )  // "OTAC"
+#define OTA_CHECKPOINT_BLANK        ( 0xFFFFFFFF )
+#define OTA_CHECKPOINT_CRC_LENGTH   ( offsetof( ota_checkpoint_t, crc ) )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum ota_checkpoint_state_t {
+    OTA_CHECKPOINT_ACTIVE = 1,
+    OTA_CHECKPOINT_CLEARED
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t sector_size;
+    uint32_t head;                              // Offset of the next slot to write
+    uint32_t newest;                            // Offset of the newest record
+    uint32_t sequence;                          // Sequence of the next record
+    unsigned int available  : 1;
+    unsigned int active     : 1;                // Newest record is a download that can be resumed
+} ota_checkpoint_log_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static bool read_checkpoint( uint32_t offset, ota_checkpoint_t *checkpoint );
+static bool checkpoint_write( ota_checkpoint_t *checkpoint );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static ota_checkpoint_log_t checkpoint_log;
+static ota_checkpoint_t record;                 // Too large for the stack of the callers
+extern sflash_handle_t sflash_handle;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Find the newest checkpoint, called once the serial flash is initialized
+  * @param  serial flash initialized and of the expected size
+  * @retval : None
+  */
+void ota_checkpoint_init( bool sflash_ok )
+{
+    uint32_t offset, sequence;
+    bool found;
+
+    memset( &checkpoint_log, 0, sizeof( ota_checkpoint_log_t ) );
+    if( ( sflash_ok == false ) || ( sizeof( ota_checkpoint_t ) > OTA_CHECKPOINT_SLOT ) ||
+        ( sflash_log_area_free( OTA_CHECKPOINT_START, OTA_CHECKPOINT_SIZE ) == false ) ) {
+        imx_printf( "OTA checkpoints not available\r\n" );
+        return;
+    }
+    checkpoint_log.sector_size = get_sflash_sector_size();
+    found = false;
+    sequence = 0;
+    for( offset = 0; offset < OTA_CHECKPOINT_SIZE; offset += OTA_CHECKPOINT_SLOT ) {
+        if( ( sflash_read( &sflash_handle, OTA_CHECKPOINT_START + offset, &record, 2 * sizeof( uint32_t ) ) != 0 ) ||
+            ( record.magic != OTA_CHECKPOINT_MAGIC ) || ( record.sequence == OTA_CHECKPOINT_BLANK ) )
+            continue;
+        if( ( ( found == false ) || ( record.sequence >= sequence ) ) && ( read_checkpoint( offset, &record ) == true ) ) {
+            checkpoint_log.newest = offset;
+            sequence = record.sequence;
+            checkpoint_log.active = ( record.state == OTA_CHECKPOINT_ACTIVE );
+            found = true;
+        }
+    }
+    if( found == true ) {
+        checkpoint_log.sequence = sequence + 1;
+        checkpoint_log.head = sflash_log_next_slot( checkpoint_log.newest, OTA_CHECKPOINT_SLOT, OTA_CHECKPOINT_SIZE );
+    }
+    checkpoint_log.available = true;
+    if( checkpoint_log.active == true )
+        imx_printf( "OTA download checkpoint found @: 0x%08lX\r\n", (uint32_t) OTA_CHECKPOINT_START + checkpoint_log.newest );
+}
+/**
+  * @brief  Check for a download that can be resumed
+  * @param  None
+  * @retval : true / false
+  */
+bool ota_checkpoint_available(void)
+{
+    return ( checkpoint_log.available == true ) && ( checkpoint_log.active == true );
+}
+/**
+  * @brief  Read the newest checkpoint
+  * @param  checkpoint
+  * @retval : true / false - none to resume or it can not be read
+  */
+bool ota_checkpoint_load( ota_checkpoint_t *checkpoint )
+{
+    bool result;
+
+    if( ota_checkpoint_available() == false )
+        return false;
+    sflash_writer_lock();
+    result = read_checkpoint( checkpoint_log.newest, checkpoint );
+    sflash_writer_unlock();
+    return ( result == true ) && ( checkpoint->state == OTA_CHECKPOINT_ACTIVE );
+}
+/**
+  * @brief  Record a checkpoint, all of the content received must be programmed
+  * @param  checkpoint, sequence, state and CRC are filled in
+  * @retval : true / false - write failed
+  */
+bool ota_checkpoint_save( ota_checkpoint_t *checkpoint )
+{
+    if( checkpoint_log.available == false )
+        return false;
+    checkpoint->state = OTA_CHECKPOINT_ACTIVE;
+    if( checkpoint_write( checkpoint ) == false )
+        return false;
+    checkpoint_log.active = true;
+    return true;
+}
+/**
+  * @brief  End the download, nothing is resumed after the next reset
+  * @param  None
+  * @retval : None
+  */
+void ota_checkpoint_clear(void)
+{
+    if( ota_checkpoint_available() == false )
+        return;
+    memset( &record, 0, sizeof( ota_checkpoint_t ) );
+    record.state = OTA_CHECKPOINT_CLEARED;
+    if( checkpoint_write( &record ) == false )
+        imx_printf( "Failed to clear OTA checkpoint\r\n" );
+    checkpoint_log.active = false;  // Not resumed from this boot either way
+}
+/**
+  * @brief  Append a record to the log
+  * @param  checkpoint
+  * @retval : true / false - write failed
+  */
+static bool checkpoint_write( ota_checkpoint_t *checkpoint )
+{
+    uint32_t attempts;
+    int result;
+
+    checkpoint->magic = OTA_CHECKPOINT_MAGIC;
+    checkpoint->sequence = checkpoint_log.sequence;
+    checkpoint->crc = sflash_log_crc( 0xFFFF, (uint8_t *) checkpoint, OTA_CHECKPOINT_CRC_LENGTH );
+    sflash_writer_lock();
+    for( attempts = 0; attempts < OTA_CHECKPOINT_SIZE / OTA_CHECKPOINT_SLOT; attempts++ ) {
+        if( ( checkpoint_log.head % checkpoint_log.sector_size ) == 0 ) {
+            if( sflash_erase_area( &sflash_handle, OTA_CHECKPOINT_START + checkpoint_log.head, checkpoint_log.sector_size,
+                    checkpoint_log.sector_size ) != 0 )
+                break;
+        } else if( sflash_log_slot_blank( OTA_CHECKPOINT_START + checkpoint_log.head, OTA_CHECKPOINT_SLOT ) == false ) {
+            checkpoint_log.head = sflash_log_next_slot( checkpoint_log.head, OTA_CHECKPOINT_SLOT, OTA_CHECKPOINT_SIZE );
+            continue;
+        }
+        result = protected_sflash_write( &sflash_handle, OTA_CHECKPOINT_START + checkpoint_log.head, checkpoint, sizeof( ota_checkpoint_t ),
+                WRITE_SFLASH_UNPARTITIONED_SPACE );
+        if( result == 0 ) {
+            sflash_writer_unlock();
+            checkpoint_log.newest = checkpoint_log.head;
+            checkpoint_log.head = sflash_log_next_slot( checkpoint_log.head, OTA_CHECKPOINT_SLOT, OTA_CHECKPOINT_SIZE );
+            checkpoint_log.sequence += 1;
+            return true;
+        }
+        checkpoint_log.head = sflash_log_next_slot( checkpoint_log.head, OTA_CHECKPOINT_SLOT, OTA_CHECKPOINT_SIZE );    // Leave the slot, it may be partly programmed
+    }
+    sflash_writer_unlock();
+    imx_printf( "OTA checkpoint write failed @: 0x%08lX\r\n", (uint32_t) OTA_CHECKPOINT_START + checkpoint_log.head );
+    return false;
+}
+/**
+  * @brief  Read a record and check it
+  * @param  offset in the log, record
+  * @retval : true - record written and the CRC is good
+  */
+static bool read_checkpoint( uint32_t offset, ota_checkpoint_t *checkpoint )
+{
+    if( sflash_read( &sflash_handle, OTA_CHECKPOINT_START + offset, checkpoint, sizeof( ota_checkpoint_t ) ) != 0 )
+        return false;
+    return ( checkpoint->magic == OTA_CHECKPOINT_MAGIC ) &&
+            ( sflash_log_crc( 0xFFFF, (uint8_t *) checkpoint, OTA_CHECKPOINT_CRC_LENGTH ) == checkpoint->crc );
+}
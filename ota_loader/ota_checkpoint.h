@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file ota_checkpoint.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ */
+
+#ifndef OTA_CHECKPOINT_H_
+#define OTA_CHECKPOINT_H_
+
+/*
+ *  Resume checkpoints for OTA downloads, kept in a small log of records in unpartitioned serial flash so a download
+ *  interrupted by a reset continues with an HTTP Range request. A new record is appended for each checkpoint, the
+ *  newest one with a good CRC is used. A cleared record ends the download.
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t state;
+    uint16_t image_no;
+    uint16_t port;
+    uint8_t resume_count;                       // Resumes of this download so far
+    uint8_t using_sha256;
+    uint32_t total_content_length;
+    uint32_t content_received;                  // All of it is programmed
+    char site[ IMX_IMATRIX_SITE_LENGTH ];
+    char uri[ IMX_IMATRIX_URI_LENGTH ];
+    uint8_t expected_hash[ OTA_HASH_SIZE ];
+    sha2_context sha256_context;                // Digest of the content received so far
+    uint16_t crc;                               // CRC-16 CCITT of all of the above
+} ota_checkpoint_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void ota_checkpoint_init( bool sflash_ok );
+bool ota_checkpoint_available(void);
+bool ota_checkpoint_load( ota_checkpoint_t *checkpoint );
+bool ota_checkpoint_save( ota_checkpoint_t *checkpoint );
+void ota_checkpoint_clear(void);
+#endif /* OTA_CHECKPOINT_H_ */
@@ -0,0 +1,455 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file ota_delta.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Applies a delta OTA image, a patch against the installed application image, as it is received. The new image is
+ *  handed on in order through the output routine, source data is read back from the serial flash a page at a time.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../cli/interface.h"
+#include "../sflash/sflash_writer.h"
+#include "ota_image.h"
+#include "ota_delta.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define OTA_DELTA_CHUNK_LENGTH      256     // One flash page
+#define OTA_DELTA_MAX_ARGUMENTS     8
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum ota_delta_state_t {
+    DELTA_DETECT,           // Collecting the magic
+    DELTA_HEADER,           // Collecting the rest of the header
+    DELTA_RAW,              // A full image, passed on as is
+    DELTA_OPERATION,
+    DELTA_ARGUMENTS,
+    DELTA_ADD_DATA,
+    DELTA_INSERT_DATA,
+    DELTA_DONE,
+    DELTA_FAILED
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    ota_image_output_t output;
+    ota_image_header_t header_check;
+    bool enabled;
+    uint16_t state;
+    uint16_t header_length;
+    uint16_t output_length;
+    uint16_t source_index;
+    uint16_t source_available;
+    uint8_t operation;
+    uint8_t argument_length;
+    uint8_t arguments_needed;
+    uint32_t source_address;
+    uint32_t source_area_length;
+    uint32_t source_length;
+    uint32_t target_length;
+    uint32_t produced;                                  // Bytes of the new image
+    uint32_t offset;                                    // Source offset of the current operation
+    uint32_t remaining;                                 // Bytes left in the current operation
+    uint8_t header[ OTA_DELTA_HEADER_LENGTH ];
+    uint8_t arguments[ OTA_DELTA_MAX_ARGUMENTS ];
+    uint8_t source_buffer[ OTA_DELTA_CHUNK_LENGTH ];
+    uint8_t output_buffer[ OTA_DELTA_CHUNK_LENGTH ];
+} ota_delta_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static uint32_t get_uint32( const uint8_t *data );
+static bool flush_output(void);
+static bool read_source( uint8_t *buffer, uint32_t offset, uint16_t length );
+static bool parse_header(void);
+static bool start_operation(void);
+static bool copy_source(void);
+static bool next_operation(void);
+static uint32_t apply( const uint8_t *data, uint32_t length );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern sflash_handle_t sflash_handle;
+static ota_delta_t delta;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Start a new image
+  * @param  delta images accepted, address and length of the installed image, output routine, header check routine or NULL
+  * @retval : None
+  */
+void ota_delta_start( bool enabled, uint32_t source_address, uint32_t source_length, ota_image_output_t output, ota_image_header_t header )
+{
+    delta.output = output;
+    delta.header_check = header;
+    delta.enabled = enabled;
+    delta.source_address = source_address;
+    delta.source_area_length = source_length;
+    delta.state = DELTA_DETECT;
+    delta.header_length = 0;
+    delta.output_length = 0;
+    delta.produced = 0;
+}
+/**
+  * @brief  Add the next piece of the image as received, or as decompressed
+  * @param  data, length
+  * @retval : true / false - the image is not valid or the output failed
+  */
+bool ota_delta_write( const uint8_t *data, uint32_t length )
+{
+    uint32_t used;
+
+    while( length > 0 ) {
+        used = apply( data, length );
+        if( used == 0 ) {
+            delta.state = DELTA_FAILED;
+            return false;
+        }
+        data += used;
+        length -= used;
+    }
+    return true;
+}
+/**
+  * @brief  Hand on what is left once all of the image has been received
+  * @param  None
+  * @retval : true / false - the patch was incomplete or the output failed
+  */
+bool ota_delta_finish(void)
+{
+    if( delta.state == DELTA_DETECT ) {// Too short to be a delta, the bytes held back are the image
+        memcpy( delta.output_buffer, delta.header, delta.header_length );
+        delta.output_length = delta.header_length;
+        delta.state = DELTA_RAW;
+    }
+    if( delta.state == DELTA_FAILED )
+        return false;
+    if( flush_output() == false )
+        return false;
+    if( ( delta.state != DELTA_RAW ) && ( delta.state != DELTA_DONE ) ) {
+        imx_printf( "Delta image incomplete, %lu of %lu Bytes\r\n", delta.produced, delta.target_length );
+        return false;
+    }
+    if( ( delta.state == DELTA_DONE ) && ( delta.produced != delta.target_length ) ) {
+        imx_printf( "Delta image ended early, %lu of %lu Bytes\r\n", delta.produced, delta.target_length );
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Check if the image being received is a delta
+  * @param  None
+  * @retval : true / false
+  */
+bool ota_delta_active(void)
+{
+    return ( ( delta.state != DELTA_DETECT ) && ( delta.state != DELTA_RAW ) );
+}
+/**
+  * @brief  SHA-256 of the new image, from the delta header
+  * @param  None
+  * @retval : pointer to the digest
+  */
+const uint8_t *ota_delta_target_hash(void)
+{
+    return &delta.header[ 16 ];
+}
+/**
+  * @brief  Little endian 32 bit value
+  * @param  data
+  * @retval : value
+  */
+static uint32_t get_uint32( const uint8_t *data )
+{
+    return (uint32_t) data[ 0 ] | ( (uint32_t) data[ 1 ] << 8 ) | ( (uint32_t) data[ 2 ] << 16 ) | ( (uint32_t) data[ 3 ] << 24 );
+}
+/**
+  * @brief  Hand the output buffer on
+  * @param  None
+  * @retval : true / false - output failed
+  */
+static bool flush_output(void)
+{
+    if( delta.output_length == 0 )
+        return true;
+    if( delta.output( delta.output_buffer, delta.output_length ) == false ) {
+        delta.state = DELTA_FAILED;
+        return false;
+    }
+    delta.output_length = 0;
+    return true;
+}
+/**
+  * @brief  Read part of the installed image, locked against the SFLASH writer thread
+  * @param  buffer, offset in the image, length
+  * @retval : true / false - read failed
+  */
+static bool read_source( uint8_t *buffer, uint32_t offset, uint16_t length )
+{
+    int result;
+
+    sflash_writer_lock();
+    result = sflash_read( &sflash_handle, delta.source_address + offset, buffer, length );
+    sflash_writer_unlock();
+    if( result != 0 ) {
+        imx_printf( "Failed to read installed image @: 0x%08lX\r\n", delta.source_address + offset );
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Check the header of a delta image
+  * @param  None
+  * @retval : true / false - not a supported image
+  */
+static bool parse_header(void)
+{
+    delta.source_length = get_uint32( &delta.header[ 8 ] );
+    delta.target_length = get_uint32( &delta.header[ 12 ] );
+    if( delta.header[ 4 ] != OTA_DELTA_VERSION ) {
+        imx_printf( "Unsupported delta image, version: %u\r\n", delta.header[ 4 ] );
+        return false;
+    }
+    if( delta.enabled == false ) {
+        imx_printf( "Delta image received for a full image update\r\n" );
+        return false;
+    }
+    if( delta.source_length > delta.source_area_length ) {
+        imx_printf( "Delta image made against a %lu Byte image, installed image area is %lu Bytes\r\n", delta.source_length, delta.source_area_length );
+        return false;
+    }
+    imx_printf( "Delta image, %lu Byte image rebuilt from the installed image\r\n", delta.target_length );
+    if( ( delta.header_check != NULL ) && ( delta.header_check( delta.target_length ) == false ) )
+        return false;
+    delta.state = ( delta.target_length == 0 ) ? DELTA_DONE : DELTA_OPERATION;
+    return true;
+}
+/**
+  * @brief  Check the arguments of an operation and start it
+  * @param  None
+  * @retval : true / false - the operation is not valid
+  */
+static bool start_operation(void)
+{
+    if( delta.operation == OTA_DELTA_INSERT ) {
+        delta.remaining = get_uint32( &delta.arguments[ 0 ] );
+        delta.offset = 0;
+    } else {
+        delta.offset = get_uint32( &delta.arguments[ 0 ] );
+        delta.remaining = get_uint32( &delta.arguments[ 4 ] );
+        if( ( delta.offset > delta.source_length ) || ( delta.remaining > delta.source_length - delta.offset ) ) {
+            imx_printf( "Delta image corrupt @: %lu, source 0x%08lX + %lu\r\n", delta.produced, delta.offset, delta.remaining );
+            return false;
+        }
+    }
+    if( delta.remaining > delta.target_length - delta.produced ) {
+        imx_printf( "Delta image corrupt @: %lu, %lu Bytes past the end of the image\r\n", delta.produced,
+                delta.remaining - ( delta.target_length - delta.produced ) );
+        return false;
+    }
+    delta.produced += delta.remaining;
+    delta.source_index = 0;
+    delta.source_available = 0;
+    switch( delta.operation ) {
+        case OTA_DELTA_COPY :
+            return copy_source();
+        case OTA_DELTA_ADD :
+            delta.state = DELTA_ADD_DATA;
+            break;
+        default :
+            delta.state = DELTA_INSERT_DATA;
+            break;
+    }
+    return next_operation();
+}
+/**
+  * @brief  Copy from the installed image, straight to the output a page at a time
+  * @param  None
+  * @retval : true / false - read or output failed
+  */
+static bool copy_source(void)
+{
+    uint16_t length;
+
+    if( flush_output() == false )
+        return false;
+    while( delta.remaining > 0 ) {
+        length = ( delta.remaining > OTA_DELTA_CHUNK_LENGTH ) ? OTA_DELTA_CHUNK_LENGTH : (uint16_t) delta.remaining;
+        if( read_source( delta.output_buffer, delta.offset, length ) == false )
+            return false;
+        delta.output_length = length;
+        if( flush_output() == false )
+            return false;
+        delta.offset += length;
+        delta.remaining -= length;
+    }
+    return next_operation();
+}
+/**
+  * @brief  Move on once the current operation is complete
+  * @param  None
+  * @retval : true
+  */
+static bool next_operation(void)
+{
+    if( delta.remaining == 0 )
+        delta.state = DELTA_OPERATION;
+    return true;
+}
+/**
+  * @brief  Run received bytes through the patch
+  * @param  data, length
+  * @retval : bytes used, 0 - the image is not valid or the output failed
+  */
+static uint32_t apply( const uint8_t *data, uint32_t length )
+{
+    uint32_t count, i;
+
+    switch( delta.state ) {
+        case DELTA_DETECT :
+            delta.header[ delta.header_length++ ] = *data;
+            if( *data != (uint8_t) OTA_DELTA_MAGIC[ delta.header_length - 1 ] ) {
+                /*
+                 * A full image, pass on what was held back and the rest as is
+                 */
+                memcpy( delta.output_buffer, delta.header, delta.header_length );
+                delta.output_length = delta.header_length;
+                delta.state = DELTA_RAW;
+            } else if( delta.header_length == OTA_DELTA_MAGIC_LENGTH )
+                delta.state = DELTA_HEADER;
+            return 1;
+        case DELTA_HEADER :
+            delta.header[ delta.header_length++ ] = *data;
+            if( ( delta.header_length == OTA_DELTA_HEADER_LENGTH ) && ( parse_header() == false ) )
+                return 0;
+            return 1;
+        case DELTA_RAW :
+            if( ( flush_output() == false ) || ( delta.output( data, length ) == false ) )
+                return 0;
+            return length;
+        case DELTA_OPERATION :
+            delta.operation = *data;
+            delta.argument_length = 0;
+            switch( delta.operation ) {
+                case OTA_DELTA_END :
+                    delta.state = DELTA_DONE;
+                    break;
+                case OTA_DELTA_COPY :
+                case OTA_DELTA_ADD :
+                    delta.arguments_needed = 8;
+                    delta.state = DELTA_ARGUMENTS;
+                    break;
+                case OTA_DELTA_INSERT :
+                    delta.arguments_needed = 4;
+                    delta.state = DELTA_ARGUMENTS;
+                    break;
+                default :
+                    imx_printf( "Delta image corrupt @: %lu, operation: %u\r\n", delta.produced, delta.operation );
+                    return 0;
+            }
+            return 1;
+        case DELTA_ARGUMENTS :
+            delta.arguments[ delta.argument_length++ ] = *data;
+            if( ( delta.argument_length == delta.arguments_needed ) && ( start_operation() == false ) )
+                return 0;
+            return 1;
+        case DELTA_ADD_DATA :
+            /*
+             * Installed image bytes, read a page at a time, plus the difference
+             */
+            if( delta.source_index == delta.source_available ) {
+                delta.source_available = ( delta.remaining > OTA_DELTA_CHUNK_LENGTH ) ? OTA_DELTA_CHUNK_LENGTH : (uint16_t) delta.remaining;
+                if( read_source( delta.source_buffer, delta.offset, delta.source_available ) == false )
+                    return 0;
+                delta.offset += delta.source_available;
+                delta.source_index = 0;
+            }
+            count = delta.source_available - delta.source_index;
+            if( count > OTA_DELTA_CHUNK_LENGTH - delta.output_length )
+                count = OTA_DELTA_CHUNK_LENGTH - delta.output_length;
+            if( count > length )
+                count = length;
+            for( i = 0; i < count; i++ )
+                delta.output_buffer[ delta.output_length++ ] = delta.source_buffer[ delta.source_index++ ] + data[ i ];
+            delta.remaining -= count;
+            if( ( delta.output_length == OTA_DELTA_CHUNK_LENGTH ) && ( flush_output() == false ) )
+                return 0;
+            next_operation();
+            return count;
+        case DELTA_INSERT_DATA :
+            count = ( length > delta.remaining ) ? delta.remaining : length;
+            if( count > OTA_DELTA_CHUNK_LENGTH - delta.output_length ) {
+                /*
+                 * Larger than the space left in the output buffer, pass it on directly
+                 */
+                if( ( flush_output() == false ) || ( delta.output( data, count ) == false ) )
+                    return 0;
+            } else {
+                memcpy( &delta.output_buffer[ delta.output_length ], data, count );
+                delta.output_length += count;
+                if( ( delta.output_length == OTA_DELTA_CHUNK_LENGTH ) && ( flush_output() == false ) )
+                    return 0;
+            }
+            delta.remaining -= count;
+            next_operation();
+            return count;
+        case DELTA_DONE :
+            return length;  // Padding after the end of the image
+        default :
+            return 0;
+    }
+}
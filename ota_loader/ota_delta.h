@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file ota_delta.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ */
+
+#ifndef OTA_DELTA_H_
+#define OTA_DELTA_H_
+
+/*
+ *  Delta OTA images - a patch against the installed application image that rebuilds the new image into the other
+ *  application slot. Anything that does not start with OTA_DELTA_MAGIC is a full image and is written as is. A delta may
+ *  itself be compressed, see ota_image.h, it is applied to the decompressed stream.
+ *
+ *  Header, OTA_DELTA_HEADER_LENGTH Bytes, little endian:
+ *      0   "IMXD"
+ *      4   version, OTA_DELTA_VERSION
+ *      5   reserved, 0
+ *      8   length of the installed image the patch was made against
+ *      12  length of the new image
+ *      16  SHA-256 of the new image
+ *
+ *  Followed by operations, an operation Byte then its arguments:
+ *      OTA_DELTA_COPY      offset, length              - copy from the installed image
+ *      OTA_DELTA_ADD       offset, length, data        - installed image bytes plus the data bytes, modulo 256
+ *      OTA_DELTA_INSERT    length, data                - new bytes
+ *      OTA_DELTA_END
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define OTA_DELTA_MAGIC             "IMXD"
+#define OTA_DELTA_MAGIC_LENGTH      4
+#define OTA_DELTA_HEADER_LENGTH     48
+#define OTA_DELTA_VERSION           1
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum ota_delta_operation_t {
+    OTA_DELTA_END,
+    OTA_DELTA_COPY,
+    OTA_DELTA_ADD,
+    OTA_DELTA_INSERT
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void ota_delta_start( bool enabled, uint32_t source_address, uint32_t source_length, ota_image_output_t output, ota_image_header_t header );
+bool ota_delta_write( const uint8_t *data, uint32_t length );
+bool ota_delta_finish(void);
+bool ota_delta_active(void);
+const uint8_t *ota_delta_target_hash(void);
+#endif /* OTA_DELTA_H_ */
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file ota_image.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Streaming decompression of OTA images into the serial flash. Data is fed in as it is received, in any size of piece,
+ *  and handed on in order through the output routine. RAM use is fixed, the window and a small output buffer.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+
+#include "../cli/interface.h"
+#include "ota_image.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define OTA_IMAGE_WINDOW_SIZE       ( 1 << OTA_IMAGE_MAX_WINDOW_BITS )
+#define OTA_IMAGE_WINDOW_MASK       ( OTA_IMAGE_WINDOW_SIZE - 1 )
+#define OTA_IMAGE_OUTPUT_LENGTH     256     // One flash page
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum ota_image_state_t {
+    IMAGE_DETECT,           // Collecting the magic
+    IMAGE_HEADER,           // Collecting the rest of the header
+    IMAGE_RAW,              // Not compressed, passed on as is
+    IMAGE_FLAGS,
+    IMAGE_LITERAL,
+    IMAGE_REFERENCE_LOW,
+    IMAGE_REFERENCE_HIGH,
+    IMAGE_DONE,
+    IMAGE_FAILED
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    ota_image_output_t output;
+    ota_image_header_t header_check;
+    uint16_t state;
+    uint16_t header_length;
+    uint16_t output_length;
+    uint16_t window_bits;
+    uint8_t flags;
+    uint8_t flag_count;
+    uint8_t reference_low;
+    uint32_t image_length;
+    uint32_t produced;                                  // Bytes decompressed
+    uint32_t written;                                   // Bytes handed to the output routine
+    uint8_t header[ OTA_IMAGE_HEADER_LENGTH ];
+    uint8_t window[ OTA_IMAGE_WINDOW_SIZE ];
+    uint8_t output_buffer[ OTA_IMAGE_OUTPUT_LENGTH ];
+} ota_image_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static bool flush_output(void);
+static bool emit( uint8_t data );
+static bool parse_header(void);
+static void next_item(void);
+static bool decode( uint8_t data );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static ota_image_t image;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Start a new image
+  * @param  output routine, header check routine or NULL
+  * @retval : None
+  */
+void ota_image_start( ota_image_output_t output, ota_image_header_t header )
+{
+    image.output = output;
+    image.header_check = header;
+    image.state = IMAGE_DETECT;
+    image.header_length = 0;
+    image.output_length = 0;
+    image.image_length = 0;
+    image.produced = 0;
+    image.written = 0;
+}
+/**
+  * @brief  Add the next piece of the image as received
+  * @param  data, length
+  * @retval : true / false - the image is not valid or the output failed
+  */
+bool ota_image_write( const uint8_t *data, uint32_t length )
+{
+    while( length > 0 ) {
+        if( image.state == IMAGE_RAW ) {
+            if( flush_output() == false )
+                return false;
+            if( image.output( data, length ) == false ) {
+                image.state = IMAGE_FAILED;
+                return false;
+            }
+            image.written += length;
+            return true;
+        }
+        if( decode( *data ) == false ) {
+            image.state = IMAGE_FAILED;
+            return false;
+        }
+        data += 1;
+        length -= 1;
+    }
+    return true;
+}
+/**
+  * @brief  Hand on what is left once all of the image has been received
+  * @param  None
+  * @retval : true / false - the image was incomplete or the output failed
+  */
+bool ota_image_finish(void)
+{
+    if( image.state == IMAGE_DETECT ) {// Too short to be compressed, the bytes held back are the image
+        memcpy( image.output_buffer, image.header, image.header_length );
+        image.output_length = image.header_length;
+        image.state = IMAGE_RAW;
+    }
+    if( image.state == IMAGE_FAILED )
+        return false;
+    if( flush_output() == false )
+        return false;
+    if( ( image.state != IMAGE_RAW ) && ( image.state != IMAGE_DONE ) ) {
+        imx_printf( "Compressed image incomplete, %lu of %lu Bytes\r\n", image.produced, image.image_length );
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Check if the image being received is compressed
+  * @param  None
+  * @retval : true / false
+  */
+bool ota_image_compressed(void)
+{
+    return ( ( image.state != IMAGE_DETECT ) && ( image.state != IMAGE_RAW ) );
+}
+/**
+  * @brief  Bytes of the image handed to the output routine so far
+  * @param  None
+  * @retval : count
+  */
+uint32_t ota_image_written(void)
+{
+    return image.written;
+}
+/**
+  * @brief  Hand the output buffer on
+  * @param  None
+  * @retval : true / false - output failed
+  */
+static bool flush_output(void)
+{
+    if( image.output_length == 0 )
+        return true;
+    if( image.output( image.output_buffer, image.output_length ) == false ) {
+        image.state = IMAGE_FAILED;
+        return false;
+    }
+    image.written += image.output_length;
+    image.output_length = 0;
+    return true;
+}
+/**
+  * @brief  Add a byte to the output, and to the window for compressed images
+  * @param  data
+  * @retval : true / false - output failed
+  */
+static bool emit( uint8_t data )
+{
+    image.window[ image.produced & OTA_IMAGE_WINDOW_MASK ] = data;
+    image.produced += 1;
+    image.output_buffer[ image.output_length++ ] = data;
+    if( image.output_length == OTA_IMAGE_OUTPUT_LENGTH )
+        return flush_output();
+    return true;
+}
+/**
+  * @brief  Check the header of a compressed image
+  * @param  None
+  * @retval : true / false - not a supported image
+  */
+static bool parse_header(void)
+{
+    image.window_bits = image.header[ 5 ];
+    image.image_length = (uint32_t) image.header[ 8 ] | ( (uint32_t) image.header[ 9 ] << 8 ) |
+            ( (uint32_t) image.header[ 10 ] << 16 ) | ( (uint32_t) image.header[ 11 ] << 24 );
+    if( ( image.header[ 4 ] != OTA_IMAGE_VERSION ) || ( image.window_bits < 8 ) || ( image.window_bits > OTA_IMAGE_MAX_WINDOW_BITS ) ) {
+        imx_printf( "Unsupported compressed image, version: %u, window bits: %u\r\n", image.header[ 4 ], image.window_bits );
+        return false;
+    }
+    imx_printf( "Compressed image, %lu Bytes once decompressed, %u Byte window\r\n", image.image_length, 1 << image.window_bits );
+    if( ( image.header_check != NULL ) && ( image.header_check( image.image_length ) == false ) )
+        return false;
+    image.state = ( image.image_length == 0 ) ? IMAGE_DONE : IMAGE_FLAGS;
+    return true;
+}
+/**
+  * @brief  Move to the next item of the current flag byte
+  * @param  None
+  * @retval : None
+  */
+static void next_item(void)
+{
+    if( image.produced >= image.image_length ) {
+        image.state = IMAGE_DONE;
+        return;
+    }
+    if( image.flag_count == 0 ) {
+        image.state = IMAGE_FLAGS;
+        return;
+    }
+    image.state = ( ( image.flags & 0x01 ) != 0 ) ? IMAGE_LITERAL : IMAGE_REFERENCE_LOW;
+    image.flags >>= 1;
+    image.flag_count -= 1;
+}
+/**
+  * @brief  Run one received byte through the decoder
+  * @param  data
+  * @retval : true / false - the image is not valid or the output failed
+  */
+static bool decode( uint8_t data )
+{
+    uint16_t reference, length;
+    uint32_t distance;
+
+    switch( image.state ) {
+        case IMAGE_DETECT :
+            image.header[ image.header_length++ ] = data;
+            if( data != (uint8_t) OTA_IMAGE_MAGIC[ image.header_length - 1 ] ) {
+                /*
+                 * Not compressed, pass on what was held back and the rest as is
+                 */
+                memcpy( image.output_buffer, image.header, image.header_length );
+                image.output_length = image.header_length;
+                image.state = IMAGE_RAW;
+            } else if( image.header_length == OTA_IMAGE_MAGIC_LENGTH )
+                image.state = IMAGE_HEADER;
+            break;
+        case IMAGE_HEADER :
+            image.header[ image.header_length++ ] = data;
+            if( image.header_length == OTA_IMAGE_HEADER_LENGTH )
+                return parse_header();
+            break;
+        case IMAGE_FLAGS :
+            image.flags = data;
+            image.flag_count = 8;
+            next_item();
+            break;
+        case IMAGE_LITERAL :
+            if( emit( data ) == false )
+                return false;
+            next_item();
+            break;
+        case IMAGE_REFERENCE_LOW :
+            image.reference_low = data;
+            image.state = IMAGE_REFERENCE_HIGH;
+            break;
+        case IMAGE_REFERENCE_HIGH :
+            reference = (uint16_t) image.reference_low | ( (uint16_t) data << 8 );
+            distance = ( reference & ( ( 1 << image.window_bits ) - 1 ) ) + 1;
+            length = ( reference >> image.window_bits ) + OTA_IMAGE_MIN_MATCH;
+            if( ( distance > image.produced ) || ( image.produced + length > image.image_length ) ) {
+                imx_printf( "Compressed image corrupt @: %lu\r\n", image.produced );
+                return false;
+            }
+            while( length-- > 0 ) {
+                if( emit( image.window[ ( image.produced - distance ) & OTA_IMAGE_WINDOW_MASK ] ) == false )
+                    return false;
+            }
+            next_item();
+            break;
+        case IMAGE_DONE :
+            break;  // Padding after the end of the image
+        default :
+            return false;
+    }
+    return true;
+}
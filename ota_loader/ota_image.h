@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file ota_image.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ */
+
+#ifndef OTA_IMAGE_H_
+#define OTA_IMAGE_H_
+
+/*
+ *  Compressed OTA images. An image that starts with OTA_IMAGE_MAGIC is compressed, anything else is written as is.
+ *
+ *  Header, OTA_IMAGE_HEADER_LENGTH Bytes, little endian:
+ *      0   "IMXZ"
+ *      4   version, OTA_IMAGE_VERSION
+ *      5   window bits, 8 - OTA_IMAGE_MAX_WINDOW_BITS
+ *      6   reserved, 0
+ *      8   length of the image once decompressed
+ *      12  reserved, 0
+ *
+ *  LZSS stream: a flag byte, read from bit 0, then 8 items. A 1 bit is a literal byte, a 0 bit is a 16 bit reference,
+ *  the low window bits are the distance back - 1 and the rest the match length - OTA_IMAGE_MIN_MATCH. Decoding stops
+ *  once the image length has been produced, unused flag bits are ignored.
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define OTA_IMAGE_MAGIC             "IMXZ"
+#define OTA_IMAGE_MAGIC_LENGTH      4
+#define OTA_IMAGE_HEADER_LENGTH     16
+#define OTA_IMAGE_VERSION           1
+#define OTA_IMAGE_MAX_WINDOW_BITS   12      // 4K of RAM for the window
+#define OTA_IMAGE_MIN_MATCH         3
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+/*
+ * Receives the image in order - returns false to stop the stream
+ */
+typedef bool (*ota_image_output_t)( const uint8_t *data, uint32_t length );
+/*
+ * Called with the decompressed length once the header of a compressed image is read - returns false to reject it
+ */
+typedef bool (*ota_image_header_t)( uint32_t image_length );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+void ota_image_start( ota_image_output_t output, ota_image_header_t header );
+bool ota_image_write( const uint8_t *data, uint32_t length );
+bool ota_image_finish(void);
+bool ota_image_compressed(void);
+uint32_t ota_image_written(void);
+#endif /* OTA_IMAGE_H_ */
@@ -55,6 +55,7 @@
 
 #include "wiced.h"
 #include "wiced_tls.h"
+#include "wiced_crypto.h"
 #include "spi_flash.h"
 #include "base64.h"
 #include "../storage.h"
@@ -66,10 +67,15 @@
 #include "../device/imx_leds.h"
 #include "../device/version.h"
 #include "../json/mjson.h"
+#include "../time/ck_time.h"
 #include "../networking/utility.h"
 #include "../sflash/sflash.h"
+#include "../sflash/sflash_writer.h"
 #include "ota_loader.h"
 #include "ota_structure.h"
+#include "ota_image.h"
+#include "ota_delta.h"
+#include "ota_checkpoint.h"
 
 /******************************************************
  *                      Macros
@@ -97,7 +103,20 @@
 
 #define CHECKSUM_LENGTH		13
 
-#define USE_SHA512 0
+#define OTA_PROGRESS_PACKETS    64  // Print progress every n packets received
+/*
+ * The image area is erased a step at a time just ahead of the writes, while waiting for the network, so the main loop
+ * is never held for more than one erase. A write that catches up with the erase waits for the sectors it needs
+ */
+#define OTA_ERASE_STEP          SFLASH_SECTOR_SIZE  // Rounded up to the smallest erasable unit of the part
+#define OTA_ERASE_AHEAD         0x008000            // 32K - keep this much erased ahead of the write offset
+#define OTA_RECEIVE_WAIT        5                   // mSec to wait for stream data, the SFLASH writer programs meanwhile
+/*
+ * Plain images from servers that accept ranges are checkpointed as they are received, a reset resumes the download
+ */
+#define OTA_CHECKPOINT_INTERVAL 0x010000            // 64K of content between checkpoints
+#define OTA_RESUME_MAX          8                   // Attempts to resume one download, after resets or network failures
+#define OTA_RESUME_RETRY        ( 60 * 1000 )       // 60 Seconds between attempts while the network keeps failing
 char *latest_image[] =
 {
         "/latest/sflash",
@@ -117,6 +136,8 @@ enum ota_loader_state_t {
     OTA_LOADER_INIT,
     OTA_LOADER_ERASE_FLASH,
     OTA_LOADER_VERIFY_ERASE,
+    OTA_LOADER_RESUME,
+    OTA_LOADER_RESUME_VERIFY,
     OTA_DNS_LOOKUP,
     OTA_LOADER_OPEN_SOCKET,
     OTA_LOADER_ESTABLISH_CONNECTION,
@@ -127,7 +148,7 @@ enum ota_loader_state_t {
     OTA_LOADER_RECEIVE_STREAM,
     OTA_LOADER_ALL_RECEIVED,
     OTA_LOADER_VERIFY_OTA,
-    OTA_CALC_CRC,
+    OTA_LOADER_VERIFY_SFLASH,
     OTA_LOADER_DATA_TIMEOUT,
     OTA_LOADER_CLOSE_CONNECTION,
     OTA_LOADER_CLOSE_SOCKET,
@@ -197,6 +218,21 @@ static const char ota_root_ca[] = "-----BEGIN CERTIFICATE-----\n"
 /******************************************************
  *               Function Declarations
  ******************************************************/
+static void ota_loader_step(void);
+static void ota_stream_start(void);
+static bool ota_erase_step(void);
+static bool ota_erase_ahead(void);
+static bool ota_stream_write( uint8_t *data, uint32_t length );
+static bool ota_image_output( const uint8_t *data, uint32_t length );
+static bool ota_image_header( uint32_t image_length );
+static bool ota_delta_header( uint32_t image_length );
+static void ota_set_image_length( uint32_t image_length );
+static void ota_write_complete( uint32_t address, uint32_t length, bool success );
+static bool ota_stream_failed(void);
+static bool ota_stream_flush(void);
+static void ota_save_checkpoint(void);
+static void print_ota_stream_stats(void);
+static void print_hash( char *title, uint8_t *hash );
 
 /******************************************************
  *               Variable Definitions
@@ -208,6 +244,7 @@ extern IOT_Device_Config_t device_config;	// Defined in device/config.h and save
 extern sflash_handle_t sflash_handle;
 app_header_t apps_lut[ FULL_IMAGE ];
 struct OTA_CONFIGURATION ota_loader_config CCMSRAM;
+static ota_checkpoint_t checkpoint;
 
 /******************************************************
  *               Function Definitions
@@ -225,6 +262,7 @@ void init_ota_loader(void)
     ota_loader_config.ota_getlatest_state = GET_LATEST_IDLE;
 	icb.ota_loader_active = false;
 	icb.get_latest_active = false;
+	ota_loader_config.verify_sflash = false;
 }
 
 /**
@@ -331,38 +369,411 @@ void setup_ota_loader( char *site, char *uri, uint16_t port, uint16_t image_no,
     ota_loader_config.port = port;
     ota_loader_config.image_no = image_no;
     ota_loader_config.load_file = load_file;// Currently always TRUE, but maybe used in the future.
+    ota_loader_config.delta = false;
+    ota_loader_config.resumed = false;
+    ota_loader_config.resume_count = 0;
 
     ota_loader_config.ota_loader_state = OTA_LOADER_INIT;
-//    sha4_starts( &ota_loader_config.sha512context, USE_SHA512 );// Guarantees that SHA512 is initialized,
-    // but needs to be called again after each full file request is called, because of the possibility of re-trys.
+    ota_stream_start(); // Started again with each full file request, because of the possibility of re-trys.
 }
 
-#ifdef SKIP_THIS
+/**
+  * @brief  Start an Over The Air(OTA) update from a delta image, a patch against the installed application image.
+  *         The new image is rebuilt into the other application slot, a full image is also accepted.
+  * @param  site, uri, port, installed image APP0 / APP1
+  * @retval : None
+  */
+void setup_ota_delta( char *site, char *uri, uint16_t port, uint16_t source_image )
+{
+    if( ( source_image != APP0 ) && ( source_image != APP1 ) ) {
+        imx_printf( "OTA delta Invalid installed image: %u\r\n", source_image );
+        return;
+    }
+    if( ota_is_active() ) {
+        imx_printf( "OTA loader already active\r\n" );
+        return;
+    }
+    setup_ota_loader( site, uri, port, ( source_image == APP0 ) ? APP1 : APP0, true );
+    if( ota_is_active() ) {
+        imx_printf( "Delta from image %u\r\n", source_image );
+        ota_loader_config.delta = true;
+        ota_loader_config.delta_source = source_image;
+    }
+}
+/**
+  * @brief  Resume a download interrupted by a reset or a network failure from its last checkpoint - called while the
+  *         network is up, attempts are spaced OTA_RESUME_RETRY apart and limited to OTA_RESUME_MAX per download
+  * @param  None
+  * @retval : None
+  */
+void ota_resume(void)
+{
+    static bool resume_tried = false;
+    static wiced_time_t resume_time;
+    wiced_time_t current_time;
 
-wiced_bool_t verify_sha512( sha4_context* context, uint8_t hash[] )
+    if( ota_is_active() )
+        return;
+    wiced_time_get_time( &current_time );
+    if( ( resume_tried == true ) && ( timer_timeout( current_time, resume_time, OTA_RESUME_RETRY ) == false ) )
+        return;
+    resume_tried = true;
+    resume_time = current_time;
+    if( ota_checkpoint_load( &checkpoint ) == false ) {
+        ota_checkpoint_clear();
+        return;
+    }
+    if( ( checkpoint.image_no >= FULL_IMAGE ) || ( checkpoint.content_received == 0 ) ||
+        ( checkpoint.content_received >= checkpoint.total_content_length ) ) {
+        imx_printf( "OTA checkpoint not valid, dropped\r\n" );
+        ota_checkpoint_clear();
+        return;
+    }
+    if( checkpoint.resume_count >= OTA_RESUME_MAX ) {
+        imx_printf( "OTA download resumed %u times, dropped\r\n", checkpoint.resume_count );
+        ota_checkpoint_clear();
+        return;
+    }
+    /*
+     * Counted before anything else is done, a download that keeps resetting the device or failing is dropped
+     */
+    checkpoint.resume_count += 1;
+    if( ota_checkpoint_save( &checkpoint ) == false ) {
+        ota_checkpoint_clear();
+        return;
+    }
+    checkpoint.site[ IMX_IMATRIX_SITE_LENGTH - 1 ] = '\0';
+    checkpoint.uri[ IMX_IMATRIX_URI_LENGTH - 1 ] = '\0';
+    imx_printf( "Resuming OTA download at %lu of %lu Bytes\r\n", checkpoint.content_received, checkpoint.total_content_length );
+    setup_ota_loader( checkpoint.site, checkpoint.uri, checkpoint.port, checkpoint.image_no, true );
+    if( ota_is_active() == false ) {
+        ota_checkpoint_clear();
+        return;
+    }
+    ota_loader_config.resumed = true;
+    ota_loader_config.resume_count = checkpoint.resume_count;
+    ota_loader_config.total_content_length = checkpoint.total_content_length;
+    ota_loader_config.content_received = checkpoint.content_received;
+    ota_loader_config.using_sha256 = ( checkpoint.using_sha256 != 0 );
+    memcpy( ota_loader_config.expected_hash, checkpoint.expected_hash, OTA_HASH_SIZE );
+    memcpy( &ota_loader_config.sha256_context, &checkpoint.sha256_context, sizeof( sha2_context ) );
+    ota_loader_config.ota_loader_state = OTA_LOADER_RESUME;
+}
+/**
+  * @brief  Start the digest and throughput statistics for a full download of the image
+  * @param  None
+  * @retval : None
+  */
+static void ota_stream_start(void)
+{
+    sha2_starts( &ota_loader_config.sha256_context, 0 );
+    wiced_time_get_time( &ota_loader_config.stream_start_time );
+    ota_loader_config.stream_packets = 0;
+    ota_loader_config.stream_bytes = 0;
+    ota_loader_config.stream_sflash_time = 0;
+    ota_loader_config.stream_hash_time = 0;
+    ota_loader_config.stream_max_packet_time = 0;
+    ota_loader_config.stream_erase_time = 0;
+    ota_loader_config.stream_erase_blocks = 0;
+    ota_loader_config.stream_max_step_time = 0;
+}
+/**
+  * @brief  Size of one erase step, at least a sector of the part fitted
+  * @param  None
+  * @retval : step size in bytes
+  */
+static uint32_t ota_erase_step_size(void)
+{
+    if( OTA_ERASE_STEP < ota_loader_config.flash_sector_size )
+        return ota_loader_config.flash_sector_size;
+    return OTA_ERASE_STEP;
+}
+/**
+  * @brief  Erase the next step of the image area
+  * @param  None
+  * @retval : true / false - erase failed or the whole area is already erased
+  */
+static bool ota_erase_step(void)
+{
+    wiced_time_t erase_start, erase_end;
+    uint32_t step;
+
+    step = ota_erase_step_size();
+    if( ota_loader_config.erased_to + step > ota_loader_config.erase_end ) {
+        imx_printf( "Sflash erase past end of image area @: 0x%08lX\r\n", ota_loader_config.erased_to );
+        return false;
+    }
+    wiced_time_get_time( &erase_start );
+    sflash_writer_lock();   // The writer thread may be programming the data received before
+    if( sflash_erase_area( &sflash_handle, ota_loader_config.erased_to, step, step ) != 0 ) {
+        sflash_writer_unlock();
+        imx_printf( "Sflash erase failed @: 0x%08lX\r\n", ota_loader_config.erased_to );
+        return false;
+    }
+    sflash_writer_unlock();
+    wiced_time_get_time( &erase_end );
+    ota_loader_config.erased_to += step;
+    ota_loader_config.stream_erase_time += erase_end - erase_start;
+    ota_loader_config.stream_erase_blocks += 1;
+    return true;
+}
+/**
+  * @brief  Erase one more step if less than OTA_ERASE_AHEAD is erased past the write offset - called while waiting for data
+  * @param  None
+  * @retval : true / false - erase failed
+  */
+static bool ota_erase_ahead(void)
+{
+    if( ( ota_loader_config.erased_to >= ota_loader_config.erase_end ) ||
+        ( ota_loader_config.erased_to >= ota_loader_config.content_offset + OTA_ERASE_AHEAD ) )
+        return true;
+    return ota_erase_step();
+}
+/**
+  * @brief  Called from the SFLASH writer thread as each buffer of the image is programmed
+  * @param  address, length, success
+  * @retval : None
+  */
+static void ota_write_complete( uint32_t address, uint32_t length, bool success )
+{
+    if( success == false ) {
+        ota_loader_config.write_failed_address = address;
+        ota_loader_config.write_failed = true;
+        return;
+    }
+    ota_loader_config.content_written += length;
+}
+/**
+  * @brief  Report a failed write from the SFLASH writer
+  * @param  None
+  * @retval : true / false - a write has failed
+  */
+static bool ota_stream_failed(void)
+{
+    if( ota_loader_config.write_failed == false )
+        return false;
+    imx_printf( "Write to serial flash failed @: 0x%08lX\r\n", ota_loader_config.write_failed_address );
+    device_config.ota_fail_sflash_write += 1;
+    return true;
+}
+/**
+  * @brief  Wait until all content received is programmed
+  * @param  None
+  * @retval : true / false - write to flash failed
+  */
+static bool ota_stream_flush(void)
+{
+    if( ( sflash_writer_flush() == false ) && ( ota_loader_config.write_failed == false ) ) {
+        ota_loader_config.write_failed_address = ota_loader_config.content_offset;
+        ota_loader_config.write_failed = true;
+    }
+    return ( ota_stream_failed() == false );
+}
+/**
+  * @brief  Save a resume checkpoint once everything received so far is programmed
+  * @param  None
+  * @retval : None
+  */
+static void ota_save_checkpoint(void)
+{
+    ota_loader_config.next_checkpoint = ota_loader_config.content_received + OTA_CHECKPOINT_INTERVAL;
+    /*
+     * Only a plain image can be picked up part way through, the state of the decompressor and the delta is not saved
+     */
+    if( ( ota_loader_config.accept_ranges == false ) || ( ota_loader_config.image_no >= FULL_IMAGE ) ||
+        ( ota_image_compressed() == true ) || ( ota_delta_active() == true ) )
+        return;
+    if( ota_stream_flush() == false )
+        return;
+    memset( &checkpoint, 0, sizeof( ota_checkpoint_t ) );
+    checkpoint.image_no = ota_loader_config.image_no;
+    checkpoint.port = ota_loader_config.port;
+    checkpoint.resume_count = ota_loader_config.resume_count;
+    checkpoint.using_sha256 = ota_loader_config.using_sha256;
+    checkpoint.total_content_length = ota_loader_config.total_content_length;
+    checkpoint.content_received = ota_loader_config.content_received;
+    strncpy( checkpoint.site, ota_loader_config.site, IMX_IMATRIX_SITE_LENGTH - 1 );
+    strncpy( checkpoint.uri, ota_loader_config.uri, IMX_IMATRIX_URI_LENGTH - 1 );
+    memcpy( checkpoint.expected_hash, ota_loader_config.expected_hash, OTA_HASH_SIZE );
+    memcpy( &checkpoint.sha256_context, &ota_loader_config.sha256_context, sizeof( sha2_context ) );
+    if( ota_checkpoint_save( &checkpoint ) == true )
+        imx_printf( "OTA checkpoint saved @: %lu Bytes\r\n", ota_loader_config.content_received );
+}
+/**
+  * @brief  Limit the erase to the length of the image, raw or decompressed
+  * @param  image_length
+  * @retval : None
+  */
+static void ota_set_image_length( uint32_t image_length )
+{
+    uint32_t image_start;
+
+    image_start = ota_loader_config.content_offset - ota_loader_config.image_written;
+    ota_loader_config.erase_end = image_start + ( ( image_length + ota_loader_config.flash_sector_size - 1 ) /
+            ota_loader_config.flash_sector_size ) * ota_loader_config.flash_sector_size;
+    if( ota_loader_config.erase_end > image_start + ota_loader_config.erase_length )
+        ota_loader_config.erase_end = image_start + ota_loader_config.erase_length;
+    if( ota_loader_config.erase_end < ota_loader_config.erased_to )
+        ota_loader_config.erase_end = ota_loader_config.erased_to;
+}
+/**
+  * @brief  Called when the header of a compressed image has been read
+  * @param  decompressed length of the image
+  * @retval : true / false - the image will not fit
+  */
+static bool ota_image_header( uint32_t image_length )
+{
+    if( ota_loader_config.delta == true )
+        return true;    // Length of the patch, the delta header has the length of the image
+    if( image_length > ota_loader_config.erase_length ) {
+        imx_printf( "Decompressed length(%lu) larger than erase_length(%lu).. Aborting\r\n", image_length, ota_loader_config.erase_length );
+        return false;
+    }
+    ota_set_image_length( image_length );
+    return true;
+}
+/**
+  * @brief  Called when the header of a delta image has been read
+  * @param  length of the rebuilt image
+  * @retval : true / false - the image will not fit
+  */
+static bool ota_delta_header( uint32_t image_length )
+{
+    if( image_length > ota_loader_config.erase_length ) {
+        imx_printf( "Delta image length(%lu) larger than erase_length(%lu).. Aborting\r\n", image_length, ota_loader_config.erase_length );
+        return false;
+    }
+    ota_set_image_length( image_length );
+    return true;
+}
+/**
+  * @brief  Queue the image for the serial flash, received as is or rebuilt from a compressed or delta image
+  * @param  data, length
+  * @retval : true / false - write to flash failed
+  */
+static bool ota_image_output( const uint8_t *data, uint32_t length )
+{
+    /*
+     * Normally already erased while waiting for the packet, erase now if the writes have caught up
+     */
+    while( ota_loader_config.erased_to < ota_loader_config.content_offset + length ) {
+        if( ota_erase_step() == false ) {
+            device_config.ota_fail_sflash_write += 1;
+            return false;
+        }
+    }
+    if( sflash_writer_write( data, length ) == false ) {
+        if( ota_loader_config.write_failed == false ) {
+            ota_loader_config.write_failed_address = ota_loader_config.content_offset;
+            ota_loader_config.write_failed = true;
+        }
+        ota_stream_failed();
+        return false;
+    }
+    if( ( ota_image_compressed() == true ) || ( ota_delta_active() == true ) )
+        sha2_update( &ota_loader_config.image_sha256_context, (const unsigned char*) data, length );
+    ota_loader_config.content_offset += length;
+    ota_loader_config.image_written += length;
+    return true;
+}
+/**
+  * @brief  Pass received content on to the serial flash, decompressing it if needed, and add it to the digest of the download
+  * @param  data, length
+  * @retval : true / false - write to flash failed or the compressed image is not valid
+  */
+static bool ota_stream_write( uint8_t *data, uint32_t length )
+{
+    wiced_time_t process_start, sflash_end, process_end;
+
+    wiced_time_get_time( &process_start );
+    if( ota_loader_config.resumed == true ) {// Only plain images are resumed, straight to the SFLASH
+        if( ota_image_output( data, length ) == false )
+            return false;
+    } else if( ota_image_write( data, length ) == false )
+        return false;
+    wiced_time_get_time( &sflash_end );
+    sha2_update( &ota_loader_config.sha256_context, (const unsigned char*) data, length );
+    wiced_time_get_time( &process_end );
+
+    ota_loader_config.stream_packets += 1;
+    ota_loader_config.stream_bytes += length;
+    ota_loader_config.stream_sflash_time += sflash_end - process_start;
+    ota_loader_config.stream_hash_time += process_end - sflash_end;
+    if( process_end - process_start > ota_loader_config.stream_max_packet_time )
+        ota_loader_config.stream_max_packet_time = process_end - process_start;
+    ota_loader_config.content_received += length;
+    return true;
+}
+/**
+  * @brief  Print the throughput of the download and the time spent on each stage
+  * @param  None
+  * @retval : None
+  */
+static void print_ota_stream_stats(void)
 {
-    int print_byte = 0;
-    unsigned char hash_output[ HASH_SIZE ];
+    wiced_time_t current_time;
+    uint32_t elapsed;
+
+    wiced_time_get_time( &current_time );
+    elapsed = current_time - ota_loader_config.stream_start_time;
+    if( elapsed == 0 )
+        elapsed = 1;
+    imx_printf( "OTA received %lu Bytes in %lu packets, %lu mSec, %lu Bytes/Sec\r\n", ota_loader_config.stream_bytes, ota_loader_config.stream_packets,
+            elapsed, (uint32_t) ( ( (uint64_t) ota_loader_config.stream_bytes * 1000 ) / elapsed ) );
+    imx_printf( "    SFLASH queue & decompress: %lu mSec, SHA-256: %lu mSec, Network & other: %lu mSec, Longest packet: %lu mSec\r\n",
+            ota_loader_config.stream_sflash_time, ota_loader_config.stream_hash_time,
+            elapsed - ( ota_loader_config.stream_sflash_time + ota_loader_config.stream_hash_time + ota_loader_config.stream_erase_time ),
+            ota_loader_config.stream_max_packet_time );
+    imx_printf( "    SFLASH erase: %lu mSec in %lu steps, Longest main loop stall: %lu mSec\r\n",
+            ota_loader_config.stream_erase_time, ota_loader_config.stream_erase_blocks, ota_loader_config.stream_max_step_time );
+    print_sflash_writer_status();
+}
 
-    memset( hash_output, 0, HASH_SIZE );
-    sha4_finish( context, hash_output );
+static void print_hash( char *title, uint8_t *hash )
+{
+    uint16_t i;
 
-    imx_printf( "SHA512                                  = ");
-    for ( print_byte = 0; print_byte < 64; print_byte++ ) imx_printf( "%x,", hash_output[ print_byte ] );
+    imx_printf( "%s SHA-256: ", title );
+    for( i = 0; i < OTA_HASH_SIZE; i++ )
+        imx_printf( "%02x", hash[ i ] );
     imx_printf( "\r\n" );
-
-    if ( 0 == memcmp( hash_output, hash, HASH_SIZE )) {
-        imx_printf( "SHA512, matches!\r\n");
-        return WICED_TRUE;
-    }
-    else {
-        imx_printf( "Calculated SHA512 is inconsistent with original : ");
-        for ( print_byte = 0; print_byte < HASH_SIZE; print_byte++ ) imx_printf( "%x,", hash[ print_byte ] );
-        imx_printf( "\r\n" );
+}
+/**
+  * @brief  Set if each image written to the serial flash is read back and checked against the digest of the download
+  * @param  None - ota_verify <on|off>
+  * @retval : None
+  */
+void cli_ota_verify( uint16_t arg )
+{
+    char *token;
+
+    token = strtok( NULL, " " );
+    if( token ) {
+        if( strcmp( token, "on" ) == 0 )
+            ota_loader_config.verify_sflash = true;
+        else if( strcmp( token, "off" ) == 0 )
+            ota_loader_config.verify_sflash = false;
+        else
+            imx_printf( "Invalid option, ota_verify <on|off>\r\n" );
     }
-    return WICED_FALSE;
+    imx_printf( "OTA SFLASH read back verification: %s\r\n", ota_loader_config.verify_sflash == true ? "Enabled" : "Disabled" );
+}
+
+/**
+  * @brief  Run one pass of the ota loader state machine, keeping the longest pass while a load is active
+  * @param  None
+  * @retval : None
+  */
+void ota_loader(void)
+{
+    wiced_time_t step_start, step_end;
+
+    wiced_time_get_time( &step_start );
+    ota_loader_step();
+    wiced_time_get_time( &step_end );
+    if( ( ota_is_active() == true ) && ( step_end - step_start > ota_loader_config.stream_max_step_time ) )
+        ota_loader_config.stream_max_step_time = step_end - step_start;
 }
-#endif
 
 /**
   * @brief  ota loader state machine
@@ -371,7 +782,7 @@ wiced_bool_t verify_sha512( sha4_context* context, uint8_t hash[] )
   */
 static  uint8_t local_buffer[ BUFFER_LENGTH ] CCMSRAM;
 
-void ota_loader(void)
+static void ota_loader_step(void)
 {
     wiced_result_t result;
     wiced_utc_time_t utc_time;
@@ -404,6 +815,9 @@ void ota_loader(void)
             ota_loader_config.accept_ranges = false;// Until a response from the web server says that the server will accept requests for part of a file.
 
             ota_loader_config.content_received = 0;
+            ota_loader_config.resumed = false;
+            ota_loader_config.next_checkpoint = OTA_CHECKPOINT_INTERVAL;
+            ota_checkpoint_clear();     // A download started from the beginning replaces any left from before
 
 /*
             image_location_t dct_app_location = {0};', DCT_APP_LOCATION_OF( ota_loader_config.image_no ), sizeof(image_location_t) ) != WICED_SUCCESS ) {
@@ -432,21 +846,44 @@ void ota_loader(void)
                 ota_loader_config.ota_loader_state = OTA_LOADER_IDLE;
             }
 
-            imx_printf( "About to erase FLash @:0x%08lX, for %lu Bytes\r\n", ota_loader_config.content_offset, ota_loader_config.erase_length );
+            imx_printf( "Erasing FLash @:0x%08lX as it is written, up to %lu Bytes\r\n", ota_loader_config.content_offset, ota_loader_config.erase_length );
             ota_loader_config.erase_count = ota_loader_config.content_offset;
+            ota_loader_config.erased_to = ota_loader_config.content_offset;
+            ota_loader_config.erase_end = ota_loader_config.content_offset + ota_loader_config.erase_length;
+            ota_loader_config.image_written = 0;
+            /*
+             * A delta image is applied to the installed image as it is decompressed, the installed image is read from its slot
+             */
+            if( ota_loader_config.delta == true )
+                ota_delta_start( true, ( uint32_t) apps_lut[ ota_loader_config.delta_source ].sectors[ 0 ].start * SFLASH_SECTOR_SIZE,
+                        ( uint32_t) apps_lut[ ota_loader_config.delta_source ].sectors[ 0 ].count * SFLASH_SECTOR_SIZE, ota_image_output, ota_delta_header );
+            else
+                ota_delta_start( false, 0, 0, ota_image_output, ota_delta_header );
+            ota_image_start( ota_delta_write, ota_image_header );
+            sha2_starts( &ota_loader_config.image_sha256_context, 0 );
+            /*
+             * Received content is programmed by the SFLASH writer thread, anything left from an earlier attempt is dropped.
+             * The areas are not checked, as before the writer
+             */
+            ota_loader_config.content_written = 0;
+            ota_loader_config.write_failed = false;
+            if( sflash_writer_start( ota_loader_config.content_offset, SFLASH_WRITER_UNCHECKED, ota_write_complete ) == false )
+                imx_printf( "SFLASH writer did not finish the previous image\r\n" );
             ota_loader_config.ota_loader_state = OTA_LOADER_ERASE_FLASH;
             break;
         case OTA_LOADER_ERASE_FLASH :
-            if( sflash_erase_area( &sflash_handle, ota_loader_config.content_offset,
-                    ota_loader_config.erase_length, ota_loader_config.erase_length ) != 0 )
-            {
-                imx_printf( "Sflash erase failed.\r\n" );
+            /*
+             * Only the first step is erased here, the rest is erased ahead of the writes while the download runs
+             */
+            if( ota_erase_step() == false ) {
+                ota_loader_config.ota_loader_state = OTA_PRE_LOADER_IDLE;
+                return;
             }
             ota_loader_config.ota_loader_state = OTA_LOADER_VERIFY_ERASE;
             break;
         case OTA_LOADER_VERIFY_ERASE :
 #ifdef VERIFY_FLASH
-            if( ota_loader_config.erase_count < ( ota_loader_config.content_offset + ota_loader_config.erase_length ) ) {
+            if( ota_loader_config.erase_count < ota_loader_config.erased_to ) {
                 imx_printf( "." );
 //              blink_red_led();
                 fflush(stdout);
@@ -469,6 +906,92 @@ void ota_loader(void)
             ota_loader_config.ota_loader_state = OTA_DNS_LOOKUP;
 #endif
             break;
+        case OTA_LOADER_RESUME :
+            /*
+             * Picked up after a reset, the content already programmed is read back and checked against the saved digest
+             */
+            ota_loader_config.socket_assigned = false;
+            ota_loader_config.good_load = false;
+            ota_loader_config.flash_sector_size = get_sflash_sector_size();
+            ota_loader_config.accept_ranges = true;     // Only checkpointed if the server accepts ranges
+            if( ota_loader_config.image_no >= FULL_IMAGE ) {
+                imx_printf( "Checkpoint for image %u can not be resumed, starting again\r\n", ota_loader_config.image_no );
+                ota_loader_config.ota_loader_state = OTA_LOADER_INIT;
+                break;
+            }
+            get_apps_lut_if_needed();
+            ota_loader_config.crc_content_offset = ( uint32_t) apps_lut[ ota_loader_config.image_no ].sectors[ 0 ].start * SFLASH_SECTOR_SIZE;
+            ota_loader_config.erase_length = ( uint32_t) apps_lut[ ota_loader_config.image_no ].sectors[ 0 ].count * SFLASH_SECTOR_SIZE;
+            ota_loader_config.allowed_sflash_area = WRITE_SFLASH_APP_AREA ( ota_loader_config.image_no );
+            if( ota_loader_config.total_content_length > ota_loader_config.erase_length ) {
+                imx_printf( "Checkpoint larger than image %u, starting again\r\n", ota_loader_config.image_no );
+                ota_loader_config.ota_loader_state = OTA_LOADER_INIT;
+                break;
+            }
+            ota_loader_config.crc_content_end = ota_loader_config.crc_content_offset + ota_loader_config.content_received;
+            ota_loader_config.crc_content_kept = ota_loader_config.crc_content_offset +
+                    ( ota_loader_config.content_received / ota_erase_step_size() ) * ota_erase_step_size();
+            sha2_starts( &ota_loader_config.image_sha256_context, 0 );
+            imx_printf( "Checking %lu Bytes in SFLASH @:0x%08lX\r\n", ota_loader_config.content_received, ota_loader_config.crc_content_offset );
+            ota_loader_config.ota_loader_state = OTA_LOADER_RESUME_VERIFY;
+            break;
+        case OTA_LOADER_RESUME_VERIFY :
+            if( ota_loader_config.crc_content_offset == ota_loader_config.crc_content_kept ) // Digest of the content kept, the download continues from it
+                memcpy( &checkpoint.sha256_context, &ota_loader_config.image_sha256_context, sizeof( sha2_context ) );
+            if( ota_loader_config.crc_content_offset < ota_loader_config.crc_content_end ) {
+                uint32_t bytes_remaining = ota_loader_config.crc_content_end -  ota_loader_config.crc_content_offset;
+                uint16_t length = BUFFER_LENGTH;
+                if( ota_loader_config.crc_content_offset < ota_loader_config.crc_content_kept )
+                    bytes_remaining = ota_loader_config.crc_content_kept - ota_loader_config.crc_content_offset;
+                if ( bytes_remaining < BUFFER_LENGTH ) {
+                    length = bytes_remaining;
+                }
+                if( sflash_read( &sflash_handle, ota_loader_config.crc_content_offset, local_buffer, length ) != 0 ) {
+                    imx_printf( "Failed to read SFLASH @:0x%08lX, starting again\r\n", ota_loader_config.crc_content_offset );
+                    ota_loader_config.ota_loader_state = OTA_LOADER_INIT;
+                    break;
+                }
+                sha2_update( &ota_loader_config.image_sha256_context, local_buffer, length );
+                ota_loader_config.crc_content_offset += length;
+            } else {
+                uint8_t sflash_hash[ OTA_HASH_SIZE ];
+                uint32_t image_start;
+
+                sha2_finish( &ota_loader_config.image_sha256_context, sflash_hash );
+                sha2_finish( &ota_loader_config.sha256_context, ota_loader_config.hash );
+                if( memcmp( sflash_hash, ota_loader_config.hash, OTA_HASH_SIZE ) != 0 ) {
+                    print_hash( "SFLASH", sflash_hash );
+                    print_hash( "Checkpoint", ota_loader_config.hash );
+                    imx_printf( "Content in SFLASH does not match the checkpoint, starting again\r\n" );
+                    ota_loader_config.ota_loader_state = OTA_LOADER_INIT;
+                    break;
+                }
+                /*
+                 * Carry on from the last whole erase step of the checked content. The steps before it are kept, the part
+                 * step after it may hold content written after the checkpoint and is erased and downloaded again
+                 */
+                image_start = ota_loader_config.crc_content_end - ota_loader_config.content_received;
+                memcpy( &ota_loader_config.sha256_context, &checkpoint.sha256_context, sizeof( sha2_context ) );
+                ota_loader_config.content_received = ota_loader_config.crc_content_kept - image_start;
+                ota_loader_config.content_offset = ota_loader_config.crc_content_kept;
+                ota_loader_config.image_written = ota_loader_config.content_received;
+                ota_loader_config.erase_count = image_start;
+                ota_loader_config.erased_to = ota_loader_config.crc_content_kept;
+                ota_loader_config.erase_end = image_start + ota_loader_config.erase_length;
+                ota_set_image_length( ota_loader_config.total_content_length );
+                ota_delta_start( false, 0, 0, ota_image_output, ota_delta_header );
+                ota_image_start( ota_delta_write, ota_image_header );
+                sha2_starts( &ota_loader_config.image_sha256_context, 0 );
+                ota_loader_config.content_written = ota_loader_config.content_received;
+                ota_loader_config.write_failed = false;
+                if( sflash_writer_start( ota_loader_config.content_offset, SFLASH_WRITER_UNCHECKED, ota_write_complete ) == false )
+                    imx_printf( "SFLASH writer did not finish the previous image\r\n" );
+                ota_loader_config.next_checkpoint = ota_loader_config.content_received + OTA_CHECKPOINT_INTERVAL;
+                ota_loader_config.packet_count = 0;
+                imx_printf( "SFLASH matches the checkpoint, resuming from 0x%08lX\r\n", ota_loader_config.content_offset );
+                ota_loader_config.ota_loader_state = OTA_DNS_LOOKUP;
+            }
+            break;
         case OTA_DNS_LOOKUP :// Restart after a partial download here if web server supports partial downloads.
             /*
              * During OTA Dim lights up to 100% and turn ON Green LED
@@ -566,6 +1089,7 @@ void ota_loader(void)
             result = wiced_tcp_send_buffer( &ota_loader_config.socket, local_buffer , (uint32_t) strlen( (char *) local_buffer ) );
             if ( result == WICED_TCPIP_SUCCESS ) {
                 if( result == WICED_TCPIP_SUCCESS ) {
+                    ota_stream_start();  // Whole file is being sent again
                     wiced_time_get_utc_time( &ota_loader_config.last_recv_packet_utc_time );
                     ota_loader_config.ota_loader_state = OTA_LOADER_PARSE_HEADER;
                     return;
@@ -573,7 +1097,6 @@ void ota_loader(void)
             }
             imx_printf( "FAILED to send request.\r\n" );
             ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_SOCKET;
-//            sha4_starts( &ota_loader_config.sha512context, USE_SHA512 );// Initialize the SHA512 computation.
             break;
         case OTA_LOADER_SEND_PARTIAL_REQUEST :      // Create query request and send
             memset( local_buffer, 0x00, BUFFER_LENGTH );
@@ -627,35 +1150,24 @@ void ota_loader(void)
                         ota_loader_config.accept_ranges = false;
 
                     ota_loader_config.total_content_length = strtol( return_item( packet_data, data_length, (uint8_t*)CONTENT_LENGTH, strlen( CONTENT_LENGTH ) ) + strlen( CONTENT_LENGTH ), NULL, 10 );
-#ifdef SKIP_THIS
                     /*
-                     * Get the SHA512 value if it was passed in.
+                     * Get the SHA-256 value if it was passed in.
                      */
-                    char* sha = return_item( packet_data, data_length, (uint8_t*)SHA512_FIELD_NAME, strlen( SHA512_FIELD_NAME ) );
-                    if ( sha == NULL ) {
-                        ota_loader_config.using_sha512 = 0;
-                    }
-                    else {
-                        ota_loader_config.using_sha512 = 1;
-                        sha += strlen( SHA512_FIELD_NAME );
+                    char* sha = return_item( packet_data, data_length, (uint8_t*)CONTENT_SHA256, strlen( CONTENT_SHA256 ) );
+                    ota_loader_config.using_sha256 = false;
+                    if ( sha != NULL ) {
+                        sha += strlen( CONTENT_SHA256 );
                         uint32_t sha_offset = (uint8_t*)sha - packet_data;
                         char* eol = return_item( (uint8_t*)sha, data_length - sha_offset, (uint8_t*)"\r", 1);
-                        char* sha_i = sha;
-
-                        imx_printf( "Received SHA512: " );
-                        while ( sha_i < eol ) {
-                            imx_printf( "%c", *sha_i );
-                            sha_i++;
-                        }
-                        imx_printf("\r\n");
-
-                        int success = base64_decode( (unsigned char*)sha, eol - sha, ota_loader_config.hash, HASH_SIZE + 1, BASE64_STANDARD );
-
-                        if ( success != HASH_SIZE ) {
-                            imx_printf("Base64 conversion failed with code: %d\r\n", success);
+                        if( eol != NULL ) {
+                            int success = base64_decode( (unsigned char*)sha, eol - sha, ota_loader_config.expected_hash, OTA_HASH_SIZE + 1, BASE64_STANDARD );
+                            if ( success == OTA_HASH_SIZE ) {
+                                ota_loader_config.using_sha256 = true;
+                                print_hash( "Received", ota_loader_config.expected_hash );
+                            } else
+                                imx_printf("Base64 conversion failed with code: %d\r\n", success);
                         }
                     }
-#endif
                     /*
                      * Find the end of the header
                      */
@@ -684,6 +1196,11 @@ void ota_loader(void)
                         wiced_packet_delete( temp_packet );
                         return;
                     }
+                    /*
+                     * Only erase as far as the image goes, the rest of the area is left alone. A compressed image sets the
+                     * decompressed length once its header is read
+                     */
+                    ota_set_image_length( ota_loader_config.total_content_length );
                     /*
                      * Save the remaining part of this buffer as the first part of the image
                      */
@@ -693,20 +1210,12 @@ void ota_loader(void)
                         /*
                          * Write bytes to flash
                          */
-
-                        if( 0 != sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) content_start, content_length ) ) {
-//                        if( 0 != protected_sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) content_start, content_length,
-//                                ota_loader_config.allowed_sflash_area ) ) {
-                            imx_printf( "Write to serial flash failed!\r\n" );
+                        ota_loader_config.content_received = 0;
+                        if( ota_stream_write( (uint8_t *) content_start, content_length ) == false ) {
                             ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
                             wiced_packet_delete( temp_packet );
                             return;
                         }
-
-//                        sha4_update( &ota_loader_config.sha512context, (const unsigned char*) content_start, content_length );
-
-                        ota_loader_config.content_received = content_length;
-                        ota_loader_config.content_offset += content_length;
                     }
                     wiced_time_get_utc_time( &ota_loader_config.last_recv_packet_utc_time );
                     ota_loader_config.packet_count = 1;
@@ -724,6 +1233,10 @@ void ota_loader(void)
                 packet_data = NULL;
                 data_length = 0;
             }else {
+                if( ota_erase_ahead() == false ) {
+                    ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+                    return;
+                }
                 wiced_time_get_utc_time( &utc_time );
                 if( utc_time > ota_loader_config.last_recv_packet_utc_time + TIMEOUT_WAIT_FOR_DATA ) {
                     ota_loader_config.ota_loader_state = OTA_LOADER_DATA_TIMEOUT;
@@ -771,19 +1284,11 @@ void ota_loader(void)
 
                         // Write bytes to flash
 
-                        if( 0 != sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) content_start, content_length ) ) {
-//                        if( 0 != protected_sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) content_start, content_length,
-//                                ota_loader_config.allowed_sflash_area ) ) {
-                            imx_printf( "Write to serial flash failed!\r\n" );
-//                          device_config.ota_fail_sflash_write += 1;
-//                          save_config();
+                        if( ota_stream_write( (uint8_t *) content_start, content_length ) == false ) {
                             ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
                             wiced_packet_delete( temp_packet );
                             return;
                         }
-
-                        ota_loader_config.content_received += content_length;
-                        ota_loader_config.content_offset += content_length;
                     }
                     wiced_time_get_utc_time( &ota_loader_config.last_recv_packet_utc_time );
 
@@ -808,20 +1313,11 @@ void ota_loader(void)
             break;
 
         case OTA_LOADER_RECEIVE_STREAM :
-            result = wiced_tcp_receive( &ota_loader_config.socket, &temp_packet, 0 );
+            result = wiced_tcp_receive( &ota_loader_config.socket, &temp_packet, OTA_RECEIVE_WAIT );
 //wiced_rtos_delay_milliseconds(500);
             if( result == WICED_TCPIP_SUCCESS ) { // Got some data process it - This will be the header
                 wiced_packet_get_data(temp_packet, 0, &packet_data, &data_length, &available_data_length);
 
-                if ( data_length > BUFFER_LENGTH ) {
-                    imx_printf( "The local buffer was too small to store the contents of a received packet.\r\n" );
-                    while ( 1 );
-                }
-                memmove( local_buffer, packet_data, data_length);
-                wiced_packet_delete( temp_packet );
-                temp_packet = NULL;
-                packet_data = NULL;
-
                 ota_loader_config.packet_count += 1;
                 /*
                  * Check to make sure we don't get memory overwrite
@@ -831,38 +1327,24 @@ void ota_loader(void)
                      * Abort as we would over run the allocated space
                      */
                     imx_printf( "Data length exceeded: %lu + %u = %lu\r\n", ota_loader_config.content_received , data_length, ota_loader_config.content_received + data_length);
+                    wiced_packet_delete( temp_packet );
                     ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
                     return;
                 }
                 /*
-                 * Write bytes to flash
+                 * Copy the bytes to the SFLASH writer straight from the packet, the digest is updated from the same data
                  */
-                wiced_time_t process_start = 0, process_end = 0, sflash_end = 0, crc_end = 0;
-
-                wiced_time_get_time( &process_start );
-
-                if ( 0 != sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) local_buffer, data_length ) ) {
-//                if ( 0 != protected_sflash_write( &sflash_handle, ota_loader_config.content_offset, (void*) local_buffer, data_length,
-//                        ota_loader_config.allowed_sflash_area ) ) {
-                    imx_printf( "Write to serial flash failed.\r\n");
-                    ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+                if( ota_stream_write( packet_data, data_length ) == false ) {
                     wiced_packet_delete( temp_packet );
+                    ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
                     return;
                 }
-                wiced_time_get_time( &sflash_end );
-
-                imx_printf( "(%u)Packet %u, @: 0x%08lX ", ota_loader_config.data_retry_count, ota_loader_config.packet_count, ota_loader_config.content_offset );
-
-                wiced_time_get_time( &crc_end );
-
-//                sha4_update( &ota_loader_config.sha512context, (const unsigned char*) local_buffer, data_length );
-
-                wiced_time_get_time( &process_end );
-
-                ota_loader_config.content_received += data_length;
-                ota_loader_config.content_offset += data_length;
-                imx_printf( "%u Bytes Now %lu/%lu ms: %lu/%lu/%lu/%lu\r\n", data_length, ota_loader_config.content_received, ota_loader_config.total_content_length,
-                        process_end - process_start, sflash_end - process_start, crc_end - sflash_end, process_end - crc_end );
+                wiced_packet_delete( temp_packet );
+                temp_packet = NULL;
+                packet_data = NULL;
+                if( ( ota_loader_config.packet_count % OTA_PROGRESS_PACKETS ) == 0 )
+                    imx_printf( "(%u)Packet %u, @: 0x%08lX Now %lu/%lu\r\n", ota_loader_config.data_retry_count, ota_loader_config.packet_count,
+                            ota_loader_config.content_offset, ota_loader_config.content_received, ota_loader_config.total_content_length );
                 /*
                  * Check if we have all the data yet
                  */
@@ -880,6 +1362,8 @@ void ota_loader(void)
                     ota_loader_config.ota_loader_state = OTA_LOADER_ALL_RECEIVED;
                     return;
                 }
+                if( ota_loader_config.content_received >= ota_loader_config.next_checkpoint )
+                    ota_save_checkpoint();
                 wiced_time_get_utc_time( &ota_loader_config.last_recv_packet_utc_time );    // Set last time we got a packet
                 data_length = 0;
             }else {// receive != SUCCESS
@@ -888,6 +1372,13 @@ void ota_loader(void)
 					ota_loader_config.ota_loader_state = OTA_LOADER_DATA_TIMEOUT;
             	}
             	else {
+            	    /*
+            	     * Nothing to write yet, use the wait to erase ahead
+            	     */
+            	    if( ota_erase_ahead() == false ) {
+            	        ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+            	        return;
+            	    }
 					wiced_time_get_utc_time( &utc_time );
 					if ( utc_time > ota_loader_config.last_recv_packet_utc_time + TIMEOUT_WAIT_FOR_DATA ) {
 						ota_loader_config.ota_loader_state = OTA_LOADER_DATA_TIMEOUT;
@@ -896,67 +1387,101 @@ void ota_loader(void)
             }
             break;
         case OTA_LOADER_ALL_RECEIVED :
-#ifdef SKIP_THIS
-            if ( ota_loader_config.using_sha512 != 0 ) {
-                if ( WICED_TRUE != verify_sha512( &ota_loader_config.sha512context, ota_loader_config.hash ) )
-                {
-                    imx_printf("Aborting update.\r\n");
+            if( ( ota_image_finish() == false ) || ( ota_delta_finish() == false ) || ( ota_stream_flush() == false ) ) {
+                ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+                return;
+            }
+            sha2_finish( &ota_loader_config.sha256_context, ota_loader_config.hash );
+            print_ota_stream_stats();
+            print_hash( "Downloaded", ota_loader_config.hash );
+            if ( ota_loader_config.using_sha256 == true ) {
+                if ( memcmp( ota_loader_config.hash, ota_loader_config.expected_hash, OTA_HASH_SIZE ) != 0 ) {
+                    print_hash( "Expected", ota_loader_config.expected_hash );
+                    imx_printf( "SHA-256 of download does not match, aborting update.\r\n" );
+                    ota_checkpoint_clear();     // Resuming would only rebuild the same bad image
                     ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
                     return;
                 }
+                imx_printf( "SHA-256, matches!\r\n" );
+            } else
+                imx_printf( "No SHA-256 was sent.\r\n" );
+            if( ( ota_image_compressed() == true ) && ( ota_delta_active() == false ) ) {
+                /*
+                 * The SFLASH holds the decompressed image, read back is checked against its digest
+                 */
+                sha2_finish( &ota_loader_config.image_sha256_context, ota_loader_config.hash );
+                imx_printf( "Decompressed %lu Bytes to %lu Bytes\r\n", ota_loader_config.content_received, ota_loader_config.image_written );
+                print_hash( "Decompressed", ota_loader_config.hash );
             }
-
-            else {
-                imx_printf("No SHA512 was sent.\r\n");// Store hash from downloaded file to verify sflash write.
-                sha4_finish( &ota_loader_config.sha512context, ota_loader_config.hash );
-                int print_byte = 0;
-                imx_printf( "SHA512                                  = ");
-                for ( print_byte = 0; print_byte < 64; print_byte++ ) imx_printf( "%x,", ota_loader_config.hash[ print_byte ] );
-                imx_printf( "\r\n" );
+            if( ota_delta_active() == true ) {
+                /*
+                 * The SFLASH holds the rebuilt image, it must match the digest the patch was made for
+                 */
+                sha2_finish( &ota_loader_config.image_sha256_context, ota_loader_config.hash );
+                imx_printf( "Delta of %lu Bytes rebuilt %lu Bytes from image %u\r\n", ota_loader_config.content_received,
+                        ota_loader_config.image_written, ota_loader_config.delta_source );
+                print_hash( "Rebuilt", ota_loader_config.hash );
+                if( memcmp( ota_loader_config.hash, ota_delta_target_hash(), OTA_HASH_SIZE ) != 0 ) {
+                    print_hash( "Expected", (uint8_t *) ota_delta_target_hash() );
+                    imx_printf( "SHA-256 of rebuilt image does not match, aborting update.\r\n" );
+                    ota_checkpoint_clear();
+                    ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+                    return;
+                }
             }
-#endif
-            // Set content_offset back to the start of the downloaded file in flash.
-            ota_loader_config.content_offset -= ota_loader_config.content_received;
+            // Set content_offset back to the start of the image in flash.
+            ota_loader_config.content_offset -= ota_loader_config.image_written;
             ota_loader_config.ota_loader_state = OTA_LOADER_VERIFY_OTA;
             return;
             break;
         case OTA_LOADER_VERIFY_OTA :
-//            sha4_starts( &ota_loader_config.sha512context, USE_SHA512 );
             ota_loader_config.crc_content_offset = ota_loader_config.content_offset;// - ota_loader_config.content_received;
-            ota_loader_config.crc_content_end = ota_loader_config.content_offset + ota_loader_config.content_received;
-//            imx_printf( "Calculating SFLASH SHA512 hash.\r\n" );
+            ota_loader_config.crc_content_end = ota_loader_config.content_offset + ota_loader_config.image_written;
             /*
              * Blink LED to indicate action
              */
             imx_set_led( IMX_LED_RED, IMX_LED_OTHER, IMX_LED_BLINK_1 | IMX_LED_BLINK_1_8 );
-            ota_loader_config.good_load = true;
-            ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
-//            ota_loader_config.ota_loader_state = OTA_CALC_CRC;
+            if( ( ota_loader_config.verify_sflash == true ) || ( ota_loader_config.resumed == true ) ) {
+                /*
+                 * Optional second pass, read the image back from the SFLASH and check it against the digest of the download.
+                 * Always done for a resumed download, part of it was written before the reset
+                 */
+                imx_printf( "Calculating SFLASH SHA-256 hash.\r\n" );
+                sha2_starts( &ota_loader_config.sha256_context, 0 );
+                ota_loader_config.ota_loader_state = OTA_LOADER_VERIFY_SFLASH;
+            } else {
+                ota_loader_config.good_load = true;
+                ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+            }
             break;
-#ifdef SKIP_THIS
-        case OTA_CALC_CRC :
+        case OTA_LOADER_VERIFY_SFLASH :
             if( ota_loader_config.crc_content_offset < ota_loader_config.crc_content_end ) {
-//              blink_red_led();
                 uint32_t bytes_remaining = ota_loader_config.crc_content_end -  ota_loader_config.crc_content_offset;
                 uint16_t length = BUFFER_LENGTH;
                 if ( bytes_remaining < BUFFER_LENGTH ) {
                     length = bytes_remaining;
                 }
                 sflash_read( &sflash_handle, ota_loader_config.crc_content_offset, local_buffer, length );
-//                sha4_update( &ota_loader_config.sha512context, local_buffer, length );
+                sha2_update( &ota_loader_config.sha256_context, local_buffer, length );
                 ota_loader_config.crc_content_offset += length;
-            } else if ( WICED_TRUE != verify_sha512( &ota_loader_config.sha512context, ota_loader_config.hash ) ) {
-                imx_printf( "SHA512 hash for saved file is different from the hash computed from the download.\r\n" );
-                imx_printf( "Writing file to flash failed! Aborting update.\r\n" );
-                ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
-                return;
             } else {
+                uint8_t sflash_hash[ OTA_HASH_SIZE ];
+
+                sha2_finish( &ota_loader_config.sha256_context, sflash_hash );
+                if ( memcmp( sflash_hash, ota_loader_config.hash, OTA_HASH_SIZE ) != 0 ) {
+                    print_hash( "SFLASH", sflash_hash );
+                    imx_printf( "SHA-256 hash for saved file is different from the hash computed from the download.\r\n" );
+                    imx_printf( "Writing file to flash failed! Aborting update.\r\n" );
+                    device_config.ota_fail_sflash_crc += 1;
+                    ota_checkpoint_clear();
+                    ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
+                    return;
+                }
                 imx_printf( "Sflash write is good\r\n" );
                 ota_loader_config.good_load = true;
                 ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_CONNECTION;
             }
             break;
-#endif
         case OTA_LOADER_DATA_TIMEOUT :
             ota_loader_config.data_retry_count++;
             if( ota_loader_config.data_retry_count > MAX_DATA_RETRY_COUNT ) {
@@ -979,10 +1504,12 @@ void ota_loader(void)
             ota_loader_config.ota_loader_state = OTA_LOADER_CLOSE_SOCKET;
             break;
         case OTA_LOADER_CLOSE_SOCKET :
+            sflash_writer_flush();  // Nothing is left programming once the loader is idle
             wiced_tcp_disconnect( &ota_loader_config.socket );
             wiced_tcp_delete_socket( &ota_loader_config.socket );
             ota_loader_config.socket_assigned = false;
             if( ota_loader_config.good_load ) {
+                ota_checkpoint_clear(); // A bad image already dropped it, a download cut off by the network is resumed later
                 imx_printf("Save is good.\r\n");
                 ota_loader_config.ota_loader_state = OTA_LOADER_DONE;
             }
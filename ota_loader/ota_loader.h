@@ -70,12 +70,15 @@ void init_ota_loader(void);
 bool ota_is_active(void);
 bool ota_get_latest_is_active(void);
 void setup_ota_loader( char *site, char *uri, uint16_t port, uint16_t image_no, uint16_t load_file );
+void setup_ota_delta( char *site, char *uri, uint16_t port, uint16_t source_image );
+void ota_resume(void);
 void ota_loader(void);
 void ota_loader_deinit(void);
 void print_lut(uint16_t arg);
 void reboot_to_image( uint16_t image_no );
 void setup_get_latest_version(uint16_t image_type, char *site );
 void cli_get_latest( uint16_t arg );
+void cli_ota_verify( uint16_t arg );
 uint16_t get_latest_version(void);
 wiced_result_t protected_wiced_framework_set_boot( uint16_t image_no, uint16_t load_mode );
 
@@ -44,6 +44,7 @@
  *
  */
 #include "wiced_apps_common.h"
+#include "wiced_crypto.h"
 
 /******************************************************
  *                      Macros
@@ -69,6 +70,8 @@
 #define HTTP_RESPONSE_NOT_FOUND     "404 Not Found"
 
 #define CONTENT_LENGTH              "Content-Length:"
+#define CONTENT_SHA256              "Content-SHA256: "   // Optional, base64 SHA-256 of the image
+#define OTA_HASH_SIZE               32
 #define ACCEPT_RANGES               "Accept-Ranges: bytes"
 #define CRLFCRLF                    "\r\n\r\n"
 
@@ -114,6 +117,7 @@ struct OTA_CONFIGURATION {
 	uint16_t port;
     wiced_tls_context_t context;// TLS is not currently supported.
     uint16_t image_no;
+    uint16_t delta_source;                      // Installed image a delta is applied to, image_no is the other application slot
     uint16_t image_type;
     uint16_t ota_loader_state;
     uint16_t last_ota_loader_state;
@@ -130,20 +134,46 @@ struct OTA_CONFIGURATION {
     uint32_t content_offset;
     uint32_t erase_length;
     uint32_t erase_count;
+    uint32_t erased_to;                         // Flash from the start of the image up to here is erased, ready to write
+    uint32_t erase_end;                         // End of the flash that may be erased for this image
     uint32_t flash_sector_size;
+    uint32_t image_written;                     // Bytes of the image in the SFLASH, after decompression and delta
+    uint32_t next_checkpoint;                   // Content received at which the next resume checkpoint is saved
     uint32_t crc_content_offset;
     uint32_t crc_content_end;
+    uint32_t crc_content_kept;                  // Resuming, the whole erase steps of content below here are kept
+    sha2_context sha256_context;                // SHA-256 of the image, updated as each packet is written
+    sha2_context image_sha256_context;          // SHA-256 of a compressed or delta image once rebuilt, what is in the SFLASH
+    uint8_t hash[ OTA_HASH_SIZE ];              // Digest of the received image
+    uint8_t expected_hash[ OTA_HASH_SIZE ];     // Digest sent by the server
+    wiced_time_t stream_start_time;
+    uint32_t stream_packets;
+    uint32_t stream_bytes;
+    uint32_t stream_sflash_time;                // mSec spent writing serial flash
+    uint32_t stream_hash_time;                  // mSec spent on the digest
+    uint32_t stream_max_packet_time;
+    uint32_t stream_erase_time;                 // mSec spent erasing serial flash ahead of the writes
+    uint32_t stream_erase_blocks;
+    uint32_t stream_max_step_time;              // Longest single pass of the loader, the longest main loop stall
+    volatile uint32_t content_written;          // Set from the SFLASH writer thread as each buffer is programmed
+    volatile uint32_t write_failed_address;
+    volatile bool write_failed;
     wiced_tcp_socket_t socket;
     wiced_tcp_stream_t tcp_stream;
 //    uint32_t checksum;
 //    uint32_t checksum32;
     uint16_t allowed_sflash_area;
+    uint8_t resume_count;                       // Resets this download has been resumed from
     unsigned int socket_assigned	: 1;
     unsigned int good_load 			: 1;
     unsigned int good_get_latest 	: 1;
     unsigned int good_get_power 	: 1;
     unsigned int load_file 			: 1;
     unsigned int accept_ranges 		: 1;
+    unsigned int using_sha256       : 1;
+    unsigned int verify_sflash      : 1;
+    unsigned int delta              : 1;
+    unsigned int resumed            : 1;        // Picked up from a checkpoint after a reset, always a plain image
 };
 
 /******************************************************
@@ -46,6 +46,7 @@
 #include "spi_flash.h"
 #include "../cli/interface.h"
 #include "../cli/messages.h"
+#include "../cli/imx_debug.h"
 #include "../storage.h"
 //#include "../fixture/certificates.h"
 #include "../common.h"
@@ -54,9 +55,9 @@
 /******************************************************
  *                      Macros
  ******************************************************/
-#ifdef PRINT_DEBUGS_FOR_SFLASH
+#if IMX_DEBUG_COMPILED( DEBUGS_FOR_SFLASH )
     #undef PRINTF
-	#define PRINTF(...) if( ( device_config.log_messages & DEBUGS_FOR_SFLASH ) != 0x00 ) imx_printf(__VA_ARGS__)
+	#define PRINTF(...) IMX_DEBUG_PRINTF( DEBUGS_FOR_SFLASH, __VA_ARGS__ )
 #elif !defined PRINTF
     #define PRINTF(...)
 #endif
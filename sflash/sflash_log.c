@@ -0,0 +1,159 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file sflash_log.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Helpers shared by the append only logs in unpartitioned serial flash. Each log is a ring of fixed size slots in whole
+ *  sectors, the sector ahead of the write position is erased before it is used so a log must span at least two of the
+ *  largest sectors. The caller serializes flash access, these do not take the writer lock.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../storage.h"
+#include "../ota_loader/ota_structure.h"
+#include "sflash.h"
+#include "sflash_log.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SFLASH_LOG_SECTOR_4K        ( 0x1000 )  // Units of the LUT sector entries
+#define SFLASH_LOG_MIN_START        ( 0x10000 )
+#define SFLASH_LOG_BLANK_READ       ( 64 )      // Bytes read at a time when checking a slot is blank
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern sflash_handle_t sflash_handle;
+extern app_header_t apps_lut[ 8 ];
+extern IOT_Device_Config_t device_config;   // Defined in storage.h
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Make sure a log lies in flash, in whole sectors, clear of every image in the LUT and the configuration area
+  * @param  start address, size
+  * @retval : true / false
+  */
+bool sflash_log_area_free( uint32_t start, uint32_t size )
+{
+    uint16_t i;
+    uint32_t sector_size, app_addr, next_app_addr;
+
+    sector_size = get_sflash_sector_size();
+    if( ( ( start % sector_size ) != 0 ) || ( ( size % sector_size ) != 0 ) || ( size < SFLASH_LOG_MIN_SECTORS * sector_size ) ||
+        ( start + size > device_config.sflash_size ) || ( start + size > SFLASH_LOG_CONFIG_AREA ) || ( start < SFLASH_LOG_MIN_START ) )
+        return false;
+    get_apps_lut_if_needed();
+    for( i = 0; i < FULL_IMAGE; i++ ) {
+        if( apps_lut[ i ].count == 1 ) {
+            app_addr = apps_lut[ i ].sectors[ 0 ].start * SFLASH_LOG_SECTOR_4K;
+            next_app_addr = app_addr + ( apps_lut[ i ].sectors[ 0 ].count * SFLASH_LOG_SECTOR_4K );
+            if( ( start < next_app_addr ) && ( start + size > app_addr ) )
+                return false;
+        }
+    }
+    return true;
+}
+/**
+  * @brief  Check that a slot has never been programmed
+  * @param  address, length
+  * @retval : true / false
+  */
+bool sflash_log_slot_blank( uint32_t address, uint32_t length )
+{
+    uint8_t buffer[ SFLASH_LOG_BLANK_READ ];
+    uint32_t i, count;
+
+    for( i = 0; i < length; i += count ) {
+        count = ( ( length - i ) < SFLASH_LOG_BLANK_READ ) ? length - i : SFLASH_LOG_BLANK_READ;
+        if( sflash_read( &sflash_handle, address + i, buffer, count ) != 0 )
+            return false;
+        if( ( buffer[ 0 ] != 0xFF ) || ( memcmp( buffer, buffer + 1, count - 1 ) != 0 ) )
+            return false;
+    }
+    return true;
+}
+/**
+  * @brief  Offset of the slot after this one, wraps to the start of the log
+  * @param  offset in the log, slot size, log size
+  * @retval : offset
+  */
+uint32_t sflash_log_next_slot( uint32_t offset, uint32_t slot_size, uint32_t log_size )
+{
+    offset += slot_size;
+    return ( offset >= log_size ) ? 0 : offset;
+}
+/**
+  * @brief  CRC-16 CCITT, polynomial 0x1021 - start with 0xFFFF, pass the running crc to continue over more data
+  * @param  running crc, data, length
+  * @retval : crc
+  */
+uint16_t sflash_log_crc( uint16_t crc, const uint8_t *data, uint32_t length )
+{
+    uint16_t i;
+
+    while( length-- > 0 ) {
+        crc ^= (uint16_t) *data++ << 8;
+        for( i = 0; i < 8; i++ )
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : ( crc << 1 );
+    }
+    return crc;
+}
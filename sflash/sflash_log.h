@@ -0,0 +1,75 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file sflash_log.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ */
+
+#ifndef SFLASH_LOG_H_
+#define SFLASH_LOG_H_
+
+/*
+ *  Helpers shared by the append only logs kept in unpartitioned serial flash - the flash spill log, the trace mirror and
+ *  the OTA checkpoints
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SFLASH_LOG_CONFIG_AREA      ( 0x3FFFFF - ( 2 * 0x10000 ) )  // Writes past here are to the configuration area
+#define SFLASH_LOG_MIN_SECTORS      ( 2 )       // A sector is erased ahead of the write position, one must always hold records
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+bool sflash_log_area_free( uint32_t start, uint32_t size );
+bool sflash_log_slot_blank( uint32_t address, uint32_t length );
+uint32_t sflash_log_next_slot( uint32_t offset, uint32_t slot_size, uint32_t log_size );
+uint16_t sflash_log_crc( uint16_t crc, const uint8_t *data, uint32_t length );
+#endif /* SFLASH_LOG_H_ */
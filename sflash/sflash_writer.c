@@ -0,0 +1,362 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file sflash_writer.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Double buffered serial flash writer. The caller copies a sequential stream into one buffer while a lower priority
+ *  thread programs the other, so programming overlaps the time the caller spends waiting on the network. Each buffer
+ *  covers whole flash pages, only the first buffer of a stream that does not start on a buffer boundary is short.
+ *  Completion is reported through a callback and the first failure stops the stream.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+
+#include "../cli/interface.h"
+#include "sflash.h"
+#include "sflash_writer.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SFLASH_WRITER_BUFFERS               2
+#define SFLASH_WRITER_BUFFER_SIZE           2048    // Multiple of the 256 Byte flash page
+#define SFLASH_WRITER_TIMEOUT               1000    // mSec to wait for a buffer to be programmed
+#define SFLASH_WRITER_THREAD_STACK_SIZE     1536
+/*
+ * Below the application on purpose. imx_process() never sleeps, so this thread only runs while the application is blocked.
+ * The overlap depends on the OTA loader blocking in tcp_receive() for the next segment while a buffer is programmed. A
+ * caller that never blocks still completes, it waits in wait_for_buffer() once both buffers are full and the writer runs
+ * then, but with no overlap. Above the application the writer would preempt the caller and poll the flash busy status
+ * itself, which gives no overlap either
+ */
+#define SFLASH_WRITER_THREAD_PRIORITY       ( WICED_APPLICATION_PRIORITY + 1 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+enum sflash_writer_buffer_state_t {
+    WRITER_BUFFER_FREE,
+    WRITER_BUFFER_FILLING,
+    WRITER_BUFFER_QUEUED
+};
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint8_t data[ SFLASH_WRITER_BUFFER_SIZE ] __attribute__ ((aligned (4)));
+    uint32_t address;
+    uint32_t length;
+    volatile uint16_t state;
+} sflash_writer_buffer_t;
+
+typedef struct {
+    uint32_t programs;
+    uint32_t bytes;
+    uint32_t program_time;                  // mSec spent programming
+    uint32_t max_program_time;
+    uint32_t waits;                         // Times the caller found no free buffer
+    uint32_t wait_time;                     // mSec the caller spent waiting for one
+    uint32_t failures;
+} sflash_writer_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static void sflash_writer_thread( wiced_thread_arg_t arg );
+static bool program_buffer( sflash_writer_buffer_t *buffer );
+static void submit_buffer( sflash_writer_buffer_t *buffer );
+static bool wait_for_buffer( sflash_writer_buffer_t *buffer );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+extern sflash_handle_t sflash_handle;
+
+static sflash_writer_buffer_t writer_buffer[ SFLASH_WRITER_BUFFERS ];
+static wiced_thread_t writer_thread;
+static wiced_semaphore_t writer_work, writer_done;
+static wiced_mutex_t sflash_mutex;
+static bool writer_running = false, mutex_ready = false;
+static uint16_t fill_index, program_index;
+static uint32_t stream_address;
+static uint16_t stream_allowed_areas;
+static sflash_writer_callback_t stream_callback;
+static volatile bool stream_failed;
+static sflash_writer_stats_t stats;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Start the writer thread, until it runs streams are programmed in the caller
+  * @param  None
+  * @retval : true if the thread started
+  */
+bool sflash_writer_init(void)
+{
+    memset( writer_buffer, 0x00, sizeof( writer_buffer ) );
+    memset( &stats, 0x00, sizeof( stats ) );
+    fill_index = 0;
+    program_index = 0;
+    stream_failed = false;
+    stream_callback = NULL;
+    if( wiced_rtos_init_mutex( &sflash_mutex ) != WICED_SUCCESS )
+        return false;
+    mutex_ready = true;
+    if( ( wiced_rtos_init_semaphore( &writer_work ) != WICED_SUCCESS ) || ( wiced_rtos_init_semaphore( &writer_done ) != WICED_SUCCESS ) )
+        return false;
+    if( wiced_rtos_create_thread( &writer_thread, SFLASH_WRITER_THREAD_PRIORITY, "SFLASH writer", sflash_writer_thread,
+            SFLASH_WRITER_THREAD_STACK_SIZE, NULL ) != WICED_SUCCESS )
+        return false;
+    writer_running = true;
+    return true;
+}
+/**
+  * @brief  Start a new sequential stream - waits for the previous stream to be programmed, data that was never flushed is dropped
+  * @param  address of the first byte, areas for protected_sflash_write() or SFLASH_WRITER_UNCHECKED, callback or NULL
+  * @retval : true / false - the previous stream did not complete
+  */
+bool sflash_writer_start( uint32_t address, uint16_t allowed_areas, sflash_writer_callback_t callback )
+{
+    uint16_t i;
+    bool result = true;
+
+    for( i = 0; i < SFLASH_WRITER_BUFFERS; i++ ) {
+        if( writer_buffer[ i ].state == WRITER_BUFFER_FILLING )
+            writer_buffer[ i ].state = WRITER_BUFFER_FREE;
+        else if( wait_for_buffer( &writer_buffer[ i ] ) == false )
+            result = false;
+    }
+    stream_address = address;
+    stream_allowed_areas = allowed_areas;
+    stream_callback = callback;
+    stream_failed = false;
+    return result;
+}
+/**
+  * @brief  Add data to the stream, full buffers are handed to the writer thread
+  * @param  data, length
+  * @retval : true / false - a buffer failed to program or none came free in time
+  */
+bool sflash_writer_write( const uint8_t *data, uint32_t length )
+{
+    sflash_writer_buffer_t *buffer;
+    uint32_t space;
+
+    while( ( length > 0 ) && ( stream_failed == false ) ) {
+        buffer = &writer_buffer[ fill_index ];
+        if( buffer->state != WRITER_BUFFER_FILLING ) {
+            if( wait_for_buffer( buffer ) == false ) {
+                stream_failed = true;
+                break;
+            }
+            buffer->address = stream_address;
+            buffer->length = 0;
+            buffer->state = WRITER_BUFFER_FILLING;
+        }
+        /*
+         * Fill to the next buffer boundary so programs after the first are aligned
+         */
+        space = SFLASH_WRITER_BUFFER_SIZE - ( ( buffer->address % SFLASH_WRITER_BUFFER_SIZE ) + buffer->length );
+        if( space > length )
+            space = length;
+        memcpy( &buffer->data[ buffer->length ], data, space );
+        buffer->length += space;
+        stream_address += space;
+        data += space;
+        length -= space;
+        if( ( buffer->address + buffer->length ) % SFLASH_WRITER_BUFFER_SIZE == 0 )
+            submit_buffer( buffer );
+    }
+    return ( stream_failed == false );
+}
+/**
+  * @brief  Program any partly filled buffer and wait until everything written to the stream is in the flash
+  * @param  None
+  * @retval : true / false - a buffer failed to program
+  */
+bool sflash_writer_flush(void)
+{
+    uint16_t i;
+
+    if( writer_buffer[ fill_index ].state == WRITER_BUFFER_FILLING ) {
+        if( writer_buffer[ fill_index ].length > 0 )
+            submit_buffer( &writer_buffer[ fill_index ] );
+        else
+            writer_buffer[ fill_index ].state = WRITER_BUFFER_FREE;
+    }
+    for( i = 0; i < SFLASH_WRITER_BUFFERS; i++ )
+        if( wait_for_buffer( &writer_buffer[ i ] ) == false )
+            stream_failed = true;
+    return ( stream_failed == false );
+}
+/**
+  * @brief  Hold the serial flash - used around other flash operations that can happen while a stream is programmed
+  * @param  None
+  * @retval : None
+  */
+void sflash_writer_lock(void)
+{
+    if( mutex_ready == true )
+        wiced_rtos_lock_mutex( &sflash_mutex );
+}
+/**
+  * @brief  Release the serial flash
+  * @param  None
+  * @retval : None
+  */
+void sflash_writer_unlock(void)
+{
+    if( mutex_ready == true )
+        wiced_rtos_unlock_mutex( &sflash_mutex );
+}
+/**
+  * @brief  Print the writer statistics
+  * @param  None
+  * @retval : None
+  */
+void print_sflash_writer_status(void)
+{
+    imx_cli_print( "SFLASH writer: %s, %u x %u Byte buffers, %lu programs, %lu Bytes in %lu mSec, longest: %lu mSec, failed: %lu\r\n",
+            writer_running == true ? "Running" : "Inline", SFLASH_WRITER_BUFFERS, SFLASH_WRITER_BUFFER_SIZE, stats.programs, stats.bytes,
+            stats.program_time, stats.max_program_time, stats.failures );
+    imx_cli_print( "    Waited for a free buffer %lu times, %lu mSec\r\n", stats.waits, stats.wait_time );
+}
+/**
+  * @brief  Hand a filled buffer to the writer thread, or program it now if the thread is not running
+  * @param  buffer
+  * @retval : None
+  */
+static void submit_buffer( sflash_writer_buffer_t *buffer )
+{
+    fill_index = ( fill_index + 1 ) % SFLASH_WRITER_BUFFERS;
+    if( writer_running == false ) {
+        program_buffer( buffer );
+        buffer->state = WRITER_BUFFER_FREE;
+        return;
+    }
+    __sync_synchronize();
+    buffer->state = WRITER_BUFFER_QUEUED;
+    wiced_rtos_set_semaphore( &writer_work );
+}
+/**
+  * @brief  Wait for a buffer to be programmed
+  * @param  buffer
+  * @retval : true / false - timed out
+  */
+static bool wait_for_buffer( sflash_writer_buffer_t *buffer )
+{
+    wiced_time_t wait_start, wait_end;
+
+    if( buffer->state != WRITER_BUFFER_QUEUED )
+        return true;
+    stats.waits += 1;
+    wiced_time_get_time( &wait_start );
+    while( buffer->state == WRITER_BUFFER_QUEUED ) {
+        if( wiced_rtos_get_semaphore( &writer_done, SFLASH_WRITER_TIMEOUT ) != WICED_SUCCESS ) {
+            imx_printf( "SFLASH writer timed out @: 0x%08lX\r\n", buffer->address );
+            return false;
+        }
+    }
+    wiced_time_get_time( &wait_end );
+    stats.wait_time += wait_end - wait_start;
+    return true;
+}
+/**
+  * @brief  Program a buffer and report the result to the stream callback
+  * @param  buffer
+  * @retval : true / false - write failed
+  */
+static bool program_buffer( sflash_writer_buffer_t *buffer )
+{
+    wiced_time_t program_start, program_end;
+    int result;
+
+    sflash_writer_lock();
+    wiced_time_get_time( &program_start );
+    if( stream_allowed_areas == SFLASH_WRITER_UNCHECKED )
+        result = sflash_write( &sflash_handle, buffer->address, buffer->data, buffer->length );
+    else
+        result = protected_sflash_write( &sflash_handle, buffer->address, buffer->data, buffer->length, stream_allowed_areas );
+    wiced_time_get_time( &program_end );
+    sflash_writer_unlock();
+
+    stats.programs += 1;
+    stats.bytes += buffer->length;
+    stats.program_time += program_end - program_start;
+    if( program_end - program_start > stats.max_program_time )
+        stats.max_program_time = program_end - program_start;
+    if( result != 0 ) {
+        stats.failures += 1;
+        stream_failed = true;
+    }
+    if( stream_callback != NULL )
+        stream_callback( buffer->address, buffer->length, result == 0 );
+    return ( result == 0 );
+}
+/**
+  * @brief  Program buffers in the order they were filled
+  * @param  None
+  * @retval : None
+  */
+static void sflash_writer_thread( wiced_thread_arg_t arg )
+{
+    sflash_writer_buffer_t *buffer;
+
+    UNUSED_PARAMETER( arg );
+    while( true ) {
+        wiced_rtos_get_semaphore( &writer_work, WICED_NEVER_TIMEOUT );
+        buffer = &writer_buffer[ program_index ];
+        if( buffer->state != WRITER_BUFFER_QUEUED )
+            continue;
+        program_buffer( buffer );
+        program_index = ( program_index + 1 ) % SFLASH_WRITER_BUFFERS;
+        __sync_synchronize();
+        buffer->state = WRITER_BUFFER_FREE;
+        wiced_rtos_set_semaphore( &writer_done );
+    }
+}
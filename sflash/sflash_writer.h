@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+/** @file sflash_writer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ */
+
+#ifndef SFLASH_WRITER_H_
+#define SFLASH_WRITER_H_
+
+/*
+ *  Double buffered serial flash writer - a sequential stream is copied into page aligned buffers that are programmed by
+ *  a writer thread while the caller fills the next one
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SFLASH_WRITER_UNCHECKED     0       // allowed_areas for a stream that is written without the area checks
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+/*
+ * Called from the writer thread after each buffer is programmed - keep it short and do not use the serial flash
+ */
+typedef void (*sflash_writer_callback_t)( uint32_t address, uint32_t length, bool success );
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+bool sflash_writer_init(void);
+bool sflash_writer_start( uint32_t address, uint16_t allowed_areas, sflash_writer_callback_t callback );
+bool sflash_writer_write( const uint8_t *data, uint32_t length );
+bool sflash_writer_flush(void);
+void sflash_writer_lock(void);
+void sflash_writer_unlock(void);
+void print_sflash_writer_status(void);
+#endif /* SFLASH_WRITER_H_ */
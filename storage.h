@@ -209,6 +209,7 @@ typedef struct control_sensor_data {
     unsigned int valid                  : 1;    // 1    Has data be read yet
     unsigned int reserved               : 8;    // 24-31
     uint16_t no_samples;
+    uint16_t start_index;                       // Oldest entry in circular history
     uint32_t errors;
     wiced_utc_time_ms_t last_sample_time;
     wiced_time_t last_poll_time;
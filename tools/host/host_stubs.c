@@ -0,0 +1,153 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file host_stubs.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  The firmware functions and globals the host tests link against in place of the rest of the image - console output,
+ *  time, the device configuration and the SFLASH wrappers, which go straight to the simulated flash.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "wiced_apps_common.h"
+
+#include "../../storage.h"
+#include "../../device/icb_def.h"
+#include "../../sflash/sflash.h"
+#include "host_stubs.h"
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+wiced_time_t host_time;
+bool host_verbose;
+uint32_t host_failures;
+IOT_Device_Config_t device_config;
+iMatrix_Control_Block_t icb;
+app_header_t apps_lut[ 8 ];
+extern sflash_handle_t sflash_handle;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Count and report a failed check
+  * @param  condition, its text, where it is
+  * @retval : condition
+  */
+bool host_check( bool condition, const char *text, const char *file, int line )
+{
+    if( condition == false ) {
+        printf( "%s:%d: FAIL: %s\n", file, line, text );
+        host_failures += 1;
+    }
+    return condition;
+}
+/**
+  * @brief  Print the result of a test program
+  * @param  name of the test
+  * @retval : exit status
+  */
+int host_result( const char *test )
+{
+    printf( "%s: %s\n", test, ( host_failures == 0 ) ? "PASS" : "FAIL" );
+    return ( host_failures == 0 ) ? 0 : 1;
+}
+
+void imx_printf( char *format, ... )
+{
+    va_list args;
+
+    if( host_verbose == false )
+        return;
+    va_start( args, format );
+    vprintf( format, args );
+    va_end( args );
+}
+
+void imx_cli_print( char *format, ... )
+{
+    va_list args;
+
+    va_start( args, format );
+    vprintf( format, args );
+    va_end( args );
+}
+
+wiced_result_t wiced_time_get_time( wiced_time_t* time )
+{
+    *time = host_time;
+    return WICED_SUCCESS;
+}
+
+wiced_result_t wiced_time_get_utc_time_ms( wiced_utc_time_ms_t* utc_time_ms )
+{
+    *utc_time_ms = (wiced_utc_time_ms_t) 1791590400000ULL + host_time;  // Oct 2026
+    return WICED_SUCCESS;
+}
+
+uint64_t htonll( uint64_t n )
+{
+    return ( (uint64_t) htonl( (uint32_t) n ) << 32 ) | htonl( (uint32_t) ( n >> 32 ) );
+}
+
+uint32_t get_sflash_sector_size(void)
+{
+    return ( sflash_handle.device_id == SFLASH_ID_M25P32 ) ? 0x10000 : 0x1000;
+}
+
+void get_apps_lut_if_needed(void)
+{
+}
+/*
+ * The area checks are left to the tests, each one only writes where its module is allowed to
+ */
+int protected_sflash_write( const sflash_handle_t* const handle, unsigned long device_address, const void* const data_addr, unsigned int size, uint16_t allowed_areas )
+{
+    UNUSED_PARAMETER( allowed_areas );
+    return sflash_write( handle, device_address, data_addr, size );
+}
+
+void sflash_writer_lock(void)
+{
+}
+
+void sflash_writer_unlock(void)
+{
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file sha256.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  SHA-256 (FIPS 180-4) behind the sha2_* calls of the WICED crypto library, for the host tools and tests.
+ *  SHA-224 is not supported, is224 must be 0.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiced_crypto.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+#define ROTR( x, n )            ( ( ( x ) >> ( n ) ) | ( ( x ) << ( 32 - ( n ) ) ) )
+#define CH( x, y, z )           ( ( ( x ) & ( y ) ) ^ ( ~( x ) & ( z ) ) )
+#define MAJ( x, y, z )          ( ( ( x ) & ( y ) ) ^ ( ( x ) & ( z ) ) ^ ( ( y ) & ( z ) ) )
+#define SIGMA0( x )             ( ROTR( x, 2 ) ^ ROTR( x, 13 ) ^ ROTR( x, 22 ) )
+#define SIGMA1( x )             ( ROTR( x, 6 ) ^ ROTR( x, 11 ) ^ ROTR( x, 25 ) )
+#define GAMMA0( x )             ( ROTR( x, 7 ) ^ ROTR( x, 18 ) ^ ( ( x ) >> 3 ) )
+#define GAMMA1( x )             ( ROTR( x, 17 ) ^ ROTR( x, 19 ) ^ ( ( x ) >> 10 ) )
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static const uint32_t k[ 64 ] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static void process_block( sha2_context *ctx, const unsigned char *data )
+{
+    uint32_t w[ 64 ], s[ 8 ], t1, t2;
+    uint16_t i;
+
+    for( i = 0; i < 16; i++ )
+        w[ i ] = ( (uint32_t) data[ i * 4 ] << 24 ) | ( (uint32_t) data[ i * 4 + 1 ] << 16 ) |
+                 ( (uint32_t) data[ i * 4 + 2 ] << 8 ) | (uint32_t) data[ i * 4 + 3 ];
+    for( i = 16; i < 64; i++ )
+        w[ i ] = GAMMA1( w[ i - 2 ] ) + w[ i - 7 ] + GAMMA0( w[ i - 15 ] ) + w[ i - 16 ];
+    memcpy( s, ctx->state, sizeof( s ) );
+    for( i = 0; i < 64; i++ ) {
+        t1 = s[ 7 ] + SIGMA1( s[ 4 ] ) + CH( s[ 4 ], s[ 5 ], s[ 6 ] ) + k[ i ] + w[ i ];
+        t2 = SIGMA0( s[ 0 ] ) + MAJ( s[ 0 ], s[ 1 ], s[ 2 ] );
+        memmove( &s[ 1 ], &s[ 0 ], 7 * sizeof( uint32_t ) );
+        s[ 4 ] += t1;
+        s[ 0 ] = t1 + t2;
+    }
+    for( i = 0; i < 8; i++ )
+        ctx->state[ i ] += s[ i ];
+}
+
+void sha2_starts( sha2_context *ctx, int32_t is224 )
+{
+    static const uint32_t initial[ 8 ] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memset( ctx, 0, sizeof( sha2_context ) );
+    memcpy( ctx->state, initial, sizeof( initial ) );
+    ctx->is224 = is224;
+}
+
+void sha2_update( sha2_context *ctx, const unsigned char *input, int32_t ilen )
+{
+    uint32_t used, fill;
+
+    if( ilen <= 0 )
+        return;
+    used = ctx->total[ 0 ] & 0x3F;
+    ctx->total[ 0 ] += (uint32_t) ilen;
+    if( ctx->total[ 0 ] < (uint32_t) ilen )
+        ctx->total[ 1 ] += 1;
+    fill = 64 - used;
+    if( ( used != 0 ) && ( (uint32_t) ilen >= fill ) ) {
+        memcpy( &ctx->buffer[ used ], input, fill );
+        process_block( ctx, ctx->buffer );
+        input += fill;
+        ilen -= fill;
+        used = 0;
+    }
+    while( ilen >= 64 ) {
+        process_block( ctx, input );
+        input += 64;
+        ilen -= 64;
+    }
+    if( ilen > 0 )
+        memcpy( &ctx->buffer[ used ], input, ilen );
+}
+
+void sha2_finish( sha2_context *ctx, unsigned char output[ 32 ] )
+{
+    unsigned char padding[ 72 ];
+    uint32_t high, low, used;
+    uint16_t i;
+
+    high = ( ctx->total[ 0 ] >> 29 ) | ( ctx->total[ 1 ] << 3 );
+    low = ctx->total[ 0 ] << 3;
+    used = ctx->total[ 0 ] & 0x3F;
+    memset( padding, 0, sizeof( padding ) );
+    padding[ 0 ] = 0x80;
+    sha2_update( ctx, padding, ( used < 56 ) ? 56 - used : 120 - used );
+    for( i = 0; i < 4; i++ ) {
+        padding[ i ] = (unsigned char) ( high >> ( 24 - i * 8 ) );
+        padding[ 4 + i ] = (unsigned char) ( low >> ( 24 - i * 8 ) );
+    }
+    sha2_update( ctx, padding, 8 );
+    for( i = 0; i < 8; i++ ) {
+        output[ i * 4 ] = (unsigned char) ( ctx->state[ i ] >> 24 );
+        output[ i * 4 + 1 ] = (unsigned char) ( ctx->state[ i ] >> 16 );
+        output[ i * 4 + 2 ] = (unsigned char) ( ctx->state[ i ] >> 8 );
+        output[ i * 4 + 3 ] = (unsigned char) ctx->state[ i ];
+    }
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file sim_flash.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Serial flash simulated in a file. The whole part is kept in memory and written back to the file on every change, so
+ *  a test can stop and start again from the same flash contents, the way a device sees it after a reset.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "sim_flash.h"
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SIM_SECTOR_SIZE             ( 0x1000 )
+#define SIM_BLOCK_SIZE              ( 0x10000 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+static bool save( unsigned long address, unsigned long length );
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+sflash_handle_t sflash_handle;
+static uint8_t flash[ SIM_FLASH_SIZE ];
+static FILE *file;
+static int32_t cut = SIM_FLASH_NO_CUT;
+static bool powered;
+static sim_flash_stats_t stats;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Open the file holding the flash, created erased if it does not exist
+  * @param  file name, device ID the driver reports, true to start with the part erased
+  * @retval : true / false
+  */
+bool sim_flash_open( const char *path, uint32_t device_id, bool erase )
+{
+    size_t length;
+
+    sim_flash_close();
+    memset( flash, 0xFF, sizeof( flash ) );
+    file = ( erase == true ) ? NULL : fopen( path, "r+b" );
+    if( file != NULL ) {
+        length = fread( flash, 1, sizeof( flash ), file );
+        if( length != sizeof( flash ) )
+            memset( flash + length, 0xFF, sizeof( flash ) - length );
+    } else {
+        file = fopen( path, "w+b" );
+        if( file == NULL )
+            return false;
+    }
+    sflash_handle.device_id = device_id;
+    memset( &stats, 0, sizeof( stats ) );
+    cut = SIM_FLASH_NO_CUT;
+    powered = true;
+    return save( 0, sizeof( flash ) );
+}
+
+void sim_flash_close(void)
+{
+    if( file != NULL )
+        fclose( file );
+    file = NULL;
+}
+/**
+  * @brief  Cut the power once this many more bytes have been programmed, writes fail from then until the flash is
+  *         opened again
+  * @param  bytes, SIM_FLASH_NO_CUT to run without a cut
+  * @retval : None
+  */
+void sim_flash_power_cut( int32_t bytes )
+{
+    cut = bytes;
+}
+
+sim_flash_stats_t *sim_flash_stats(void)
+{
+    return &stats;
+}
+
+int sflash_read( const sflash_handle_t* const handle, unsigned long device_address, void* const data_addr, unsigned int size )
+{
+    if( ( handle == NULL ) || ( device_address + size > sizeof( flash ) ) )
+        return -1;
+    memcpy( data_addr, &flash[ device_address ], size );
+    stats.reads += 1;
+    stats.bytes_read += size;
+    return 0;
+}
+
+int sflash_write( const sflash_handle_t* const handle, unsigned long device_address, const void* const data_addr, unsigned int size )
+{
+    const uint8_t *data;
+    unsigned int i, length;
+
+    if( ( handle == NULL ) || ( device_address + size > sizeof( flash ) ) || ( powered == false ) )
+        return -1;
+    data = data_addr;
+    length = size;
+    if( ( cut != SIM_FLASH_NO_CUT ) && ( (unsigned int) cut < size ) )
+        length = cut;
+    for( i = 0; i < length; i++ )
+        flash[ device_address + i ] &= data[ i ];   // Programming only clears bits
+    if( cut != SIM_FLASH_NO_CUT )
+        cut -= length;
+    stats.writes += 1;
+    stats.bytes_written += length;
+    if( save( device_address, length ) == false )
+        return -1;
+    if( length < size ) {
+        powered = false;
+        stats.cuts += 1;
+        return -1;
+    }
+    return 0;
+}
+
+int sflash_sector_erase( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    if( ( handle == NULL ) || ( device_address >= sizeof( flash ) ) || ( powered == false ) ||
+        ( handle->device_id == SFLASH_ID_M25P32 ) )     // Only erases 64K blocks
+        return -1;
+    device_address -= device_address % SIM_SECTOR_SIZE;
+    memset( &flash[ device_address ], 0xFF, SIM_SECTOR_SIZE );
+    stats.sector_erases += 1;
+    return save( device_address, SIM_SECTOR_SIZE ) ? 0 : -1;
+}
+
+int sflash_block_erase( const sflash_handle_t* const handle, unsigned long device_address )
+{
+    if( ( handle == NULL ) || ( device_address >= sizeof( flash ) ) || ( powered == false ) )
+        return -1;
+    device_address -= device_address % SIM_BLOCK_SIZE;
+    memset( &flash[ device_address ], 0xFF, SIM_BLOCK_SIZE );
+    stats.block_erases += 1;
+    return save( device_address, SIM_BLOCK_SIZE ) ? 0 : -1;
+}
+
+int sflash_get_size( const sflash_handle_t* const handle, unsigned long* const size )
+{
+    if( handle == NULL )
+        return -1;
+    *size = sizeof( flash );
+    return 0;
+}
+
+static bool save( unsigned long address, unsigned long length )
+{
+    if( file == NULL )
+        return false;
+    if( ( fseek( file, address, SEEK_SET ) != 0 ) || ( fwrite( &flash[ address ], 1, length, file ) != length ) )
+        return false;
+    return fflush( file ) == 0;
+}
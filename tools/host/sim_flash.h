@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file sim_flash.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef SIM_FLASH_H_
+#define SIM_FLASH_H_
+
+/*
+ *  Serial flash simulated in a file, for host tests of the modules that keep logs and images in SFLASH.
+ *  Behaves like NOR flash - erased bytes read 0xFF, programming only clears bits, erases are whole 4K sectors or 64K blocks.
+ *  A power cut can be set to stop a write part way through, the bytes before the cut are programmed and the rest are not.
+ */
+
+/******************************************************
+ *                      Macros
+ ******************************************************/
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define SIM_FLASH_SIZE              ( 0x400000 )    // 4M, the M25P32 on the boards
+#define SIM_FLASH_NO_CUT            ( -1 )
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/******************************************************
+ *                 Type Definitions
+ ******************************************************/
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t reads, writes, sector_erases, block_erases;
+    uint32_t bytes_read, bytes_written;
+    uint32_t cuts;                                  // Writes stopped by a power cut
+} sim_flash_stats_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+bool sim_flash_open( const char *path, uint32_t device_id, bool erase );
+void sim_flash_close(void);
+void sim_flash_power_cut( int32_t bytes );
+sim_flash_stats_t *sim_flash_stats(void);
+#endif /* SIM_FLASH_H_ */
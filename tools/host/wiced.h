@@ -0,0 +1,145 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file wiced.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef HOST_WICED_H_
+#define HOST_WICED_H_
+
+/*
+ *  Host stand in for the parts of the WICED SDK the firmware headers use, so modules can be built and tested on a PC.
+ *  Types only - the functions a test needs are provided by host_stubs.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <arpa/inet.h>
+
+typedef uint32_t wiced_time_t;
+typedef uint32_t wiced_utc_time_t;
+typedef uint64_t wiced_utc_time_ms_t;
+typedef struct { char x[27]; } wiced_iso8601_time_t;
+typedef int wiced_result_t;
+#define WICED_SUCCESS 0
+#define WICED_ERROR 4
+#define WICED_NOT_FOUND 5
+#define WICED_TCPIP_SUCCESS 0
+#define WICED_TIMEOUT 2
+#define WICED_BADARG 5
+#define WICED_NEVER_TIMEOUT 0xFFFFFFFF
+#define WICED_NO_WAIT 0
+#define WICED_WAIT_FOREVER 0xFFFFFFFF
+#define WICED_FALSE 0
+#define WICED_TRUE 1
+#define WICED_IPV4 4
+#define WICED_STA_INTERFACE 0
+#define WICED_AP_INTERFACE 1
+typedef int wiced_bool_t;
+typedef int wiced_security_t;
+typedef int wiced_interface_t;
+typedef struct { int version; union { uint32_t v4; uint32_t v6[4]; } ip; } wiced_ip_address_t;
+typedef struct { int x; } wiced_mutex_t;
+typedef struct { int x; } wiced_semaphore_t;
+typedef struct { int x; } wiced_thread_t;
+typedef struct { int x; } wiced_timed_event_t;
+typedef struct { int x; } wiced_worker_thread_t;
+typedef struct { int x; } wiced_queue_t;
+typedef struct { int x; } wiced_udp_socket_t;
+typedef struct { int x; int socket; } wiced_tcp_socket_t;
+typedef struct { int x; } wiced_tcp_stream_t;
+typedef struct { int x; } wiced_tcp_server_t;
+typedef struct { int x; } wiced_packet_t;
+typedef struct { int x; } wiced_tls_context_t;
+typedef struct { int x; } wiced_tls_identity_t;
+typedef struct { int x; } wiced_dtls_context_t;
+typedef struct { int x; } wiced_dtls_identity_t;
+typedef struct { int x; } wiced_spi_device_t;
+typedef struct { uint8_t octet[6]; } wiced_mac_t;
+typedef int wiced_gpio_t;
+typedef uint32_t wiced_thread_arg_t;
+typedef void (*wiced_thread_function_t)( wiced_thread_arg_t arg );
+typedef wiced_result_t (*event_handler_t)( void* arg );
+#define UNUSED_PARAMETER(x) (void)(x)
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define WICED_MAX_PAYLOAD_SIZE 1400
+#define WICED_NETWORK_WORKER_PRIORITY 3
+#define WICED_DEFAULT_LIBRARY_PRIORITY 5
+#define WICED_APPLICATION_PRIORITY 7
+#define RTOS_HIGHEST_PRIORITY 0
+#define RTOS_LOWEST_PRIORITY 7
+#define WICED_HARDWARE_IO_WORKER_THREAD (&wiced_hw_worker)
+extern wiced_worker_thread_t wiced_hw_worker;
+wiced_result_t wiced_time_get_time( wiced_time_t* t );
+wiced_result_t wiced_time_get_utc_time( wiced_utc_time_t* t );
+wiced_result_t wiced_time_get_utc_time_ms( wiced_utc_time_ms_t* t );
+wiced_result_t wiced_time_get_iso8601_time( wiced_iso8601_time_t* t );
+wiced_result_t wiced_rtos_delay_milliseconds( uint32_t ms );
+wiced_result_t wiced_rtos_init_mutex( wiced_mutex_t* m );
+wiced_result_t wiced_rtos_lock_mutex( wiced_mutex_t* m );
+wiced_result_t wiced_rtos_unlock_mutex( wiced_mutex_t* m );
+wiced_result_t wiced_rtos_deinit_mutex( wiced_mutex_t* m );
+wiced_result_t wiced_rtos_init_semaphore( wiced_semaphore_t* m );
+wiced_result_t wiced_rtos_set_semaphore( wiced_semaphore_t* m );
+wiced_result_t wiced_rtos_get_semaphore( wiced_semaphore_t* m, uint32_t timeout );
+wiced_result_t wiced_rtos_create_thread( wiced_thread_t* thread, uint8_t priority, const char* name, wiced_thread_function_t function, uint32_t stack_size, void* arg );
+wiced_result_t wiced_rtos_thread_join( wiced_thread_t* thread );
+wiced_result_t wiced_rtos_delete_thread( wiced_thread_t* thread );
+wiced_result_t wiced_rtos_register_timed_event( wiced_timed_event_t* e, wiced_worker_thread_t* w, event_handler_t f, uint32_t ms, void* arg );
+wiced_result_t wiced_rtos_send_asynchronous_event( wiced_worker_thread_t* w, event_handler_t f, void* arg );
+wiced_result_t wiced_packet_delete( wiced_packet_t* p );
+wiced_result_t wiced_packet_get_data( wiced_packet_t* p, uint16_t offset, uint8_t** data, uint16_t* fragment_available_data_length, uint16_t *total_available_data_length );
+wiced_result_t wiced_udp_packet_get_info( wiced_packet_t* packet, wiced_ip_address_t* address, uint16_t* port );
+wiced_result_t wiced_udp_receive( wiced_udp_socket_t* socket, wiced_packet_t** packet, uint32_t timeout );
+wiced_result_t wiced_tcp_stream_write( wiced_tcp_stream_t* tcp_stream, const void* data, uint32_t data_length );
+wiced_result_t wiced_tcp_stream_flush( wiced_tcp_stream_t* tcp_stream );
+wiced_result_t wiced_tcp_receive( wiced_tcp_socket_t* socket, wiced_packet_t** packet, uint32_t timeout );
+wiced_result_t wiced_hostname_lookup( const char* hostname, wiced_ip_address_t* address, uint32_t timeout_ms, wiced_interface_t interface );
+wiced_result_t wiced_watchdog_kick( void );
+uint32_t host_rtos_get_time( void );
+#define SET_IPV4_ADDRESS(a,b) ((a).version=4,(a).ip.v4=(b))
+#define GET_IPV4_ADDRESS(a) ((a).ip.v4)
+#define MAKE_IPV4_ADDRESS(a,b,c,d) ((((uint32_t)(a))<<24)|(((uint32_t)(b))<<16)|(((uint32_t)(c))<<8)|((uint32_t)(d)))
+#define SECONDS 1000
+#define MINUTES (60*SECONDS)
+#define HOURS (60*MINUTES)
+typedef struct { int x; } wiced_system_monitor_t;
+
+#endif /* HOST_WICED_H_ */
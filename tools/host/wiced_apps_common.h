@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file wiced_apps_common.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ */
+
+#ifndef HOST_WICED_APPS_COMMON_H_
+#define HOST_WICED_APPS_COMMON_H_
+
+/*
+ *  Host stand in for the WICED application look up table
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    uint16_t start;
+    uint16_t count;
+} app_entry_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t secure;
+    app_entry_t sectors[ 8 ];
+} app_header_t;
+
+enum { DCT_FR_APP_INDEX, DCT_DCT_IMAGE_INDEX, DCT_OTA_APP_INDEX, DCT_FILESYSTEM_IMAGE_INDEX, DCT_WIFI_FIRMWARE_INDEX,
+       DCT_APP0_INDEX, DCT_APP1_INDEX, DCT_APP2_INDEX };
+
+#endif /* HOST_WICED_APPS_COMMON_H_ */
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file imxd_diff.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host patch generator for delta OTA images, the format applied by ota_loader/ota_delta.c and described in ota_delta.h.
+ *
+ *      imxd_diff installed.bin new.bin patch.imxd
+ *
+ *  Exact matches of the new image in the installed one are found through a hash of every position of the installed
+ *  image, the offset of the last match is always tried first as code that has only moved keeps its offset. A match is
+ *  then extended while most bytes still agree, as they do where only addresses changed, and the difference is sent with
+ *  OTA_DELTA_ADD. The differences are mostly zero, pack the patch with imxz_pack to send it compressed.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiced_crypto.h"
+
+#include "../ota_loader/ota_image.h"
+#include "../ota_loader/ota_delta.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define HASH_BITS               ( 20 )
+#define HASH_SIZE               ( 1 << HASH_BITS )
+#define HASH_LENGTH             ( 8 )           // Bytes hashed at each position
+#define MAX_CHAIN               ( 64 )          // Installed image positions tried for each match
+#define MIN_MATCH               ( 16 )          // Shorter matches cost more than the operation that copies them
+#define EXTEND_GIVE_UP          ( 64 )          // Bytes past the best point of an extension before it stops
+#define NO_POSITION             ( -1 )
+#define HASH_SIZE_BYTES         ( 32 )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t length;
+} image_t;
+
+typedef struct {
+    FILE *file;
+    uint32_t written;
+    uint32_t copies, copied;
+    uint32_t adds, added, add_differences;
+    uint32_t inserts, inserted;
+} patch_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static int32_t *head;
+static int32_t *previous;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static uint32_t hash( const uint8_t *data )
+{
+    uint32_t value;
+    uint16_t i;
+
+    value = 0;
+    for( i = 0; i < HASH_LENGTH; i++ )
+        value = ( value * 0x9E3779B1 ) ^ data[ i ];
+    return ( value ^ ( value >> 15 ) ) & ( HASH_SIZE - 1 );
+}
+
+static void put_uint32( uint8_t *data, uint32_t value )
+{
+    data[ 0 ] = (uint8_t) value;
+    data[ 1 ] = (uint8_t) ( value >> 8 );
+    data[ 2 ] = (uint8_t) ( value >> 16 );
+    data[ 3 ] = (uint8_t) ( value >> 24 );
+}
+
+static bool read_image( const char *name, image_t *image )
+{
+    FILE *file;
+    long length;
+
+    file = fopen( name, "rb" );
+    if( file == NULL ) {
+        perror( name );
+        return false;
+    }
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    image->data = malloc( length + 1 );
+    image->length = ( image->data == NULL ) ? 0 : fread( image->data, 1, length, file );
+    fclose( file );
+    if( ( image->data == NULL ) || ( image->length != (uint32_t) length ) ) {
+        fprintf( stderr, "%s: unable to read\n", name );
+        return false;
+    }
+    return true;
+}
+/**
+  * @brief  Hash every position of the installed image, latest first in each chain
+  * @param  installed image
+  * @retval : true / false - out of memory
+  */
+static bool index_source( const image_t *source )
+{
+    uint32_t i, h;
+
+    head = malloc( HASH_SIZE * sizeof( int32_t ) );
+    previous = malloc( ( source->length + 1 ) * sizeof( int32_t ) );
+    if( ( head == NULL ) || ( previous == NULL ) )
+        return false;
+    for( i = 0; i < HASH_SIZE; i++ )
+        head[ i ] = NO_POSITION;
+    for( i = 0; i + HASH_LENGTH <= source->length; i++ ) {
+        h = hash( &source->data[ i ] );
+        previous[ i ] = head[ h ];
+        head[ h ] = i;
+    }
+    return true;
+}
+
+static uint32_t match_length( const image_t *source, uint32_t source_offset, const image_t *target, uint32_t target_offset )
+{
+    uint32_t length;
+
+    length = 0;
+    while( ( source_offset + length < source->length ) && ( target_offset + length < target->length ) &&
+           ( source->data[ source_offset + length ] == target->data[ target_offset + length ] ) )
+        length += 1;
+    return length;
+}
+/**
+  * @brief  Find the longest exact match of the new image at a position, trying the offset of the last match first
+  * @param  installed and new images, position in the new image, installed image offset expected, offset found
+  * @retval : length of the match
+  */
+static uint32_t find_match( const image_t *source, const image_t *target, uint32_t position, int64_t expected, uint32_t *offset )
+{
+    int32_t candidate;
+    uint32_t best, length, chain;
+
+    best = 0;
+    if( ( expected >= 0 ) && ( expected < source->length ) ) {
+        best = match_length( source, (uint32_t) expected, target, position );
+        *offset = (uint32_t) expected;
+    }
+    if( position + HASH_LENGTH > target->length )
+        return best;
+    candidate = head[ hash( &target->data[ position ] ) ];
+    for( chain = 0; ( candidate != NO_POSITION ) && ( chain < MAX_CHAIN ); chain++ ) {
+        length = match_length( source, candidate, target, position );
+        if( length > best ) {
+            best = length;
+            *offset = candidate;
+        }
+        candidate = previous[ candidate ];
+    }
+    return best;
+}
+/**
+  * @brief  Extend a match while the images mostly agree at the same offset, ending at the point most bytes matched
+  * @param  installed and new images, where the exact match ended in each
+  * @retval : bytes to add after the exact match
+  */
+static uint32_t extend_match( const image_t *source, uint32_t source_offset, const image_t *target, uint32_t target_offset )
+{
+    int32_t score, best_score;
+    uint32_t length, best;
+
+    score = 0;
+    best_score = 0;
+    best = 0;
+    for( length = 0; ( source_offset + length < source->length ) && ( target_offset + length < target->length ) &&
+                     ( length - best < EXTEND_GIVE_UP ); length++ ) {
+        score += ( source->data[ source_offset + length ] == target->data[ target_offset + length ] ) ? 1 : -1;
+        if( score > best_score ) {
+            best_score = score;
+            best = length + 1;
+        }
+    }
+    return best;
+}
+
+static bool write_bytes( patch_t *patch, const uint8_t *data, uint32_t length )
+{
+    if( fwrite( data, 1, length, patch->file ) != length )
+        return false;
+    patch->written += length;
+    return true;
+}
+
+static bool write_operation( patch_t *patch, uint8_t operation, uint32_t first, uint32_t second )
+{
+    uint8_t data[ 9 ];
+    uint16_t length;
+
+    data[ 0 ] = operation;
+    put_uint32( &data[ 1 ], first );
+    put_uint32( &data[ 5 ], second );
+    length = ( operation == OTA_DELTA_INSERT ) ? 5 : ( operation == OTA_DELTA_END ) ? 1 : 9;
+    return write_bytes( patch, data, length );
+}
+
+static bool insert( patch_t *patch, const image_t *target, uint32_t start, uint32_t end )
+{
+    if( start == end )
+        return true;
+    patch->inserts += 1;
+    patch->inserted += end - start;
+    return write_operation( patch, OTA_DELTA_INSERT, end - start, 0 ) && write_bytes( patch, &target->data[ start ], end - start );
+}
+
+static bool add( patch_t *patch, const image_t *source, uint32_t offset, const image_t *target, uint32_t start, uint32_t length )
+{
+    uint8_t *difference;
+    uint32_t i;
+    bool result;
+
+    difference = malloc( length );
+    if( difference == NULL )
+        return false;
+    for( i = 0; i < length; i++ ) {
+        difference[ i ] = target->data[ start + i ] - source->data[ offset + i ];
+        if( difference[ i ] != 0 )
+            patch->add_differences += 1;
+    }
+    patch->adds += 1;
+    patch->added += length;
+    result = write_operation( patch, OTA_DELTA_ADD, offset, length ) && write_bytes( patch, difference, length );
+    free( difference );
+    return result;
+}
+/**
+  * @brief  Write the patch, header then operations
+  * @param  installed and new images, patch
+  * @retval : true / false - write failed
+  */
+static bool diff( const image_t *source, const image_t *target, patch_t *patch )
+{
+    uint8_t header[ OTA_DELTA_HEADER_LENGTH ];
+    sha2_context context;
+    uint32_t position, pending, offset, length, extension;
+    int64_t expected;
+    bool result;
+
+    memset( header, 0, sizeof( header ) );
+    memcpy( header, OTA_DELTA_MAGIC, OTA_DELTA_MAGIC_LENGTH );
+    header[ 4 ] = OTA_DELTA_VERSION;
+    put_uint32( &header[ 8 ], source->length );
+    put_uint32( &header[ 12 ], target->length );
+    sha2_starts( &context, 0 );
+    sha2_update( &context, target->data, target->length );
+    sha2_finish( &context, &header[ 16 ] );
+    result = write_bytes( patch, header, sizeof( header ) );
+    /*
+     * Bytes between matches are inserted as is
+     */
+    expected = NO_POSITION;
+    pending = 0;
+    offset = 0;
+    for( position = 0; ( position < target->length ) && result; ) {
+        length = find_match( source, target, position, expected, &offset );
+        if( length < MIN_MATCH ) {
+            position += 1;
+            if( expected >= 0 )
+                expected += 1;
+            continue;
+        }
+        result = insert( patch, target, pending, position );
+        if( result ) {
+            patch->copies += 1;
+            patch->copied += length;
+            result = write_operation( patch, OTA_DELTA_COPY, offset, length );
+        }
+        position += length;
+        offset += length;
+        extension = extend_match( source, offset, target, position );
+        if( ( extension > 0 ) && result ) {
+            result = add( patch, source, offset, target, position, extension );
+            position += extension;
+            offset += extension;
+        }
+        pending = position;
+        expected = offset;
+    }
+    if( result )
+        result = insert( patch, target, pending, target->length );
+    if( result )
+        result = write_operation( patch, OTA_DELTA_END, 0, 0 );
+    return result;
+}
+
+int main( int argc, char *argv[] )
+{
+    image_t source, target;
+    patch_t patch;
+
+    if( argc != 4 ) {
+        fprintf( stderr, "Usage: imxd_diff installed.bin new.bin patch.imxd\n" );
+        return 2;
+    }
+    if( ( read_image( argv[ 1 ], &source ) == false ) || ( read_image( argv[ 2 ], &target ) == false ) )
+        return 1;
+    if( index_source( &source ) == false ) {
+        fprintf( stderr, "Out of memory\n" );
+        return 1;
+    }
+    memset( &patch, 0, sizeof( patch ) );
+    patch.file = fopen( argv[ 3 ], "wb" );
+    if( patch.file == NULL ) {
+        perror( argv[ 3 ] );
+        return 1;
+    }
+    if( ( diff( &source, &target, &patch ) == false ) || ( fclose( patch.file ) != 0 ) ) {
+        fprintf( stderr, "%s: unable to write\n", argv[ 3 ] );
+        return 1;
+    }
+    printf( "%s: %u Bytes, %.1f%% of %u Bytes - %u copies of %u Bytes, %u adds of %u Bytes with %u changed, %u inserts of %u Bytes\n",
+            argv[ 3 ], patch.written, ( target.length > 0 ) ? ( 100.0 * patch.written ) / target.length : 0.0, target.length,
+            patch.copies, patch.copied, patch.adds, patch.added, patch.add_differences, patch.inserts, patch.inserted );
+    free( source.data );
+    free( target.data );
+    return 0;
+}
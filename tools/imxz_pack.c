@@ -0,0 +1,291 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file imxz_pack.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host packer for compressed OTA images, the format read by ota_loader/ota_image.c and described in ota_image.h.
+ *
+ *      imxz_pack [ -w window_bits ] image.bin image.imxz
+ *
+ *  LZSS with hash chains over the window the device keeps, window bits 8 - 12, default 12. Smaller windows give
+ *  longer matches, larger ones find more of them. Each match is checked against one starting a byte later before it
+ *  is taken.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ota_loader/ota_image.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define HASH_BITS               ( 15 )
+#define HASH_SIZE               ( 1 << HASH_BITS )
+#define MAX_CHAIN               ( 512 )         // Earlier positions tried for each match
+#define NO_POSITION             ( -1 )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t max_distance;
+    uint32_t max_match;
+    int32_t *head;                              // Latest position of each hash
+    int32_t *previous;                          // Earlier position with the same hash, per position
+    uint32_t hashed;                            // Positions added to the chains
+} matcher_t;
+
+typedef struct {
+    FILE *file;
+    uint8_t items[ 1 + ( 8 * 2 ) ];             // Flag byte and up to 8 items
+    uint16_t item_length;
+    uint8_t item_count;
+    uint32_t written;
+    uint32_t literals, references;
+} packer_t;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static uint32_t hash( const uint8_t *data )
+{
+    return ( ( (uint32_t) data[ 0 ] << 10 ) ^ ( (uint32_t) data[ 1 ] << 5 ) ^ data[ 2 ] ) & ( HASH_SIZE - 1 );
+}
+/**
+  * @brief  Add positions to the hash chains, up to but not including the one given
+  * @param  matcher, position
+  * @retval : None
+  */
+static void add_positions( matcher_t *matcher, uint32_t position )
+{
+    uint32_t h;
+
+    for( ; ( matcher->hashed < position ) && ( matcher->hashed + OTA_IMAGE_MIN_MATCH <= matcher->length ); matcher->hashed++ ) {
+        h = hash( &matcher->data[ matcher->hashed ] );
+        matcher->previous[ matcher->hashed ] = matcher->head[ h ];
+        matcher->head[ h ] = matcher->hashed;
+    }
+}
+/**
+  * @brief  Find the longest match for a position within the window
+  * @param  matcher, position, distance of the match found
+  * @retval : length of the match, 0 if none of at least OTA_IMAGE_MIN_MATCH
+  */
+static uint32_t find_match( matcher_t *matcher, uint32_t position, uint32_t *distance )
+{
+    int32_t candidate;
+    uint32_t best, length, limit, chain;
+
+    best = 0;
+    if( position + OTA_IMAGE_MIN_MATCH > matcher->length )
+        return 0;
+    add_positions( matcher, position );
+    limit = matcher->length - position;
+    if( limit > matcher->max_match )
+        limit = matcher->max_match;
+    candidate = matcher->head[ hash( &matcher->data[ position ] ) ];
+    for( chain = 0; ( candidate != NO_POSITION ) && ( position - candidate <= matcher->max_distance ) && ( chain < MAX_CHAIN ); chain++ ) {
+        for( length = 0; ( length < limit ) && ( matcher->data[ candidate + length ] == matcher->data[ position + length ] ); length++ )
+            ;
+        if( length > best ) {
+            best = length;
+            *distance = position - candidate;
+            if( best == limit )
+                break;
+        }
+        candidate = matcher->previous[ candidate ];
+    }
+    return ( best >= OTA_IMAGE_MIN_MATCH ) ? best : 0;
+}
+/**
+  * @brief  Write the items of the current flag byte
+  * @param  packer
+  * @retval : true / false - write failed
+  */
+static bool flush_items( packer_t *packer )
+{
+    if( packer->item_count == 0 )
+        return true;
+    if( fwrite( packer->items, 1, packer->item_length, packer->file ) != packer->item_length )
+        return false;
+    packer->written += packer->item_length;
+    packer->item_count = 0;
+    packer->item_length = 1;
+    packer->items[ 0 ] = 0;
+    return true;
+}
+/**
+  * @brief  Add a literal or a reference, a literal is a 1 in the flag byte
+  * @param  packer, literal, its byte or the 16 bit reference
+  * @retval : true / false - write failed
+  */
+static bool add_item( packer_t *packer, bool literal, uint16_t value )
+{
+    if( literal ) {
+        packer->items[ 0 ] |= 1 << packer->item_count;
+        packer->items[ packer->item_length++ ] = (uint8_t) value;
+        packer->literals += 1;
+    } else {
+        packer->items[ packer->item_length++ ] = (uint8_t) value;
+        packer->items[ packer->item_length++ ] = (uint8_t) ( value >> 8 );
+        packer->references += 1;
+    }
+    packer->item_count += 1;
+    if( packer->item_count == 8 )
+        return flush_items( packer );
+    return true;
+}
+
+static bool write_header( FILE *file, uint16_t window_bits, uint32_t image_length )
+{
+    uint8_t header[ OTA_IMAGE_HEADER_LENGTH ];
+
+    memset( header, 0, sizeof( header ) );
+    memcpy( header, OTA_IMAGE_MAGIC, OTA_IMAGE_MAGIC_LENGTH );
+    header[ 4 ] = OTA_IMAGE_VERSION;
+    header[ 5 ] = (uint8_t) window_bits;
+    header[ 8 ] = (uint8_t) image_length;
+    header[ 9 ] = (uint8_t) ( image_length >> 8 );
+    header[ 10 ] = (uint8_t) ( image_length >> 16 );
+    header[ 11 ] = (uint8_t) ( image_length >> 24 );
+    return fwrite( header, 1, sizeof( header ), file ) == sizeof( header );
+}
+/**
+  * @brief  Compress an image
+  * @param  image, length, window bits, output file, packer for the counts
+  * @retval : true / false - write failed
+  */
+static bool pack( const uint8_t *data, uint32_t length, uint16_t window_bits, packer_t *packer )
+{
+    matcher_t matcher;
+    uint32_t position, match, distance, next_match, next_distance, i;
+    bool result;
+
+    memset( &matcher, 0, sizeof( matcher ) );
+    matcher.data = data;
+    matcher.length = length;
+    matcher.max_distance = 1 << window_bits;
+    matcher.max_match = ( 1 << ( 16 - window_bits ) ) - 1 + OTA_IMAGE_MIN_MATCH;
+    matcher.head = malloc( HASH_SIZE * sizeof( int32_t ) );
+    matcher.previous = malloc( ( length + 1 ) * sizeof( int32_t ) );
+    if( ( matcher.head == NULL ) || ( matcher.previous == NULL ) ) {
+        fprintf( stderr, "Out of memory\n" );
+        return false;
+    }
+    for( i = 0; i < HASH_SIZE; i++ )
+        matcher.head[ i ] = NO_POSITION;
+    packer->item_length = 1;
+    packer->items[ 0 ] = 0;
+    packer->written = OTA_IMAGE_HEADER_LENGTH;
+    result = write_header( packer->file, window_bits, length );
+    for( position = 0; ( position < length ) && result; ) {
+        match = find_match( &matcher, position, &distance );
+        if( match > 0 ) {
+            /*
+             * A longer match a byte later is worth a literal
+             */
+            next_match = find_match( &matcher, position + 1, &next_distance );
+            if( next_match > match )
+                match = 0;
+        }
+        if( match == 0 ) {
+            result = add_item( packer, true, data[ position ] );
+            position += 1;
+        } else {
+            result = add_item( packer, false, (uint16_t) ( ( ( match - OTA_IMAGE_MIN_MATCH ) << window_bits ) | ( distance - 1 ) ) );
+            position += match;
+        }
+    }
+    if( result )
+        result = flush_items( packer );
+    free( matcher.head );
+    free( matcher.previous );
+    return result;
+}
+
+int main( int argc, char *argv[] )
+{
+    FILE *file;
+    uint8_t *data;
+    packer_t packer;
+    long length;
+    uint16_t window_bits;
+    int arg;
+
+    window_bits = OTA_IMAGE_MAX_WINDOW_BITS;
+    arg = 1;
+    if( ( argc > 2 ) && ( strcmp( argv[ 1 ], "-w" ) == 0 ) ) {
+        window_bits = atoi( argv[ 2 ] );
+        arg += 2;
+    }
+    if( ( argc - arg != 2 ) || ( window_bits < 8 ) || ( window_bits > OTA_IMAGE_MAX_WINDOW_BITS ) ) {
+        fprintf( stderr, "Usage: imxz_pack [ -w window_bits ] image.bin image.imxz\n       window bits 8 - %u\n", OTA_IMAGE_MAX_WINDOW_BITS );
+        return 2;
+    }
+    file = fopen( argv[ arg ], "rb" );
+    if( file == NULL ) {
+        perror( argv[ arg ] );
+        return 1;
+    }
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    data = malloc( length + 1 );
+    if( ( data == NULL ) || ( fread( data, 1, length, file ) != (size_t) length ) ) {
+        fprintf( stderr, "%s: unable to read\n", argv[ arg ] );
+        return 1;
+    }
+    fclose( file );
+    memset( &packer, 0, sizeof( packer ) );
+    packer.file = fopen( argv[ arg + 1 ], "wb" );
+    if( packer.file == NULL ) {
+        perror( argv[ arg + 1 ] );
+        return 1;
+    }
+    if( ( pack( data, length, window_bits, &packer ) == false ) || ( fclose( packer.file ) != 0 ) ) {
+        fprintf( stderr, "%s: unable to write\n", argv[ arg + 1 ] );
+        return 1;
+    }
+    printf( "%s: %ld Bytes, %s: %u Bytes, %.1f%%, %u literals, %u references, %u Byte window\n", argv[ arg ], length,
+            argv[ arg + 1 ], packer.written, ( length > 0 ) ? ( 100.0 * packer.written ) / length : 0.0, packer.literals,
+            packer.references, 1 << window_bits );
+    free( data );
+    return 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Copyright 2017, Sierra Telecom, Inc. or a subsidiary of 
+# Sierra Telecom, Inc.. All Rights Reserved.
+# This software, including source code, documentation and related
+# materials ("Software"), is owned by Sierra Telecom, Inc.
+# or one of its subsidiaries ("Sierra") and is protected by and subject to
+# worldwide patent protection (United States and foreign),
+# United States copyright laws and international treaty provisions.
+# Therefore, you may use this Software only as provided in the license
+# agreement accompanying the software package from which you
+# obtained this Software ("EULA").
+
+# Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+# reserves the right to make changes to the Software without notice. Sierra
+# does not assume any liability arising out of the application or use of the
+# Software or any product or circuit described in the Software. Sierra does
+# not authorize its products for use in any products where a malfunction or
+# failure of the Sierra product may reasonably be expected to result in
+# significant property damage, injury or death ("High Risk Product"). By
+# including Sierra's product in a High Risk Product, the manufacturer
+# of such system or application assumes all risk of such use and in doing
+# so agrees to indemnify Sierra against all liability.
+
+# Size of an OTA update sent each way - the full image, compressed, as a delta against the installed image and as a
+# compressed delta. Uses imxz_pack and imxd_diff, build them first with make -C tools
+#
+#   tools/ota_size.sh installed.bin new.bin [ window_bits ]
+
+TOOLS=$(dirname "$0")/build
+WINDOW_BITS=${3:-12}
+
+if [ $# -lt 2 ] || [ ! -f "$1" ] || [ ! -f "$2" ]; then
+    echo "Usage: $0 installed.bin new.bin [ window_bits ]" >&2
+    exit 2
+fi
+if [ ! -x "$TOOLS/imxz_pack" ] || [ ! -x "$TOOLS/imxd_diff" ]; then
+    echo "$TOOLS/imxz_pack or $TOOLS/imxd_diff missing, run make -C tools" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+"$TOOLS/imxz_pack" -w "$WINDOW_BITS" "$2" "$WORK/image.imxz" > /dev/null || exit 1
+"$TOOLS/imxd_diff" "$1" "$2" "$WORK/patch.imxd" > /dev/null || exit 1
+"$TOOLS/imxz_pack" -w "$WINDOW_BITS" "$WORK/patch.imxd" "$WORK/patch.imxz" > /dev/null || exit 1
+
+FULL=$(wc -c < "$2")
+report() {
+    SIZE=$(wc -c < "$2")
+    awk -v name="$1" -v size="$SIZE" -v full="$FULL" \
+        'BEGIN { printf( "%-20s %10d %7.1f%%\n", name, size, ( full > 0 ) ? ( 100.0 * size ) / full : 0 ) }'
+}
+printf "%-20s %10s %8s\n" "Sent as" "Bytes" "Of full"
+report "Full image" "$2"
+report "Compressed image" "$WORK/image.imxz"
+report "Delta" "$WORK/patch.imxd"
+report "Compressed delta" "$WORK/patch.imxz"
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file test_ota_delta.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host test of delta OTA images. Patches are made with imxd_diff between an installed image, held in an application
+ *  slot of the simulated flash, and a new one. Each is applied in pieces of random size, as is and packed with
+ *  imxz_pack, through ota_image_write() and ota_delta_write() into the other slot. The digest of what was written must
+ *  match ota_delta_target_hash(), as the OTA loader checks, and the slot must hold the new image.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "wiced_crypto.h"
+
+#include "../../storage.h"
+#include "../../device/icb_def.h"
+#include "../../ota_loader/ota_image.h"
+#include "../../ota_loader/ota_delta.h"
+#include "../host/host_stubs.h"
+#include "../host/sim_flash.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TEST_FLASH_FILE         "test_ota_delta.bin"
+#define TEST_INSTALLED_START    ( 0x100000 )
+#define TEST_TARGET_START       ( 0x200000 )
+#define TEST_SLOT_SIZE          ( 0x100000 )
+#define TEST_BLOCK_SIZE         ( 0x10000 )
+#define TEST_MAX_PIECE          ( 1460 )
+#define TEST_INSTALLED_FILE     "test_ota_delta.old"
+#define TEST_NEW_FILE           "test_ota_delta.new"
+#define TEST_PATCH_FILE         "test_ota_delta.imxd"
+#define TEST_PACKED_FILE        "test_ota_delta.imxz"
+#define TEST_HASH_SIZE          ( 32 )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t length;
+} buffer_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint32_t slot_written;
+static sha2_context output_sha;
+extern sflash_handle_t sflash_handle;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static bool slot_output( const uint8_t *data, uint32_t length )
+{
+    if( HOST_CHECK( slot_written + length <= TEST_SLOT_SIZE ) == false )
+        return false;
+    if( HOST_CHECK( sflash_write( &sflash_handle, TEST_TARGET_START + slot_written, data, length ) == 0 ) == false )
+        return false;
+    sha2_update( &output_sha, data, length );
+    slot_written += length;
+    return true;
+}
+
+static void sha256( const uint8_t *data, uint32_t length, uint8_t *hash )
+{
+    sha2_context context;
+
+    sha2_starts( &context, 0 );
+    sha2_update( &context, data, length );
+    sha2_finish( &context, hash );
+}
+
+static bool read_file( const char *name, buffer_t *buffer )
+{
+    FILE *file;
+    long length;
+
+    file = fopen( name, "rb" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return false;
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    buffer->data = malloc( length + 1 );
+    buffer->length = fread( buffer->data, 1, length, file );
+    fclose( file );
+    return HOST_CHECK( buffer->length == (uint32_t) length );
+}
+
+static bool write_file( const char *name, const uint8_t *data, uint32_t length )
+{
+    FILE *file;
+
+    file = fopen( name, "wb" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return false;
+    fwrite( data, 1, length, file );
+    fclose( file );
+    return true;
+}
+
+static void erase_slot( uint32_t start )
+{
+    uint32_t address;
+
+    for( address = start; address < start + TEST_SLOT_SIZE; address += TEST_BLOCK_SIZE )
+        HOST_CHECK( sflash_block_erase( &sflash_handle, address ) == 0 );
+}
+/**
+  * @brief  Put the installed image in its slot
+  * @param  image
+  * @retval : None
+  */
+static void install( const buffer_t *image )
+{
+    erase_slot( TEST_INSTALLED_START );
+    HOST_CHECK( sflash_write( &sflash_handle, TEST_INSTALLED_START, image->data, image->length ) == 0 );
+}
+/**
+  * @brief  Feed a stream through the decoders into the target slot, in pieces of random size
+  * @param  stream, length, installed image area length
+  * @retval : true / false - rejected
+  */
+static bool load_stream( const uint8_t *stream, uint32_t length, uint32_t installed_length )
+{
+    uint32_t offset, piece;
+    bool result;
+
+    erase_slot( TEST_TARGET_START );
+    slot_written = 0;
+    sha2_starts( &output_sha, 0 );
+    ota_delta_start( true, TEST_INSTALLED_START, installed_length, slot_output, NULL );
+    ota_image_start( ota_delta_write, NULL );
+    result = true;
+    for( offset = 0; ( offset < length ) && result; offset += piece ) {
+        piece = 1 + ( rand() % TEST_MAX_PIECE );
+        if( piece > length - offset )
+            piece = length - offset;
+        result = ota_image_write( &stream[ offset ], piece );
+    }
+    if( result )
+        result = ota_image_finish();
+    if( result )
+        result = ota_delta_finish();
+    return result;
+}
+/**
+  * @brief  The slot must hold the new image and the digest written must be the one the patch carries
+  * @param  name for messages, new image
+  * @retval : None
+  */
+static void check_slot( const char *name, const buffer_t *image )
+{
+    uint8_t expected[ TEST_HASH_SIZE ], written[ TEST_HASH_SIZE ];
+    uint8_t *slot;
+
+    HOST_CHECK( ota_delta_active() == true );
+    slot = malloc( image->length + 1 );
+    HOST_CHECK( slot_written == image->length );
+    HOST_CHECK( sflash_read( &sflash_handle, TEST_TARGET_START, slot, image->length ) == 0 );
+    if( HOST_CHECK( memcmp( slot, image->data, image->length ) == 0 ) == false )
+        printf( "    %s: slot differs from the new image\n", name );
+    sha256( image->data, image->length, expected );
+    sha2_finish( &output_sha, written );
+    HOST_CHECK( memcmp( written, ota_delta_target_hash(), TEST_HASH_SIZE ) == 0 );
+    HOST_CHECK( memcmp( expected, ota_delta_target_hash(), TEST_HASH_SIZE ) == 0 );
+    free( slot );
+}
+/**
+  * @brief  Make a patch from the installed image to a new one and apply it, as is and compressed
+  * @param  name for messages, installed and new images
+  * @retval : None
+  */
+static void update( const char *name, const buffer_t *installed, const buffer_t *image )
+{
+    char command[ 160 ];
+    buffer_t patch, packed;
+
+    install( installed );
+    write_file( TEST_INSTALLED_FILE, installed->data, installed->length );
+    write_file( TEST_NEW_FILE, image->data, image->length );
+    snprintf( command, sizeof( command ), "./imxd_diff %s %s %s%s && ./imxz_pack %s %s%s", TEST_INSTALLED_FILE, TEST_NEW_FILE,
+            TEST_PATCH_FILE, host_verbose ? "" : " > /dev/null", TEST_PATCH_FILE, TEST_PACKED_FILE, host_verbose ? "" : " > /dev/null" );
+    if( HOST_CHECK( system( command ) == 0 ) == false )
+        return;
+    if( ( read_file( TEST_PATCH_FILE, &patch ) == false ) || ( read_file( TEST_PACKED_FILE, &packed ) == false ) )
+        return;
+    if( HOST_CHECK( load_stream( patch.data, patch.length, TEST_SLOT_SIZE ) == true ) == false )
+        printf( "    %s: patch rejected\n", name );
+    HOST_CHECK( ota_image_compressed() == false );
+    check_slot( name, image );
+    if( HOST_CHECK( load_stream( packed.data, packed.length, TEST_SLOT_SIZE ) == true ) == false )
+        printf( "    %s: compressed patch rejected\n", name );
+    HOST_CHECK( ota_image_compressed() == true );
+    check_slot( name, image );
+    if( host_verbose )
+        printf( "%s: %u Byte image, patch %u Bytes, compressed %u Bytes\n", name, image->length, patch.length, packed.length );
+    free( patch.data );
+    free( packed.data );
+}
+/**
+  * @brief  Patches that must be rejected - made against a larger image, not accepted, cut short or corrupt
+  * @param  installed and new images
+  * @retval : None
+  */
+static void broken_patches( const buffer_t *installed, const buffer_t *image )
+{
+    char command[ 160 ];
+    buffer_t patch;
+    uint8_t hash[ TEST_HASH_SIZE ];
+
+    install( installed );
+    write_file( TEST_INSTALLED_FILE, installed->data, installed->length );
+    write_file( TEST_NEW_FILE, image->data, image->length );
+    snprintf( command, sizeof( command ), "./imxd_diff %s %s %s > /dev/null", TEST_INSTALLED_FILE, TEST_NEW_FILE, TEST_PATCH_FILE );
+    if( ( HOST_CHECK( system( command ) == 0 ) == false ) || ( read_file( TEST_PATCH_FILE, &patch ) == false ) )
+        return;
+    HOST_CHECK( load_stream( patch.data, patch.length, installed->length - 1 ) == false );
+    HOST_CHECK( slot_written == 0 );
+    /*
+     * Full image updates do not take a delta
+     */
+    erase_slot( TEST_TARGET_START );
+    slot_written = 0;
+    ota_delta_start( false, TEST_INSTALLED_START, TEST_SLOT_SIZE, slot_output, NULL );
+    HOST_CHECK( ota_delta_write( patch.data, patch.length ) == false );
+    HOST_CHECK( load_stream( patch.data, patch.length - 1, TEST_SLOT_SIZE ) == false );
+    patch.data[ OTA_DELTA_HEADER_LENGTH ] = OTA_DELTA_INSERT + 1;
+    HOST_CHECK( load_stream( patch.data, patch.length, TEST_SLOT_SIZE ) == false );
+    /*
+     * A copy past the end of the installed image
+     */
+    patch.data[ OTA_DELTA_HEADER_LENGTH ] = OTA_DELTA_COPY;
+    memset( &patch.data[ OTA_DELTA_HEADER_LENGTH + 1 ], 0xFF, 4 );
+    HOST_CHECK( load_stream( patch.data, patch.length, TEST_SLOT_SIZE ) == false );
+    free( patch.data );
+    /*
+     * A patch made for another image rebuilds something else - the digest check of the loader catches it
+     */
+    if( ( HOST_CHECK( system( command ) == 0 ) == false ) || ( read_file( TEST_PATCH_FILE, &patch ) == false ) )
+        return;
+    install( image );
+    if( HOST_CHECK( load_stream( patch.data, patch.length, TEST_SLOT_SIZE ) == true ) ) {
+        sha2_finish( &output_sha, hash );
+        HOST_CHECK( memcmp( hash, ota_delta_target_hash(), TEST_HASH_SIZE ) != 0 );
+    }
+    free( patch.data );
+}
+/**
+  * @brief  A new build of an image - code moved by an insertion, addresses in it shifted, a block removed and data added
+  * @param  installed image, new image
+  * @retval : None
+  */
+static void new_build( const buffer_t *installed, buffer_t *image )
+{
+    uint32_t i, in, out, shift_from, removed_from, removed_length;
+
+    image->data = malloc( installed->length + 4096 );
+    shift_from = installed->length / 3;
+    removed_from = ( 2 * installed->length ) / 3;
+    removed_length = 300;
+    for( in = 0, out = 0; in < installed->length; in++ ) {
+        if( in == shift_from )
+            for( i = 0; i < 100; i++ )
+                image->data[ out++ ] = (uint8_t) ( i * 7 );
+        if( in == removed_from )
+            in += removed_length;
+        image->data[ out++ ] = installed->data[ in ];
+    }
+    /*
+     * Little endian words after the insertion that look like addresses into the image move with it
+     */
+    for( i = shift_from + 100; ( i + 4 <= out ) && ( i < removed_from ); i += 64 )
+        image->data[ i ] += 100;
+    for( i = 0; i < 2000; i++ )
+        image->data[ out++ ] = (uint8_t) rand();
+    image->length = out;
+}
+
+int main( int argc, char *argv[] )
+{
+    buffer_t installed, image, other;
+    uint32_t i;
+
+    host_verbose = ( argc > 1 ) && ( strcmp( argv[ 1 ], "-v" ) == 0 );
+    srand( 1 );
+    HOST_CHECK( sim_flash_open( TEST_FLASH_FILE, SFLASH_ID_M25P32, true ) == true );
+    if( read_file( argv[ 0 ], &installed ) == false )
+        return host_result( "test_ota_delta" );
+    new_build( &installed, &image );
+    update( "new build", &installed, &image );
+    update( "same image", &installed, &installed );
+    /*
+     * Nothing in common, all inserted
+     */
+    other.length = 50000;
+    other.data = malloc( other.length );
+    for( i = 0; i < other.length; i++ )
+        other.data[ i ] = (uint8_t) rand();
+    update( "unrelated", &installed, &other );
+    other.length = 0;
+    update( "empty", &installed, &other );
+    broken_patches( &installed, &image );
+    free( installed.data );
+    free( image.data );
+    free( other.data );
+    sim_flash_close();
+    return host_result( "test_ota_delta" );
+}
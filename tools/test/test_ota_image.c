@@ -0,0 +1,305 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file test_ota_image.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host round trip of compressed OTA images. Images are packed with imxz_pack, fed in pieces of random size through
+ *  ota_image_write() and ota_delta_write(), as the OTA loader does, and written to an application slot of the simulated
+ *  flash. The slot must then hold the image, byte for byte and by SHA-256. Uncompressed images must pass through as is
+ *  and broken streams must be rejected.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+#include "wiced_crypto.h"
+
+#include "../../storage.h"
+#include "../../device/icb_def.h"
+#include "../../ota_loader/ota_image.h"
+#include "../../ota_loader/ota_delta.h"
+#include "../host/host_stubs.h"
+#include "../host/sim_flash.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TEST_FLASH_FILE         "test_ota_image.bin"
+#define TEST_SLOT_START         ( 0x100000 )
+#define TEST_SLOT_SIZE          ( 0x100000 )
+#define TEST_BLOCK_SIZE         ( 0x10000 )
+#define TEST_MAX_PIECE          ( 1460 )        // Largest piece fed in, a TCP segment
+#define TEST_IMAGE_FILE         "test_ota_image.in"
+#define TEST_PACKED_FILE        "test_ota_image.imxz"
+#define TEST_HASH_SIZE          ( 32 )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t length;
+} buffer_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static uint32_t slot_written;
+static sha2_context output_sha;
+extern sflash_handle_t sflash_handle;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Output routine, the OTA loader writes the slot the same way
+  * @param  data, length
+  * @retval : true / false - past the end of the slot or the write failed
+  */
+static bool slot_output( const uint8_t *data, uint32_t length )
+{
+    if( HOST_CHECK( slot_written + length <= TEST_SLOT_SIZE ) == false )
+        return false;
+    if( HOST_CHECK( sflash_write( &sflash_handle, TEST_SLOT_START + slot_written, data, length ) == 0 ) == false )
+        return false;
+    sha2_update( &output_sha, data, length );
+    slot_written += length;
+    return true;
+}
+
+static void sha256( const uint8_t *data, uint32_t length, uint8_t *hash )
+{
+    sha2_context context;
+
+    sha2_starts( &context, 0 );
+    sha2_update( &context, data, length );
+    sha2_finish( &context, hash );
+}
+
+static bool read_file( const char *name, buffer_t *buffer )
+{
+    FILE *file;
+    long length;
+
+    file = fopen( name, "rb" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return false;
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    buffer->data = malloc( length + 1 );
+    buffer->length = fread( buffer->data, 1, length, file );
+    fclose( file );
+    return HOST_CHECK( buffer->length == (uint32_t) length );
+}
+
+static bool write_file( const char *name, const uint8_t *data, uint32_t length )
+{
+    FILE *file;
+
+    file = fopen( name, "wb" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return false;
+    fwrite( data, 1, length, file );
+    fclose( file );
+    return true;
+}
+/**
+  * @brief  Erase the slot and feed a stream through the decoders, in pieces of random size
+  * @param  stream, length
+  * @retval : true / false - rejected
+  */
+static bool load_stream( const uint8_t *stream, uint32_t length )
+{
+    uint32_t offset, piece, address;
+    bool result;
+
+    for( address = TEST_SLOT_START; address < TEST_SLOT_START + TEST_SLOT_SIZE; address += TEST_BLOCK_SIZE )
+        HOST_CHECK( sflash_block_erase( &sflash_handle, address ) == 0 );
+    slot_written = 0;
+    sha2_starts( &output_sha, 0 );
+    ota_delta_start( false, 0, 0, slot_output, NULL );
+    ota_image_start( ota_delta_write, NULL );
+    result = true;
+    for( offset = 0; ( offset < length ) && result; offset += piece ) {
+        piece = 1 + ( rand() % TEST_MAX_PIECE );
+        if( piece > length - offset )
+            piece = length - offset;
+        result = ota_image_write( &stream[ offset ], piece );
+    }
+    if( result )
+        result = ota_image_finish();
+    if( result )
+        result = ota_delta_finish();
+    return result;
+}
+/**
+  * @brief  Check the slot holds the image - the bytes, the digest of what was written and the digest read back
+  * @param  image
+  * @retval : None
+  */
+static void check_slot( const char *name, const buffer_t *image )
+{
+    uint8_t expected[ TEST_HASH_SIZE ], written[ TEST_HASH_SIZE ], read_back[ TEST_HASH_SIZE ];
+    uint8_t *slot;
+
+    slot = malloc( image->length + 1 );
+    HOST_CHECK( slot_written == image->length );
+    HOST_CHECK( ota_image_written() == image->length );
+    HOST_CHECK( sflash_read( &sflash_handle, TEST_SLOT_START, slot, image->length ) == 0 );
+    if( HOST_CHECK( memcmp( slot, image->data, image->length ) == 0 ) == false )
+        printf( "    %s: slot differs from the image\n", name );
+    sha256( image->data, image->length, expected );
+    sha2_finish( &output_sha, written );
+    sha256( slot, image->length, read_back );
+    HOST_CHECK( memcmp( written, expected, TEST_HASH_SIZE ) == 0 );
+    HOST_CHECK( memcmp( read_back, expected, TEST_HASH_SIZE ) == 0 );
+    free( slot );
+}
+/**
+  * @brief  Pack an image with each window size, load it and check the slot
+  * @param  name for messages, image
+  * @retval : None
+  */
+static void round_trip( const char *name, const buffer_t *image )
+{
+    char command[ 128 ];
+    buffer_t packed;
+    uint16_t window_bits;
+
+    write_file( TEST_IMAGE_FILE, image->data, image->length );
+    for( window_bits = 8; window_bits <= OTA_IMAGE_MAX_WINDOW_BITS; window_bits += 2 ) {
+        snprintf( command, sizeof( command ), "./imxz_pack -w %u %s %s%s", window_bits, TEST_IMAGE_FILE, TEST_PACKED_FILE,
+                host_verbose ? "" : " > /dev/null" );
+        if( HOST_CHECK( system( command ) == 0 ) == false )
+            return;
+        if( read_file( TEST_PACKED_FILE, &packed ) == false )
+            return;
+        if( HOST_CHECK( load_stream( packed.data, packed.length ) == true ) == false )
+            printf( "    %s: %u bit window rejected\n", name, window_bits );
+        HOST_CHECK( ota_image_compressed() == true );
+        check_slot( name, image );
+        free( packed.data );
+    }
+}
+/**
+  * @brief  An uncompressed image is written as is
+  * @param  name for messages, image
+  * @retval : None
+  */
+static void pass_through( const char *name, const buffer_t *image )
+{
+    HOST_CHECK( load_stream( image->data, image->length ) == true );
+    HOST_CHECK( ota_image_compressed() == false );
+    check_slot( name, image );
+}
+/**
+  * @brief  A packed image cut short, with a bad header or a reference before the start must be rejected
+  * @param  image
+  * @retval : None
+  */
+static void broken_streams( const buffer_t *image )
+{
+    char command[ 128 ];
+    buffer_t packed;
+
+    write_file( TEST_IMAGE_FILE, image->data, image->length );
+    snprintf( command, sizeof( command ), "./imxz_pack %s %s > /dev/null", TEST_IMAGE_FILE, TEST_PACKED_FILE );
+    if( ( HOST_CHECK( system( command ) == 0 ) == false ) || ( read_file( TEST_PACKED_FILE, &packed ) == false ) )
+        return;
+    HOST_CHECK( load_stream( packed.data, packed.length - 10 ) == false );
+    HOST_CHECK( slot_written < image->length );
+    packed.data[ 4 ] = OTA_IMAGE_VERSION + 1;
+    HOST_CHECK( load_stream( packed.data, packed.length ) == false );
+    HOST_CHECK( slot_written == 0 );
+    packed.data[ 4 ] = OTA_IMAGE_VERSION;
+    packed.data[ 5 ] = OTA_IMAGE_MAX_WINDOW_BITS + 1;
+    HOST_CHECK( load_stream( packed.data, packed.length ) == false );
+    packed.data[ 5 ] = OTA_IMAGE_MAX_WINDOW_BITS;
+    /*
+     * First item a reference, nothing has been produced for it to refer to
+     */
+    packed.data[ OTA_IMAGE_HEADER_LENGTH ] &= ~0x01;
+    HOST_CHECK( load_stream( packed.data, packed.length ) == false );
+    free( packed.data );
+}
+
+int main( int argc, char *argv[] )
+{
+    buffer_t image;
+    uint32_t i;
+
+    host_verbose = ( argc > 1 ) && ( strcmp( argv[ 1 ], "-v" ) == 0 );
+    srand( 1 );
+    HOST_CHECK( sim_flash_open( TEST_FLASH_FILE, SFLASH_ID_M25P32, true ) == true );
+    /*
+     * A real program - this one
+     */
+    if( read_file( argv[ 0 ], &image ) == true ) {
+        round_trip( "program", &image );
+        pass_through( "program", &image );
+        broken_streams( &image );
+        free( image.data );
+    }
+    /*
+     * Long runs, matches of the longest length
+     */
+    image.length = 70000;
+    image.data = calloc( image.length, 1 );
+    for( i = 40000; i < 40100; i++ )
+        image.data[ i ] = (uint8_t) i;
+    round_trip( "zeros", &image );
+    /*
+     * Nothing to match, more flag bytes and literals than data
+     */
+    for( i = 0; i < image.length; i++ )
+        image.data[ i ] = (uint8_t) rand();
+    round_trip( "random", &image );
+    pass_through( "random", &image );
+    /*
+     * Shorter than the header, and the last flag byte part used
+     */
+    for( image.length = 0; image.length <= 20; image.length++ ) {
+        round_trip( "short", &image );
+        pass_through( "short", &image );
+    }
+    free( image.data );
+    sim_flash_close();
+    return host_result( "test_ota_image" );
+}
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file test_spill.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host test of the flash spill log - records spilled from the history, uploaded, ACKed or sent again, across resets,
+ *  power cuts part way through a write and enough records to wrap the log several times.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+
+#include "../../storage.h"
+#include "../../device/icb_def.h"
+#include "../../cs_ctrl/hal_history.h"
+#include "../../cs_ctrl/hal_spill.h"
+#include "../host/host_stubs.h"
+#include "../host/sim_flash.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TEST_FLASH_FILE         "test_spill.bin"
+#define TEST_HISTORY_SIZE       ( 64 )
+#define TEST_RECORD_SAMPLES     ( 25 )          // Samples in a full spill record
+#define TEST_RECORD_LENGTH      ( sizeof( header_t ) + ( TEST_RECORD_SAMPLES * IMX_SAMPLE_LENGTH ) )
+#define TEST_LOG_RECORDS        ( 0x50000 / 128 )
+#define TEST_SENSOR_ID          ( 0x1000 )
+#define TEST_EVENT_ID           ( 0x2000 )
+#define TEST_MAX_VALUES         ( 4 * TEST_LOG_RECORDS * TEST_RECORD_SAMPLES )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {
+    uint32_t id[ TEST_MAX_VALUES ];
+    uint32_t value[ TEST_MAX_VALUES ];
+    uint32_t count;
+} received_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static imx_data_32_t history[ 2 ][ TEST_HISTORY_SIZE ];
+static control_sensor_data_t csd[ 2 ];
+static received_t received;
+static uint32_t next_value;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+bool cs_find_entry( imx_peripheral_type_t type, uint32_t id, uint16_t *entry )
+{
+    uint16_t i;
+
+    if( type != IMX_SENSORS )
+        return false;
+    for( i = 0; i < device_config.no_sensors; i++ )
+        if( device_config.scb[ i ].id == id ) {
+            *entry = i;
+            return true;
+        }
+    return false;
+}
+/**
+  * @brief  Start the device again from what is in the flash, erasing it first for a new test
+  * @param  true for an erased flash
+  * @retval : None
+  */
+static void reset_device( bool erase )
+{
+    uint16_t i;
+
+    HOST_CHECK( sim_flash_open( TEST_FLASH_FILE, SFLASH_ID_M25P32, erase ) == true );
+    memset( &device_config, 0, sizeof( device_config ) );
+    device_config.sflash_size = SIM_FLASH_SIZE;
+    device_config.history_size = TEST_HISTORY_SIZE;
+    device_config.no_sensors = 2;
+    device_config.scb[ 0 ].id = TEST_SENSOR_ID;
+    device_config.scb[ 0 ].sample_rate = 1000;
+    device_config.scb[ 1 ].id = TEST_EVENT_ID;
+    device_config.scb[ 1 ].sample_rate = 0;
+    for( i = 0; i < 2; i++ ) {
+        device_config.scb[ i ].enabled = true;
+        device_config.scb[ i ].send_imatrix = true;
+        device_config.scb[ i ].data_type = IMX_UINT32;
+        memset( &csd[ i ], 0, sizeof( control_sensor_data_t ) );
+        csd[ i ].data = history[ i ];
+    }
+    spill_init( true );
+}
+/**
+  * @brief  Fill the history of the sensor with numbered samples and spill a full record of them
+  * @param  None
+  * @retval : true if spilled
+  */
+static bool spill_record(void)
+{
+    uint16_t i;
+
+    for( i = 0; i < TEST_RECORD_SAMPLES; i++ )
+        history_add( &csd[ 0 ], next_value + i );
+    if( spill_history( IMX_SENSORS, &device_config.scb[ 0 ], &csd[ 0 ] ) == false ) {
+        history_reset( &csd[ 0 ] );
+        return false;
+    }
+    HOST_CHECK( csd[ 0 ].no_samples == 0 );
+    next_value += TEST_RECORD_SAMPLES;
+    return true;
+}
+/**
+  * @brief  Build a packet of spilled records and take the samples back out of it
+  * @param  packet size, records added
+  * @retval : samples in the packet
+  */
+static uint16_t upload( uint16_t size, spill_range_t *range )
+{
+    static uint8_t packet[ 1500 ];
+    upload_data_t *upload_data;
+    header_t *header;
+    uint8_t *position;
+    uint32_t bits, id, sample;
+    uint16_t remaining, samples, no_samples, i;
+    bool packet_full;
+
+    memset( packet, 0, sizeof( packet ) );
+    upload_data = (upload_data_t *) packet;
+    remaining = size;
+    packet_full = false;
+    samples = spill_upload( &upload_data, &remaining, &packet_full, range );
+    HOST_CHECK( (uint8_t *) upload_data - packet == size - remaining );
+    for( position = packet; position < (uint8_t *) upload_data; ) {
+        header = (header_t *) position;
+        bits = ntohl( header->bits.bit_data );
+        id = ntohl( header->id );
+        no_samples = ( bits >> 8 ) & 0xFF;
+        position += sizeof( header_t );
+        for( i = 0; i < no_samples; i++ ) {
+            memcpy( &sample, position, IMX_SAMPLE_LENGTH );
+            position += IMX_SAMPLE_LENGTH;
+            if( received.count < TEST_MAX_VALUES ) {
+                received.id[ received.count ] = id;
+                received.value[ received.count ] = ntohl( sample );
+                received.count += 1;
+            }
+        }
+    }
+    return samples;
+}
+/**
+  * @brief  Check the samples received are a run of consecutive values of the sensor
+  * @param  first value, number of values
+  * @retval : true / false
+  */
+static bool received_run( uint32_t first, uint32_t count )
+{
+    uint32_t i;
+
+    if( received.count != count ) {
+        printf( "Received %u samples, expected %u\n", received.count, count );
+        return false;
+    }
+    for( i = 0; i < count; i++ )
+        if( ( received.id[ i ] != TEST_SENSOR_ID ) || ( received.value[ i ] != first + i ) ) {
+            printf( "Sample %u is ID: 0x%08x, %u - expected ID: 0x%08x, %u\n", i, received.id[ i ], received.value[ i ],
+                    TEST_SENSOR_ID, first + i );
+            return false;
+        }
+    return true;
+}
+
+static void start_test( void )
+{
+    memset( &received, 0, sizeof( received ) );
+    next_value = 0;
+    host_time = 0;
+    reset_device( true );
+}
+/*
+ * A new log has no sector erased, nothing is written until spill_process() erases one
+ */
+static void test_not_erased( void )
+{
+    start_test();
+    HOST_CHECK( spill_record() == false );
+    spill_process();
+    HOST_CHECK( sim_flash_stats()->block_erases == 1 );
+    HOST_CHECK( spill_record() == true );
+    HOST_CHECK( spill_pending() == 1 );
+}
+/*
+ * Records stay pending until the packet is ACKed, a packet that is not ACKed is sent again
+ */
+static void test_ack_and_resend( void )
+{
+    spill_range_t range, again;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() && spill_record() && spill_record() );
+    HOST_CHECK( upload( 1400, &range ) == 3 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 0, 3 * TEST_RECORD_SAMPLES ) );
+    HOST_CHECK( spill_pending() == 3 );
+    HOST_CHECK( spill_unsent() == false );
+
+    spill_resend( &range );
+    HOST_CHECK( spill_unsent() == true );
+    memset( &received, 0, sizeof( received ) );
+    HOST_CHECK( upload( 1400, &again ) == 3 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 0, 3 * TEST_RECORD_SAMPLES ) );
+
+    spill_acked( &again );
+    HOST_CHECK( spill_pending() == 0 );
+    spill_acked( &range );                  // A late ACK for the first copy changes nothing
+    HOST_CHECK( spill_pending() == 0 );
+    HOST_CHECK( spill_unsent() == false );
+}
+/*
+ * Packets ACKed out of order, the tail only moves past records that are retired
+ */
+static void test_ack_out_of_order( void )
+{
+    spill_range_t first, second;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() && spill_record() && spill_record() && spill_record() );
+    HOST_CHECK( upload( 2 * TEST_RECORD_LENGTH, &first ) == 2 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( upload( 2 * TEST_RECORD_LENGTH, &second ) == 2 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 0, 4 * TEST_RECORD_SAMPLES ) );
+    spill_acked( &second );
+    HOST_CHECK( spill_pending() == 2 );
+    /*
+     * The first packet is lost - only its records go again
+     */
+    spill_resend( &first );
+    memset( &received, 0, sizeof( received ) );
+    HOST_CHECK( upload( 1400, &first ) == 2 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 0, 2 * TEST_RECORD_SAMPLES ) );
+    spill_acked( &first );
+    HOST_CHECK( spill_pending() == 0 );
+}
+/*
+ * A reset keeps what was not ACKed, sent or not, and drops what was
+ */
+static void test_reset( void )
+{
+    spill_range_t range;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() && spill_record() && spill_record() && spill_record() );
+    HOST_CHECK( upload( 2 * TEST_RECORD_LENGTH, &range ) == 2 * TEST_RECORD_SAMPLES );
+    spill_acked( &range );
+    HOST_CHECK( upload( TEST_RECORD_LENGTH, &range ) == TEST_RECORD_SAMPLES );      // Sent, never ACKed
+
+    reset_device( false );
+    HOST_CHECK( spill_pending() == 2 );
+    memset( &received, 0, sizeof( received ) );
+    HOST_CHECK( upload( 1400, &range ) == 2 * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 2 * TEST_RECORD_SAMPLES, 2 * TEST_RECORD_SAMPLES ) );
+    spill_acked( &range );
+    /*
+     * New records follow on from the ones found at start up
+     */
+    spill_process();
+    HOST_CHECK( spill_record() == true );
+    memset( &received, 0, sizeof( received ) );
+    HOST_CHECK( upload( 1400, &range ) == TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( 4 * TEST_RECORD_SAMPLES, TEST_RECORD_SAMPLES ) );
+}
+/*
+ * Power lost part way through writing a record - the torn record is skipped, writing starts again in the next sector
+ */
+static void test_torn_record( void )
+{
+    spill_range_t range;
+    uint32_t cut;
+
+    for( cut = 0; cut < 128; cut += 12 ) {
+        start_test();
+        spill_process();
+        HOST_CHECK( spill_record() && spill_record() && spill_record() );
+        sim_flash_power_cut( cut );
+        HOST_CHECK( spill_record() == false );
+        next_value += TEST_RECORD_SAMPLES;  // Those samples were lost with the power
+
+        reset_device( false );
+        HOST_CHECK( spill_pending() == 3 );
+        spill_process();
+        HOST_CHECK( spill_record() == true );
+        HOST_CHECK( upload( 1400, &range ) == 4 * TEST_RECORD_SAMPLES );
+        HOST_CHECK( received.count == 4 * TEST_RECORD_SAMPLES );
+        HOST_CHECK( received.value[ 3 * TEST_RECORD_SAMPLES ] == 4 * TEST_RECORD_SAMPLES );
+        received.count = 3 * TEST_RECORD_SAMPLES;
+        HOST_CHECK( received_run( 0, 3 * TEST_RECORD_SAMPLES ) );
+        spill_acked( &range );
+        HOST_CHECK( spill_pending() == 0 );
+    }
+}
+/*
+ * Power lost while an ACK retires a record - it is sent again after the reset
+ */
+static void test_torn_ack( void )
+{
+    spill_range_t range;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() && spill_record() );
+    HOST_CHECK( upload( 1400, &range ) == 2 * TEST_RECORD_SAMPLES );
+    sim_flash_power_cut( 1 );               // First record retired, the power goes before the second
+    spill_acked( &range );
+
+    reset_device( false );
+    HOST_CHECK( spill_pending() == 1 );
+    memset( &received, 0, sizeof( received ) );
+    HOST_CHECK( upload( 1400, &range ) == TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( TEST_RECORD_SAMPLES, TEST_RECORD_SAMPLES ) );
+}
+/*
+ * Uploads keep up - the log wraps several times without losing or repeating a sample
+ */
+static void test_wrap_around( void )
+{
+    spill_range_t range;
+    uint32_t i;
+
+    start_test();
+    for( i = 0; i < 3 * TEST_LOG_RECORDS; i++ ) {
+        spill_process();
+        HOST_CHECK( spill_record() == true );
+        if( ( i % 7 ) == 6 ) {
+            upload( 1400, &range );
+            spill_acked( &range );
+        }
+    }
+    upload( 1400, &range );
+    spill_acked( &range );
+    HOST_CHECK( spill_pending() == 0 );
+    HOST_CHECK( received_run( 0, 3 * TEST_LOG_RECORDS * TEST_RECORD_SAMPLES ) );
+    HOST_CHECK( sim_flash_stats()->block_erases >= ( 3 * TEST_LOG_RECORDS ) / 512 );
+}
+/*
+ * No uploads - the oldest records are lost a sector at a time, what is left is the newest, in order. An ACK that
+ * arrives for records already lost does not retire the ones written over them
+ */
+static void test_overrun( void )
+{
+    spill_range_t range;
+    uint32_t i, pending, first;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() == true );
+    HOST_CHECK( upload( 1400, &range ) == TEST_RECORD_SAMPLES );
+    for( i = 0; i < 2 * TEST_LOG_RECORDS; i++ ) {
+        spill_process();
+        HOST_CHECK( spill_record() == true );
+    }
+    pending = spill_pending();
+    HOST_CHECK( ( pending < TEST_LOG_RECORDS ) && ( pending > TEST_LOG_RECORDS - 2 * 512 ) );
+    spill_acked( &range );
+    HOST_CHECK( spill_pending() == pending );
+
+    memset( &received, 0, sizeof( received ) );
+    while( spill_unsent() == true ) {
+        upload( 1400, &range );
+        spill_acked( &range );
+    }
+    first = next_value - ( pending * TEST_RECORD_SAMPLES );
+    HOST_CHECK( received_run( first, pending * TEST_RECORD_SAMPLES ) );
+    HOST_CHECK( spill_pending() == 0 );
+}
+/*
+ * Records for a sensor that is no longer configured are dropped, not sent
+ */
+static void test_unknown_id( void )
+{
+    spill_range_t range;
+
+    start_test();
+    spill_process();
+    HOST_CHECK( spill_record() && spill_record() );
+    device_config.scb[ 0 ].id = TEST_SENSOR_ID + 1;
+    HOST_CHECK( upload( 1400, &range ) == 0 );
+    HOST_CHECK( range.records == 0 );
+    HOST_CHECK( spill_pending() == 0 );
+}
+
+int main( int argc, char *argv[] )
+{
+    host_verbose = ( argc > 1 ) && ( strcmp( argv[ 1 ], "-v" ) == 0 );
+    test_not_erased();
+    test_ack_and_resend();
+    test_ack_out_of_order();
+    test_reset();
+    test_torn_record();
+    test_torn_ack();
+    test_wrap_around();
+    test_overrun();
+    test_unknown_id();
+    sim_flash_close();
+    remove( TEST_FLASH_FILE );
+    return host_result( "test_spill" );
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file test_trace.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host test of the binary trace and its decoder. Records traces mirrored to the simulated flash and writes:
+ *
+ *      trace_raw.txt               the records as "trace flash" prints them
+ *      trace_expected.txt          the messages they hold, formatted on the host
+ *      trace_mirror.bin            a binary copy of the mirror, after enough records to wrap it
+ *      trace_mirror_expected.txt   the messages still held in the mirror
+ *
+ *  The Makefile then decodes them with trace_decode against this program and compares the output. Built without PIE so
+ *  the format strings have 32 bit addresses, as they do on the device.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "wiced.h"
+#include "spi_flash.h"
+#include "spi_flash_internal.h"
+
+#include "../../storage.h"
+#include "../../device/icb_def.h"
+#include "../../cli/trace.h"
+#include "../host/host_stubs.h"
+#include "../host/sim_flash.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TEST_FLASH_FILE         "test_trace.bin"
+#define TEST_LOG_START          ( 0x390000 )    // Defaults in trace.c
+#define TEST_LOG_SIZE           ( 0x020000 )
+#define TEST_RECORD_SIZE        ( 32 )
+#define TEST_FILLERS            ( 5000 )        // More than the mirror holds
+#define TEST_MAX_MESSAGES       ( TEST_FILLERS + 64 )
+#define TEST_MESSAGE_LENGTH     ( 128 )
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static char expected[ TEST_MAX_MESSAGES ][ TEST_MESSAGE_LENGTH ];
+static uint32_t no_expected;
+extern sflash_handle_t sflash_handle;
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+/**
+  * @brief  Format a message as the decoder should print it - time stamp, no \r, one line
+  * @param  format string and arguments with their host types
+  * @retval : None
+  */
+static void expect( const char *format, ... )
+{
+    char message[ TEST_MESSAGE_LENGTH ];
+    char *line;
+    uint16_t i, length;
+    va_list args;
+
+    if( HOST_CHECK( no_expected < TEST_MAX_MESSAGES ) == false )
+        return;
+    va_start( args, format );
+    vsnprintf( message, sizeof( message ), format, args );
+    va_end( args );
+    line = expected[ no_expected++ ];
+    length = snprintf( line, TEST_MESSAGE_LENGTH, "%06u.%03u: ", (uint32_t) host_time / 1000, (uint32_t) host_time % 1000 );
+    for( i = 0; ( message[ i ] != '\0' ) && ( length < TEST_MESSAGE_LENGTH - 2 ); i++ )
+        if( message[ i ] != '\r' )
+            line[ length++ ] = message[ i ];
+    if( ( length == 0 ) || ( line[ length - 1 ] != '\n' ) )
+        line[ length++ ] = '\n';
+    line[ length ] = '\0';
+}
+/**
+  * @brief  Run a trace command with its options
+  * @param  command line
+  * @retval : None
+  */
+static void command( const char *line )
+{
+    static char buffer[ 64 ];
+
+    strncpy( buffer, line, sizeof( buffer ) - 1 );
+    strtok( buffer, " " );
+    cli_trace( 0 );
+}
+/**
+  * @brief  Move the time on and copy the new records to the mirror
+  * @param  None
+  * @retval : None
+  */
+static void next_record(void)
+{
+    trace_process();
+    trace_process();
+    host_time += 1001;
+}
+/**
+  * @brief  One of each conversion the decoder handles, %s arguments are literals in this image
+  * @param  None
+  * @retval : None
+  */
+static void trace_conversions(void)
+{
+    static const char *name = "sensor";
+    int32_t negative;
+
+    negative = -1234;
+    TRACE( "Plain message\r\n" );
+    expect( "Plain message\r\n" );
+    next_record();
+    TRACE( "Unsigned: %u, signed: %d, long: %lu\r\n", 4000000000U, negative, (uint32_t) 123456 );
+    expect( "Unsigned: %u, signed: %d, long: %lu\r\n", 4000000000U, negative, 123456UL );
+    next_record();
+    TRACE( "Hex: 0x%08lx %x %X %o %#x\r\n", (uint32_t) 0xDEADBEEF, 0xABCU, 0xABCU, 8U, 255U );
+    expect( "Hex: 0x%08lx %x %X %o %#x\r\n", 0xDEADBEEFUL, 0xABCU, 0xABCU, 8U, 255U );
+    next_record();
+    TRACE( "Widths: [%5u] [%-5d] [%05d] [%+d] [%hu]\r\n", 42U, -7, 42, 3, (uint16_t) 65535 );
+    expect( "Widths: [%5u] [%-5d] [%05d] [%+d] [%hu]\r\n", 42U, -7, 42, 3, (uint16_t) 65535 );
+    next_record();
+    TRACE( "Star width: [%*d] 100%% done\r\n", 6, 99 );
+    expect( "Star width: [%*d] 100%% done\r\n", 6, 99 );
+    next_record();
+    TRACE( "Char: %c%c, string: %s, cut: [%.3s] [%-8s]\r\n", 'O', 'K', (uint32_t) (uintptr_t) name,
+            (uint32_t) (uintptr_t) "abcdef", (uint32_t) (uintptr_t) "left" );
+    expect( "Char: %c%c, string: %s, cut: [%.3s] [%-8s]\r\n", 'O', 'K', name, "abcdef", "left" );
+    next_record();
+    TRACE( "No line end %u", 1U );
+    expect( "No line end %u", 1U );
+    next_record();
+}
+
+static bool write_expected( const char *name, uint32_t first )
+{
+    FILE *file;
+    uint32_t i;
+
+    file = fopen( name, "w" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return false;
+    for( i = first; i < no_expected; i++ )
+        fputs( expected[ i ], file );
+    fclose( file );
+    return true;
+}
+/**
+  * @brief  Write the mirror as "trace flash" prints it, with the header and some console noise the decoder must skip
+  * @param  file name
+  * @retval : records written
+  */
+static uint32_t write_raw( const char *name )
+{
+    uint32_t record[ TEST_RECORD_SIZE / sizeof( uint32_t ) ];
+    uint32_t offset, count;
+    FILE *file;
+
+    file = fopen( name, "w" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return 0;
+    fprintf( file, ">trace flash\r\nSequence Time(mS) Format   Arguments\r\n" );
+    count = 0;
+    for( offset = 0; offset < TEST_LOG_SIZE; offset += TEST_RECORD_SIZE ) {
+        HOST_CHECK( sflash_read( &sflash_handle, TEST_LOG_START + offset, record, TEST_RECORD_SIZE ) == 0 );
+        if( record[ 2 ] == 0xFFFFFFFF )
+            continue;
+        fprintf( file, "%08x %08x %08x %08x %08x %08x %08x %08x\r\n", record[ 2 ], record[ 1 ], record[ 0 ],
+                record[ 3 ], record[ 4 ], record[ 5 ], record[ 6 ], record[ 7 ] );
+        count += 1;
+    }
+    fprintf( file, ">\r\n" );
+    fclose( file );
+    return count;
+}
+/**
+  * @brief  Copy the mirror area of the flash to a file
+  * @param  file name
+  * @retval : records held
+  */
+static uint32_t write_mirror( const char *name )
+{
+    uint32_t record[ TEST_RECORD_SIZE / sizeof( uint32_t ) ];
+    uint32_t offset, count;
+    FILE *file;
+
+    file = fopen( name, "wb" );
+    if( HOST_CHECK( file != NULL ) == false )
+        return 0;
+    count = 0;
+    for( offset = 0; offset < TEST_LOG_SIZE; offset += TEST_RECORD_SIZE ) {
+        HOST_CHECK( sflash_read( &sflash_handle, TEST_LOG_START + offset, record, TEST_RECORD_SIZE ) == 0 );
+        fwrite( record, 1, TEST_RECORD_SIZE, file );
+        if( record[ 2 ] != 0xFFFFFFFF )
+            count += 1;
+    }
+    fclose( file );
+    return count;
+}
+
+int main( int argc, char *argv[] )
+{
+    uint32_t i, first, held;
+
+    host_verbose = ( argc > 1 ) && ( strcmp( argv[ 1 ], "-v" ) == 0 );
+    HOST_CHECK( sim_flash_open( TEST_FLASH_FILE, SFLASH_ID_M25P32, true ) == true );
+    device_config.sflash_size = SIM_FLASH_SIZE;
+    host_time = 1000;
+    trace_init( true );
+    command( "trace flash on" );
+    /*
+     * Each conversion once, decoded from the lines "trace flash" prints
+     */
+    trace_conversions();
+    HOST_CHECK( write_raw( "trace_raw.txt" ) == no_expected );
+    write_expected( "trace_expected.txt", 0 );
+    /*
+     * Wrap the mirror, the binary copy holds the newest records in slot order, not record order
+     */
+    for( i = 0; i < TEST_FILLERS; i++ ) {
+        TRACE( "Filler record: %u of %u\r\n", i, (uint32_t) TEST_FILLERS );
+        expect( "Filler record: %u of %u\r\n", i, (uint32_t) TEST_FILLERS );
+        next_record();
+    }
+    trace_conversions();
+    held = write_mirror( "trace_mirror.bin" );
+    HOST_CHECK( held >= ( TEST_LOG_SIZE / 2 ) / TEST_RECORD_SIZE );
+    HOST_CHECK( held < TEST_LOG_SIZE / TEST_RECORD_SIZE );
+    first = ( held < no_expected ) ? no_expected - held : 0;
+    write_expected( "trace_mirror_expected.txt", first );
+    sim_flash_close();
+    return host_result( "test_trace" );
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright 2017, Sierra Telecom. All Rights Reserved.
+ *
+ * This software, associated documentation and materials ("Software"),
+ * is owned by Sierra Telecom ("Sierra") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Sierra hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Sierra's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Sierra.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Sierra
+ * reserves the right to make changes to the Software without notice. Sierra
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Sierra does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Sierra product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Sierra's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Sierra against all liability.
+ */
+
+/** @file trace_decode.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: greg.phillips
+ *
+ *  Host decoder for the binary trace. The device records the address of each format string and the raw arguments, see
+ *  trace_record_t in cli/trace.h. This tool looks the format strings, and any %s arguments, up in the ELF file of the
+ *  build that made the records and prints the messages as the device would.
+ *
+ *      trace_decode image.elf [ capture.txt ]      lines of 8 hex words from "trace raw" or "trace flash", stdin if no file
+ *      trace_decode -b image.elf mirror.bin        binary copy of the flash mirror, printed in record order
+ *
+ *  Only 32 bit arguments are recorded, so the l, h and hh length modifiers are ignored.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+#define TRACE_ARGS              ( 5 )
+#define TRACE_RECORD_WORDS      ( 3 + TRACE_ARGS )
+#define TRACE_BLANK             ( 0xFFFFFFFF )
+#define MAX_LINE                ( 512 )
+#define MAX_STRING              ( 256 )         // Longest %s argument printed
+#define MAX_SPEC                ( 32 )
+
+#define EI_CLASS                ( 4 )
+#define EI_DATA                 ( 5 )
+#define ELFCLASS32              ( 1 )
+#define ELFCLASS64              ( 2 )
+#define ELFDATA2LSB             ( 1 )
+#define SHT_NOBITS              ( 8 )
+#define SHF_ALLOC               ( 0x2 )
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+typedef struct {                                // Field order of trace_record_t
+    uint32_t format;
+    uint32_t time;
+    uint32_t sequence;
+    uint32_t arg[ TRACE_ARGS ];
+} record_t;
+
+typedef struct {                                // Loaded sections of the image with contents in the file
+    uint64_t address;
+    uint64_t size;
+    uint64_t offset;
+} section_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    section_t *sections;
+    uint32_t no_sections;
+} image_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+static image_t image;
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+static uint64_t get_le( const uint8_t *data, uint16_t bytes )
+{
+    uint64_t value;
+
+    value = 0;
+    while( bytes > 0 ) {
+        bytes -= 1;
+        value = ( value << 8 ) | data[ bytes ];
+    }
+    return value;
+}
+/**
+  * @brief  Read an ELF file and list the sections loaded on the device
+  * @param  file name
+  * @retval : true / false
+  */
+static bool load_image( const char *name )
+{
+    FILE *file;
+    const uint8_t *header;
+    section_t *section;
+    uint64_t section_offset, flags, type;
+    uint16_t section_size, count, i;
+    bool elf64;
+    long length;
+
+    file = fopen( name, "rb" );
+    if( file == NULL ) {
+        perror( name );
+        return false;
+    }
+    fseek( file, 0, SEEK_END );
+    length = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    image.data = malloc( length );
+    if( ( image.data == NULL ) || ( fread( image.data, 1, length, file ) != (size_t) length ) ) {
+        fprintf( stderr, "%s: unable to read\n", name );
+        fclose( file );
+        return false;
+    }
+    fclose( file );
+    image.length = length;
+    header = image.data;
+    if( ( image.length < 64 ) || ( memcmp( header, "\177ELF", 4 ) != 0 ) || ( header[ EI_DATA ] != ELFDATA2LSB ) ||
+        ( ( header[ EI_CLASS ] != ELFCLASS32 ) && ( header[ EI_CLASS ] != ELFCLASS64 ) ) ) {
+        fprintf( stderr, "%s: not a little endian ELF file\n", name );
+        return false;
+    }
+    elf64 = ( header[ EI_CLASS ] == ELFCLASS64 );
+    section_offset = elf64 ? get_le( header + 0x28, 8 ) : get_le( header + 0x20, 4 );
+    section_size = get_le( header + ( elf64 ? 0x3A : 0x2E ), 2 );
+    count = get_le( header + ( elf64 ? 0x3C : 0x30 ), 2 );
+    if( ( section_offset + (uint64_t) count * section_size ) > image.length ) {
+        fprintf( stderr, "%s: section headers past the end of the file\n", name );
+        return false;
+    }
+    image.sections = calloc( count, sizeof( section_t ) );
+    for( i = 0; i < count; i++ ) {
+        header = image.data + section_offset + (uint64_t) i * section_size;
+        type = get_le( header + 4, 4 );
+        flags = elf64 ? get_le( header + 8, 8 ) : get_le( header + 8, 4 );
+        if( ( type == SHT_NOBITS ) || ( ( flags & SHF_ALLOC ) == 0 ) )
+            continue;
+        section = &image.sections[ image.no_sections ];
+        section->address = elf64 ? get_le( header + 0x10, 8 ) : get_le( header + 0x0C, 4 );
+        section->offset = elf64 ? get_le( header + 0x18, 8 ) : get_le( header + 0x10, 4 );
+        section->size = elf64 ? get_le( header + 0x20, 8 ) : get_le( header + 0x14, 4 );
+        if( ( section->offset + section->size ) <= image.length )
+            image.no_sections += 1;
+    }
+    return true;
+}
+/**
+  * @brief  Find a NUL terminated string at a device address in the image
+  * @param  address
+  * @retval : string, NULL if not in the image or not terminated within the section
+  */
+static const char *image_string( uint32_t address )
+{
+    const section_t *section;
+    const char *string;
+    uint32_t i;
+
+    for( i = 0; i < image.no_sections; i++ ) {
+        section = &image.sections[ i ];
+        if( ( address >= section->address ) && ( address < section->address + section->size ) ) {
+            string = (const char *) image.data + section->offset + ( address - section->address );
+            if( memchr( string, '\0', section->address + section->size - address ) == NULL )
+                return NULL;
+            return string;
+        }
+    }
+    return NULL;
+}
+/**
+  * @brief  Print a record as the device would, one argument per conversion
+  * @param  record
+  * @retval : None
+  */
+static void print_record( const record_t *record )
+{
+    const char *text, *format, *string, *start;
+    char spec[ MAX_SPEC ], buffer[ MAX_STRING + 16 ];
+    uint16_t next_arg, length;
+    uint32_t arg;
+
+    printf( "%06u.%03u: ", record->time / 1000, record->time % 1000 );
+    text = image_string( record->format );
+    if( text == NULL ) {
+        printf( "<format 0x%08x not in image> %08x %08x %08x %08x %08x\n", record->format,
+                record->arg[ 0 ], record->arg[ 1 ], record->arg[ 2 ], record->arg[ 3 ], record->arg[ 4 ] );
+        return;
+    }
+    format = text;
+    next_arg = 0;
+    while( *format != '\0' ) {
+        if( *format != '%' ) {
+            if( *format != '\r' )               // Device line endings are \r\n
+                putchar( *format );
+            format += 1;
+            continue;
+        }
+        if( format[ 1 ] == '%' ) {
+            putchar( '%' );
+            format += 2;
+            continue;
+        }
+        /*
+         * Copy the flags, width and precision, dropping length modifiers, taking any * from the arguments
+         */
+        start = format;
+        length = 0;
+        spec[ length++ ] = *format++;
+        while( ( *format != '\0' ) && ( strchr( "-+ #0123456789.*lhzjt", *format ) != NULL ) && ( length < MAX_SPEC - 16 ) ) {
+            if( *format == '*' ) {
+                arg = ( next_arg < TRACE_ARGS ) ? record->arg[ next_arg++ ] : 0;
+                length += sprintf( &spec[ length ], "%d", (int32_t) arg );
+            } else if( strchr( "lhzjt", *format ) == NULL )
+                spec[ length++ ] = *format;
+            format += 1;
+        }
+        if( *format == '\0' ) {
+            fputs( start, stdout );
+            break;
+        }
+        spec[ length++ ] = *format;
+        spec[ length ] = '\0';
+        arg = ( next_arg < TRACE_ARGS ) ? record->arg[ next_arg++ ] : 0;
+        switch( *format ) {
+            case 'd' :
+            case 'i' :
+                printf( spec, (int32_t) arg );
+                break;
+            case 'u' :
+            case 'x' :
+            case 'X' :
+            case 'o' :
+                printf( spec, arg );
+                break;
+            case 'c' :
+                printf( spec, (int) (uint8_t) arg );
+                break;
+            case 'p' :
+                printf( "0x%08x", arg );
+                break;
+            case 's' :
+                string = image_string( arg );
+                if( string == NULL ) {
+                    snprintf( buffer, sizeof( buffer ), "<0x%08x>", arg );
+                    string = buffer;
+                } else if( strlen( string ) > MAX_STRING ) {
+                    snprintf( buffer, sizeof( buffer ), "%.*s...", MAX_STRING, string );
+                    string = buffer;
+                }
+                printf( spec, string );
+                break;
+            default :                           // Not recorded by TRACE(), print as is
+                fwrite( start, 1, format + 1 - start, stdout );
+                next_arg -= 1;
+                break;
+        }
+        format += 1;
+    }
+    if( ( format == text ) || ( format[ -1 ] != '\n' ) )
+        putchar( '\n' );
+}
+/**
+  * @brief  Decode lines of 8 hex words, other lines - headers and prompts - are skipped
+  * @param  file
+  * @retval : records decoded
+  */
+static uint32_t decode_text( FILE *file )
+{
+    char line[ MAX_LINE ];
+    char *position, *end;
+    uint32_t words[ TRACE_RECORD_WORDS ];
+    uint32_t count;
+    uint16_t i;
+    record_t record;
+
+    count = 0;
+    while( fgets( line, sizeof( line ), file ) != NULL ) {
+        position = line;
+        for( i = 0; i < TRACE_RECORD_WORDS; i++ ) {
+            while( isspace( (unsigned char) *position ) )
+                position += 1;
+            words[ i ] = strtoul( position, &end, 16 );
+            if( ( end - position ) != 8 )
+                break;
+            position = end;
+        }
+        if( i != TRACE_RECORD_WORDS )
+            continue;
+        record.sequence = words[ 0 ];
+        record.time = words[ 1 ];
+        record.format = words[ 2 ];
+        memcpy( record.arg, &words[ 3 ], sizeof( record.arg ) );
+        print_record( &record );
+        count += 1;
+    }
+    return count;
+}
+
+static int compare_sequence( const void *a, const void *b )
+{
+    const record_t *first = a, *second = b;
+
+    return ( first->sequence < second->sequence ) ? -1 : ( first->sequence > second->sequence );
+}
+/**
+  * @brief  Decode a binary copy of the flash mirror - blank slots and records never completed are skipped
+  * @param  file
+  * @retval : records decoded
+  */
+static uint32_t decode_binary( FILE *file )
+{
+    uint8_t data[ sizeof( record_t ) ];
+    record_t *records;
+    uint32_t count, size, i;
+
+    count = 0;
+    size = 0;
+    records = NULL;
+    while( fread( data, 1, sizeof( data ), file ) == sizeof( data ) ) {
+        if( count == size ) {
+            size = ( size == 0 ) ? 1024 : size * 2;
+            records = realloc( records, size * sizeof( record_t ) );
+        }
+        records[ count ].format = get_le( data, 4 );
+        records[ count ].time = get_le( data + 4, 4 );
+        records[ count ].sequence = get_le( data + 8, 4 );
+        for( i = 0; i < TRACE_ARGS; i++ )
+            records[ count ].arg[ i ] = get_le( data + 12 + ( i * 4 ), 4 );
+        if( ( records[ count ].sequence != TRACE_BLANK ) && ( records[ count ].sequence != 0 ) )
+            count += 1;
+    }
+    qsort( records, count, sizeof( record_t ), compare_sequence );
+    for( i = 0; i < count; i++ )
+        print_record( &records[ i ] );
+    free( records );
+    return count;
+}
+
+int main( int argc, char *argv[] )
+{
+    FILE *file;
+    bool binary;
+    int arg;
+
+    binary = false;
+    arg = 1;
+    if( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-b" ) == 0 ) ) {
+        binary = true;
+        arg += 1;
+    }
+    if( ( argc - arg < 1 ) || ( argc - arg > 2 ) || ( binary && ( argc - arg != 2 ) ) ) {
+        fprintf( stderr, "Usage: trace_decode image.elf [ capture.txt ]\n       trace_decode -b image.elf mirror.bin\n" );
+        return 2;
+    }
+    if( load_image( argv[ arg ] ) == false )
+        return 1;
+    file = stdin;
+    if( argc - arg == 2 ) {
+        file = fopen( argv[ arg + 1 ], binary ? "rb" : "r" );
+        if( file == NULL ) {
+            perror( argv[ arg + 1 ] );
+            return 1;
+        }
+    }
+    if( binary )
+        decode_binary( file );
+    else
+        decode_text( file );
+    if( file != stdin )
+        fclose( file );
+    return 0;
+}